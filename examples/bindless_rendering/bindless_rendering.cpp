@@ -35,6 +35,7 @@
 #include <donut/core/vfs/VFS.h>
 #include <donut/core/math/math.h>
 #include <nvrhi/utils.h>
+#include <BindlessDescriptorTable.h>
 
 using namespace donut;
 using namespace donut::math;
@@ -90,15 +91,7 @@ public:
         m_VertexShader = m_ShaderFactory->CreateShader("/shaders/app/bindless_rendering.hlsl", "vs_main", nullptr, nvrhi::ShaderType::Vertex);
         m_PixelShader = m_ShaderFactory->CreateShader("/shaders/app/bindless_rendering.hlsl", "ps_main", nullptr, nvrhi::ShaderType::Pixel);
 
-        nvrhi::BindlessLayoutDesc bindlessLayoutDesc;
-        bindlessLayoutDesc.visibility = nvrhi::ShaderType::All;
-        bindlessLayoutDesc.firstSlot = 0;
-        bindlessLayoutDesc.maxCapacity = 1024;
-        bindlessLayoutDesc.registerSpaces = {
-            nvrhi::BindingLayoutItem::RawBuffer_SRV(1),
-            nvrhi::BindingLayoutItem::Texture_SRV(2)
-        };
-        m_BindlessLayout = GetDevice()->createBindlessLayout(bindlessLayoutDesc);
+        m_BindlessLayout = CreateSceneBindlessLayout(GetDevice());
 
         m_DescriptorTableManager = std::make_shared<engine::DescriptorTableManager>(GetDevice(), m_BindlessLayout);
 
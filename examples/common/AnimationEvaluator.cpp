@@ -0,0 +1,513 @@
+/*
+* Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#include "AnimationEvaluator.h"
+
+#include <donut/engine/SceneGraph.h>
+#include <donut/engine/KeyframeAnimation.h>
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+
+#ifdef DONUT_WITH_TASKFLOW
+#include <taskflow/taskflow.hpp>
+#endif
+
+using namespace donut;
+using namespace donut::math;
+using namespace donut::engine;
+
+static constexpr uint32_t c_NumInterpolationModes = uint32_t(animation::InterpolationMode::HermiteSpline) + 1;
+
+// Number of channels evaluated together; every lane loop below runs over this many channels
+static constexpr uint32_t c_BatchSize = 16;
+
+// Number of batches per task when evaluating on an executor
+static constexpr uint32_t c_BatchesPerTask = 16;
+
+// Keyframe values for one batch of channels, one array per vector component.
+// For spline interpolation, p0..p3 are the 4 keyframes around the segment (Catmull-Rom),
+// or the start value, start out-tangent, end in-tangent and end value (Hermite).
+struct alignas(64) KeyframeBatch
+{
+    float u[c_BatchSize];
+    float dt[c_BatchSize];
+    float p0[4][c_BatchSize];
+    float p1[4][c_BatchSize];
+    float p2[4][c_BatchSize];
+    float p3[4][c_BatchSize];
+    float result[4][c_BatchSize];
+};
+
+static void InterpolateStep(KeyframeBatch& batch, uint32_t count)
+{
+    for (int comp = 0; comp < 4; comp++)
+        for (uint32_t lane = 0; lane < count; lane++)
+            batch.result[comp][lane] = batch.p1[comp][lane];
+}
+
+static void InterpolateLinear(KeyframeBatch& batch, uint32_t count)
+{
+    for (int comp = 0; comp < 4; comp++)
+        for (uint32_t lane = 0; lane < count; lane++)
+            batch.result[comp][lane] = batch.p1[comp][lane] + (batch.p2[comp][lane] - batch.p1[comp][lane]) * batch.u[lane];
+}
+
+static void InterpolateSlerp(KeyframeBatch& batch, uint32_t count)
+{
+    float w1[c_BatchSize];
+    float w2[c_BatchSize];
+
+    for (uint32_t lane = 0; lane < count; lane++)
+    {
+        float cosTheta = 0.f;
+        for (int comp = 0; comp < 4; comp++)
+            cosTheta += batch.p1[comp][lane] * batch.p2[comp][lane];
+
+        // Interpolate along the shortest path
+        const float sign = cosTheta < 0.f ? -1.f : 1.f;
+        cosTheta = std::min(cosTheta * sign, 1.f);
+
+        // Fall back to linear interpolation for nearly identical rotations, the result is normalized below
+        const float u = batch.u[lane];
+        const float theta = std::acos(cosTheta);
+        const float sinTheta = std::max(std::sin(theta), 1e-6f);
+        const bool nearlyParallel = cosTheta > 0.9995f;
+
+        w1[lane] = nearlyParallel ? 1.f - u : std::sin((1.f - u) * theta) / sinTheta;
+        w2[lane] = (nearlyParallel ? u : std::sin(u * theta) / sinTheta) * sign;
+    }
+
+    for (int comp = 0; comp < 4; comp++)
+        for (uint32_t lane = 0; lane < count; lane++)
+            batch.result[comp][lane] = batch.p1[comp][lane] * w1[lane] + batch.p2[comp][lane] * w2[lane];
+}
+
+static void InterpolateCatmullRom(KeyframeBatch& batch, uint32_t count)
+{
+    // https://en.wikipedia.org/wiki/Cubic_Hermite_spline#Interpolation_on_the_unit_interval_with_matched_derivatives_at_endpoints
+    for (int comp = 0; comp < 4; comp++)
+    {
+        for (uint32_t lane = 0; lane < count; lane++)
+        {
+            const float a = batch.p0[comp][lane];
+            const float b = batch.p1[comp][lane];
+            const float c = batch.p2[comp][lane];
+            const float d = batch.p3[comp][lane];
+            const float t = batch.u[lane];
+
+            const float i = -a + 3.f * b - 3.f * c + d;
+            const float j = 2.f * a - 5.f * b + 4.f * c - d;
+            const float k = -a + c;
+            batch.result[comp][lane] = 0.5f * ((i * t + j) * t + k) * t + b;
+        }
+    }
+}
+
+static void InterpolateHermite(KeyframeBatch& batch, uint32_t count)
+{
+    // https://github.com/KhronosGroup/glTF/tree/master/specification/2.0#appendix-c-spline-interpolation
+    for (int comp = 0; comp < 4; comp++)
+    {
+        for (uint32_t lane = 0; lane < count; lane++)
+        {
+            const float t = batch.u[lane];
+            const float t2 = t * t;
+            const float t3 = t2 * t;
+            const float dt = batch.dt[lane];
+
+            batch.result[comp][lane] = (2.f * t3 - 3.f * t2 + 1.f) * batch.p0[comp][lane]
+                + (t3 - 2.f * t2 + t) * batch.p1[comp][lane] * dt
+                + (-2.f * t3 + 3.f * t2) * batch.p3[comp][lane]
+                + (t3 - t2) * batch.p2[comp][lane] * dt;
+        }
+    }
+}
+
+static void StoreLane(float dst[4][c_BatchSize], uint32_t lane, const float4& value)
+{
+    dst[0][lane] = value.x;
+    dst[1][lane] = value.y;
+    dst[2][lane] = value.z;
+    dst[3][lane] = value.w;
+}
+
+void AnimationEvaluator::Clear()
+{
+    m_AnimationDurations.clear();
+    m_AnimationTimes.clear();
+    m_ChannelAnimation.clear();
+    m_ChannelTarget.clear();
+    m_ChannelComponent.clear();
+    m_ChannelFirstKey.clear();
+    m_ChannelNumKeys.clear();
+    m_ChannelCursor.clear();
+    m_ChannelValues.clear();
+    m_ChannelChanged.clear();
+    m_ModeRanges.clear();
+    m_KeyTimes.clear();
+    m_KeyValues.clear();
+    m_KeyInTangents.clear();
+    m_KeyOutTangents.clear();
+    m_Transforms.clear();
+    m_TargetComponents.clear();
+    m_TargetChannels.clear();
+    m_TargetChannelIndices.clear();
+    m_TargetNodes.clear();
+    m_FallbackChannels.clear();
+}
+
+void AnimationEvaluator::Init(const SceneGraph& sceneGraph)
+{
+    Clear();
+
+    struct PendingChannel
+    {
+        uint32_t animation;
+        uint32_t target;
+        Component component;
+        uint32_t mode;
+        const std::vector<animation::Keyframe>* keyframes;
+    };
+
+    std::vector<PendingChannel> pendingChannels;
+    std::unordered_map<SceneGraphNode*, uint32_t> targetIndices;
+
+    const auto& animations = sceneGraph.GetAnimations();
+    for (uint32_t animationIndex = 0; animationIndex < uint32_t(animations.size()); animationIndex++)
+    {
+        const auto& anim = animations[animationIndex];
+        m_AnimationDurations.push_back(anim->GetDuration());
+
+        for (const auto& channel : anim->GetChannels())
+        {
+            const auto& sampler = channel->GetSampler();
+            std::shared_ptr<SceneGraphNode> node = channel->GetTargetNode();
+
+            if (!sampler || sampler->GetKeyframes().empty())
+                continue;
+
+            Component component;
+            switch (channel->GetAttribute())
+            {
+            case AnimationAttribute::Translation: component = Translation; break;
+            case AnimationAttribute::Rotation: component = Rotation; break;
+            case AnimationAttribute::Scaling: component = Scaling; break;
+            default:
+                // Leaf properties are rare, keep applying them through the channel
+                m_FallbackChannels.push_back({ channel, animationIndex });
+                continue;
+            }
+
+            if (!node)
+                continue;
+
+            auto [it, inserted] = targetIndices.try_emplace(node.get(), uint32_t(m_TargetNodes.size()));
+            if (inserted)
+            {
+                // Start from the current node transform so that components without channels are preserved
+                AnimatedTransform transform;
+                transform.translation = float3(node->GetTranslation());
+                transform.rotation = float4(float(node->GetRotation().x), float(node->GetRotation().y),
+                    float(node->GetRotation().z), float(node->GetRotation().w));
+                transform.scaling = float3(node->GetScaling());
+
+                m_TargetNodes.push_back(node);
+                m_Transforms.push_back(transform);
+                m_TargetComponents.push_back(0);
+            }
+
+            m_TargetComponents[it->second] |= uint8_t(1 << component);
+            pendingChannels.push_back({ animationIndex, it->second, component, uint32_t(sampler->GetMode()), &sampler->GetKeyframes() });
+        }
+    }
+
+    m_AnimationTimes.resize(m_AnimationDurations.size(), 0.f);
+
+    // Group the channels by interpolation mode so that every batch is interpolated the same way
+    std::stable_sort(pendingChannels.begin(), pendingChannels.end(),
+        [](const PendingChannel& a, const PendingChannel& b) { return a.mode < b.mode; });
+
+    m_ModeRanges.resize(c_NumInterpolationModes);
+
+    for (uint32_t channelIndex = 0; channelIndex < uint32_t(pendingChannels.size()); channelIndex++)
+    {
+        const PendingChannel& pending = pendingChannels[channelIndex];
+
+        m_ChannelAnimation.push_back(pending.animation);
+        m_ChannelTarget.push_back(pending.target);
+        m_ChannelComponent.push_back(pending.component);
+        m_ChannelFirstKey.push_back(uint32_t(m_KeyTimes.size()));
+        m_ChannelNumKeys.push_back(uint32_t(pending.keyframes->size()));
+        m_ChannelCursor.push_back(0);
+        m_ChannelValues.push_back(float4(0.f));
+        m_ChannelChanged.push_back(0);
+
+        for (const animation::Keyframe& keyframe : *pending.keyframes)
+        {
+            m_KeyTimes.push_back(keyframe.time);
+            m_KeyValues.push_back(keyframe.value);
+            m_KeyInTangents.push_back(keyframe.inTangent);
+            m_KeyOutTangents.push_back(keyframe.outTangent);
+        }
+
+        ChannelRange& range = m_ModeRanges[std::min(pending.mode, c_NumInterpolationModes - 1)];
+        if (range.begin == range.end)
+            range.begin = channelIndex;
+        range.end = channelIndex + 1;
+    }
+
+    // Build the lists of channels affecting each target
+    m_TargetChannels.resize(m_TargetNodes.size());
+    for (uint32_t target : m_ChannelTarget)
+        ++m_TargetChannels[target].end;
+
+    uint32_t offset = 0;
+    for (ChannelRange& range : m_TargetChannels)
+    {
+        range.begin = offset;
+        offset += range.end;
+        range.end = range.begin;
+    }
+
+    m_TargetChannelIndices.resize(m_ChannelTarget.size());
+    for (uint32_t channelIndex = 0; channelIndex < uint32_t(m_ChannelTarget.size()); channelIndex++)
+        m_TargetChannelIndices[m_TargetChannels[m_ChannelTarget[channelIndex]].end++] = channelIndex;
+}
+
+#ifdef DONUT_WITH_TASKFLOW
+void AnimationEvaluator::Evaluate(float time, float animationTimeOffset, tf::Executor* executor)
+#else
+void AnimationEvaluator::Evaluate(float time, float animationTimeOffset)
+#endif
+{
+    for (size_t animationIndex = 0; animationIndex < m_AnimationTimes.size(); animationIndex++)
+    {
+        const float duration = m_AnimationDurations[animationIndex];
+        float animationTime = time + float(animationIndex) * animationTimeOffset;
+
+        if (duration > 0.f)
+        {
+            float integral;
+            animationTime = std::modf(animationTime / duration, &integral) * duration;
+        }
+
+        m_AnimationTimes[animationIndex] = animationTime;
+    }
+
+#ifdef DONUT_WITH_TASKFLOW
+    if (executor)
+    {
+        tf::Taskflow taskflow;
+
+        for (uint32_t mode = 0; mode < uint32_t(m_ModeRanges.size()); mode++)
+        {
+            const ChannelRange range = m_ModeRanges[mode];
+            const uint32_t channelsPerTask = c_BatchSize * c_BatchesPerTask;
+
+            for (uint32_t taskBegin = range.begin; taskBegin < range.end; taskBegin += channelsPerTask)
+            {
+                const uint32_t taskEnd = std::min(taskBegin + channelsPerTask, range.end);
+
+                taskflow.emplace([this, mode, taskBegin, taskEnd]()
+                {
+                    for (uint32_t first = taskBegin; first < taskEnd; first += c_BatchSize)
+                        EvaluateBatch(mode, first, std::min(c_BatchSize, taskEnd - first));
+                });
+            }
+        }
+
+        executor->run(taskflow).wait();
+        MergeTargets();
+        return;
+    }
+#endif
+
+    for (uint32_t mode = 0; mode < uint32_t(m_ModeRanges.size()); mode++)
+    {
+        const ChannelRange range = m_ModeRanges[mode];
+
+        for (uint32_t first = range.begin; first < range.end; first += c_BatchSize)
+            EvaluateBatch(mode, first, std::min(c_BatchSize, range.end - first));
+    }
+
+    MergeTargets();
+}
+
+void AnimationEvaluator::EvaluateBatch(uint32_t mode, uint32_t firstChannel, uint32_t numChannels)
+{
+    const auto interpolationMode = animation::InterpolationMode(mode);
+
+    KeyframeBatch batch;
+
+    // Find the keyframe segment for every channel and gather the keyframe values
+    for (uint32_t lane = 0; lane < numChannels; lane++)
+    {
+        const uint32_t channel = firstChannel + lane;
+        const float time = m_AnimationTimes[m_ChannelAnimation[channel]];
+        const uint32_t firstKey = m_ChannelFirstKey[channel];
+        const uint32_t numKeys = m_ChannelNumKeys[channel];
+        const float* keyTimes = m_KeyTimes.data() + firstKey;
+
+        // Start from the segment used last time. Time moving forward only needs to step over
+        // a few keyframes; time moving backward, e.g. when the animation loops, needs a search.
+        uint32_t cursor = m_ChannelCursor[channel];
+        if (time < keyTimes[cursor])
+            cursor = uint32_t(std::max<ptrdiff_t>(std::upper_bound(keyTimes, keyTimes + numKeys, time) - keyTimes - 1, 0));
+
+        while (cursor + 1 < numKeys && time >= keyTimes[cursor + 1])
+            ++cursor;
+
+        m_ChannelCursor[channel] = cursor;
+
+        // Before the first or after the last keyframe, hold the value of that keyframe
+        uint32_t b = cursor;
+        uint32_t c = cursor;
+        float u = 0.f;
+        float dt = 0.f;
+
+        if (cursor + 1 < numKeys && time > keyTimes[cursor])
+        {
+            c = cursor + 1;
+            dt = keyTimes[c] - keyTimes[b];
+            u = (time - keyTimes[b]) / dt;
+        }
+
+        batch.u[lane] = u;
+        batch.dt[lane] = dt;
+
+        switch (interpolationMode)
+        {
+        case animation::InterpolationMode::CatmullRomSpline: {
+            const uint32_t a = (c != b && b > 0) ? b - 1 : b;
+            const uint32_t d = (c != b && c + 1 < numKeys) ? c + 1 : c;
+            StoreLane(batch.p0, lane, m_KeyValues[firstKey + a]);
+            StoreLane(batch.p1, lane, m_KeyValues[firstKey + b]);
+            StoreLane(batch.p2, lane, m_KeyValues[firstKey + c]);
+            StoreLane(batch.p3, lane, m_KeyValues[firstKey + d]);
+            break;
+        }
+        case animation::InterpolationMode::HermiteSpline:
+            StoreLane(batch.p0, lane, m_KeyValues[firstKey + b]);
+            StoreLane(batch.p1, lane, m_KeyOutTangents[firstKey + b]);
+            StoreLane(batch.p2, lane, m_KeyInTangents[firstKey + c]);
+            StoreLane(batch.p3, lane, m_KeyValues[firstKey + c]);
+            break;
+        default:
+            StoreLane(batch.p1, lane, m_KeyValues[firstKey + b]);
+            StoreLane(batch.p2, lane, m_KeyValues[firstKey + c]);
+            break;
+        }
+    }
+
+    switch (interpolationMode)
+    {
+    case animation::InterpolationMode::Step: InterpolateStep(batch, numChannels); break;
+    case animation::InterpolationMode::Linear: InterpolateLinear(batch, numChannels); break;
+    case animation::InterpolationMode::Slerp: InterpolateSlerp(batch, numChannels); break;
+    case animation::InterpolationMode::CatmullRomSpline: InterpolateCatmullRom(batch, numChannels); break;
+    case animation::InterpolationMode::HermiteSpline: InterpolateHermite(batch, numChannels); break;
+    default: InterpolateLinear(batch, numChannels); break;
+    }
+
+    // Channels of one target can be in different batches, so the results are merged into the transforms later
+    for (uint32_t lane = 0; lane < numChannels; lane++)
+        m_ChannelValues[firstChannel + lane] = float4(batch.result[0][lane], batch.result[1][lane], batch.result[2][lane], batch.result[3][lane]);
+}
+
+void AnimationEvaluator::MergeTargets()
+{
+    // The channels of every target are applied in channel order, so when several animations drive the same
+    // component of a node, the same one wins every frame
+    for (uint32_t target = 0; target < uint32_t(m_TargetChannels.size()); target++)
+    {
+        AnimatedTransform& transform = m_Transforms[target];
+        const ChannelRange range = m_TargetChannels[target];
+
+        for (uint32_t index = range.begin; index < range.end; index++)
+        {
+            const uint32_t channel = m_TargetChannelIndices[index];
+            float4 value = m_ChannelValues[channel];
+            bool changed = false;
+
+            switch (m_ChannelComponent[channel])
+            {
+            case Translation:
+                changed = any(value.xyz() != transform.translation);
+                transform.translation = value.xyz();
+                break;
+            case Rotation: {
+                const float len = length(value);
+                value = len > 0.f ? value / len : float4(0.f, 0.f, 0.f, 1.f);
+                changed = any(value != transform.rotation);
+                transform.rotation = value;
+                break;
+            }
+            case Scaling:
+                changed = any(value.xyz() != transform.scaling);
+                transform.scaling = value.xyz();
+                break;
+            }
+
+            m_ChannelChanged[channel] = changed ? 1 : 0;
+        }
+    }
+}
+
+bool AnimationEvaluator::IsTargetChanged(size_t target) const
+{
+    const ChannelRange range = m_TargetChannels[target];
+
+    for (uint32_t index = range.begin; index < range.end; index++)
+    {
+        if (m_ChannelChanged[m_TargetChannelIndices[index]])
+            return true;
+    }
+
+    return false;
+}
+
+void AnimationEvaluator::ApplyToSceneGraph()
+{
+    for (uint32_t target = 0; target < uint32_t(m_TargetNodes.size()); target++)
+    {
+        if (!IsTargetChanged(target))
+            continue;
+
+        const AnimatedTransform& transform = m_Transforms[target];
+        const uint8_t components = m_TargetComponents[target];
+
+        const double3 translation = double3(transform.translation);
+        const dquat rotation = dquat::fromXYZW(double4(transform.rotation));
+        const double3 scaling = double3(transform.scaling);
+
+        m_TargetNodes[target]->SetTransform(
+            (components & (1 << Translation)) ? &translation : nullptr,
+            (components & (1 << Rotation)) ? &rotation : nullptr,
+            (components & (1 << Scaling)) ? &scaling : nullptr);
+    }
+
+    for (const FallbackChannel& fallback : m_FallbackChannels)
+    {
+        (void)fallback.channel->Apply(m_AnimationTimes[fallback.animation]);
+    }
+}
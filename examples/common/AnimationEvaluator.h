@@ -0,0 +1,138 @@
+/*
+* Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <donut/core/math/math.h>
+#include <memory>
+#include <vector>
+
+#ifdef DONUT_WITH_TASKFLOW
+namespace tf
+{
+    class Executor;
+}
+#endif
+
+namespace donut::engine
+{
+    class SceneGraph;
+    class SceneGraphNode;
+    class SceneGraphAnimationChannel;
+}
+
+// Evaluated local transform of one animated scene graph node.
+struct AnimatedTransform
+{
+    donut::math::float3 translation = 0.f;
+    donut::math::float4 rotation = donut::math::float4(0.f, 0.f, 0.f, 1.f); // quaternion, xyzw
+    donut::math::float3 scaling = 1.f;
+};
+
+// Evaluates all keyframe animations in a scene graph.
+//
+// The keyframes of all channels are stored as structure-of-arrays, and every channel keeps
+// a cursor to the keyframe segment it sampled last, so advancing the time monotonically
+// finds the new segment in O(1). Channels are grouped by interpolation mode and evaluated
+// in fixed-size batches with one loop per vector component, which the compiler vectorizes.
+// Batches only write the values of their own channels, so they can run in parallel. The values
+// are then merged per target into a flat array of transforms, one per animated node, and are
+// written into the scene graph with one call per node that actually changed.
+class AnimationEvaluator
+{
+public:
+    // Rebuilds the track storage from the animations in the scene graph.
+    // Must be called after loading a scene and whenever the set of animations changes.
+    void Init(const donut::engine::SceneGraph& sceneGraph);
+    void Clear();
+
+    // Samples every animation 'i' at (time + i * animationTimeOffset), wrapped to its duration.
+#ifdef DONUT_WITH_TASKFLOW
+    void Evaluate(float time, float animationTimeOffset = 0.f, tf::Executor* executor = nullptr);
+#else
+    void Evaluate(float time, float animationTimeOffset = 0.f);
+#endif
+
+    // Writes the transforms of the nodes whose animated values changed in the last Evaluate call
+    // into the scene graph, and applies the channels that don't animate transforms.
+    void ApplyToSceneGraph();
+
+    [[nodiscard]] const std::vector<AnimatedTransform>& GetTransforms() const { return m_Transforms; }
+    [[nodiscard]] const std::vector<std::shared_ptr<donut::engine::SceneGraphNode>>& GetTargetNodes() const { return m_TargetNodes; }
+    [[nodiscard]] size_t GetNumChannels() const { return m_ChannelTarget.size(); }
+
+    // Returns true if any animated component of the target changed in the last Evaluate call.
+    [[nodiscard]] bool IsTargetChanged(size_t target) const;
+
+private:
+    enum Component : uint8_t
+    {
+        Translation,
+        Rotation,
+        Scaling
+    };
+
+    struct ChannelRange
+    {
+        uint32_t begin = 0;
+        uint32_t end = 0;
+    };
+
+    struct FallbackChannel
+    {
+        std::shared_ptr<donut::engine::SceneGraphAnimationChannel> channel;
+        uint32_t animation = 0;
+    };
+
+    // Per-animation data
+    std::vector<float> m_AnimationDurations;
+    std::vector<float> m_AnimationTimes;
+
+    // Per-channel data, sorted by interpolation mode
+    std::vector<uint32_t> m_ChannelAnimation;
+    std::vector<uint32_t> m_ChannelTarget;
+    std::vector<Component> m_ChannelComponent;
+    std::vector<uint32_t> m_ChannelFirstKey;
+    std::vector<uint32_t> m_ChannelNumKeys;
+    std::vector<uint32_t> m_ChannelCursor;
+    std::vector<donut::math::float4> m_ChannelValues;
+    std::vector<uint8_t> m_ChannelChanged;
+    std::vector<ChannelRange> m_ModeRanges;
+
+    // Per-keyframe data
+    std::vector<float> m_KeyTimes;
+    std::vector<donut::math::float4> m_KeyValues;
+    std::vector<donut::math::float4> m_KeyInTangents;
+    std::vector<donut::math::float4> m_KeyOutTangents;
+
+    // Per-target data
+    std::vector<AnimatedTransform> m_Transforms;
+    std::vector<uint8_t> m_TargetComponents;
+    std::vector<ChannelRange> m_TargetChannels;
+    std::vector<uint32_t> m_TargetChannelIndices;
+    std::vector<std::shared_ptr<donut::engine::SceneGraphNode>> m_TargetNodes;
+
+    std::vector<FallbackChannel> m_FallbackChannels;
+
+    void EvaluateBatch(uint32_t mode, uint32_t firstChannel, uint32_t numChannels);
+    void MergeTargets();
+};
@@ -0,0 +1,182 @@
+/*
+* Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#include "BarrierPlanner.h"
+
+#include <cassert>
+
+void BarrierPlanner::BeginFrame()
+{
+    m_Passes.clear();
+    m_WrittenResources.clear();
+    m_NextPass = 0;
+}
+
+uint32_t BarrierPlanner::AddPass(const char* name)
+{
+    Pass& pass = m_Passes.emplace_back();
+    pass.name = name;
+    return uint32_t(m_Passes.size() - 1);
+}
+
+void BarrierPlanner::ReadTexture(uint32_t pass, nvrhi::ITexture* texture, nvrhi::ResourceStates state, nvrhi::TextureSubresourceSet subresources)
+{
+    Access& access = m_Passes[pass].accesses.emplace_back();
+    access.texture = texture;
+    access.subresources = subresources;
+    access.state = state;
+}
+
+void BarrierPlanner::WriteTexture(uint32_t pass, nvrhi::ITexture* texture, nvrhi::ResourceStates state, nvrhi::TextureSubresourceSet subresources)
+{
+    ReadTexture(pass, texture, state, subresources);
+    m_Passes[pass].accesses.back().write = true;
+}
+
+void BarrierPlanner::ReadBuffer(uint32_t pass, nvrhi::IBuffer* buffer, nvrhi::ResourceStates state)
+{
+    Access& access = m_Passes[pass].accesses.emplace_back();
+    access.buffer = buffer;
+    access.state = state;
+}
+
+void BarrierPlanner::WriteBuffer(uint32_t pass, nvrhi::IBuffer* buffer, nvrhi::ResourceStates state)
+{
+    ReadBuffer(pass, buffer, state);
+    m_Passes[pass].accesses.back().write = true;
+}
+
+void BarrierPlanner::WriteFramebuffer(uint32_t pass, nvrhi::IFramebuffer* framebuffer)
+{
+    const nvrhi::FramebufferDesc& desc = framebuffer->getDesc();
+
+    for (const nvrhi::FramebufferAttachment& attachment : desc.colorAttachments)
+        WriteTexture(pass, attachment.texture, nvrhi::ResourceStates::RenderTarget, attachment.subresources);
+
+    if (desc.depthAttachment.valid())
+    {
+        if (desc.depthAttachment.isReadOnly)
+            ReadTexture(pass, desc.depthAttachment.texture, nvrhi::ResourceStates::DepthRead, desc.depthAttachment.subresources);
+        else
+            WriteTexture(pass, desc.depthAttachment.texture, nvrhi::ResourceStates::DepthWrite, desc.depthAttachment.subresources);
+    }
+}
+
+bool BarrierPlanner::IsTransitionNeeded(nvrhi::ICommandList* commandList, const Access& access) const
+{
+    // Consecutive accesses in the UAV state need a barrier between them if either one writes
+    if (access.state == nvrhi::ResourceStates::UnorderedAccess
+        && (access.write || m_WrittenResources.count(access.GetResource())))
+        return true;
+
+    // Resources that the command list hasn't used yet start in their initial state if they keep it
+    if (access.buffer)
+    {
+        const nvrhi::BufferDesc& desc = access.buffer->getDesc();
+        nvrhi::ResourceStates state = commandList->getBufferState(access.buffer);
+        if (state == nvrhi::ResourceStates::Unknown && desc.keepInitialState)
+            state = desc.initialState;
+        return state != access.state;
+    }
+
+    const nvrhi::TextureDesc& desc = access.texture->getDesc();
+    const nvrhi::TextureSubresourceSet subresources = access.subresources.resolve(desc, false);
+    for (nvrhi::MipLevel mipLevel = subresources.baseMipLevel; mipLevel < subresources.baseMipLevel + subresources.numMipLevels; mipLevel++)
+    {
+        for (nvrhi::ArraySlice arraySlice = subresources.baseArraySlice; arraySlice < subresources.baseArraySlice + subresources.numArraySlices; arraySlice++)
+        {
+            nvrhi::ResourceStates state = commandList->getTextureSubresourceState(access.texture, arraySlice, mipLevel);
+            if (state == nvrhi::ResourceStates::Unknown && desc.keepInitialState)
+                state = desc.initialState;
+            if (state != access.state)
+                return true;
+        }
+    }
+
+    return false;
+}
+
+void BarrierPlanner::Issue(nvrhi::ICommandList* commandList, Access& access, PassStats& stats)
+{
+    access.issued = true;
+
+    if (!IsTransitionNeeded(commandList, access))
+    {
+        stats.transitionsAvoided++;
+        return;
+    }
+
+    if (access.buffer)
+        commandList->setBufferState(access.buffer, access.state);
+    else
+        commandList->setTextureState(access.texture, access.subresources, access.state);
+
+    stats.barriersIssued++;
+}
+
+bool BarrierPlanner::UsesResource(const Pass& pass, const nvrhi::IResource* resource)
+{
+    for (const Access& access : pass.accesses)
+    {
+        if (access.GetResource() == resource)
+            return true;
+    }
+
+    return false;
+}
+
+void BarrierPlanner::BeginPass(nvrhi::ICommandList* commandList, uint32_t passIndex)
+{
+    assert(passIndex == m_NextPass);
+    m_NextPass = passIndex + 1;
+
+    Pass& pass = m_Passes[passIndex];
+    for (Access& access : pass.accesses)
+    {
+        if (!access.issued)
+            Issue(commandList, access, pass.stats);
+    }
+
+    // Transitions of the next pass that don't depend on this one go into the same batch
+    if (m_NextPass < m_Passes.size())
+    {
+        Pass& nextPass = m_Passes[m_NextPass];
+        for (Access& access : nextPass.accesses)
+        {
+            // UAV accesses wait for the pass before them, there is nothing to move
+            if (access.issued || access.state == nvrhi::ResourceStates::UnorderedAccess || UsesResource(pass, access.GetResource()))
+                continue;
+
+            const uint32_t barriersIssued = nextPass.stats.barriersIssued;
+            Issue(commandList, access, nextPass.stats);
+            nextPass.stats.barriersHoisted += nextPass.stats.barriersIssued - barriersIssued;
+        }
+    }
+
+    for (const Access& access : pass.accesses)
+    {
+        if (access.write)
+            m_WrittenResources.insert(access.GetResource());
+    }
+
+    commandList->commitBarriers();
+}
@@ -0,0 +1,109 @@
+/*
+* Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <nvrhi/nvrhi.h>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+// Explicit resource transitions for a sequence of passes recorded into one command list.
+//
+// The passes of a frame are declared up front with the resources they read and write, and
+// BeginPass() then issues the transitions for a pass as one batch, without relying on the
+// automatic state tracking of the command list, which can be disabled around the passes.
+// Accesses that find their resource in the required state already are skipped and counted
+// as avoided. A write that follows another write in the UAV state gets a UAV barrier.
+//
+// NVRHI doesn't expose split barriers, so the planner does the next best thing: transitions of
+// the next pass for resources that the current pass doesn't touch are hoisted into the batch of
+// the current pass, which leaves fewer synchronization points between the passes.
+//
+// Planners keep their state per command list, so parallel recording needs one planner per list.
+class BarrierPlanner
+{
+public:
+    struct PassStats
+    {
+        uint32_t barriersIssued = 0;
+        uint32_t transitionsAvoided = 0;
+        // Issued at the boundary before the previous pass, counted in barriersIssued as well
+        uint32_t barriersHoisted = 0;
+    };
+
+    // Drops the passes of the previous frame and their stats
+    void BeginFrame();
+
+    // Declares the next pass and returns its index
+    uint32_t AddPass(const char* name);
+
+    void ReadTexture(uint32_t pass, nvrhi::ITexture* texture, nvrhi::ResourceStates state,
+        nvrhi::TextureSubresourceSet subresources = nvrhi::AllSubresources);
+    void WriteTexture(uint32_t pass, nvrhi::ITexture* texture, nvrhi::ResourceStates state,
+        nvrhi::TextureSubresourceSet subresources = nvrhi::AllSubresources);
+    void ReadBuffer(uint32_t pass, nvrhi::IBuffer* buffer, nvrhi::ResourceStates state);
+    void WriteBuffer(uint32_t pass, nvrhi::IBuffer* buffer, nvrhi::ResourceStates state);
+
+    // Declares the attachments of the framebuffer as written, or read for read-only depth
+    void WriteFramebuffer(uint32_t pass, nvrhi::IFramebuffer* framebuffer);
+
+    // Issues and commits the transitions of the pass, call before recording its commands.
+    // Passes must begin in the order they were added.
+    void BeginPass(nvrhi::ICommandList* commandList, uint32_t pass);
+
+    [[nodiscard]] uint32_t GetNumPasses() const { return uint32_t(m_Passes.size()); }
+    [[nodiscard]] const std::string& GetPassName(uint32_t pass) const { return m_Passes[pass].name; }
+    [[nodiscard]] const PassStats& GetPassStats(uint32_t pass) const { return m_Passes[pass].stats; }
+
+private:
+    struct Access
+    {
+        nvrhi::ITexture* texture = nullptr;
+        nvrhi::IBuffer* buffer = nullptr;
+        nvrhi::TextureSubresourceSet subresources;
+        nvrhi::ResourceStates state = nvrhi::ResourceStates::Unknown;
+        bool write = false;
+        bool issued = false;
+
+        [[nodiscard]] const nvrhi::IResource* GetResource() const
+        {
+            return texture ? static_cast<const nvrhi::IResource*>(texture) : buffer;
+        }
+    };
+
+    struct Pass
+    {
+        std::string name;
+        std::vector<Access> accesses;
+        PassStats stats;
+    };
+
+    bool IsTransitionNeeded(nvrhi::ICommandList* commandList, const Access& access) const;
+    void Issue(nvrhi::ICommandList* commandList, Access& access, PassStats& stats);
+    static bool UsesResource(const Pass& pass, const nvrhi::IResource* resource);
+
+    std::vector<Pass> m_Passes;
+    // Resources written by the passes that have begun, for UAV barriers
+    std::unordered_set<const nvrhi::IResource*> m_WrittenResources;
+    uint32_t m_NextPass = 0;
+};
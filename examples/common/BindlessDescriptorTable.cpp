@@ -0,0 +1,235 @@
+/*
+* Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#include "BindlessDescriptorTable.h"
+
+#include <donut/core/log.h>
+
+#include <algorithm>
+
+using namespace donut;
+
+BindlessDescriptorTable::Descriptor::~Descriptor()
+{
+    if (auto table = m_Table.lock())
+        table->Release(m_Index);
+}
+
+BindlessDescriptorTable::BindlessDescriptorTable(nvrhi::IDevice* device, nvrhi::IBindingLayout* layout, uint32_t initialCapacity, float compactionThreshold)
+    : m_Device(device)
+    , m_Layout(layout)
+    , m_CompactionThreshold(compactionThreshold)
+{
+    const nvrhi::BindlessLayoutDesc* layoutDesc = layout->getBindlessDesc();
+    m_MaxCapacity = (layoutDesc && layoutDesc->maxCapacity) ? layoutDesc->maxCapacity : ~0u;
+
+    const uint32_t capacity = std::min(std::max(initialCapacity, 1u), m_MaxCapacity);
+    m_Table = m_Device->createDescriptorTable(m_Layout);
+    m_Device->resizeDescriptorTable(m_Table, capacity, false);
+    m_Slots.resize(capacity);
+    m_Stats.capacity = capacity;
+}
+
+BindlessDescriptorTable::Handle BindlessDescriptorTable::CreateDescriptor(nvrhi::BindingSetItem item)
+{
+    uint32_t index;
+    if (!m_FreeSlots.empty())
+    {
+        index = m_FreeSlots.top();
+        m_FreeSlots.pop();
+    }
+    else
+    {
+        if (m_End == m_Slots.size() && !Grow())
+        {
+            log::error("BindlessDescriptorTable: the table is full at %u descriptors", uint32_t(m_Slots.size()));
+            return nullptr;
+        }
+
+        index = m_End++;
+    }
+
+    item.slot = index;
+    m_Device->writeDescriptorTable(m_Table, item);
+
+    auto descriptor = std::make_shared<Descriptor>();
+    descriptor->m_Table = weak_from_this();
+    descriptor->m_Index = index;
+
+    Slot& slot = m_Slots[index];
+    slot.item = item;
+    slot.owner = descriptor.get();
+    slot.state = SlotState::Used;
+
+    m_Stats.numUsed++;
+    m_Stats.highWaterMark = std::max(m_Stats.highWaterMark, index + 1);
+    UpdateFragmentation();
+
+    return descriptor;
+}
+
+void BindlessDescriptorTable::Release(uint32_t index)
+{
+    // The slot may be read by work in flight, it becomes free after the next submission completes
+    Slot& slot = m_Slots[index];
+    slot.item = nvrhi::BindingSetItem::None();
+    slot.owner = nullptr;
+    slot.state = SlotState::PendingRelease;
+    m_RecordedReleases.push_back(index);
+
+    m_Stats.numUsed--;
+    m_Stats.numPendingRelease++;
+    UpdateFragmentation();
+}
+
+bool BindlessDescriptorTable::Grow()
+{
+    const uint32_t capacity = uint32_t(m_Slots.size());
+    if (capacity >= m_MaxCapacity)
+        return false;
+
+    const uint32_t newCapacity = uint32_t(std::min(uint64_t(capacity) * 2, uint64_t(m_MaxCapacity)));
+
+    // Resizing in place would release the old descriptors while the GPU may still read them, so the
+    // live descriptors are written into a new table instead, and the old one is retired
+    nvrhi::DescriptorTableHandle table = m_Device->createDescriptorTable(m_Layout);
+    m_Device->resizeDescriptorTable(table, newCapacity, false);
+
+    for (uint32_t index = 0; index < m_End; index++)
+    {
+        if (m_Slots[index].state == SlotState::Used)
+            m_Device->writeDescriptorTable(table, m_Slots[index].item);
+    }
+
+    m_RetiredTables.push_back(m_Table);
+    m_Table = table;
+    m_Slots.resize(newCapacity);
+    m_Stats.capacity = newCapacity;
+    m_Stats.numGrowths++;
+    m_Version++;
+
+    return true;
+}
+
+void BindlessDescriptorTable::Compact()
+{
+    for (uint32_t moves = 0; moves < c_MaxMovesPerUpdate && m_Stats.fragmentation > m_CompactionThreshold; moves++)
+    {
+        if (m_FreeSlots.empty())
+            break;
+
+        // Highest used slot, skipping the ones that wait for their release
+        uint32_t source = m_Stats.highWaterMark;
+        while (source > 0 && m_Slots[source - 1].state != SlotState::Used)
+            source--;
+        if (source == 0)
+            break;
+        source--;
+
+        const uint32_t target = m_FreeSlots.top();
+        if (target >= source)
+            break;
+        m_FreeSlots.pop();
+
+        Slot& sourceSlot = m_Slots[source];
+        Slot& targetSlot = m_Slots[target];
+
+        targetSlot.item = sourceSlot.item;
+        targetSlot.item.slot = target;
+        targetSlot.owner = sourceSlot.owner;
+        targetSlot.state = SlotState::Used;
+        targetSlot.owner->m_Index = target;
+        m_Device->writeDescriptorTable(m_Table, targetSlot.item);
+        m_Stats.numUsed++;
+
+        // Work in flight still uses the old index
+        sourceSlot.owner = nullptr;
+        Release(source);
+
+        m_Stats.numMoves++;
+        m_Version++;
+    }
+}
+
+void BindlessDescriptorTable::Update()
+{
+    while (!m_Submissions.empty() && m_Device->pollEventQuery(m_Submissions.front().query))
+    {
+        Submission& submission = m_Submissions.front();
+        for (uint32_t index : submission.releasedSlots)
+        {
+            m_Slots[index].state = SlotState::Free;
+            m_FreeSlots.push(index);
+        }
+        m_Stats.numPendingRelease -= uint32_t(submission.releasedSlots.size());
+
+        m_FreeQueries.push_back(submission.query);
+        m_Submissions.pop_front();
+    }
+
+    while (m_Stats.highWaterMark > 0 && m_Slots[m_Stats.highWaterMark - 1].state == SlotState::Free)
+        m_Stats.highWaterMark--;
+    UpdateFragmentation();
+
+    Compact();
+}
+
+void BindlessDescriptorTable::Submit(nvrhi::CommandQueue queue)
+{
+    if (m_RecordedReleases.empty() && m_RetiredTables.empty())
+        return;
+
+    Submission& submission = m_Submissions.emplace_back();
+    if (!m_FreeQueries.empty())
+    {
+        submission.query = m_FreeQueries.back();
+        m_FreeQueries.pop_back();
+        m_Device->resetEventQuery(submission.query);
+    }
+    else
+        submission.query = m_Device->createEventQuery();
+
+    m_Device->setEventQuery(submission.query, queue);
+    submission.releasedSlots = std::move(m_RecordedReleases);
+    submission.retiredTables = std::move(m_RetiredTables);
+    m_RecordedReleases.clear();
+    m_RetiredTables.clear();
+}
+
+void BindlessDescriptorTable::UpdateFragmentation()
+{
+    const uint32_t numHoles = m_Stats.highWaterMark - m_Stats.numUsed - m_Stats.numPendingRelease;
+    m_Stats.fragmentation = m_Stats.highWaterMark ? float(numHoles) / float(m_Stats.highWaterMark) : 0.f;
+}
+
+nvrhi::BindingLayoutHandle CreateSceneBindlessLayout(nvrhi::IDevice* device)
+{
+    nvrhi::BindlessLayoutDesc bindlessLayoutDesc;
+    bindlessLayoutDesc.visibility = nvrhi::ShaderType::All;
+    bindlessLayoutDesc.firstSlot = 0;
+    bindlessLayoutDesc.maxCapacity = c_MaxBindlessDescriptors;
+    bindlessLayoutDesc.registerSpaces = {
+        nvrhi::BindingLayoutItem::RawBuffer_SRV(1),
+        nvrhi::BindingLayoutItem::Texture_SRV(2)
+    };
+    return device->createBindlessLayout(bindlessLayoutDesc);
+}
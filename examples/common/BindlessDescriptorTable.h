@@ -0,0 +1,153 @@
+/*
+* Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <nvrhi/nvrhi.h>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <queue>
+#include <vector>
+
+// Bindless descriptor table with stable handles, deferred slot reuse and background compaction,
+// for tables whose owners read the descriptor indices when they record their work.
+//
+// - Freed slots go into a free list and are handed out lowest first, but only after the GPU has
+//   finished the work submitted before they were freed, so in-flight indices never see a new resource.
+// - When the table is full, it grows into a new table of twice the capacity with the live descriptors
+//   written at the same indices. The old table stays alive until the GPU is done with it.
+// - When the holes below the highest used slot exceed the compaction threshold, Update() moves a
+//   few of the highest descriptors into the lowest holes. The handles follow the moves, and the
+//   version changes so that owners that keep indices in GPU memory know to write them again.
+//
+// Submit() must be called after each frame's command lists are executed, and Update() once per
+// frame before recording. The capacity is limited by the maxCapacity of the bindless layout.
+class BindlessDescriptorTable : public std::enable_shared_from_this<BindlessDescriptorTable>
+{
+public:
+    class Descriptor
+    {
+    public:
+        ~Descriptor();
+
+        // The index can change between frames when the table is compacted
+        [[nodiscard]] nvrhi::DescriptorIndex Get() const { return m_Index; }
+
+    private:
+        friend class BindlessDescriptorTable;
+
+        std::weak_ptr<BindlessDescriptorTable> m_Table;
+        nvrhi::DescriptorIndex m_Index = 0;
+    };
+
+    typedef std::shared_ptr<Descriptor> Handle;
+
+    struct Stats
+    {
+        uint32_t capacity = 0;
+        uint32_t numUsed = 0;
+        // Released but possibly still referenced by work in flight
+        uint32_t numPendingRelease = 0;
+        // One past the highest slot that is not free
+        uint32_t highWaterMark = 0;
+        float fragmentation = 0.f;
+        uint32_t numGrowths = 0;
+        uint32_t numMoves = 0;
+    };
+
+    // Must be owned by a shared_ptr, the handles keep a weak reference to the table
+    BindlessDescriptorTable(nvrhi::IDevice* device, nvrhi::IBindingLayout* layout, uint32_t initialCapacity = 64, float compactionThreshold = 0.25f);
+
+    // Writes the descriptor into a free slot, growing the table if needed. Returns null when the
+    // table is at the capacity limit of its layout.
+    Handle CreateDescriptor(nvrhi::BindingSetItem item);
+
+    // Releases the slots and tables that the GPU is done with, and runs a compaction step
+    void Update();
+
+    // Tags the releases and retired tables since the previous call with an event query.
+    // Must be called after the command lists that use the table are executed.
+    void Submit(nvrhi::CommandQueue queue = nvrhi::CommandQueue::Graphics);
+
+    // Changes when the table object or any descriptor index changes
+    [[nodiscard]] uint64_t GetVersion() const { return m_Version; }
+
+    [[nodiscard]] nvrhi::IDescriptorTable* GetDescriptorTable() const { return m_Table; }
+    [[nodiscard]] const Stats& GetStats() const { return m_Stats; }
+
+private:
+    enum class SlotState : uint8_t
+    {
+        Free,
+        Used,
+        PendingRelease
+    };
+
+    struct Slot
+    {
+        nvrhi::BindingSetItem item;
+        Descriptor* owner = nullptr;
+        SlotState state = SlotState::Free;
+    };
+
+    struct Submission
+    {
+        nvrhi::EventQueryHandle query;
+        std::vector<uint32_t> releasedSlots;
+        std::vector<nvrhi::DescriptorTableHandle> retiredTables;
+    };
+
+    // Moves per Update, each one is a descriptor write
+    static constexpr uint32_t c_MaxMovesPerUpdate = 16;
+
+    void Release(uint32_t index);
+    bool Grow();
+    void Compact();
+    void UpdateFragmentation();
+
+    nvrhi::DeviceHandle m_Device;
+    nvrhi::BindingLayoutHandle m_Layout;
+    nvrhi::DescriptorTableHandle m_Table;
+    uint32_t m_MaxCapacity;
+    float m_CompactionThreshold;
+
+    std::vector<Slot> m_Slots;
+    // Free slots below m_End, lowest first; the slots from m_End up have never been used
+    std::priority_queue<uint32_t, std::vector<uint32_t>, std::greater<uint32_t>> m_FreeSlots;
+    uint32_t m_End = 0;
+
+    std::vector<uint32_t> m_RecordedReleases;
+    std::vector<nvrhi::DescriptorTableHandle> m_RetiredTables;
+    std::deque<Submission> m_Submissions;
+    std::vector<nvrhi::EventQueryHandle> m_FreeQueries;
+
+    uint64_t m_Version = 0;
+    Stats m_Stats;
+};
+
+// Capacity of the bindless layouts in the examples
+constexpr uint32_t c_MaxBindlessDescriptors = 65536;
+
+// Layout of the scene tables, with the geometry buffers in space 1 and the material textures in space 2.
+// Those tables are filled by donut's DescriptorTableManager, which Scene and TextureCache write into.
+nvrhi::BindingLayoutHandle CreateSceneBindlessLayout(nvrhi::IDevice* device);
@@ -0,0 +1,177 @@
+/*
+* Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#include "CompactGBuffer.h"
+
+#include <donut/engine/CommonRenderPasses.h>
+#include <donut/engine/SceneGraph.h>
+#include <donut/engine/ShaderFactory.h>
+#include <donut/engine/View.h>
+#include <donut/render/ShadowMap.h>
+#include <nvrhi/utils.h>
+
+using namespace donut;
+using namespace donut::math;
+using namespace donut::engine;
+using namespace donut::render;
+
+#include "compact_lighting_cb.h"
+
+uint32_t CompactGBufferLayout::GetBytesPerPixel(const std::vector<nvrhi::ITexture*>& textures)
+{
+    uint32_t bytes = 0;
+    for (nvrhi::ITexture* texture : textures)
+    {
+        if (texture)
+            bytes += nvrhi::getFormatInfo(texture->getDesc().format).bytesPerBlock;
+    }
+    return bytes;
+}
+
+nvrhi::ShaderHandle CompactGBufferFillPass::CreatePixelShader(ShaderFactory& shaderFactory, const CreateParameters& params, bool alphaTested)
+{
+    std::vector<ShaderMacro> macros;
+    macros.push_back(ShaderMacro("MOTION_VECTORS", params.enableMotionVectors ? "1" : "0"));
+    macros.push_back(ShaderMacro("ALPHA_TESTED", alphaTested ? "1" : "0"));
+
+    return shaderFactory.CreateShader("common/compact_gbuffer_ps.hlsl", "main", &macros, nvrhi::ShaderType::Pixel);
+}
+
+CompactDeferredLightingPass::CompactDeferredLightingPass(nvrhi::IDevice* device,
+    const std::shared_ptr<ShaderFactory>& shaderFactory,
+    const std::shared_ptr<CommonRenderPasses>& commonPasses)
+    : m_Device(device)
+    , m_CommonPasses(commonPasses)
+    , m_BindingCache(device)
+{
+    nvrhi::BindingLayoutDesc layoutDesc;
+    layoutDesc.visibility = nvrhi::ShaderType::Compute;
+    layoutDesc.bindings = {
+        nvrhi::BindingLayoutItem::VolatileConstantBuffer(0),
+        nvrhi::BindingLayoutItem::Texture_SRV(0),
+        nvrhi::BindingLayoutItem::Texture_SRV(1),
+        nvrhi::BindingLayoutItem::Texture_SRV(2),
+        nvrhi::BindingLayoutItem::Texture_SRV(3),
+        nvrhi::BindingLayoutItem::Texture_SRV(4),
+        nvrhi::BindingLayoutItem::Texture_SRV(5),
+        nvrhi::BindingLayoutItem::Texture_SRV(6),
+        nvrhi::BindingLayoutItem::Sampler(0),
+        nvrhi::BindingLayoutItem::Texture_UAV(0)
+    };
+    m_BindingLayout = m_Device->createBindingLayout(layoutDesc);
+
+    nvrhi::ComputePipelineDesc pipelineDesc;
+    pipelineDesc.CS = shaderFactory->CreateShader("common/compact_lighting.hlsl", "main_cs", nullptr, nvrhi::ShaderType::Compute);
+    pipelineDesc.bindingLayouts = { m_BindingLayout };
+    m_Pipeline = m_Device->createComputePipeline(pipelineDesc);
+
+    m_ConstantBuffer = m_Device->createBuffer(nvrhi::utils::CreateVolatileConstantBufferDesc(
+        sizeof(CompactLightingConstants), "CompactLightingConstants", engine::c_MaxRenderPassConstantBufferVersions));
+
+    nvrhi::SamplerDesc samplerDesc;
+    samplerDesc.setAllAddressModes(nvrhi::SamplerAddressMode::Border)
+        .setBorderColor(nvrhi::Color(1.f))
+        .setAllFilters(true)
+        .setReductionType(nvrhi::SamplerReductionType::Comparison);
+    m_ShadowSampler = m_Device->createSampler(samplerDesc);
+}
+
+void CompactDeferredLightingPass::Render(nvrhi::ICommandList* commandList, const IView& view, const Inputs& inputs)
+{
+    CompactLightingConstants constants = {};
+    constants.ambientColorTop = float4(inputs.ambientColorTop, 0.f);
+    constants.ambientColorBottom = float4(inputs.ambientColorBottom, 0.f);
+    constants.enableAmbientOcclusion = inputs.ambientOcclusion != nullptr;
+
+    // All shadows must come from the same texture array, lights with other shadow maps are not shadowed
+    nvrhi::ITexture* shadowMapTexture = nullptr;
+    uint32_t numShadows = 0;
+
+    if (inputs.lights)
+    {
+        for (const auto& light : *inputs.lights)
+        {
+            // The lights past the limit are ignored
+            if (constants.numLights >= COMPACT_LIGHTING_MAX_LIGHTS)
+                break;
+
+            LightConstants& lightConstants = constants.lights[constants.numLights++];
+            light->FillLightConstants(lightConstants);
+
+            if (!light->shadowMap)
+                continue;
+
+            if (!shadowMapTexture)
+            {
+                shadowMapTexture = light->shadowMap->GetTexture();
+                constants.shadowMapTextureSize = float2(light->shadowMap->GetTextureSize());
+            }
+
+            if (light->shadowMap->GetTexture() != shadowMapTexture)
+                continue;
+
+            for (uint32_t cascade = 0; cascade < light->shadowMap->GetNumberOfCascades() && cascade < 4; cascade++)
+            {
+                if (numShadows >= COMPACT_LIGHTING_MAX_SHADOWS)
+                    break;
+
+                light->shadowMap->GetCascade(cascade)->FillShadowConstants(constants.shadows[numShadows]);
+                lightConstants.shadowCascades[cascade] = int(numShadows);
+                ++numShadows;
+            }
+        }
+    }
+
+    nvrhi::BindingSetDesc bindingSetDesc;
+    bindingSetDesc.bindings = {
+        nvrhi::BindingSetItem::ConstantBuffer(0, m_ConstantBuffer),
+        nvrhi::BindingSetItem::Texture_SRV(0, inputs.depth),
+        nvrhi::BindingSetItem::Texture_SRV(1, inputs.gbufferBaseColor),
+        nvrhi::BindingSetItem::Texture_SRV(2, inputs.gbufferNormals),
+        nvrhi::BindingSetItem::Texture_SRV(3, inputs.gbufferMaterial),
+        nvrhi::BindingSetItem::Texture_SRV(4, inputs.gbufferEmissive),
+        nvrhi::BindingSetItem::Texture_SRV(5, inputs.ambientOcclusion ? inputs.ambientOcclusion : m_CommonPasses->m_WhiteTexture.Get()),
+        nvrhi::BindingSetItem::Texture_SRV(6, shadowMapTexture ? shadowMapTexture : m_CommonPasses->m_BlackTexture2DArray.Get()),
+        nvrhi::BindingSetItem::Sampler(0, m_ShadowSampler),
+        nvrhi::BindingSetItem::Texture_UAV(0, inputs.output)
+    };
+
+    nvrhi::ComputeState state;
+    state.pipeline = m_Pipeline;
+    state.bindings = { m_BindingCache.GetOrCreateBindingSet(bindingSetDesc, m_BindingLayout) };
+
+    commandList->beginMarker("CompactDeferredLighting");
+
+    for (uint32_t viewIndex = 0; viewIndex < view.GetNumChildViews(ViewType::PLANAR); viewIndex++)
+    {
+        const IView* planarView = view.GetChildView(ViewType::PLANAR, viewIndex);
+        planarView->FillPlanarViewConstants(constants.view);
+        constants.reverseDepth = planarView->IsReverseDepth() ? 1 : 0;
+        commandList->writeBuffer(m_ConstantBuffer, &constants, sizeof(constants));
+
+        const uint2 groupCount = (uint2(constants.view.viewportSize) + COMPACT_LIGHTING_GROUP_SIZE - 1) / COMPACT_LIGHTING_GROUP_SIZE;
+        commandList->setComputeState(state);
+        commandList->dispatch(groupCount.x, groupCount.y, 1);
+    }
+
+    commandList->endMarker();
+}
@@ -0,0 +1,103 @@
+/*
+* Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <donut/core/math/math.h>
+#include <donut/engine/BindingCache.h>
+#include <donut/render/GBufferFillPass.h>
+#include <nvrhi/nvrhi.h>
+#include <memory>
+#include <vector>
+
+namespace donut::engine
+{
+    class CommonRenderPasses;
+    class IView;
+    class Light;
+    class ShaderFactory;
+}
+
+// Compact GBuffer: octahedral normals in RG16, roughness, metalness and occlusion in one RGBA8 target,
+// and the base color as YCoCg with the chroma subsampled in a checkerboard. It takes 14 bytes per pixel
+// instead of the 24 bytes of donut's GBufferRenderTargets. See compact_gbuffer.hlsli for the layout.
+struct CompactGBufferLayout
+{
+    static constexpr nvrhi::Format BaseColorFormat = nvrhi::Format::RG8_UNORM;
+    static constexpr nvrhi::Format NormalsFormat = nvrhi::Format::RG16_UNORM;
+    static constexpr nvrhi::Format MaterialFormat = nvrhi::Format::RGBA8_UNORM;
+    static constexpr nvrhi::Format EmissiveFormat = nvrhi::Format::R11G11B10_FLOAT;
+
+    // Sum of the texel sizes of the textures, for comparing GBuffer layouts
+    static uint32_t GetBytesPerPixel(const std::vector<nvrhi::ITexture*>& textures);
+};
+
+// GBufferFillPass that writes the compact layout. The framebuffer must have the four compact
+// channels as its first render targets, followed by the motion vectors if they are enabled.
+class CompactGBufferFillPass : public donut::render::GBufferFillPass
+{
+public:
+    using GBufferFillPass::GBufferFillPass;
+
+protected:
+    nvrhi::ShaderHandle CreatePixelShader(donut::engine::ShaderFactory& shaderFactory, const CreateParameters& params, bool alphaTested) override;
+};
+
+// Deferred lighting from the compact GBuffer: directional lights with cascaded shadows, ambient light
+// with occlusion, and emissive color. Point and spot lights are shaded as well unless they are left
+// to a tiled lighting pass. Light probes are not supported.
+class CompactDeferredLightingPass
+{
+public:
+    struct Inputs
+    {
+        nvrhi::ITexture* depth = nullptr;
+        nvrhi::ITexture* gbufferBaseColor = nullptr;
+        nvrhi::ITexture* gbufferNormals = nullptr;
+        nvrhi::ITexture* gbufferMaterial = nullptr;
+        nvrhi::ITexture* gbufferEmissive = nullptr;
+        nvrhi::ITexture* ambientOcclusion = nullptr;
+        nvrhi::ITexture* output = nullptr;
+        const std::vector<std::shared_ptr<donut::engine::Light>>* lights = nullptr;
+        donut::math::float3 ambientColorTop = 0.f;
+        donut::math::float3 ambientColorBottom = 0.f;
+    };
+
+    CompactDeferredLightingPass(nvrhi::IDevice* device,
+        const std::shared_ptr<donut::engine::ShaderFactory>& shaderFactory,
+        const std::shared_ptr<donut::engine::CommonRenderPasses>& commonPasses);
+
+    // Overwrites the output for every planar child view, except where there is no geometry.
+    void Render(nvrhi::ICommandList* commandList, const donut::engine::IView& view, const Inputs& inputs);
+
+    void ResetBindingCache() { m_BindingCache.Clear(); }
+
+private:
+    nvrhi::DeviceHandle m_Device;
+    std::shared_ptr<donut::engine::CommonRenderPasses> m_CommonPasses;
+
+    nvrhi::BindingLayoutHandle m_BindingLayout;
+    nvrhi::ComputePipelineHandle m_Pipeline;
+    nvrhi::BufferHandle m_ConstantBuffer;
+    nvrhi::SamplerHandle m_ShadowSampler;
+    donut::engine::BindingCache m_BindingCache;
+};
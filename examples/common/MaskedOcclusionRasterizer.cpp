@@ -0,0 +1,423 @@
+/*
+* Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#include "MaskedOcclusionRasterizer.h"
+
+#ifdef DONUT_WITH_TASKFLOW
+#include <taskflow/taskflow.hpp>
+#endif
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MOC_USE_SSE2 1
+#else
+#define MOC_USE_SSE2 0
+#endif
+
+using namespace donut::math;
+
+// Vertices closer to the camera plane than this, in clip space w, reject the triangle
+static constexpr float c_MinClipW = 1e-4f;
+// Triangles reaching farther outside of the screen than this, in pixels, are skipped
+static constexpr float c_GuardBand = 16384.f;
+// Tile rows per rasterization task
+static constexpr uint32_t c_TileRowsPerBand = 4;
+
+static constexpr float c_EmptyLayer = -FLT_MAX;
+
+namespace
+{
+    // 4 lanes, one per row of a tile
+    struct Float4
+    {
+#if MOC_USE_SSE2
+        __m128 v;
+
+        static Float4 Set(float a, float b, float c, float d) { return { _mm_setr_ps(a, b, c, d) }; }
+        static Float4 Splat(float a) { return { _mm_set1_ps(a) }; }
+        Float4 operator+(const Float4& o) const { return { _mm_add_ps(v, o.v) }; }
+        Float4 operator*(const Float4& o) const { return { _mm_mul_ps(v, o.v) }; }
+        Float4 operator/(const Float4& o) const { return { _mm_div_ps(v, o.v) }; }
+        Float4 operator-() const { return { _mm_sub_ps(_mm_setzero_ps(), v) }; }
+        static Float4 Min(const Float4& a, const Float4& b) { return { _mm_min_ps(a.v, b.v) }; }
+        static Float4 Max(const Float4& a, const Float4& b) { return { _mm_max_ps(a.v, b.v) }; }
+        static Float4 SelectBySign(const Float4& a, const Float4& ifNegative, const Float4& otherwise)
+        {
+            const __m128 negative = _mm_cmplt_ps(a.v, _mm_setzero_ps());
+            return { _mm_or_ps(_mm_and_ps(negative, ifNegative.v), _mm_andnot_ps(negative, otherwise.v)) };
+        }
+        void Store(float* out) const { _mm_storeu_ps(out, v); }
+#else
+        float v[4];
+
+        static Float4 Set(float a, float b, float c, float d) { return { { a, b, c, d } }; }
+        static Float4 Splat(float a) { return { { a, a, a, a } }; }
+        Float4 operator+(const Float4& o) const { return { { v[0] + o.v[0], v[1] + o.v[1], v[2] + o.v[2], v[3] + o.v[3] } }; }
+        Float4 operator*(const Float4& o) const { return { { v[0] * o.v[0], v[1] * o.v[1], v[2] * o.v[2], v[3] * o.v[3] } }; }
+        Float4 operator/(const Float4& o) const { return { { v[0] / o.v[0], v[1] / o.v[1], v[2] / o.v[2], v[3] / o.v[3] } }; }
+        Float4 operator-() const { return { { -v[0], -v[1], -v[2], -v[3] } }; }
+        static Float4 Min(const Float4& a, const Float4& b)
+        {
+            return { { std::min(a.v[0], b.v[0]), std::min(a.v[1], b.v[1]), std::min(a.v[2], b.v[2]), std::min(a.v[3], b.v[3]) } };
+        }
+        static Float4 Max(const Float4& a, const Float4& b)
+        {
+            return { { std::max(a.v[0], b.v[0]), std::max(a.v[1], b.v[1]), std::max(a.v[2], b.v[2]), std::max(a.v[3], b.v[3]) } };
+        }
+        static Float4 SelectBySign(const Float4& a, const Float4& ifNegative, const Float4& otherwise)
+        {
+            Float4 result;
+            for (int lane = 0; lane < 4; lane++)
+                result.v[lane] = a.v[lane] < 0.f ? ifNegative.v[lane] : otherwise.v[lane];
+            return result;
+        }
+        void Store(float* out) const { std::copy(v, v + 4, out); }
+#endif
+    };
+}
+
+void MaskedOcclusionRasterizer::SetResolution(uint32_t width, uint32_t height)
+{
+    m_TilesX = std::max((width + c_TileWidth - 1) / c_TileWidth, 1u);
+    m_TilesY = std::max((height + c_TileHeight - 1) / c_TileHeight, 1u);
+    m_Width = m_TilesX * c_TileWidth;
+    m_Height = m_TilesY * c_TileHeight;
+    m_Tiles.resize(m_TilesX * m_TilesY);
+}
+
+void MaskedOcclusionRasterizer::Clear(bool reverseDepth)
+{
+    m_ReverseDepth = reverseDepth;
+    m_Triangles.clear();
+
+    Tile empty = {};
+    empty.zMax0 = FLT_MAX;
+    empty.zMax1 = c_EmptyLayer;
+    std::fill(m_Tiles.begin(), m_Tiles.end(), empty);
+}
+
+float MaskedOcclusionRasterizer::ToInternalDepth(float clipZ, float clipW) const
+{
+    // Negation is exact, so both conventions keep their full precision
+    const float depth = clipZ / clipW;
+    return m_ReverseDepth ? -depth : depth;
+}
+
+float MaskedOcclusionRasterizer::GetTileDepth(uint32_t tileX, uint32_t tileY) const
+{
+    const float depth = m_Tiles[tileY * m_TilesX + tileX].zMax0;
+    if (depth == FLT_MAX)
+        return m_ReverseDepth ? 0.f : 1.f;
+    return m_ReverseDepth ? -depth : depth;
+}
+
+void MaskedOcclusionRasterizer::SetupTriangles(const Mesh& mesh, std::vector<Triangle>& triangles) const
+{
+    triangles.clear();
+    triangles.reserve(mesh.numTriangles);
+
+    const float width = float(m_Width);
+    const float height = float(m_Height);
+
+    for (uint32_t index = 0; index < mesh.numTriangles; index++)
+    {
+        float x[3], y[3], z[3];
+        bool rejected = false;
+
+        for (int vertex = 0; vertex < 3; vertex++)
+        {
+            const float4 clipPos = float4(mesh.positions[mesh.indices[index * 3 + vertex]], 1.f) * mesh.objectToClip;
+            if (clipPos.w < c_MinClipW)
+            {
+                rejected = true;
+                break;
+            }
+
+            x[vertex] = (clipPos.x / clipPos.w * 0.5f + 0.5f) * width;
+            y[vertex] = (0.5f - clipPos.y / clipPos.w * 0.5f) * height;
+            z[vertex] = ToInternalDepth(clipPos.z, clipPos.w);
+
+            if (std::abs(x[vertex]) > c_GuardBand || std::abs(y[vertex]) > c_GuardBand)
+                rejected = true;
+        }
+
+        if (rejected)
+            continue;
+
+        float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+        if (std::abs(area) < 1e-6f)
+            continue;
+
+        // Both sides are rasterized, flip back-facing triangles to positive area
+        if (area < 0.f)
+        {
+            std::swap(x[1], x[2]);
+            std::swap(y[1], y[2]);
+            std::swap(z[1], z[2]);
+            area = -area;
+        }
+
+        Triangle triangle;
+
+        // Covered pixels have their centers inside the triangle
+        triangle.minX = std::max(int(std::ceil(std::min({ x[0], x[1], x[2] }) - 0.5f)), 0);
+        triangle.maxX = std::min(int(std::floor(std::max({ x[0], x[1], x[2] }) - 0.5f)), int(m_Width) - 1);
+        triangle.minY = std::max(int(std::ceil(std::min({ y[0], y[1], y[2] }) - 0.5f)), 0);
+        triangle.maxY = std::min(int(std::floor(std::max({ y[0], y[1], y[2] }) - 0.5f)), int(m_Height) - 1);
+
+        if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY)
+            continue;
+
+        for (int edge = 0; edge < 3; edge++)
+        {
+            const int a = edge;
+            const int b = (edge + 1) % 3;
+            triangle.edgeA[edge] = y[a] - y[b];
+            triangle.edgeB[edge] = x[b] - x[a];
+            triangle.edgeC[edge] = -(triangle.edgeA[edge] * x[a] + triangle.edgeB[edge] * y[a]);
+        }
+
+        triangle.depthA = ((z[1] - z[0]) * (y[2] - y[0]) - (z[2] - z[0]) * (y[1] - y[0])) / area;
+        triangle.depthB = ((z[2] - z[0]) * (x[1] - x[0]) - (z[1] - z[0]) * (x[2] - x[0])) / area;
+        triangle.depthC = z[0] - triangle.depthA * x[0] - triangle.depthB * y[0];
+        triangle.depthMax = std::max({ z[0], z[1], z[2] });
+
+        triangles.push_back(triangle);
+    }
+}
+
+void MaskedOcclusionRasterizer::RasterizeTile(const Triangle& triangle, uint32_t tileX, uint32_t tileY)
+{
+    const float tileLeft = float(tileX * c_TileWidth);
+    const float tileTop = float(tileY * c_TileHeight);
+
+    // Span of pixel centers inside the triangle, per row
+    const Float4 rowY = Float4::Set(tileTop + 0.5f, tileTop + 1.5f, tileTop + 2.5f, tileTop + 3.5f);
+    Float4 left = Float4::Splat(-FLT_MAX);
+    Float4 right = Float4::Splat(FLT_MAX);
+
+    for (int edge = 0; edge < 3; edge++)
+    {
+        const float edgeA = triangle.edgeA[edge];
+        const Float4 rowTerm = Float4::Splat(triangle.edgeB[edge]) * rowY + Float4::Splat(triangle.edgeC[edge]);
+
+        if (edgeA > 0.f)
+            left = Float4::Max(left, -rowTerm / Float4::Splat(edgeA));
+        else if (edgeA < 0.f)
+            right = Float4::Min(right, -rowTerm / Float4::Splat(edgeA));
+        else
+            // Horizontal edge, rows on its outer side are empty
+            right = Float4::Min(right, Float4::SelectBySign(rowTerm, Float4::Splat(-FLT_MAX), Float4::Splat(FLT_MAX)));
+    }
+
+    float spanLeft[4], spanRight[4];
+    left.Store(spanLeft);
+    right.Store(spanRight);
+
+    uint32_t coverage[c_TileHeight];
+    bool anyCoverage = false;
+
+    for (uint32_t row = 0; row < c_TileHeight; row++)
+    {
+        const int pixelY = int(tileTop) + int(row);
+        coverage[row] = 0;
+
+        if (pixelY < triangle.minY || pixelY > triangle.maxY)
+            continue;
+
+        // Clamped before the conversion, the spans can be huge
+        const float first = std::ceil(std::clamp(spanLeft[row] - 0.5f - tileLeft, -1.f, float(c_TileWidth)));
+        const float last = std::floor(std::clamp(spanRight[row] - 0.5f - tileLeft, -1.f, float(c_TileWidth)));
+        const int firstPixel = std::max(int(first), 0);
+        const int lastPixel = std::min(int(last), int(c_TileWidth) - 1);
+
+        if (lastPixel < firstPixel)
+            continue;
+
+        coverage[row] = (~0u >> (31 - lastPixel)) & (~0u << firstPixel);
+        anyCoverage = true;
+    }
+
+    if (!anyCoverage)
+        return;
+
+    // Farthest depth of the triangle in the tile, from the plane at the corners of the covered rectangle
+    const float rectLeft = std::max(tileLeft, float(triangle.minX)) + 0.5f;
+    const float rectRight = std::min(tileLeft + c_TileWidth - 1, float(triangle.maxX)) + 0.5f;
+    const float rectTop = std::max(tileTop, float(triangle.minY)) + 0.5f;
+    const float rectBottom = std::min(tileTop + c_TileHeight - 1, float(triangle.maxY)) + 0.5f;
+    const float depthX = std::max(triangle.depthA * rectLeft, triangle.depthA * rectRight);
+    const float depthY = std::max(triangle.depthB * rectTop, triangle.depthB * rectBottom);
+    const float triangleDepth = std::min(depthX + depthY + triangle.depthC, triangle.depthMax);
+
+    Tile& tile = m_Tiles[tileY * m_TilesX + tileX];
+
+    if (triangleDepth >= tile.zMax0)
+        return;
+
+    // Start a new working layer when the triangle is closer to the reference layer than the current one is
+    if (tile.zMax1 != c_EmptyLayer && tile.zMax1 - triangleDepth > tile.zMax0 - tile.zMax1)
+    {
+        tile.zMax1 = c_EmptyLayer;
+        std::fill(tile.mask, tile.mask + c_TileHeight, 0u);
+    }
+
+    tile.zMax1 = std::max(tile.zMax1, triangleDepth);
+
+    bool full = true;
+    for (uint32_t row = 0; row < c_TileHeight; row++)
+    {
+        tile.mask[row] |= coverage[row];
+        full = full && tile.mask[row] == ~0u;
+    }
+
+    if (full)
+    {
+        tile.zMax0 = tile.zMax1;
+        tile.zMax1 = c_EmptyLayer;
+        std::fill(tile.mask, tile.mask + c_TileHeight, 0u);
+    }
+}
+
+void MaskedOcclusionRasterizer::RasterizeBand(uint32_t firstTileRow, uint32_t endTileRow)
+{
+    const int bandTop = int(firstTileRow * c_TileHeight);
+    const int bandBottom = int(endTileRow * c_TileHeight) - 1;
+
+    for (const Triangle& triangle : m_Triangles)
+    {
+        if (triangle.maxY < bandTop || triangle.minY > bandBottom)
+            continue;
+
+        const uint32_t tileTop = uint32_t(std::max(triangle.minY, bandTop)) / c_TileHeight;
+        const uint32_t tileBottom = uint32_t(std::min(triangle.maxY, bandBottom)) / c_TileHeight;
+        const uint32_t tileLeft = uint32_t(triangle.minX) / c_TileWidth;
+        const uint32_t tileRight = uint32_t(triangle.maxX) / c_TileWidth;
+
+        for (uint32_t tileY = tileTop; tileY <= tileBottom; tileY++)
+        {
+            for (uint32_t tileX = tileLeft; tileX <= tileRight; tileX++)
+                RasterizeTile(triangle, tileX, tileY);
+        }
+    }
+}
+
+#ifdef DONUT_WITH_TASKFLOW
+void MaskedOcclusionRasterizer::RenderOccluders(const std::vector<Mesh>& meshes, tf::Executor* executor)
+#else
+void MaskedOcclusionRasterizer::RenderOccluders(const std::vector<Mesh>& meshes)
+#endif
+{
+    // Setup writes into one list per mesh, and the lists are joined in mesh order
+    m_MeshTriangles.resize(std::max(m_MeshTriangles.size(), meshes.size()));
+
+#ifdef DONUT_WITH_TASKFLOW
+    if (executor)
+    {
+        tf::Taskflow taskflow;
+        for (size_t mesh = 0; mesh < meshes.size(); mesh++)
+            taskflow.emplace([this, &meshes, mesh]() { SetupTriangles(meshes[mesh], m_MeshTriangles[mesh]); });
+        executor->run(taskflow).wait();
+    }
+    else
+#endif
+    {
+        for (size_t mesh = 0; mesh < meshes.size(); mesh++)
+            SetupTriangles(meshes[mesh], m_MeshTriangles[mesh]);
+    }
+
+    m_Triangles.clear();
+    for (size_t mesh = 0; mesh < meshes.size(); mesh++)
+        m_Triangles.insert(m_Triangles.end(), m_MeshTriangles[mesh].begin(), m_MeshTriangles[mesh].end());
+
+    // Bands own disjoint tiles
+#ifdef DONUT_WITH_TASKFLOW
+    if (executor)
+    {
+        tf::Taskflow taskflow;
+        for (uint32_t firstRow = 0; firstRow < m_TilesY; firstRow += c_TileRowsPerBand)
+        {
+            const uint32_t endRow = std::min(firstRow + c_TileRowsPerBand, m_TilesY);
+            taskflow.emplace([this, firstRow, endRow]() { RasterizeBand(firstRow, endRow); });
+        }
+        executor->run(taskflow).wait();
+        return;
+    }
+#endif
+
+    RasterizeBand(0, m_TilesY);
+}
+
+bool MaskedOcclusionRasterizer::TestBox(const box3& bounds, const float4x4& worldToClip) const
+{
+    if (bounds.isempty() || m_Tiles.empty())
+        return true;
+
+    float minX = FLT_MAX, minY = FLT_MAX, maxX = -FLT_MAX, maxY = -FLT_MAX;
+    float nearest = FLT_MAX;
+
+    for (int corner = 0; corner < 8; corner++)
+    {
+        const float3 position = float3(
+            (corner & 1) ? bounds.m_maxs.x : bounds.m_mins.x,
+            (corner & 2) ? bounds.m_maxs.y : bounds.m_mins.y,
+            (corner & 4) ? bounds.m_maxs.z : bounds.m_mins.z);
+        const float4 clipPos = float4(position, 1.f) * worldToClip;
+
+        // Boxes that reach behind the camera can't be tested
+        if (clipPos.w < c_MinClipW)
+            return true;
+
+        const float x = (clipPos.x / clipPos.w * 0.5f + 0.5f) * float(m_Width);
+        const float y = (0.5f - clipPos.y / clipPos.w * 0.5f) * float(m_Height);
+        minX = std::min(minX, x);
+        maxX = std::max(maxX, x);
+        minY = std::min(minY, y);
+        maxY = std::max(maxY, y);
+        nearest = std::min(nearest, ToInternalDepth(clipPos.z, clipPos.w));
+    }
+
+    // Every pixel that the rectangle touches, not only the covered centers
+    const int pixelLeft = std::max(int(std::floor(std::max(minX, -1.f))), 0);
+    const int pixelRight = std::min(int(std::floor(std::min(maxX, float(m_Width)))), int(m_Width) - 1);
+    const int pixelTop = std::max(int(std::floor(std::max(minY, -1.f))), 0);
+    const int pixelBottom = std::min(int(std::floor(std::min(maxY, float(m_Height)))), int(m_Height) - 1);
+
+    // Off the screen, the caller's frustum culling is responsible
+    if (pixelLeft > pixelRight || pixelTop > pixelBottom)
+        return true;
+
+    for (uint32_t tileY = uint32_t(pixelTop) / c_TileHeight; tileY <= uint32_t(pixelBottom) / c_TileHeight; tileY++)
+    {
+        for (uint32_t tileX = uint32_t(pixelLeft) / c_TileWidth; tileX <= uint32_t(pixelRight) / c_TileWidth; tileX++)
+        {
+            if (nearest < m_Tiles[tileY * m_TilesX + tileX].zMax0)
+                return true;
+        }
+    }
+
+    return false;
+}
@@ -0,0 +1,131 @@
+/*
+* Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <donut/core/math/math.h>
+#include <vector>
+
+#ifdef DONUT_WITH_TASKFLOW
+namespace tf
+{
+    class Executor;
+}
+#endif
+
+// Low resolution CPU depth rasterizer for occlusion culling, after "Masked Software Occlusion Culling"
+// by Hasselgren, Andersson and Akenine-Möller.
+//
+// The screen is split into 32x4 pixel tiles. Instead of per-pixel depth, every tile stores a coverage
+// mask with one bit per pixel and two depths: the farthest depth of the fully covered reference layer,
+// and the farthest depth of the working layer, which is made of the triangles that partially cover the
+// tile. When the mask fills up, the working layer becomes the reference layer. Triangles that are much
+// closer than the working layer discard it, which keeps the reference depth tight for nearby occluders.
+// The edge functions are evaluated for the 4 rows of a tile at once with SSE2, or in scalar code on
+// other targets.
+//
+// Rasterization is split into horizontal bands that are processed in parallel on the executor. Every
+// band sees the triangles in submission order, so the result is the same for any number of threads.
+// The class only depends on the math library, so it can be exercised without a GPU or a scene.
+class MaskedOcclusionRasterizer
+{
+public:
+    static constexpr uint32_t c_TileWidth = 32;
+    static constexpr uint32_t c_TileHeight = 4;
+
+    struct Mesh
+    {
+        const donut::math::float3* positions = nullptr;
+        const uint32_t* indices = nullptr;
+        uint32_t numTriangles = 0;
+        donut::math::float4x4 objectToClip = donut::math::float4x4::identity();
+    };
+
+    // The width is rounded up to whole tiles, and the height as well.
+    void SetResolution(uint32_t width, uint32_t height);
+
+    // Resets all tiles to the far plane. With reverse depth, larger depth values are closer.
+    void Clear(bool reverseDepth);
+
+    // Rasterizes the triangles of the meshes, both sides, in order. Triangles that cross the camera
+    // plane or lie far outside of the screen are skipped, which only makes the occluders smaller.
+#ifdef DONUT_WITH_TASKFLOW
+    void RenderOccluders(const std::vector<Mesh>& meshes, tf::Executor* executor = nullptr);
+#else
+    void RenderOccluders(const std::vector<Mesh>& meshes);
+#endif
+
+    // Returns false when the box is behind the occluders everywhere it covers on the screen.
+    [[nodiscard]] bool TestBox(const donut::math::box3& bounds, const donut::math::float4x4& worldToClip) const;
+
+    [[nodiscard]] uint32_t GetWidth() const { return m_Width; }
+    [[nodiscard]] uint32_t GetHeight() const { return m_Height; }
+    [[nodiscard]] uint32_t GetNumTilesX() const { return m_TilesX; }
+    [[nodiscard]] uint32_t GetNumTilesY() const { return m_TilesY; }
+    [[nodiscard]] uint32_t GetNumTrianglesRasterized() const { return uint32_t(m_Triangles.size()); }
+
+    // Depth of the reference layer of a tile, in the convention passed to Clear. Tiles without
+    // a full layer report the far plane.
+    [[nodiscard]] float GetTileDepth(uint32_t tileX, uint32_t tileY) const;
+
+private:
+    struct Tile
+    {
+        uint32_t mask[c_TileHeight];
+        // Internally, depth grows with distance regardless of the convention
+        float zMax0;
+        float zMax1;
+    };
+
+    struct Triangle
+    {
+        // Edge functions A*x + B*y + C, non-negative inside, in pixel units
+        float edgeA[3];
+        float edgeB[3];
+        float edgeC[3];
+        // Depth plane and range
+        float depthA;
+        float depthB;
+        float depthC;
+        float depthMax;
+        // Covered pixel range, inclusive
+        int minX;
+        int minY;
+        int maxX;
+        int maxY;
+    };
+
+    void SetupTriangles(const Mesh& mesh, std::vector<Triangle>& triangles) const;
+    void RasterizeBand(uint32_t firstTileRow, uint32_t endTileRow);
+    void RasterizeTile(const Triangle& triangle, uint32_t tileX, uint32_t tileY);
+    [[nodiscard]] float ToInternalDepth(float clipZ, float clipW) const;
+
+    uint32_t m_Width = 0;
+    uint32_t m_Height = 0;
+    uint32_t m_TilesX = 0;
+    uint32_t m_TilesY = 0;
+    bool m_ReverseDepth = false;
+
+    std::vector<Tile> m_Tiles;
+    std::vector<Triangle> m_Triangles;
+    std::vector<std::vector<Triangle>> m_MeshTriangles;
+};
@@ -0,0 +1,202 @@
+/*
+* Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#include "ReadbackQueue.h"
+
+#include <algorithm>
+
+// Staging buffers are allocated in power-of-two sizes so that they can be reused for similar requests
+static constexpr uint64_t c_MinStagingBufferSize = 256;
+
+// Upper bound on the number of idle staging resources kept in each pool
+static constexpr size_t c_MaxPooledResources = 16;
+
+ReadbackQueue::ReadbackQueue(nvrhi::IDevice* device)
+    : m_Device(device)
+{
+}
+
+nvrhi::BufferHandle ReadbackQueue::AcquireStagingBuffer(uint64_t size)
+{
+    uint64_t allocationSize = c_MinStagingBufferSize;
+    while (allocationSize < size)
+        allocationSize *= 2;
+
+    auto it = std::find_if(m_FreeBuffers.begin(), m_FreeBuffers.end(),
+        [allocationSize](const nvrhi::BufferHandle& buffer) { return buffer->getDesc().byteSize == allocationSize; });
+
+    if (it != m_FreeBuffers.end())
+    {
+        nvrhi::BufferHandle buffer = *it;
+        m_FreeBuffers.erase(it);
+        return buffer;
+    }
+
+    auto bufferDesc = nvrhi::BufferDesc()
+        .setByteSize(allocationSize)
+        .setCpuAccess(nvrhi::CpuAccessMode::Read)
+        .setDebugName("ReadbackQueue/StagingBuffer")
+        .setInitialState(nvrhi::ResourceStates::CopyDest)
+        .setKeepInitialState(true);
+
+    return m_Device->createBuffer(bufferDesc);
+}
+
+nvrhi::StagingTextureHandle ReadbackQueue::AcquireStagingTexture(uint32_t width, uint32_t height, nvrhi::Format format)
+{
+    auto it = std::find_if(m_FreeTextures.begin(), m_FreeTextures.end(),
+        [width, height, format](const nvrhi::StagingTextureHandle& texture)
+        {
+            const nvrhi::TextureDesc& desc = texture->getDesc();
+            return desc.width == width && desc.height == height && desc.format == format;
+        });
+
+    if (it != m_FreeTextures.end())
+    {
+        nvrhi::StagingTextureHandle texture = *it;
+        m_FreeTextures.erase(it);
+        return texture;
+    }
+
+    auto textureDesc = nvrhi::TextureDesc()
+        .setWidth(width)
+        .setHeight(height)
+        .setFormat(format)
+        .setDebugName("ReadbackQueue/StagingTexture");
+
+    return m_Device->createStagingTexture(textureDesc, nvrhi::CpuAccessMode::Read);
+}
+
+void ReadbackQueue::ReadBuffer(nvrhi::ICommandList* commandList, nvrhi::IBuffer* buffer, uint64_t offset, uint64_t size, BufferCallback callback)
+{
+    Request request;
+    request.stagingBuffer = AcquireStagingBuffer(size);
+    request.size = size;
+    request.bufferCallback = std::move(callback);
+
+    commandList->copyBuffer(request.stagingBuffer, 0, buffer, offset, size);
+
+    m_RecordedRequests.push_back(std::move(request));
+}
+
+void ReadbackQueue::ReadTexture(nvrhi::ICommandList* commandList, nvrhi::ITexture* texture, const nvrhi::TextureSlice& slice, TextureCallback callback)
+{
+    const nvrhi::TextureDesc& textureDesc = texture->getDesc();
+    const nvrhi::TextureSlice sourceSlice = slice.resolve(textureDesc);
+
+    Request request;
+    request.stagingTexture = AcquireStagingTexture(sourceSlice.width, sourceSlice.height, textureDesc.format);
+    request.slice = nvrhi::TextureSlice().setWidth(sourceSlice.width).setHeight(sourceSlice.height);
+    request.format = textureDesc.format;
+    request.textureCallback = std::move(callback);
+
+    commandList->copyTexture(request.stagingTexture, request.slice, texture, sourceSlice);
+
+    m_RecordedRequests.push_back(std::move(request));
+}
+
+void ReadbackQueue::OnCompletion(CompletionCallback callback)
+{
+    Request request;
+    request.completionCallback = std::move(callback);
+    m_RecordedRequests.push_back(std::move(request));
+}
+
+void ReadbackQueue::Submit(nvrhi::CommandQueue queue)
+{
+    if (m_RecordedRequests.empty())
+        return;
+
+    Submission submission;
+    if (m_FreeQueries.empty())
+    {
+        submission.query = m_Device->createEventQuery();
+    }
+    else
+    {
+        submission.query = m_FreeQueries.back();
+        m_FreeQueries.pop_back();
+        m_Device->resetEventQuery(submission.query);
+    }
+
+    m_Device->setEventQuery(submission.query, queue);
+    submission.requests = std::move(m_RecordedRequests);
+    m_RecordedRequests.clear();
+
+    m_Submissions.push_back(std::move(submission));
+}
+
+void ReadbackQueue::CompleteSubmission(Submission& submission)
+{
+    for (Request& request : submission.requests)
+    {
+        if (request.stagingBuffer)
+        {
+            const void* data = m_Device->mapBuffer(request.stagingBuffer, nvrhi::CpuAccessMode::Read);
+            if (data && request.bufferCallback)
+                request.bufferCallback(data, size_t(request.size));
+            m_Device->unmapBuffer(request.stagingBuffer);
+
+            if (m_FreeBuffers.size() < c_MaxPooledResources)
+                m_FreeBuffers.push_back(request.stagingBuffer);
+        }
+        else if (request.stagingTexture)
+        {
+            size_t rowPitch = 0;
+            const void* data = m_Device->mapStagingTexture(request.stagingTexture, request.slice, nvrhi::CpuAccessMode::Read, &rowPitch);
+            if (data && request.textureCallback)
+                request.textureCallback(data, rowPitch, request.slice.width, request.slice.height, request.format);
+            m_Device->unmapStagingTexture(request.stagingTexture);
+
+            if (m_FreeTextures.size() < c_MaxPooledResources)
+                m_FreeTextures.push_back(request.stagingTexture);
+        }
+        else if (request.completionCallback)
+        {
+            request.completionCallback();
+        }
+    }
+
+    m_FreeQueries.push_back(submission.query);
+}
+
+void ReadbackQueue::Poll()
+{
+    // Submissions on one queue complete in order, so stop at the first one still in flight
+    while (!m_Submissions.empty() && m_Device->pollEventQuery(m_Submissions.front().query))
+    {
+        Submission submission = std::move(m_Submissions.front());
+        m_Submissions.pop_front();
+        CompleteSubmission(submission);
+    }
+}
+
+void ReadbackQueue::Flush()
+{
+    while (!m_Submissions.empty())
+    {
+        Submission submission = std::move(m_Submissions.front());
+        m_Submissions.pop_front();
+        m_Device->waitEventQuery(submission.query);
+        CompleteSubmission(submission);
+    }
+}
@@ -0,0 +1,94 @@
+/*
+* Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <nvrhi/nvrhi.h>
+#include <deque>
+#include <functional>
+#include <vector>
+
+// Asynchronous GPU readback.
+//
+// Copies are recorded into the caller's command list, into staging resources taken from a pool.
+// After the command list is executed, Submit() tags the copies recorded since the previous call
+// with an event query, and Poll() calls the callbacks of the submissions that the GPU has finished,
+// usually a few frames later. Staging resources go back into the pool after their callback returns.
+// Only Flush() waits for the GPU.
+class ReadbackQueue
+{
+public:
+    typedef std::function<void(const void* data, size_t size)> BufferCallback;
+    typedef std::function<void(const void* data, size_t rowPitch, uint32_t width, uint32_t height, nvrhi::Format format)> TextureCallback;
+    typedef std::function<void()> CompletionCallback;
+
+    explicit ReadbackQueue(nvrhi::IDevice* device);
+
+    void ReadBuffer(nvrhi::ICommandList* commandList, nvrhi::IBuffer* buffer, uint64_t offset, uint64_t size, BufferCallback callback);
+    void ReadTexture(nvrhi::ICommandList* commandList, nvrhi::ITexture* texture, const nvrhi::TextureSlice& slice, TextureCallback callback);
+
+    // Calls the function once the work recorded before the next Submit has finished on the GPU.
+    // Useful for resources that the caller reads back on its own.
+    void OnCompletion(CompletionCallback callback);
+
+    // Must be called after the command list with the recorded copies has been executed.
+    void Submit(nvrhi::CommandQueue queue = nvrhi::CommandQueue::Graphics);
+
+    // Delivers the callbacks for all finished submissions. Call once per frame.
+    void Poll();
+
+    // Waits for all submissions and delivers their callbacks.
+    void Flush();
+
+    [[nodiscard]] size_t GetNumPendingSubmissions() const { return m_Submissions.size(); }
+
+private:
+    struct Request
+    {
+        nvrhi::BufferHandle stagingBuffer;
+        nvrhi::StagingTextureHandle stagingTexture;
+        uint64_t size = 0;
+        nvrhi::TextureSlice slice;
+        nvrhi::Format format = nvrhi::Format::UNKNOWN;
+        BufferCallback bufferCallback;
+        TextureCallback textureCallback;
+        CompletionCallback completionCallback;
+    };
+
+    struct Submission
+    {
+        nvrhi::EventQueryHandle query;
+        std::vector<Request> requests;
+    };
+
+    nvrhi::DeviceHandle m_Device;
+    std::vector<Request> m_RecordedRequests;
+    std::deque<Submission> m_Submissions;
+
+    std::vector<nvrhi::EventQueryHandle> m_FreeQueries;
+    std::vector<nvrhi::BufferHandle> m_FreeBuffers;
+    std::vector<nvrhi::StagingTextureHandle> m_FreeTextures;
+
+    nvrhi::BufferHandle AcquireStagingBuffer(uint64_t size);
+    nvrhi::StagingTextureHandle AcquireStagingTexture(uint32_t width, uint32_t height, nvrhi::Format format);
+    void CompleteSubmission(Submission& submission);
+};
@@ -0,0 +1,201 @@
+/*
+* Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#include "ShadingRateGenerator.h"
+#include <donut/engine/ShaderFactory.h>
+#include <donut/engine/CommonRenderPasses.h>
+#include <donut/core/math/math.h>
+#include <donut/core/log.h>
+#include <nvrhi/utils.h>
+#include "ReadbackQueue.h"
+
+using namespace donut;
+using namespace donut::math;
+
+#include "shading_rate_cb.h"
+
+static_assert(SHADING_RATE_NUM_RATES == 16, "Stats::tilesPerRate must hold all shading rate encodings");
+
+float ShadingRateGenerator::Stats::GetFraction(uint8_t rate) const
+{
+    if (numTiles == 0 || rate >= tilesPerRate.size())
+        return 0.f;
+
+    return float(tilesPerRate[rate]) / float(numTiles);
+}
+
+float ShadingRateGenerator::Stats::GetShadingRatio() const
+{
+    if (numTiles == 0)
+        return 1.f;
+
+    float ratio = 0.f;
+    for (uint8_t rate = 0; rate < tilesPerRate.size(); ++rate)
+    {
+        const uint32_t pixelsPerInvocation = (1u << (rate >> 2)) * (1u << (rate & 3));
+        ratio += GetFraction(rate) / float(pixelsPerInvocation);
+    }
+    return ratio;
+}
+
+ShadingRateGenerator::ShadingRateGenerator(nvrhi::IDevice* device, engine::ShaderFactory& shaderFactory, const std::string& shaderPath, uint32_t tileSize)
+    : m_Device(device)
+    , m_BindingCache(device)
+    , m_TileSize(tileSize)
+{
+    ShadingRateThresholds& performance = m_Thresholds[size_t(ShadingRateQuality::Performance)];
+    performance.gradientThreshold = 0.04f;
+    performance.motionScale = 0.2f;
+    performance.darkLuminance = 0.3f;
+    performance.allowQuarterRate = true;
+
+    ShadingRateThresholds& balanced = m_Thresholds[size_t(ShadingRateQuality::Balanced)];
+    balanced.gradientThreshold = 0.02f;
+    balanced.motionScale = 0.1f;
+    balanced.darkLuminance = 0.2f;
+    balanced.allowQuarterRate = true;
+
+    ShadingRateThresholds& quality = m_Thresholds[size_t(ShadingRateQuality::Quality)];
+    quality.gradientThreshold = 0.01f;
+    quality.motionScale = 0.05f;
+    quality.darkLuminance = 0.15f;
+    quality.allowQuarterRate = false;
+
+    m_Shader = shaderFactory.CreateShader(shaderPath.c_str(), "main_cs", nullptr, nvrhi::ShaderType::Compute);
+    if (!m_Shader)
+        return;
+
+    nvrhi::BindingLayoutDesc layoutDesc;
+    layoutDesc.visibility = nvrhi::ShaderType::Compute;
+    layoutDesc.bindings = {
+        nvrhi::BindingLayoutItem::VolatileConstantBuffer(0),
+        nvrhi::BindingLayoutItem::Texture_UAV(0),
+        nvrhi::BindingLayoutItem::StructuredBuffer_UAV(1),
+        nvrhi::BindingLayoutItem::Texture_SRV(0),
+        nvrhi::BindingLayoutItem::Texture_SRV(1)
+    };
+    m_BindingLayout = device->createBindingLayout(layoutDesc);
+
+    nvrhi::ComputePipelineDesc pipelineDesc;
+    pipelineDesc.CS = m_Shader;
+    pipelineDesc.bindingLayouts = { m_BindingLayout };
+    m_Pipeline = device->createComputePipeline(pipelineDesc);
+
+    m_ConstantBuffer = device->createBuffer(nvrhi::utils::CreateVolatileConstantBufferDesc(
+        sizeof(ShadingRateConstants), "ShadingRateConstants", engine::c_MaxRenderPassConstantBufferVersions));
+
+    nvrhi::BufferDesc countsDesc;
+    countsDesc.byteSize = sizeof(uint32_t) * SHADING_RATE_NUM_RATES;
+    countsDesc.structStride = sizeof(uint32_t);
+    countsDesc.canHaveUAVs = true;
+    countsDesc.initialState = nvrhi::ResourceStates::UnorderedAccess;
+    countsDesc.keepInitialState = true;
+    countsDesc.debugName = "ShadingRateCounts";
+    m_RateCounts = device->createBuffer(countsDesc);
+}
+
+void ShadingRateGenerator::Generate(
+    nvrhi::ICommandList* commandList,
+    nvrhi::ITexture* shadingRateSurface,
+    nvrhi::ITexture* previousFrameColor,
+    nvrhi::ITexture* motionVectors,
+    ShadingRateQuality quality,
+    ReadbackQueue* readbackQueue)
+{
+    const nvrhi::TextureDesc& surfaceDesc = shadingRateSurface->getDesc();
+    const nvrhi::TextureDesc& colorDesc = previousFrameColor->getDesc();
+    const ShadingRateThresholds& thresholds = m_Thresholds[size_t(quality)];
+
+    ShadingRateConstants constants = {};
+    constants.surfaceSize = uint2(surfaceDesc.width, surfaceDesc.height);
+    constants.sourceSize = uint2(colorDesc.width, colorDesc.height);
+    constants.tileSize = m_TileSize;
+    constants.gradientThreshold = thresholds.gradientThreshold;
+    constants.motionScale = thresholds.motionScale;
+    constants.darkLuminance = thresholds.darkLuminance;
+    constants.allowQuarterRate = thresholds.allowQuarterRate ? 1 : 0;
+    constants.allowAdditionalRates = m_AllowAdditionalRates ? 1 : 0;
+    commandList->writeBuffer(m_ConstantBuffer, &constants, sizeof(constants));
+
+    nvrhi::BindingSetDesc bindingSetDesc;
+    bindingSetDesc.bindings = {
+        nvrhi::BindingSetItem::ConstantBuffer(0, m_ConstantBuffer),
+        nvrhi::BindingSetItem::Texture_UAV(0, shadingRateSurface, nvrhi::Format::R8_UINT),
+        nvrhi::BindingSetItem::StructuredBuffer_UAV(1, m_RateCounts),
+        nvrhi::BindingSetItem::Texture_SRV(0, motionVectors),
+        nvrhi::BindingSetItem::Texture_SRV(1, previousFrameColor)
+    };
+    nvrhi::BindingSetHandle bindingSet = m_BindingCache.GetOrCreateBindingSet(bindingSetDesc, m_BindingLayout);
+
+    commandList->beginMarker("GenerateShadingRates");
+
+    commandList->clearBufferUInt(m_RateCounts, 0);
+
+    nvrhi::ComputeState state;
+    state.pipeline = m_Pipeline;
+    state.bindings = { bindingSet };
+    commandList->setComputeState(state);
+    commandList->dispatch(surfaceDesc.width, surfaceDesc.height, 1);
+
+    if (readbackQueue)
+    {
+        readbackQueue->ReadBuffer(commandList, m_RateCounts, 0, m_RateCounts->getDesc().byteSize,
+            [this](const void* data, size_t size)
+            {
+                const uint32_t* counts = static_cast<const uint32_t*>(data);
+                m_Stats.numTiles = 0;
+                for (size_t rate = 0; rate < m_Stats.tilesPerRate.size(); ++rate)
+                {
+                    m_Stats.tilesPerRate[rate] = counts[rate];
+                    m_Stats.numTiles += counts[rate];
+                }
+            });
+    }
+
+    commandList->endMarker();
+}
+
+const char* ShadingRateGenerator::GetQualityName(ShadingRateQuality quality)
+{
+    switch (quality)
+    {
+    case ShadingRateQuality::Performance: return "Performance";
+    case ShadingRateQuality::Balanced: return "Balanced";
+    case ShadingRateQuality::Quality: return "Quality";
+    default: return "<invalid>";
+    }
+}
+
+const char* ShadingRateGenerator::GetRateName(uint8_t rate)
+{
+    switch (rate)
+    {
+    case 0x0: return "1x1";
+    case 0x1: return "1x2";
+    case 0x4: return "2x1";
+    case 0x5: return "2x2";
+    case 0x6: return "2x4";
+    case 0x9: return "4x2";
+    case 0xa: return "4x4";
+    default: return "<invalid>";
+    }
+}
@@ -0,0 +1,118 @@
+/*
+* Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <donut/engine/BindingCache.h>
+#include <nvrhi/nvrhi.h>
+#include <array>
+#include <memory>
+#include <string>
+
+namespace donut::engine
+{
+    class ShaderFactory;
+}
+
+class ReadbackQueue;
+
+enum class ShadingRateQuality
+{
+    Performance,
+    Balanced,
+    Quality,
+
+    Count
+};
+
+struct ShadingRateThresholds
+{
+    // Mean perceptual luminance difference between neighboring pixels below which an axis is shaded at half rate.
+    // Quarter rate needs half of that.
+    float gradientThreshold = 0.02f;
+    // Relative increase of the threshold per pixel of motion
+    float motionScale = 0.1f;
+    // Perceptual luminance below which the threshold grows inversely with the tile's luminance
+    float darkLuminance = 0.2f;
+    bool allowQuarterRate = true;
+};
+
+// Generates a shading rate surface from the previous frame's final image and the motion vectors.
+//
+// Every tile of the surface gets the coarsest rate along each axis at which the estimated error
+// stays under the threshold of the selected quality level. The error is estimated from luminance
+// differences between neighboring pixels of the reprojected previous frame; flat, fast-moving and
+// dark tiles end up with coarse rates. The number of tiles at each rate is counted on the GPU and
+// read back without stalling.
+class ShadingRateGenerator
+{
+public:
+    struct Stats
+    {
+        uint32_t numTiles = 0;
+        std::array<uint32_t, 16> tilesPerRate = {};
+
+        [[nodiscard]] float GetFraction(uint8_t rate) const;
+        // Fraction of pixel shader invocations relative to full rate shading
+        [[nodiscard]] float GetShadingRatio() const;
+    };
+
+    // The shader path is relative to the factory, e.g. "common/shading_rate.hlsl".
+    ShadingRateGenerator(nvrhi::IDevice* device, donut::engine::ShaderFactory& shaderFactory, const std::string& shaderPath, uint32_t tileSize);
+
+    [[nodiscard]] bool IsValid() const { return m_Pipeline != nullptr; }
+
+    ShadingRateThresholds& GetThresholds(ShadingRateQuality quality) { return m_Thresholds[size_t(quality)]; }
+
+    // Set if the device supports the 2x4 and 4x2 rates
+    void SetAllowAdditionalRates(bool allow) { m_AllowAdditionalRates = allow; }
+
+    // Fills the shading rate surface, which must be an R8_UINT UAV texture with one texel per tile.
+    // The statistics are delivered through the readback queue, if there is one.
+    void Generate(nvrhi::ICommandList* commandList,
+        nvrhi::ITexture* shadingRateSurface,
+        nvrhi::ITexture* previousFrameColor,
+        nvrhi::ITexture* motionVectors,
+        ShadingRateQuality quality,
+        ReadbackQueue* readbackQueue);
+
+    void ResetBindingCache() { m_BindingCache.Clear(); }
+
+    [[nodiscard]] const Stats& GetStats() const { return m_Stats; }
+    [[nodiscard]] uint32_t GetTileSize() const { return m_TileSize; }
+
+    static const char* GetQualityName(ShadingRateQuality quality);
+    static const char* GetRateName(uint8_t rate);
+
+private:
+    nvrhi::DeviceHandle m_Device;
+    nvrhi::ShaderHandle m_Shader;
+    nvrhi::BindingLayoutHandle m_BindingLayout;
+    nvrhi::ComputePipelineHandle m_Pipeline;
+    nvrhi::BufferHandle m_ConstantBuffer;
+    nvrhi::BufferHandle m_RateCounts;
+    donut::engine::BindingCache m_BindingCache;
+    uint32_t m_TileSize;
+    bool m_AllowAdditionalRates = false;
+    std::array<ShadingRateThresholds, size_t(ShadingRateQuality::Count)> m_Thresholds;
+    Stats m_Stats;
+};
@@ -0,0 +1,160 @@
+/*
+* Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#include "SinglePassMipGen.h"
+
+#include <donut/engine/ShaderFactory.h>
+#include <donut/engine/View.h>
+#include <nvrhi/utils.h>
+
+#include <algorithm>
+
+using namespace donut;
+using namespace donut::math;
+using namespace donut::engine;
+
+#include "single_pass_mipgen_cb.h"
+
+SinglePassMipGen::SinglePassMipGen(nvrhi::IDevice* device, const std::shared_ptr<ShaderFactory>& shaderFactory,
+    const std::string& shaderPath)
+    : m_Device(device)
+    , m_BindingCache(device)
+{
+    nvrhi::BindingLayoutDesc layoutDesc;
+    layoutDesc.visibility = nvrhi::ShaderType::Compute;
+    layoutDesc.bindings = {
+        nvrhi::BindingLayoutItem::VolatileConstantBuffer(0),
+        nvrhi::BindingLayoutItem::Texture_SRV(0),
+        nvrhi::BindingLayoutItem::StructuredBuffer_UAV(SPD_MAX_LEVELS)
+    };
+    for (uint32_t level = 0; level < c_MaxLevels; level++)
+        layoutDesc.bindings.push_back(nvrhi::BindingLayoutItem::Texture_UAV(level));
+    m_BindingLayout = m_Device->createBindingLayout(layoutDesc);
+
+    static const char* reductionDefines[] = { "0", "1", "2", "3" };
+    for (int reduction = 0; reduction < 4; reduction++)
+    {
+        std::vector<ShaderMacro> macros = { ShaderMacro("SPD_REDUCTION", reductionDefines[reduction]) };
+
+        nvrhi::ComputePipelineDesc pipelineDesc;
+        pipelineDesc.CS = shaderFactory->CreateShader(shaderPath.c_str(), "main", &macros, nvrhi::ShaderType::Compute);
+        pipelineDesc.bindingLayouts = { m_BindingLayout };
+        m_Pipelines[reduction] = m_Device->createComputePipeline(pipelineDesc);
+    }
+
+    m_ConstantBuffer = m_Device->createBuffer(nvrhi::utils::CreateVolatileConstantBufferDesc(
+        sizeof(SinglePassMipGenConstants), "SinglePassMipGenConstants", engine::c_MaxRenderPassConstantBufferVersions));
+
+    nvrhi::BufferDesc counterDesc;
+    counterDesc.byteSize = sizeof(uint32_t);
+    counterDesc.structStride = sizeof(uint32_t);
+    counterDesc.canHaveUAVs = true;
+    counterDesc.initialState = nvrhi::ResourceStates::UnorderedAccess;
+    counterDesc.keepInitialState = true;
+    counterDesc.debugName = "SinglePassMipGenCounter";
+    m_CounterBuffer = m_Device->createBuffer(counterDesc);
+}
+
+uint32_t SinglePassMipGen::GetMaxLevels(uint32_t destWidth, uint32_t destHeight)
+{
+    // The last group reduces the 6th level on its own, which only works when it fits into one tile
+    const uint32_t sixthLevelSize = std::max(destWidth, destHeight) >> 5;
+    return sixthLevelSize > SPD_TILE_SIZE ? 6 : c_MaxLevels;
+}
+
+void SinglePassMipGen::Dispatch(nvrhi::ICommandList* commandList,
+    nvrhi::ITexture* source, uint32_t sourceMip,
+    nvrhi::ITexture* dest, uint32_t destFirstMip, uint32_t numLevels,
+    Reduction reduction)
+{
+    const nvrhi::TextureDesc& sourceDesc = source->getDesc();
+    const nvrhi::TextureDesc& destDesc = dest->getDesc();
+
+    const uint32_t destWidth = std::max(destDesc.width >> destFirstMip, 1u);
+    const uint32_t destHeight = std::max(destDesc.height >> destFirstMip, 1u);
+
+    numLevels = std::min(numLevels, destDesc.mipLevels - std::min(destFirstMip, destDesc.mipLevels));
+    numLevels = std::min(numLevels, GetMaxLevels(destWidth, destHeight));
+    if (numLevels == 0)
+        return;
+
+    if (!m_CounterCleared)
+    {
+        // The last group resets the counter after every dispatch, so it only needs clearing once
+        commandList->clearBufferUInt(m_CounterBuffer, 0);
+        m_CounterCleared = true;
+    }
+
+    SinglePassMipGenConstants constants = {};
+    constants.sourceSize = uint2(std::max(sourceDesc.width >> sourceMip, 1u), std::max(sourceDesc.height >> sourceMip, 1u));
+    constants.sourceMip = sourceMip;
+    constants.numLevels = numLevels;
+    constants.destSize = uint2(destWidth, destHeight);
+
+    const uint32_t groupsX = (destWidth + SPD_TILE_SIZE / 2 - 1) / (SPD_TILE_SIZE / 2);
+    const uint32_t groupsY = (destHeight + SPD_TILE_SIZE / 2 - 1) / (SPD_TILE_SIZE / 2);
+    constants.numGroups = groupsX * groupsY;
+
+    nvrhi::BindingSetDesc bindingSetDesc;
+    bindingSetDesc.bindings = {
+        nvrhi::BindingSetItem::ConstantBuffer(0, m_ConstantBuffer),
+        nvrhi::BindingSetItem::Texture_SRV(0, source, nvrhi::Format::UNKNOWN, nvrhi::TextureSubresourceSet(sourceMip, 1, 0, 1)),
+        nvrhi::BindingSetItem::StructuredBuffer_UAV(SPD_MAX_LEVELS, m_CounterBuffer)
+    };
+
+    // Slots past the last level are bound to it as well; the shader never writes them
+    for (uint32_t level = 0; level < c_MaxLevels; level++)
+    {
+        const uint32_t mip = destFirstMip + std::min(level, numLevels - 1);
+        bindingSetDesc.bindings.push_back(nvrhi::BindingSetItem::Texture_UAV(level, dest, nvrhi::Format::UNKNOWN,
+            nvrhi::TextureSubresourceSet(mip, 1, 0, 1)));
+    }
+
+    nvrhi::ComputeState state;
+    state.pipeline = m_Pipelines[int(reduction)];
+    state.bindings = { m_BindingCache.GetOrCreateBindingSet(bindingSetDesc, m_BindingLayout) };
+
+    commandList->beginMarker("SinglePassMipGen");
+
+    commandList->writeBuffer(m_ConstantBuffer, &constants, sizeof(constants));
+    commandList->setComputeState(state);
+    commandList->dispatch(groupsX, groupsY, 1);
+
+    commandList->endMarker();
+}
+
+void SinglePassMipGen::GenerateMips(nvrhi::ICommandList* commandList, nvrhi::ITexture* texture, Reduction reduction)
+{
+    const uint32_t mipLevels = texture->getDesc().mipLevels;
+    if (mipLevels < 2)
+        return;
+
+    // Large textures need more than one dispatch, each one continuing from the last level of the previous
+    const nvrhi::TextureDesc& desc = texture->getDesc();
+    for (uint32_t mip = 1; mip < mipLevels; )
+    {
+        const uint32_t numLevels = std::min(mipLevels - mip,
+            GetMaxLevels(std::max(desc.width >> mip, 1u), std::max(desc.height >> mip, 1u)));
+        Dispatch(commandList, texture, mip - 1, texture, mip, numLevels, reduction);
+        mip += numLevels;
+    }
+}
@@ -0,0 +1,89 @@
+/*
+* Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <donut/engine/BindingCache.h>
+#include <nvrhi/nvrhi.h>
+#include <memory>
+#include <string>
+
+namespace donut::engine
+{
+    class ShaderFactory;
+}
+
+// Mip chain generation in a single compute dispatch, replacing one dispatch per level.
+//
+// Every thread group reduces a 64x64 tile of the source into 6 levels with quad lane reads and
+// groupshared memory, and the last group to finish, detected with a global atomic counter,
+// reduces the 6th level into the remaining ones. Up to 12 levels are produced in one pass.
+// Besides the box filter for color, the pass can build min, max, or min/max (RG) pyramids
+// for hierarchical depth tests.
+//
+// Requires wave operations, so the shaders exist for DX12 and Vulkan only.
+class SinglePassMipGen
+{
+public:
+    enum class Reduction
+    {
+        Average,
+        Min,
+        Max,
+        // Reads depth from the red channel and writes min to red and max to green
+        MinMax
+    };
+
+    static constexpr uint32_t c_MaxLevels = 12;
+
+    // The shader path is relative to the factory, e.g. "common/single_pass_mipgen.hlsl".
+    SinglePassMipGen(nvrhi::IDevice* device, const std::shared_ptr<donut::engine::ShaderFactory>& shaderFactory,
+        const std::string& shaderPath);
+
+    // Fills numLevels mips of dest starting at destFirstMip, each one half the size of the previous.
+    // The first of them is reduced from sourceMip of source, which is normally the mip above it,
+    // but can be another texture, such as depth for a min/max pyramid. Dest must allow UAVs.
+    // The number of levels is clamped to what the pass can produce in one dispatch.
+    void Dispatch(nvrhi::ICommandList* commandList,
+        nvrhi::ITexture* source, uint32_t sourceMip,
+        nvrhi::ITexture* dest, uint32_t destFirstMip, uint32_t numLevels,
+        Reduction reduction = Reduction::Average);
+
+    // Convenience for the usual case: fills all mips of the texture below mip 0, with more than one
+    // dispatch when the texture is too large for one.
+    void GenerateMips(nvrhi::ICommandList* commandList, nvrhi::ITexture* texture, Reduction reduction = Reduction::Average);
+
+    // Number of levels a single dispatch can produce for the given size of the first dest level.
+    [[nodiscard]] static uint32_t GetMaxLevels(uint32_t destWidth, uint32_t destHeight);
+
+    void ResetBindingCache() { m_BindingCache.Clear(); }
+
+private:
+    nvrhi::DeviceHandle m_Device;
+
+    nvrhi::BindingLayoutHandle m_BindingLayout;
+    nvrhi::ComputePipelineHandle m_Pipelines[4];
+    nvrhi::BufferHandle m_ConstantBuffer;
+    nvrhi::BufferHandle m_CounterBuffer;
+    bool m_CounterCleared = false;
+    donut::engine::BindingCache m_BindingCache;
+};
@@ -0,0 +1,207 @@
+/*
+* Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#include "TransformHierarchy.h"
+
+#include <donut/engine/SceneGraph.h>
+#include <algorithm>
+
+#ifdef DONUT_WITH_TASKFLOW
+#include <taskflow/taskflow.hpp>
+#endif
+
+using namespace donut;
+using namespace donut::math;
+using namespace donut::engine;
+
+// Levels with fewer nodes than this are updated on the calling thread
+static constexpr uint32_t c_MinNodesForParallelUpdate = 4096;
+
+static constexpr uint32_t c_NodesPerTask = 1024;
+
+static daffine3 GetNodeLocalTransform(const SceneGraphNode& node)
+{
+    // Same composition order as SceneGraphNode
+    daffine3 transform = scaling(node.GetScaling());
+    transform *= node.GetRotation().toAffine();
+    transform *= translation(node.GetTranslation());
+    return transform;
+}
+
+void TransformHierarchy::Clear()
+{
+    m_Nodes.clear();
+    m_Parents.clear();
+    m_LocalTransforms.clear();
+    m_WorldTransforms.clear();
+    m_LocalDirty.clear();
+    m_WorldDirty.clear();
+    m_Levels.clear();
+    m_DirtyRanges.clear();
+    m_NodeIndices.clear();
+    m_AnyLocalDirty = false;
+}
+
+void TransformHierarchy::Init(const SceneGraph& sceneGraph)
+{
+    Clear();
+
+    SceneGraphNode* root = sceneGraph.GetRootNode().get();
+    if (!root)
+        return;
+
+    // Breadth-first traversal: each level is appended after the previous one
+    m_Nodes.push_back(root);
+    m_Parents.push_back(c_InvalidNode);
+
+    uint32_t levelBegin = 0;
+    while (levelBegin < uint32_t(m_Nodes.size()))
+    {
+        const uint32_t levelEnd = uint32_t(m_Nodes.size());
+        m_Levels.push_back({ levelBegin, levelEnd });
+
+        for (uint32_t parent = levelBegin; parent < levelEnd; parent++)
+        {
+            for (SceneGraphNode* child = m_Nodes[parent]->GetFirstChild(); child; child = child->GetNextSibling())
+            {
+                m_Nodes.push_back(child);
+                m_Parents.push_back(parent);
+            }
+        }
+
+        levelBegin = levelEnd;
+    }
+
+    const size_t numNodes = m_Nodes.size();
+    m_LocalTransforms.resize(numNodes);
+    m_WorldTransforms.resize(numNodes, daffine3::identity());
+    m_LocalDirty.resize(numNodes, 1);
+    m_WorldDirty.resize(numNodes, 0);
+    m_NodeIndices.reserve(numNodes);
+
+    for (uint32_t index = 0; index < uint32_t(numNodes); index++)
+    {
+        m_LocalTransforms[index] = GetNodeLocalTransform(*m_Nodes[index]);
+        m_NodeIndices[m_Nodes[index]] = index;
+    }
+
+    m_AnyLocalDirty = true;
+}
+
+uint32_t TransformHierarchy::FindNode(const SceneGraphNode* node) const
+{
+    auto it = m_NodeIndices.find(node);
+    return (it != m_NodeIndices.end()) ? it->second : c_InvalidNode;
+}
+
+void TransformHierarchy::SetLocalTransform(uint32_t node, const daffine3& transform)
+{
+    m_LocalTransforms[node] = transform;
+    m_LocalDirty[node] = 1;
+    m_AnyLocalDirty = true;
+}
+
+void TransformHierarchy::SyncLocalTransform(uint32_t node)
+{
+    SetLocalTransform(node, GetNodeLocalTransform(*m_Nodes[node]));
+}
+
+void TransformHierarchy::UpdateRange(uint32_t begin, uint32_t end)
+{
+    for (uint32_t index = begin; index < end; index++)
+    {
+        const uint32_t parent = m_Parents[index];
+        const bool parentDirty = (parent != c_InvalidNode) && m_WorldDirty[parent];
+        const bool dirty = m_LocalDirty[index] || parentDirty;
+
+        m_WorldDirty[index] = dirty ? 1 : 0;
+        m_LocalDirty[index] = 0;
+
+        if (!dirty)
+            continue;
+
+        m_WorldTransforms[index] = (parent != c_InvalidNode)
+            ? m_LocalTransforms[index] * m_WorldTransforms[parent]
+            : m_LocalTransforms[index];
+    }
+}
+
+#ifdef DONUT_WITH_TASKFLOW
+void TransformHierarchy::Update(tf::Executor* executor)
+#else
+void TransformHierarchy::Update()
+#endif
+{
+    // Only the nodes reported last time can still have the dirty bit set
+    for (const NodeRange& range : m_DirtyRanges)
+        std::fill(m_WorldDirty.begin() + range.begin, m_WorldDirty.begin() + range.end, 0);
+    m_DirtyRanges.clear();
+
+    if (!m_AnyLocalDirty)
+        return;
+
+    // Levels have to be processed in order, but the nodes within one level are independent
+    for (const NodeRange& level : m_Levels)
+    {
+        const uint32_t levelSize = level.end - level.begin;
+
+#ifdef DONUT_WITH_TASKFLOW
+        if (executor && levelSize >= c_MinNodesForParallelUpdate)
+        {
+            tf::Taskflow taskflow;
+
+            for (uint32_t taskBegin = level.begin; taskBegin < level.end; taskBegin += c_NodesPerTask)
+            {
+                const uint32_t taskEnd = std::min(taskBegin + c_NodesPerTask, level.end);
+                taskflow.emplace([this, taskBegin, taskEnd]() { UpdateRange(taskBegin, taskEnd); });
+            }
+
+            executor->run(taskflow).wait();
+            continue;
+        }
+#endif
+
+        UpdateRange(level.begin, level.end);
+    }
+
+    m_AnyLocalDirty = false;
+
+    // Collect the runs of nodes with changed world transforms
+    const uint32_t numNodes = uint32_t(m_Nodes.size());
+    uint32_t index = 0;
+    while (index < numNodes)
+    {
+        if (!m_WorldDirty[index])
+        {
+            ++index;
+            continue;
+        }
+
+        NodeRange range;
+        range.begin = index;
+        while (index < numNodes && m_WorldDirty[index])
+            ++index;
+        range.end = index;
+
+        m_DirtyRanges.push_back(range);
+    }
+}
@@ -0,0 +1,105 @@
+/*
+* Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <donut/core/math/math.h>
+#include <unordered_map>
+#include <vector>
+
+#ifdef DONUT_WITH_TASKFLOW
+namespace tf
+{
+    class Executor;
+}
+#endif
+
+namespace donut::engine
+{
+    class SceneGraph;
+    class SceneGraphNode;
+}
+
+// Flat copy of the scene graph transform hierarchy.
+//
+// Nodes are stored in breadth-first order, so every level of the tree is a contiguous range
+// and every parent comes before its children. Local transforms are set explicitly, and Update
+// propagates the dirty state and world transforms level by level. Levels that are wide enough
+// are split into tasks on the executor. After Update, the ranges of nodes whose world transform
+// changed are available so that consumers can upload only those.
+//
+// The hierarchy doesn't replace Scene::RefreshSceneGraph. The world transforms and bounds of the
+// scene graph nodes, which the scene instance buffer and skinning read, can only be written by
+// donut's own refresh, so it has to keep running next to Update.
+class TransformHierarchy
+{
+public:
+    static constexpr uint32_t c_InvalidNode = ~0u;
+
+    struct NodeRange
+    {
+        uint32_t begin = 0;
+        uint32_t end = 0;
+    };
+
+    // Flattens the scene graph and reads the current local transforms of all nodes.
+    // Must be called after loading a scene and whenever the graph structure changes.
+    void Init(const donut::engine::SceneGraph& sceneGraph);
+    void Clear();
+
+    [[nodiscard]] uint32_t FindNode(const donut::engine::SceneGraphNode* node) const;
+
+    void SetLocalTransform(uint32_t node, const donut::math::daffine3& transform);
+
+    // Re-reads the local transform of a node from its translation, rotation and scaling.
+    void SyncLocalTransform(uint32_t node);
+
+#ifdef DONUT_WITH_TASKFLOW
+    void Update(tf::Executor* executor = nullptr);
+#else
+    void Update();
+#endif
+
+    [[nodiscard]] size_t GetNumNodes() const { return m_Nodes.size(); }
+    [[nodiscard]] donut::engine::SceneGraphNode* GetNode(uint32_t node) const { return m_Nodes[node]; }
+    [[nodiscard]] uint32_t GetParent(uint32_t node) const { return m_Parents[node]; }
+    [[nodiscard]] const donut::math::daffine3& GetWorldTransform(uint32_t node) const { return m_WorldTransforms[node]; }
+    [[nodiscard]] const std::vector<NodeRange>& GetLevels() const { return m_Levels; }
+
+    // Nodes whose world transform changed in the last Update call, sorted and non-overlapping.
+    [[nodiscard]] const std::vector<NodeRange>& GetDirtyRanges() const { return m_DirtyRanges; }
+    [[nodiscard]] bool IsWorldTransformDirty(uint32_t node) const { return m_WorldDirty[node] != 0; }
+
+private:
+    std::vector<donut::engine::SceneGraphNode*> m_Nodes;
+    std::vector<uint32_t> m_Parents;
+    std::vector<donut::math::daffine3> m_LocalTransforms;
+    std::vector<donut::math::daffine3> m_WorldTransforms;
+    std::vector<uint8_t> m_LocalDirty;
+    std::vector<uint8_t> m_WorldDirty;
+    std::vector<NodeRange> m_Levels;
+    std::vector<NodeRange> m_DirtyRanges;
+    std::unordered_map<const donut::engine::SceneGraphNode*, uint32_t> m_NodeIndices;
+    bool m_AnyLocalDirty = false;
+
+    void UpdateRange(uint32_t begin, uint32_t end);
+};
@@ -0,0 +1,141 @@
+/*
+* Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef COMPACT_GBUFFER_HLSLI
+#define COMPACT_GBUFFER_HLSLI
+
+#include <donut/shaders/scene_material.hlsli>
+
+// Compact GBuffer layout, 14 bytes per pixel instead of 24:
+//
+//   Channel 0  RG8_UNORM        base color luma, and Co or Cg in a checkerboard
+//   Channel 1  RG16_UNORM       octahedral shading normal
+//   Channel 2  RGBA8_UNORM      roughness, metalness, occlusion, opacity
+//   Channel 3  R11G11B10_FLOAT  emissive color
+//
+// The base color is stored instead of the diffuse albedo and F0, which are derived from it with the
+// metalness. Specular-glossiness materials are approximated by their metal-rough equivalent.
+// Chroma is stored at half the resolution in a checkerboard and reconstructed from the neighbor
+// with the closest luma, which avoids bleeding across edges.
+
+float2 SignNotZero(float2 v)
+{
+    return float2(v.x >= 0 ? 1 : -1, v.y >= 0 ? 1 : -1);
+}
+
+float2 EncodeOctahedralNormal(float3 n)
+{
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    float2 oct = (n.z >= 0) ? n.xy : (1 - abs(n.yx)) * SignNotZero(n.xy);
+    return oct * 0.5 + 0.5;
+}
+
+float3 DecodeOctahedralNormal(float2 encoded)
+{
+    float2 oct = encoded * 2 - 1;
+    float3 n = float3(oct, 1 - abs(oct.x) - abs(oct.y));
+    float t = saturate(-n.z);
+    n.xy -= SignNotZero(n.xy) * t;
+    return normalize(n);
+}
+
+bool IsChromaOrange(uint2 pixel)
+{
+    return ((pixel.x ^ pixel.y) & 1) == 0;
+}
+
+void EncodeCompactGBuffer(MaterialSample surface, uint2 pixel,
+    out float4 o_channel0, out float4 o_channel1, out float4 o_channel2, out float4 o_channel3)
+{
+    // Square root as a cheap perceptual curve before quantizing to 8 bits
+    const float3 color = sqrt(saturate(surface.baseColor));
+    const float luma = dot(color, float3(0.25, 0.5, 0.25));
+    const float co = dot(color, float3(0.5, 0, -0.5)) + 0.5;
+    const float cg = dot(color, float3(-0.25, 0.5, -0.25)) + 0.5;
+
+    o_channel0 = float4(luma, IsChromaOrange(pixel) ? co : cg, 0, 0);
+    o_channel1 = float4(EncodeOctahedralNormal(surface.shadingNormal), 0, 0);
+    o_channel2 = float4(surface.roughness, surface.metalness, surface.occlusion, surface.opacity);
+    o_channel3 = float4(surface.emissiveColor, 0);
+}
+
+// Chroma of the opposite kind for a pixel, taken from the 4 neighbors that don't cross a luma edge
+float ReconstructChroma(Texture2D channel0, int2 pixel, float luma)
+{
+    static const float c_LumaEdgeThreshold = 30.0 / 255.0;
+    static const int2 c_Offsets[4] = { int2(-1, 0), int2(1, 0), int2(0, -1), int2(0, 1) };
+
+    float4 neighborLuma, neighborChroma;
+    [unroll]
+    for (uint i = 0; i < 4; i++)
+    {
+        const float2 neighbor = channel0[pixel + c_Offsets[i]].xy;
+        neighborLuma[i] = neighbor.x;
+        neighborChroma[i] = neighbor.y;
+    }
+
+    float4 weights = 1 - step(c_LumaEdgeThreshold, abs(neighborLuma - luma));
+    float totalWeight = dot(weights, 1);
+    if (totalWeight == 0)
+    {
+        weights = float4(1, 0, 0, 0);
+        totalWeight = 1;
+    }
+
+    return dot(weights, neighborChroma) / totalWeight;
+}
+
+float3 DecodeCompactBaseColor(Texture2D channel0, int2 pixel)
+{
+    const float2 lumaChroma = channel0[pixel].xy;
+    const float otherChroma = ReconstructChroma(channel0, pixel, lumaChroma.x);
+
+    const bool orange = IsChromaOrange(uint2(pixel));
+    const float co = (orange ? lumaChroma.y : otherChroma) - 0.5;
+    const float cg = (orange ? otherChroma : lumaChroma.y) - 0.5;
+    const float luma = lumaChroma.x;
+
+    const float3 color = saturate(float3(luma + co - cg, luma + cg, luma - co - cg));
+    return color * color;
+}
+
+MaterialSample DecodeCompactGBuffer(int2 pixel, Texture2D channel0, Texture2D channel1, Texture2D channel2, Texture2D channel3)
+{
+    MaterialSample surface = (MaterialSample)0;
+
+    const float4 material = channel2[pixel];
+    surface.baseColor = DecodeCompactBaseColor(channel0, pixel);
+    surface.shadingNormal = DecodeOctahedralNormal(channel1[pixel].xy);
+    surface.geometryNormal = surface.shadingNormal;
+    surface.roughness = material.x;
+    surface.metalness = material.y;
+    surface.occlusion = material.z;
+    surface.opacity = material.w;
+    surface.emissiveColor = channel3[pixel].rgb;
+
+    surface.diffuseAlbedo = surface.baseColor * (1 - surface.metalness);
+    surface.specularF0 = lerp(0.04, surface.baseColor, surface.metalness);
+
+    return surface;
+}
+
+#endif // COMPACT_GBUFFER_HLSLI
@@ -0,0 +1,82 @@
+/*
+* Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma pack_matrix(row_major)
+
+// Pixel shader for CompactGBufferFillPass. Same inputs and bindings as donut's GBuffer fill pixel
+// shader, only the output layout differs, see compact_gbuffer.hlsli.
+
+#include <donut/shaders/gbuffer_cb.h>
+
+#define MATERIAL_REGISTER_SPACE     GBUFFER_SPACE_MATERIAL
+#define MATERIAL_CB_SLOT            GBUFFER_BINDING_MATERIAL_CONSTANTS
+#define MATERIAL_DIFFUSE_SLOT       GBUFFER_BINDING_MATERIAL_DIFFUSE_TEXTURE
+#define MATERIAL_SPECULAR_SLOT      GBUFFER_BINDING_MATERIAL_SPECULAR_TEXTURE
+#define MATERIAL_NORMALS_SLOT       GBUFFER_BINDING_MATERIAL_NORMAL_TEXTURE
+#define MATERIAL_EMISSIVE_SLOT      GBUFFER_BINDING_MATERIAL_EMISSIVE_TEXTURE
+#define MATERIAL_OCCLUSION_SLOT     GBUFFER_BINDING_MATERIAL_OCCLUSION_TEXTURE
+#define MATERIAL_TRANSMISSION_SLOT  GBUFFER_BINDING_MATERIAL_TRANSMISSION_TEXTURE
+#define MATERIAL_OPACITY_SLOT       GBUFFER_BINDING_MATERIAL_OPACITY_TEXTURE
+
+#define MATERIAL_SAMPLER_REGISTER_SPACE GBUFFER_SPACE_VIEW
+#define MATERIAL_SAMPLER_SLOT       GBUFFER_BINDING_MATERIAL_SAMPLER
+
+#include <donut/shaders/scene_material.hlsli>
+#include <donut/shaders/material_bindings.hlsli>
+#include <donut/shaders/motion_vectors.hlsli>
+#include <donut/shaders/forward_vertex.hlsli>
+#include <donut/shaders/binding_helpers.hlsli>
+#include "compact_gbuffer.hlsli"
+
+DECLARE_CBUFFER(GBufferFillConstants, c_GBuffer, GBUFFER_BINDING_VIEW_CONSTANTS, GBUFFER_SPACE_VIEW);
+
+void main(
+    in float4 i_position : SV_Position,
+    in SceneVertex i_vtx,
+    in bool i_isFrontFace : SV_IsFrontFace,
+    out float4 o_channel0 : SV_Target0,
+    out float4 o_channel1 : SV_Target1,
+    out float4 o_channel2 : SV_Target2,
+    out float4 o_channel3 : SV_Target3
+#if MOTION_VECTORS
+    , out float3 o_motion : SV_Target4
+#endif
+)
+{
+    MaterialTextureSample textures = SampleMaterialTexturesAuto(i_vtx.texCoord, g_Material.normalTextureTransformScale);
+
+    MaterialSample surface = EvaluateSceneMaterial(i_vtx.normal, i_vtx.tangent, g_Material, textures);
+
+#if ALPHA_TESTED
+    if (g_Material.domain != MaterialDomain_Opaque)
+        clip(surface.opacity - g_Material.alphaCutoff);
+#endif
+
+    if (!i_isFrontFace)
+        surface.shadingNormal = -surface.shadingNormal;
+
+    EncodeCompactGBuffer(surface, uint2(i_position.xy), o_channel0, o_channel1, o_channel2, o_channel3);
+
+#if MOTION_VECTORS
+    o_motion = GetMotionVector(i_position.xyz, i_vtx.prevPos, c_GBuffer.view, c_GBuffer.viewPrev);
+#endif
+}
@@ -0,0 +1,123 @@
+/*
+* Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma pack_matrix(row_major)
+
+#include <donut/shaders/lighting.hlsli>
+#include <donut/shaders/shadows.hlsli>
+#include "compact_gbuffer.hlsli"
+#include "compact_lighting_cb.h"
+
+// ---[ Resources ]---
+
+ConstantBuffer<CompactLightingConstants> g_Lighting : register(b0);
+
+Texture2D t_GBufferDepth : register(t0);
+Texture2D t_GBuffer0 : register(t1);
+Texture2D t_GBuffer1 : register(t2);
+Texture2D t_GBuffer2 : register(t3);
+Texture2D t_GBuffer3 : register(t4);
+Texture2D<float> t_AmbientOcclusion : register(t5);
+Texture2DArray t_ShadowMapArray : register(t6);
+SamplerComparisonState s_ShadowSampler : register(s0);
+
+RWTexture2D<float4> u_Output : register(u0);
+
+bool IsBackground(float depth)
+{
+    return g_Lighting.reverseDepth ? (depth == 0) : (depth == 1);
+}
+
+float GetLightShadow(LightConstants light, float3 surfaceWorldPos)
+{
+    if (light.shadowCascades[0] < 0)
+        return 1;
+
+    // x is the shadow, y is the weight of the cascades that covered the position so far
+    float2 shadow = 0;
+    for (int cascade = 0; cascade < 4; cascade++)
+    {
+        if (light.shadowCascades[cascade] < 0)
+            break;
+
+        float2 cascadeShadow = EvaluateShadowGather16(t_ShadowMapArray, s_ShadowSampler,
+            g_Lighting.shadows[light.shadowCascades[cascade]], surfaceWorldPos, g_Lighting.shadowMapTextureSize);
+
+        shadow = saturate(shadow + cascadeShadow * (1.0001 - shadow.y));
+
+        if (shadow.y == 1)
+            break;
+    }
+
+    return shadow.x + (1 - shadow.y) * light.outOfBoundsShadow;
+}
+
+// ---[ Shading ]---
+
+// Directional lights with their shadows, ambient light and emissive color from the compact GBuffer.
+// Replaces donut's deferred lighting pass, which only reads the standard GBuffer layout.
+[numthreads(COMPACT_LIGHTING_GROUP_SIZE, COMPACT_LIGHTING_GROUP_SIZE, 1)]
+void main_cs(uint2 dispatchThreadId : SV_DispatchThreadID)
+{
+    if (any(float2(dispatchThreadId) >= g_Lighting.view.viewportSize))
+        return;
+
+    const uint2 pixelPosition = uint2(g_Lighting.view.viewportOrigin) + dispatchThreadId;
+
+    float depth = t_GBufferDepth[pixelPosition].x;
+    if (IsBackground(depth))
+        return;
+
+    MaterialSample surfaceMaterial = DecodeCompactGBuffer(pixelPosition, t_GBuffer0, t_GBuffer1, t_GBuffer2, t_GBuffer3);
+
+    float3 surfaceWorldPos = ReconstructWorldPosition(g_Lighting.view, float2(pixelPosition) + 0.5, depth);
+
+    float3 viewIncident = GetIncidentVector(g_Lighting.view.cameraDirectionOrPosition, surfaceWorldPos);
+
+    float3 diffuseTerm = 0;
+    float3 specularTerm = 0;
+
+    for (uint lightIndex = 0; lightIndex < g_Lighting.numLights; lightIndex++)
+    {
+        LightConstants light = g_Lighting.lights[lightIndex];
+
+        float shadow = GetLightShadow(light, surfaceWorldPos);
+        if (shadow == 0)
+            continue;
+
+        float3 diffuseRadiance, specularRadiance;
+        ShadeSurface(light, surfaceMaterial, surfaceWorldPos, viewIncident, diffuseRadiance, specularRadiance);
+
+        diffuseTerm += (shadow * diffuseRadiance) * light.color;
+        specularTerm += (shadow * specularRadiance) * light.color;
+    }
+
+    float ambientOcclusion = surfaceMaterial.occlusion;
+    if (g_Lighting.enableAmbientOcclusion)
+        ambientOcclusion *= t_AmbientOcclusion[pixelPosition];
+
+    float3 ambientColor = lerp(g_Lighting.ambientColorBottom.rgb, g_Lighting.ambientColorTop.rgb, surfaceMaterial.shadingNormal.y * 0.5 + 0.5);
+    diffuseTerm += ambientColor * surfaceMaterial.diffuseAlbedo * ambientOcclusion;
+    specularTerm += ambientColor * surfaceMaterial.specularF0 * ambientOcclusion;
+
+    u_Output[pixelPosition] = float4(diffuseTerm + specularTerm + surfaceMaterial.emissiveColor, 0);
+}
@@ -0,0 +1,51 @@
+/*
+* Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef COMPACT_LIGHTING_CB_H
+#define COMPACT_LIGHTING_CB_H
+
+#include <donut/shaders/light_cb.h>
+#include <donut/shaders/view_cb.h>
+
+#define COMPACT_LIGHTING_GROUP_SIZE 8
+#define COMPACT_LIGHTING_MAX_LIGHTS 16
+#define COMPACT_LIGHTING_MAX_SHADOWS 16
+
+struct CompactLightingConstants
+{
+    PlanarViewConstants view;
+
+    float4 ambientColorTop;
+    float4 ambientColorBottom;
+
+    float2 shadowMapTextureSize;
+    uint numLights;
+    uint enableAmbientOcclusion;
+
+    uint reverseDepth;
+    uint3 padding;
+
+    ShadowConstants shadows[COMPACT_LIGHTING_MAX_SHADOWS];
+    LightConstants lights[COMPACT_LIGHTING_MAX_LIGHTS];
+};
+
+#endif // COMPACT_LIGHTING_CB_H
@@ -87,3 +87,27 @@ BlendFragment blendIntegrate(BlendFragment buffer[MLAB_FRAGMENTS])
 
     return result;
 }
+
+// Returns true when all slots of the blending array are occupied, which means that
+// any further fragment behind the last slot will be merged into it.
+bool blendIsFull(BlendFragment buffer[MLAB_FRAGMENTS])
+{
+    return !isinf(buffer[MLAB_FRAGMENTS-1].depth);
+}
+
+// Returns the depth of the first fragment at which the product of attenuations
+// of all fragments in front of it (inclusive) drops below 'epsilon', or +INF if that never happens.
+// Fragments behind that depth cannot contribute more than 'epsilon' to the integrated result.
+float blendGetOpaqueDepth(BlendFragment buffer[MLAB_FRAGMENTS], float epsilon)
+{
+    float transmittance = 1;
+
+    for (int i = 0; i < MLAB_FRAGMENTS; ++i)
+    {
+        transmittance *= buffer[i].attenuation;
+        if (transmittance < epsilon)
+            return buffer[i].depth;
+    }
+
+    return 1.#INF;
+}
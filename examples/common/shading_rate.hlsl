@@ -0,0 +1,170 @@
+/*
+* Copyright (c) 2014-2021, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+// Shading rate enum values copied from D3D12 header
+/*
+    {
+        D3D12_SHADING_RATE_1X1	= 0,
+        D3D12_SHADING_RATE_1X2	= 0x1,
+        D3D12_SHADING_RATE_2X1	= 0x4,
+        D3D12_SHADING_RATE_2X2	= 0x5,
+        D3D12_SHADING_RATE_2X4	= 0x6,
+        D3D12_SHADING_RATE_4X2	= 0x9,
+        D3D12_SHADING_RATE_4X4	= 0xa
+    } 	D3D12_SHADING_RATE;
+*/
+
+#include "shading_rate_cb.h"
+
+ConstantBuffer<ShadingRateConstants> g_Const : register(b0);
+
+RWTexture2D<uint> shadingRateSurface : register(u0);
+RWStructuredBuffer<uint> u_RateCounts : register(u1);
+Texture2D<float2> motionVectors : register(t0);
+Texture2D<float4> prevFrameColors : register(t1);
+
+groupshared float s_SumLuminance[SHADING_RATE_GROUP_SIZE * SHADING_RATE_GROUP_SIZE];
+groupshared float2 s_SumGradient[SHADING_RATE_GROUP_SIZE * SHADING_RATE_GROUP_SIZE];
+groupshared float2 s_NumGradients[SHADING_RATE_GROUP_SIZE * SHADING_RATE_GROUP_SIZE];
+groupshared float s_MaxMotion[SHADING_RATE_GROUP_SIZE * SHADING_RATE_GROUP_SIZE];
+groupshared float s_NumPixels[SHADING_RATE_GROUP_SIZE * SHADING_RATE_GROUP_SIZE];
+
+// Approximately perceptually uniform luminance of a display-referred (tone-mapped) color
+float PerceptualLuminance(float3 color)
+{
+    return sqrt(saturate(dot(color, float3(0.2126, 0.7152, 0.0722))));
+}
+
+float LoadLuminance(int2 pixel)
+{
+    pixel = clamp(pixel, 0, int2(g_Const.sourceSize) - 1);
+    return PerceptualLuminance(prevFrameColors[pixel].rgb);
+}
+
+// Picks the coarsest rate along one axis whose error estimate stays under the threshold
+uint AxisRateLog2(float meanGradient, float threshold)
+{
+    // Quarter rate roughly doubles the error of half rate
+    if (g_Const.allowQuarterRate && meanGradient < threshold * 0.5)
+        return 2;
+    if (meanGradient < threshold)
+        return 1;
+    return 0;
+}
+
+// Each thread group computes the shading rate for one tile of the shading rate surface.
+//
+// The tile is reprojected into the previous frame using the motion vectors, and the mean
+// differences of perceptual luminance between horizontal and vertical neighbors estimate
+// the error of shading at a lower rate along each axis. Motion and darkness both raise
+// the threshold, since TAA and motion blur hide detail in moving areas, and dark areas
+// are displayed with less contrast.
+[numthreads(SHADING_RATE_GROUP_SIZE, SHADING_RATE_GROUP_SIZE, 1)]
+void main_cs(uint3 groupId : SV_GroupID, uint3 threadId : SV_GroupThreadID, uint threadIndex : SV_GroupIndex)
+{
+    const int2 tileOrigin = int2(groupId.xy * g_Const.tileSize);
+    const int2 tileEnd = min(tileOrigin + int(g_Const.tileSize), int2(g_Const.sourceSize));
+
+    float sumLuminance = 0;
+    float2 sumGradient = 0;
+    float2 numGradients = 0;
+    float maxMotion = 0;
+    float numPixels = 0;
+
+    for (int y = tileOrigin.y + int(threadId.y); y < tileEnd.y; y += SHADING_RATE_GROUP_SIZE)
+    {
+        for (int x = tileOrigin.x + int(threadId.x); x < tileEnd.x; x += SHADING_RATE_GROUP_SIZE)
+        {
+            int2 pixel = int2(x, y);
+            float2 motion = motionVectors[pixel];
+            int2 prevPixel = pixel + int2(round(motion));
+
+            float luminance = LoadLuminance(prevPixel);
+            sumLuminance += luminance;
+            maxMotion = max(maxMotion, length(motion));
+            numPixels += 1;
+
+            // Only compare with neighbors inside the same tile
+            if (x + 1 < tileEnd.x)
+            {
+                sumGradient.x += abs(LoadLuminance(prevPixel + int2(1, 0)) - luminance);
+                numGradients.x += 1;
+            }
+            if (y + 1 < tileEnd.y)
+            {
+                sumGradient.y += abs(LoadLuminance(prevPixel + int2(0, 1)) - luminance);
+                numGradients.y += 1;
+            }
+        }
+    }
+
+    s_SumLuminance[threadIndex] = sumLuminance;
+    s_SumGradient[threadIndex] = sumGradient;
+    s_NumGradients[threadIndex] = numGradients;
+    s_MaxMotion[threadIndex] = maxMotion;
+    s_NumPixels[threadIndex] = numPixels;
+
+    GroupMemoryBarrierWithGroupSync();
+
+    for (uint stride = SHADING_RATE_GROUP_SIZE * SHADING_RATE_GROUP_SIZE / 2; stride > 0; stride >>= 1)
+    {
+        if (threadIndex < stride)
+        {
+            s_SumLuminance[threadIndex] += s_SumLuminance[threadIndex + stride];
+            s_SumGradient[threadIndex] += s_SumGradient[threadIndex + stride];
+            s_NumGradients[threadIndex] += s_NumGradients[threadIndex + stride];
+            s_MaxMotion[threadIndex] = max(s_MaxMotion[threadIndex], s_MaxMotion[threadIndex + stride]);
+            s_NumPixels[threadIndex] += s_NumPixels[threadIndex + stride];
+        }
+
+        GroupMemoryBarrierWithGroupSync();
+    }
+
+    if (threadIndex != 0 || any(groupId.xy >= g_Const.surfaceSize))
+        return;
+
+    float meanLuminance = s_SumLuminance[0] / max(s_NumPixels[0], 1);
+    float2 meanGradient = s_SumGradient[0] / max(s_NumGradients[0], 1);
+
+    float threshold = g_Const.gradientThreshold;
+    threshold *= 1 + s_MaxMotion[0] * g_Const.motionScale;
+    if (meanLuminance < g_Const.darkLuminance)
+        threshold /= max(meanLuminance / g_Const.darkLuminance, 0.125);
+
+    uint rateX = AxisRateLog2(meanGradient.x, threshold);
+    uint rateY = AxisRateLog2(meanGradient.y, threshold);
+
+    // 4x1 and 1x4 don't exist, and 4x2 and 2x4 are optional
+    rateX = min(rateX, rateY + 1);
+    rateY = min(rateY, rateX + 1);
+    if (!g_Const.allowAdditionalRates && rateX != rateY && max(rateX, rateY) == 2)
+    {
+        rateX = 1;
+        rateY = 1;
+    }
+
+    uint shadingRate = (rateX << 2) | rateY;
+    shadingRateSurface[groupId.xy] = shadingRate;
+
+    uint previousCount;
+    InterlockedAdd(u_RateCounts[shadingRate], 1, previousCount);
+}
@@ -0,0 +1,47 @@
+/*
+* Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef SHADING_RATE_CB_H
+#define SHADING_RATE_CB_H
+
+// Each shading rate tile is processed by one thread group of this size in both dimensions
+#define SHADING_RATE_GROUP_SIZE 8
+
+// Shading rates are counted by their D3D12 encoding, (log2(width) << 2) | log2(height)
+#define SHADING_RATE_NUM_RATES 16
+
+struct ShadingRateConstants
+{
+    uint2 surfaceSize;
+    uint2 sourceSize;
+
+    uint tileSize;
+    float gradientThreshold;
+    float motionScale;
+    float darkLuminance;
+
+    uint allowQuarterRate;
+    uint allowAdditionalRates;
+    uint2 padding;
+};
+
+#endif // SHADING_RATE_CB_H
@@ -0,0 +1,247 @@
+/*
+* Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+// Single pass downsampler, after the approach of AMD FidelityFX SPD.
+//
+// Each thread group reduces a 64x64 tile of the source into the first 6 destination levels:
+// the first level directly from the source, the second one with quad lane reads, and the rest
+// through groupshared memory. The last group to finish, found with a global atomic counter,
+// then reduces the 6th level, at most 64x64 texels, into levels 7 to 12.
+
+#include "single_pass_mipgen_cb.h"
+
+#ifndef SPD_REDUCTION
+#define SPD_REDUCTION SPD_REDUCTION_AVERAGE
+#endif
+
+ConstantBuffer<SinglePassMipGenConstants> g_Spd : register(b0);
+
+Texture2D<float4> t_Source : register(t0);
+
+RWTexture2D<float4> u_Level0 : register(u0);
+RWTexture2D<float4> u_Level1 : register(u1);
+RWTexture2D<float4> u_Level2 : register(u2);
+RWTexture2D<float4> u_Level3 : register(u3);
+RWTexture2D<float4> u_Level4 : register(u4);
+// Written by all groups and read by the last one
+globallycoherent RWTexture2D<float4> u_Level5 : register(u5);
+RWTexture2D<float4> u_Level6 : register(u6);
+RWTexture2D<float4> u_Level7 : register(u7);
+RWTexture2D<float4> u_Level8 : register(u8);
+RWTexture2D<float4> u_Level9 : register(u9);
+RWTexture2D<float4> u_Level10 : register(u10);
+RWTexture2D<float4> u_Level11 : register(u11);
+globallycoherent RWStructuredBuffer<uint> u_Counter : register(u12);
+
+groupshared float4 s_Data[16][16];
+groupshared uint s_FinishedGroups;
+
+float4 Reduce4(float4 a, float4 b, float4 c, float4 d)
+{
+#if SPD_REDUCTION == SPD_REDUCTION_AVERAGE
+    return (a + b + c + d) * 0.25;
+#elif SPD_REDUCTION == SPD_REDUCTION_MIN
+    return min(min(a, b), min(c, d));
+#elif SPD_REDUCTION == SPD_REDUCTION_MAX
+    return max(max(a, b), max(c, d));
+#else
+    return float4(min(min(a.x, b.x), min(c.x, d.x)), max(max(a.y, b.y), max(c.y, d.y)), 0, 0);
+#endif
+}
+
+uint2 GetLevelSize(uint level)
+{
+    return max(g_Spd.destSize >> level, 1);
+}
+
+float4 LoadInput(int2 position, bool fromSource)
+{
+    if (fromSource)
+    {
+        // Clamping replicates the edge, which keeps min and max reductions conservative
+        float4 value = t_Source.Load(int3(min(position, int2(g_Spd.sourceSize) - 1), g_Spd.sourceMip));
+#if SPD_REDUCTION == SPD_REDUCTION_MIN_MAX
+        value = float4(value.x, value.x, 0, 0);
+#endif
+        return value;
+    }
+
+    return u_Level5[min(position, int2(GetLevelSize(5)) - 1)];
+}
+
+void StoreLevel(uint level, int2 position, float4 value)
+{
+    if (level >= g_Spd.numLevels || any(position >= int2(GetLevelSize(level))))
+        return;
+
+    switch (level)
+    {
+    case 0: u_Level0[position] = value; break;
+    case 1: u_Level1[position] = value; break;
+    case 2: u_Level2[position] = value; break;
+    case 3: u_Level3[position] = value; break;
+    case 4: u_Level4[position] = value; break;
+    case 5: u_Level5[position] = value; break;
+    case 6: u_Level6[position] = value; break;
+    case 7: u_Level7[position] = value; break;
+    case 8: u_Level8[position] = value; break;
+    case 9: u_Level9[position] = value; break;
+    case 10: u_Level10[position] = value; break;
+    case 11: u_Level11[position] = value; break;
+    }
+}
+
+// Maps the thread index to a 16x16 position in Morton order,
+// so that every quad of lanes covers a 2x2 block
+uint2 RemapThread(uint threadIndex)
+{
+    uint x = (threadIndex & 1) | ((threadIndex >> 1) & 2) | ((threadIndex >> 2) & 4) | ((threadIndex >> 3) & 8);
+    uint y = ((threadIndex >> 1) & 1) | ((threadIndex >> 2) & 2) | ((threadIndex >> 3) & 4) | ((threadIndex >> 4) & 8);
+    return uint2(x, y);
+}
+
+// Reduces a 64x64 tile of the input into the 6 levels starting at baseLevel.
+// Uniform across the group, all threads return at the same point.
+//
+// Reads past the edge of a level use its last texel, like the clamped loads from the source,
+// so that odd sizes don't pull in values from outside the image.
+void DownsampleTile(uint2 tile, uint threadIndex, uint baseLevel, bool fromSource)
+{
+    const uint2 position = RemapThread(threadIndex);
+
+    // First level: each thread reduces four 2x2 blocks, one in each 16x16 quadrant of the 32x32 output
+    float4 values[4];
+    [unroll]
+    for (uint quadrant = 0; quadrant < 4; quadrant++)
+    {
+        int2 outputPosition = int2(tile * 32 + position + uint2(quadrant & 1, quadrant >> 1) * 16);
+        int2 inputPosition = outputPosition * 2;
+
+        values[quadrant] = Reduce4(
+            LoadInput(inputPosition, fromSource),
+            LoadInput(inputPosition + int2(1, 0), fromSource),
+            LoadInput(inputPosition + int2(0, 1), fromSource),
+            LoadInput(inputPosition + int2(1, 1), fromSource));
+
+        StoreLevel(baseLevel, outputPosition, values[quadrant]);
+    }
+
+    if (g_Spd.numLevels <= baseLevel + 1)
+        return;
+
+    // Second level: the lanes of a quad hold 2x2 blocks of every quadrant; each lane keeps one quadrant
+    const uint quadLane = threadIndex & 3;
+    const int2 firstLevelSize = int2(GetLevelSize(baseLevel));
+    float4 value = 0;
+    [unroll]
+    for (uint quadrant = 0; quadrant < 4; quadrant++)
+    {
+        // Morton order puts x in bit 0 and y in bit 1 of the quad lane
+        const int2 quadOrigin = int2(tile * 32 + (position & ~1u) + uint2(quadrant & 1, quadrant >> 1) * 16);
+        const bool2 inside = quadOrigin + 1 < firstLevelSize;
+
+        const float4 v00 = QuadReadLaneAt(values[quadrant], 0);
+        float4 v10 = QuadReadLaneAt(values[quadrant], 1);
+        float4 v01 = QuadReadLaneAt(values[quadrant], 2);
+        float4 v11 = QuadReadLaneAt(values[quadrant], 3);
+        v11 = inside.x ? (inside.y ? v11 : v10) : (inside.y ? v01 : v00);
+        v10 = inside.x ? v10 : v00;
+        v01 = inside.y ? v01 : v00;
+
+        const float4 reduced = Reduce4(v00, v10, v01, v11);
+
+        if (quadrant == quadLane)
+            value = reduced;
+    }
+
+    const uint2 localPosition = position / 2 + uint2(quadLane & 1, quadLane >> 1) * 8;
+    StoreLevel(baseLevel + 1, int2(tile * 16 + localPosition), value);
+    s_Data[localPosition.y][localPosition.x] = value;
+
+    GroupMemoryBarrierWithGroupSync();
+
+    // Remaining levels through groupshared memory, from 8x8 down to 1x1
+    uint size = 8;
+    for (uint level = 2; level < 6; level++)
+    {
+        if (g_Spd.numLevels <= baseLevel + level)
+            return;
+
+        const bool active = threadIndex < size * size;
+        const uint2 outputPosition = uint2(threadIndex % size, threadIndex / size);
+
+        if (active)
+        {
+            // Last texel of the previous level inside this tile
+            const uint2 lastInput = uint2(max(int2(GetLevelSize(baseLevel + level - 1)) - 1 - int2(tile * size * 2), 0));
+            const uint2 p0 = outputPosition * 2;
+            const uint2 p1 = min(p0 + 1, lastInput);
+
+            value = Reduce4(
+                s_Data[p0.y][p0.x],
+                s_Data[p0.y][p1.x],
+                s_Data[p1.y][p0.x],
+                s_Data[p1.y][p1.x]);
+
+            StoreLevel(baseLevel + level, int2(tile * size + outputPosition), value);
+        }
+
+        GroupMemoryBarrierWithGroupSync();
+
+        if (active)
+            s_Data[outputPosition.y][outputPosition.x] = value;
+
+        GroupMemoryBarrierWithGroupSync();
+
+        size /= 2;
+    }
+}
+
+[numthreads(SPD_GROUP_SIZE, 1, 1)]
+void main(uint3 groupId : SV_GroupID, uint threadIndex : SV_GroupIndex)
+{
+    DownsampleTile(groupId.xy, threadIndex, 0, true);
+
+    if (g_Spd.numLevels <= 6)
+        return;
+
+    // Only the last group to get here continues, when the 6th level of all tiles has been written
+    if (threadIndex == 0)
+    {
+        DeviceMemoryBarrier();
+
+        uint finishedGroups;
+        InterlockedAdd(u_Counter[0], 1, finishedGroups);
+        s_FinishedGroups = finishedGroups;
+    }
+
+    GroupMemoryBarrierWithGroupSync();
+
+    if (s_FinishedGroups != g_Spd.numGroups - 1)
+        return;
+
+    // Leave the counter ready for the next dispatch
+    if (threadIndex == 0)
+        u_Counter[0] = 0;
+
+    DownsampleTile(uint2(0, 0), threadIndex, 6, false);
+}
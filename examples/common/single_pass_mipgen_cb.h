@@ -0,0 +1,49 @@
+/*
+* Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef SINGLE_PASS_MIPGEN_CB_H
+#define SINGLE_PASS_MIPGEN_CB_H
+
+// Every thread group reduces a 64x64 tile of the source down to one texel
+#define SPD_GROUP_SIZE 256
+#define SPD_TILE_SIZE 64
+#define SPD_MAX_LEVELS 12
+
+#define SPD_REDUCTION_AVERAGE 0
+#define SPD_REDUCTION_MIN 1
+#define SPD_REDUCTION_MAX 2
+// Min in x and max in y; the source is read as depth from x
+#define SPD_REDUCTION_MIN_MAX 3
+
+struct SinglePassMipGenConstants
+{
+    uint2 sourceSize;
+    uint sourceMip;
+    uint numLevels;
+
+    // Size of the first destination level; level i is this size shifted right by i
+    uint2 destSize;
+    uint numGroups;
+    uint padding;
+};
+
+#endif // SINGLE_PASS_MIPGEN_CB_H
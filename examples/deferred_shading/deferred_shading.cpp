@@ -62,6 +62,8 @@ using namespace donut::render;
 #include <donut/shaders/material_cb.h>
 #include <donut/shaders/bindless.h>
 
+#include <CompactGBuffer.h>
+
 #include "CubeGeometry.h"
 
 static const char* g_WindowTitle = "Donut Example: Deferred Shading";
@@ -72,6 +74,14 @@ class RenderTargets : public GBufferRenderTargets
 public:
     nvrhi::TextureHandle ShadedColor;
 
+    // 紧凑 G-buffer（见 CompactGBuffer.h）：每像素 14 字节，代替标准布局的 24 字节
+    // 启用时不创建标准布局的四个纹理，GBufferFramebuffer 指向紧凑布局的纹理
+    bool UseCompactLayout = false;
+    nvrhi::TextureHandle CompactBaseColor;
+    nvrhi::TextureHandle CompactNormals;
+    nvrhi::TextureHandle CompactMaterial;
+    nvrhi::TextureHandle CompactEmissive;
+
     void Init(
         nvrhi::IDevice* device,
         dm::uint2 size,
@@ -79,7 +89,10 @@ public:
         bool enableMotionVectors,
         bool useReverseProjection) override
     {
-        GBufferRenderTargets::Init(device, size, sampleCount, enableMotionVectors, useReverseProjection);
+        if (UseCompactLayout)
+            InitCompactLayout(device, size, useReverseProjection);
+        else
+            GBufferRenderTargets::Init(device, size, sampleCount, enableMotionVectors, useReverseProjection);
 
         nvrhi::TextureDesc textureDesc;
         textureDesc.dimension = nvrhi::TextureDimension::Texture2D;
@@ -93,6 +106,75 @@ public:
         textureDesc.sampleCount = sampleCount;
         ShadedColor = device->createTexture(textureDesc);
     }
+
+    void Clear(nvrhi::ICommandList* commandList) override
+    {
+        if (!UseCompactLayout)
+        {
+            GBufferRenderTargets::Clear(commandList);
+            return;
+        }
+
+        commandList->clearDepthStencilTexture(Depth, nvrhi::AllSubresources, true, m_DepthClearValue, false, 0);
+
+        // 色度重建会读取几何体边缘的相邻像素
+        commandList->clearTextureFloat(CompactBaseColor, nvrhi::AllSubresources, nvrhi::Color(0.f));
+
+        // 紧凑光照Pass不写入没有几何体的像素
+        commandList->clearTextureFloat(ShadedColor, nvrhi::AllSubresources, nvrhi::Color(0.f));
+    }
+
+private:
+    float m_DepthClearValue = 1.f;
+
+    // 紧凑布局只支持单采样，且不输出运动矢量
+    void InitCompactLayout(nvrhi::IDevice* device, dm::uint2 size, bool useReverseProjection)
+    {
+        m_Size = size;
+        m_SampleCount = 1;
+        m_DepthClearValue = useReverseProjection ? 0.f : 1.f;
+
+        nvrhi::TextureDesc desc;
+        desc.width = size.x;
+        desc.height = size.y;
+        desc.dimension = nvrhi::TextureDimension::Texture2D;
+        desc.isRenderTarget = true;
+        desc.useClearValue = true;
+        desc.keepInitialState = true;
+
+        desc.format = nvrhi::Format::D32;
+        desc.clearValue = nvrhi::Color(m_DepthClearValue);
+        desc.initialState = nvrhi::ResourceStates::DepthWrite;
+        desc.debugName = "Depth";
+        Depth = device->createTexture(desc);
+
+        desc.clearValue = nvrhi::Color(0.f);
+        desc.initialState = nvrhi::ResourceStates::RenderTarget;
+
+        desc.format = CompactGBufferLayout::BaseColorFormat;
+        desc.debugName = "CompactBaseColor";
+        CompactBaseColor = device->createTexture(desc);
+
+        desc.format = CompactGBufferLayout::NormalsFormat;
+        desc.debugName = "CompactNormals";
+        CompactNormals = device->createTexture(desc);
+
+        desc.format = CompactGBufferLayout::MaterialFormat;
+        desc.debugName = "CompactMaterial";
+        CompactMaterial = device->createTexture(desc);
+
+        desc.format = CompactGBufferLayout::EmissiveFormat;
+        desc.debugName = "CompactEmissive";
+        CompactEmissive = device->createTexture(desc);
+
+        GBufferFramebuffer = std::make_shared<FramebufferFactory>(device);
+        GBufferFramebuffer->RenderTargets = {
+            CompactBaseColor,
+            CompactNormals,
+            CompactMaterial,
+            CompactEmissive };
+        GBufferFramebuffer->DepthTarget = Depth;
+    }
 };
 
 class SimpleScene
@@ -297,6 +379,9 @@ private:
     std::shared_ptr<RenderTargets> m_RenderTargets;
     std::unique_ptr<GBufferFillPass> m_GBufferPass;
     std::unique_ptr<DeferredLightingPass> m_DeferredLightingPass;
+    std::unique_ptr<CompactDeferredLightingPass> m_CompactLightingPass;
+    // 共享的紧凑 G-buffer 着色器没有 D3D11 版本，D3D11 上使用标准布局
+    bool m_UseCompactGBuffer = false;
     
     PlanarView m_View;
 
@@ -328,16 +413,27 @@ public:
         auto nativeFS = std::make_shared<vfs::NativeFileSystem>();
 
         std::filesystem::path frameworkShaderPath = app::GetDirectoryWithExecutable() / "shaders/framework" / app::GetShaderTypeName(GetDevice()->getGraphicsAPI());
+        std::filesystem::path commonShaderPath = app::GetDirectoryWithExecutable() / "shaders/common" / app::GetShaderTypeName(GetDevice()->getGraphicsAPI());
         
         std::shared_ptr<vfs::RootFileSystem> rootFS = std::make_shared<vfs::RootFileSystem>();
         rootFS->mount("/shaders/donut", frameworkShaderPath);
+        rootFS->mount("/shaders/common", commonShaderPath);
         m_ShaderFactory = std::make_shared<ShaderFactory>(GetDevice(), rootFS, "/shaders");
         m_CommonPasses = std::make_shared<CommonRenderPasses>(GetDevice(), m_ShaderFactory);
         m_BindingCache = std::make_unique<engine::BindingCache>(GetDevice());
 
-        // 创建DeferredLightingPass对象
-        m_DeferredLightingPass = std::make_unique<DeferredLightingPass>(GetDevice(), m_CommonPasses);
-        m_DeferredLightingPass->Init(m_ShaderFactory);
+        m_UseCompactGBuffer = GetDevice()->getGraphicsAPI() != nvrhi::GraphicsAPI::D3D11;
+
+        // 创建光照Pass对象：紧凑布局使用 CompactDeferredLightingPass
+        if (m_UseCompactGBuffer)
+        {
+            m_CompactLightingPass = std::make_unique<CompactDeferredLightingPass>(GetDevice(), m_ShaderFactory, m_CommonPasses);
+        }
+        else
+        {
+            m_DeferredLightingPass = std::make_unique<DeferredLightingPass>(GetDevice(), m_CommonPasses);
+            m_DeferredLightingPass->Init(m_ShaderFactory);
+        }
 
         // 创建TextureCache, 用于加载纹理
         m_TextureCache = std::make_shared<TextureCache>(GetDevice(), nativeFS, nullptr);
@@ -368,11 +464,13 @@ public:
         {
             m_RenderTargets = nullptr;
             m_BindingCache->Clear();
-            m_DeferredLightingPass->ResetBindingCache();
+            if (m_DeferredLightingPass) m_DeferredLightingPass->ResetBindingCache();
+            if (m_CompactLightingPass) m_CompactLightingPass->ResetBindingCache();
 
             m_GBufferPass.reset();
 
             m_RenderTargets = std::make_shared<RenderTargets>();
+            m_RenderTargets->UseCompactLayout = m_UseCompactGBuffer;
             m_RenderTargets->Init(GetDevice(), size, 1, false, false);
         }
 
@@ -381,7 +479,10 @@ public:
         if (!m_GBufferPass)
         {
             GBufferFillPass::CreateParameters GBufferParams;
-            m_GBufferPass = std::make_unique<GBufferFillPass>(GetDevice(), m_CommonPasses);
+            if (m_UseCompactGBuffer)
+                m_GBufferPass = std::make_unique<CompactGBufferFillPass>(GetDevice(), m_CommonPasses);
+            else
+                m_GBufferPass = std::make_unique<GBufferFillPass>(GetDevice(), m_CommonPasses);
             m_GBufferPass->Init(*m_ShaderFactory, GBufferParams);
         }
 
@@ -415,14 +516,35 @@ public:
             false);
 
         // 设置灯光数据，利用前向渲染的方式，避免遮挡
-        DeferredLightingPass::Inputs deferredInputs;
-        deferredInputs.SetGBuffer(*m_RenderTargets);
-        deferredInputs.ambientColorTop = 0.2f;
-        deferredInputs.ambientColorBottom = deferredInputs.ambientColorTop * float3(0.3f, 0.4f, 0.3f);
-        deferredInputs.lights = &m_Scene.GetLights();
-        deferredInputs.output = m_RenderTargets->ShadedColor;
-        // 渲染灯光
-        m_DeferredLightingPass->Render(m_CommandList, m_View, deferredInputs);
+        const float3 ambientColorTop = 0.2f;
+        const float3 ambientColorBottom = ambientColorTop * float3(0.3f, 0.4f, 0.3f);
+
+        if (m_UseCompactGBuffer)
+        {
+            CompactDeferredLightingPass::Inputs compactInputs;
+            compactInputs.depth = m_RenderTargets->Depth;
+            compactInputs.gbufferBaseColor = m_RenderTargets->CompactBaseColor;
+            compactInputs.gbufferNormals = m_RenderTargets->CompactNormals;
+            compactInputs.gbufferMaterial = m_RenderTargets->CompactMaterial;
+            compactInputs.gbufferEmissive = m_RenderTargets->CompactEmissive;
+            compactInputs.ambientColorTop = ambientColorTop;
+            compactInputs.ambientColorBottom = ambientColorBottom;
+            compactInputs.lights = &m_Scene.GetLights();
+            compactInputs.output = m_RenderTargets->ShadedColor;
+            // 渲染灯光
+            m_CompactLightingPass->Render(m_CommandList, m_View, compactInputs);
+        }
+        else
+        {
+            DeferredLightingPass::Inputs deferredInputs;
+            deferredInputs.SetGBuffer(*m_RenderTargets);
+            deferredInputs.ambientColorTop = ambientColorTop;
+            deferredInputs.ambientColorBottom = ambientColorBottom;
+            deferredInputs.lights = &m_Scene.GetLights();
+            deferredInputs.output = m_RenderTargets->ShadedColor;
+            // 渲染灯光
+            m_DeferredLightingPass->Render(m_CommandList, m_View, deferredInputs);
+        }
 
         m_CommonPasses->BlitTexture(m_CommandList, framebuffer, m_RenderTargets->ShadedColor, m_BindingCache.get());
 
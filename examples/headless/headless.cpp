@@ -26,6 +26,22 @@
 #include <donut/core/log.h>
 #include <donut/core/vfs/VFS.h>
 #include <nvrhi/utils.h>
+#include <BarrierPlanner.h>
+#include <BindlessDescriptorTable.h>
+#include <MaskedOcclusionRasterizer.h>
+#include <ReadbackQueue.h>
+#include <ShadingRateGenerator.h>
+#include <SinglePassMipGen.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iterator>
+#include <random>
+
+#ifdef DONUT_WITH_TASKFLOW
+#include <taskflow/taskflow.hpp>
+#endif
 
 using namespace donut;
 
@@ -64,16 +80,10 @@ bool RunTest(nvrhi::IDevice* device)
         .setInitialState(nvrhi::ResourceStates::UnorderedAccess)
         .setKeepInitialState(true);
 
-    auto readbackBufferDesc = nvrhi::BufferDesc()
-        .setByteSize(outputBufferDesc.byteSize)
-        .setCpuAccess(nvrhi::CpuAccessMode::Read)
-        .setDebugName("ReadbackBuffer")
-        .setInitialState(nvrhi::ResourceStates::CopyDest)
-        .setKeepInitialState(true);
-
     auto inputBuffer = device->createBuffer(inputBufferDesc);
     auto outputBuffer = device->createBuffer(outputBufferDesc);
-    auto readbackBuffer = device->createBuffer(readbackBufferDesc);
+
+    ReadbackQueue readbackQueue(device);
 
     // Create the binding layout and binding set...
 
@@ -118,21 +128,21 @@ bool RunTest(nvrhi::IDevice* device)
     commandList->setComputeState(state);
     commandList->dispatch(1, 1, 1);
 
-    // Copy the shader output into the staging buffer
+    // Copy the shader output into a staging buffer, the callback reads it once the GPU is done
 
-    commandList->copyBuffer(readbackBuffer, 0, outputBuffer, 0, readbackBufferDesc.byteSize);
+    uint32_t computedResult = 0;
+    readbackQueue.ReadBuffer(commandList, outputBuffer, 0, outputBufferDesc.byteSize,
+        [&computedResult](const void* data, size_t size)
+        {
+            computedResult = *static_cast<uint32_t const*>(data);
+        });
 
-    // Close and execute the command list, wait on the CPU side for it to be finished
+    // Close and execute the command list, then wait for this submission only and deliver the readback
 
     commandList->close();
     device->executeCommandList(commandList);
-    device->waitForIdle();
-
-    // Read the shader output
-
-    uint32_t const* outputData = static_cast<uint32_t const*>(device->mapBuffer(readbackBuffer, nvrhi::CpuAccessMode::Read));
-    uint32_t computedResult = *outputData;
-    device->unmapBuffer(readbackBuffer);
+    readbackQueue.Submit();
+    readbackQueue.Flush();
 
     // Compre the result to the expected one to see if the test passes
 
@@ -149,6 +159,746 @@ bool RunTest(nvrhi::IDevice* device)
     }
 }
 
+// Reference for one mip level: 2x2 reduction of the level above with reads clamped to its edge
+static std::vector<float> ReduceLevelOnCpu(const std::vector<float>& input, uint32_t width, uint32_t height, uint32_t channels,
+    SinglePassMipGen::Reduction reduction)
+{
+    const uint32_t outputWidth = std::max(width / 2, 1u);
+    const uint32_t outputHeight = std::max(height / 2, 1u);
+    std::vector<float> output(outputWidth * outputHeight * channels);
+
+    for (uint32_t y = 0; y < outputHeight; y++)
+    {
+        for (uint32_t x = 0; x < outputWidth; x++)
+        {
+            const uint32_t x0 = std::min(x * 2, width - 1), x1 = std::min(x * 2 + 1, width - 1);
+            const uint32_t y0 = std::min(y * 2, height - 1), y1 = std::min(y * 2 + 1, height - 1);
+
+            for (uint32_t c = 0; c < channels; c++)
+            {
+                const float a = input[(y0 * width + x0) * channels + c];
+                const float b = input[(y0 * width + x1) * channels + c];
+                const float d = input[(y1 * width + x0) * channels + c];
+                const float e = input[(y1 * width + x1) * channels + c];
+
+                float value = 0.f;
+                switch (reduction)
+                {
+                case SinglePassMipGen::Reduction::Average: value = (a + b + d + e) * 0.25f; break;
+                case SinglePassMipGen::Reduction::Min: value = std::min(std::min(a, b), std::min(d, e)); break;
+                case SinglePassMipGen::Reduction::Max: value = std::max(std::max(a, b), std::max(d, e)); break;
+                case SinglePassMipGen::Reduction::MinMax:
+                    // Channel 0 holds the minimum and channel 1 the maximum
+                    value = c == 0 ? std::min(std::min(a, b), std::min(d, e)) : std::max(std::max(a, b), std::max(d, e));
+                    break;
+                }
+                output[(y * outputWidth + x) * channels + c] = value;
+            }
+        }
+    }
+
+    return output;
+}
+
+// Generates the mips of a texture with the given contents and compares every level to the CPU reference.
+// The source is RGBA32_FLOAT for Average, or R32_FLOAT reduced into a separate RG32_FLOAT pyramid for MinMax.
+static bool TestMipGenReduction(nvrhi::IDevice* device, SinglePassMipGen& mipGen, ReadbackQueue& readbackQueue,
+    uint32_t width, uint32_t height, SinglePassMipGen::Reduction reduction)
+{
+    const bool minMax = reduction == SinglePassMipGen::Reduction::MinMax;
+    const uint32_t sourceChannels = minMax ? 1 : 4;
+    const uint32_t destChannels = minMax ? 2 : 4;
+
+    std::mt19937 generator(width * 1000 + height);
+    std::uniform_real_distribution<float> distribution(0.f, 1.f);
+    std::vector<float> sourceData(width * height * sourceChannels);
+    for (float& value : sourceData)
+        value = distribution(generator);
+
+    auto sourceDesc = nvrhi::TextureDesc()
+        .setWidth(width)
+        .setHeight(height)
+        .setFormat(minMax ? nvrhi::Format::R32_FLOAT : nvrhi::Format::RGBA32_FLOAT)
+        .setMipLevels(minMax ? 1 : uint32_t(std::floor(std::log2(float(std::max(width, height))))) + 1)
+        .setIsUAV(!minMax)
+        .setInitialState(nvrhi::ResourceStates::ShaderResource)
+        .setKeepInitialState(true)
+        .setDebugName("MipGenSource");
+    nvrhi::TextureHandle source = device->createTexture(sourceDesc);
+
+    // Min/max pyramids start at half the resolution of the depth buffer
+    nvrhi::TextureHandle dest = source;
+    uint32_t destFirstMip = 1;
+    uint32_t numLevels = sourceDesc.mipLevels - 1;
+    if (minMax)
+    {
+        auto destDesc = nvrhi::TextureDesc()
+            .setWidth(std::max(width / 2, 1u))
+            .setHeight(std::max(height / 2, 1u))
+            .setFormat(nvrhi::Format::RG32_FLOAT)
+            .setIsUAV(true)
+            .setInitialState(nvrhi::ResourceStates::ShaderResource)
+            .setKeepInitialState(true)
+            .setDebugName("MipGenMinMax");
+        destDesc.mipLevels = uint32_t(std::floor(std::log2(float(std::max(destDesc.width, destDesc.height))))) + 1;
+        dest = device->createTexture(destDesc);
+        destFirstMip = 0;
+        numLevels = destDesc.mipLevels;
+    }
+
+    nvrhi::CommandListHandle commandList = device->createCommandList();
+    commandList->open();
+    commandList->writeTexture(source, 0, 0, sourceData.data(), width * sourceChannels * sizeof(float));
+    mipGen.Dispatch(commandList, source, 0, dest, destFirstMip, numLevels, reduction);
+
+    std::vector<std::vector<float>> results(numLevels);
+    for (uint32_t level = 0; level < numLevels; level++)
+    {
+        readbackQueue.ReadTexture(commandList, dest, nvrhi::TextureSlice().setMipLevel(destFirstMip + level),
+            [&results, level, destChannels](const void* data, size_t rowPitch, uint32_t levelWidth, uint32_t levelHeight, nvrhi::Format)
+            {
+                results[level].resize(levelWidth * levelHeight * destChannels);
+                for (uint32_t row = 0; row < levelHeight; row++)
+                {
+                    memcpy(results[level].data() + row * levelWidth * destChannels,
+                        static_cast<const uint8_t*>(data) + row * rowPitch, levelWidth * destChannels * sizeof(float));
+                }
+            });
+    }
+
+    commandList->close();
+    device->executeCommandList(commandList);
+    readbackQueue.Submit();
+    readbackQueue.Flush();
+
+    // The min/max reference starts from depth replicated into both channels
+    std::vector<float> expected;
+    if (minMax)
+    {
+        expected.resize(width * height * 2);
+        for (uint32_t i = 0; i < width * height; i++)
+            expected[i * 2] = expected[i * 2 + 1] = sourceData[i];
+    }
+    else
+        expected = sourceData;
+
+    // Averages may be summed in a different order on the GPU, min and max must match exactly
+    const float tolerance = reduction == SinglePassMipGen::Reduction::Average ? 1e-5f : 0.f;
+
+    uint32_t levelWidth = width;
+    uint32_t levelHeight = height;
+    for (uint32_t level = 0; level < numLevels; level++)
+    {
+        expected = ReduceLevelOnCpu(expected, levelWidth, levelHeight, destChannels, reduction);
+        levelWidth = std::max(levelWidth / 2, 1u);
+        levelHeight = std::max(levelHeight / 2, 1u);
+
+        if (results[level].size() != expected.size())
+        {
+            printf("Mip generation: level %d of %dx%d has the wrong size\n", level + 1, width, height);
+            return false;
+        }
+
+        for (size_t i = 0; i < expected.size(); i++)
+        {
+            if (std::abs(results[level][i] - expected[i]) > tolerance)
+            {
+                printf("Mip generation: level %d of %dx%d differs at texel %d, expected %f, computed %f\n",
+                    level + 1, width, height, int(i / destChannels), expected[i], results[level][i]);
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+// Measures one dispatch for the whole chain against one dispatch per level, both with the same pass.
+static void MeasureMipGen(nvrhi::IDevice* device, SinglePassMipGen& mipGen, uint32_t width, uint32_t height)
+{
+    constexpr int numIterations = 20;
+
+    auto textureDesc = nvrhi::TextureDesc()
+        .setWidth(width)
+        .setHeight(height)
+        .setFormat(nvrhi::Format::RGBA16_FLOAT)
+        .setMipLevels(uint32_t(std::floor(std::log2(float(std::max(width, height))))) + 1)
+        .setIsUAV(true)
+        .setInitialState(nvrhi::ResourceStates::ShaderResource)
+        .setKeepInitialState(true)
+        .setDebugName("MipGenTiming");
+    nvrhi::TextureHandle texture = device->createTexture(textureDesc);
+
+    nvrhi::TimerQueryHandle singlePassQuery = device->createTimerQuery();
+    nvrhi::TimerQueryHandle perLevelQuery = device->createTimerQuery();
+    nvrhi::CommandListHandle commandList = device->createCommandList();
+
+    double singlePassTime = 0.0;
+    double perLevelTime = 0.0;
+    for (int iteration = 0; iteration < numIterations; iteration++)
+    {
+        commandList->open();
+
+        commandList->beginTimerQuery(singlePassQuery);
+        mipGen.GenerateMips(commandList, texture);
+        commandList->endTimerQuery(singlePassQuery);
+
+        commandList->beginTimerQuery(perLevelQuery);
+        for (uint32_t mip = 1; mip < textureDesc.mipLevels; mip++)
+            mipGen.Dispatch(commandList, texture, mip - 1, texture, mip, 1);
+        commandList->endTimerQuery(perLevelQuery);
+
+        commandList->close();
+        device->executeCommandList(commandList);
+        device->waitForIdle();
+
+        singlePassTime += device->getTimerQueryTime(singlePassQuery);
+        perLevelTime += device->getTimerQueryTime(perLevelQuery);
+        device->resetTimerQuery(singlePassQuery);
+        device->resetTimerQuery(perLevelQuery);
+    }
+
+    printf("Mip generation for %dx%d: single dispatch %.3f ms, one dispatch per level %.3f ms\n", width, height,
+        singlePassTime * 1000.0 / numIterations, perLevelTime * 1000.0 / numIterations);
+}
+
+bool RunMipGenTest(nvrhi::IDevice* device)
+{
+    std::filesystem::path commonShaderPath = app::GetDirectoryWithExecutable() / "shaders/common" / app::GetShaderTypeName(device->getGraphicsAPI());
+
+    auto nativeFS = std::make_shared<vfs::NativeFileSystem>();
+    auto shaderFactory = std::make_shared<engine::ShaderFactory>(device, nativeFS, commonShaderPath);
+
+    SinglePassMipGen mipGen(device, shaderFactory, "single_pass_mipgen.hlsl");
+    ReadbackQueue readbackQueue(device);
+
+    // Timing goes first: if the group counter was not reset after a dispatch,
+    // the tail levels of the checks below would not be written.
+    MeasureMipGen(device, mipGen, 1920, 1080);
+
+    // Odd sizes cover the edge handling, and more than 6 levels cover the last group's pass
+    bool passed = true;
+    passed = TestMipGenReduction(device, mipGen, readbackQueue, 301, 187, SinglePassMipGen::Reduction::Average) && passed;
+    passed = TestMipGenReduction(device, mipGen, readbackQueue, 1, 77, SinglePassMipGen::Reduction::Average) && passed;
+    passed = TestMipGenReduction(device, mipGen, readbackQueue, 1283, 719, SinglePassMipGen::Reduction::MinMax) && passed;
+
+    if (passed)
+        printf("Mip generation test PASSED\n");
+    else
+        printf("Mip generation test FAILED!\n");
+
+    return passed;
+}
+
+// Runs the shading rate generator on synthetic images with known content and checks the resulting rates.
+// The surface is a plain UAV texture that isn't used for rendering, so this doesn't need VRS support.
+bool RunShadingRateTest(nvrhi::IDevice* device)
+{
+    std::filesystem::path commonShaderPath = app::GetDirectoryWithExecutable() / "shaders/common" / app::GetShaderTypeName(device->getGraphicsAPI());
+
+    auto nativeFS = std::make_shared<vfs::NativeFileSystem>();
+    engine::ShaderFactory shaderFactory(device, nativeFS, commonShaderPath);
+
+    // The test image consists of 5 regions, each 64x64 pixels, processed with 16x16 tiles
+    constexpr uint32_t regionSize = 64;
+    constexpr uint32_t numRegions = 5;
+    constexpr uint32_t tileSize = 16;
+    constexpr uint32_t width = regionSize * numRegions;
+    constexpr uint32_t height = regionSize;
+
+    ShadingRateGenerator generator(device, shaderFactory, "shading_rate.hlsl", tileSize);
+    if (!generator.IsValid())
+        return false;
+
+    struct Region
+    {
+        const char* name;
+        float dark;
+        float bright;
+        bool stripes;
+        float motion;
+        bool (*check)(uint8_t rate);
+    };
+
+    const Region regions[numRegions] = {
+        // Flat areas can use the coarsest rate
+        { "flat", 0.5f, 0.5f, false, 0.f, [](uint8_t rate) { return rate == 0xa; } },
+        // High-contrast checkerboard needs full rate
+        { "checkerboard", 0.2f, 0.8f, false, 0.f, [](uint8_t rate) { return rate == 0x0; } },
+        // Vertical stripes only change along X, so Y can be coarse, but 1x4 is not a valid rate
+        { "stripes", 0.2f, 0.8f, true, 0.f, [](uint8_t rate) { return rate == 0x1; } },
+        // Same pattern as the checkerboard at very low luminance
+        { "dark checkerboard", 0.002f, 0.008f, false, 0.f, [](uint8_t rate) { return rate != 0x0; } },
+        // Low-contrast checkerboard that needs full rate when static, but not when moving fast
+        { "moving checkerboard", 0.45f, 0.55f, false, 32.f, [](uint8_t rate) { return rate != 0x0; } },
+    };
+
+    std::vector<dm::float4> colors(width * height);
+    std::vector<dm::float2> motion(width * height);
+    for (uint32_t y = 0; y < height; ++y)
+    {
+        for (uint32_t x = 0; x < width; ++x)
+        {
+            const Region& region = regions[x / regionSize];
+            const bool odd = region.stripes ? (x & 1) : ((x ^ y) & 1);
+            colors[y * width + x] = dm::float4(dm::float3(odd ? region.bright : region.dark), 1.f);
+
+            // Reproject into the other half of the same region, the pattern repeats every 2 pixels
+            const float direction = (x % regionSize) < regionSize / 2 ? 1.f : -1.f;
+            motion[y * width + x] = dm::float2(region.motion * direction, 0.f);
+        }
+    }
+
+    auto textureDesc = nvrhi::TextureDesc()
+        .setWidth(width)
+        .setHeight(height)
+        .setFormat(nvrhi::Format::RGBA32_FLOAT)
+        .setInitialState(nvrhi::ResourceStates::ShaderResource)
+        .setKeepInitialState(true)
+        .setDebugName("ColorTexture");
+    nvrhi::TextureHandle colorTexture = device->createTexture(textureDesc);
+
+    textureDesc.setFormat(nvrhi::Format::RG32_FLOAT).setDebugName("MotionVectors");
+    nvrhi::TextureHandle motionTexture = device->createTexture(textureDesc);
+
+    auto surfaceDesc = nvrhi::TextureDesc()
+        .setWidth(width / tileSize)
+        .setHeight(height / tileSize)
+        .setFormat(nvrhi::Format::R8_UINT)
+        .setIsUAV(true)
+        .setInitialState(nvrhi::ResourceStates::UnorderedAccess)
+        .setKeepInitialState(true)
+        .setDebugName("ShadingRateSurface");
+    nvrhi::TextureHandle surface = device->createTexture(surfaceDesc);
+
+    ReadbackQueue readbackQueue(device);
+    nvrhi::CommandListHandle commandList = device->createCommandList();
+    commandList->open();
+
+    commandList->writeTexture(colorTexture, 0, 0, colors.data(), width * sizeof(dm::float4));
+    commandList->writeTexture(motionTexture, 0, 0, motion.data(), width * sizeof(dm::float2));
+
+    generator.Generate(commandList, surface, colorTexture, motionTexture, ShadingRateQuality::Balanced, &readbackQueue);
+
+    std::vector<uint8_t> rates(surfaceDesc.width * surfaceDesc.height);
+    readbackQueue.ReadTexture(commandList, surface, nvrhi::TextureSlice(),
+        [&rates](const void* data, size_t rowPitch, uint32_t surfaceWidth, uint32_t surfaceHeight, nvrhi::Format)
+        {
+            for (uint32_t y = 0; y < surfaceHeight; ++y)
+                memcpy(rates.data() + y * surfaceWidth, static_cast<const uint8_t*>(data) + y * rowPitch, surfaceWidth);
+        });
+
+    commandList->close();
+    device->executeCommandList(commandList);
+    readbackQueue.Submit();
+    readbackQueue.Flush();
+
+    bool passed = true;
+    for (uint32_t regionIndex = 0; regionIndex < numRegions; ++regionIndex)
+    {
+        const Region& region = regions[regionIndex];
+        const uint32_t tilesPerRegion = regionSize / tileSize;
+
+        for (uint32_t y = 0; y < surfaceDesc.height; ++y)
+        {
+            for (uint32_t x = regionIndex * tilesPerRegion; x < (regionIndex + 1) * tilesPerRegion; ++x)
+            {
+                const uint8_t rate = rates[y * surfaceDesc.width + x];
+                if (!region.check(rate))
+                {
+                    printf("Shading rate: tile %u,%u of the %s region has rate %s\n", x, y, region.name, ShadingRateGenerator::GetRateName(rate));
+                    passed = false;
+                }
+            }
+        }
+    }
+
+    const ShadingRateGenerator::Stats& stats = generator.GetStats();
+    if (stats.numTiles != surfaceDesc.width * surfaceDesc.height)
+    {
+        printf("Shading rate: the rate counts add up to %u tiles instead of %u\n", stats.numTiles, surfaceDesc.width * surfaceDesc.height);
+        passed = false;
+    }
+
+    if (passed)
+        printf("Shading rate test PASSED\n");
+    else
+        printf("Shading rate test FAILED!\n");
+
+    return passed;
+}
+
+// Plans a few passes over synthetic resources and checks the resulting states and counters,
+// including the hoisting of transitions into the batch of the previous pass
+bool RunBarrierPlannerTest(nvrhi::IDevice* device)
+{
+    auto textureDesc = nvrhi::TextureDesc()
+        .setWidth(64)
+        .setHeight(64)
+        .setFormat(nvrhi::Format::RGBA8_UNORM)
+        .setIsRenderTarget(true)
+        .setInitialState(nvrhi::ResourceStates::ShaderResource)
+        .setKeepInitialState(true)
+        .setDebugName("ColorTexture");
+    nvrhi::TextureHandle colorTexture = device->createTexture(textureDesc);
+
+    textureDesc
+        .setIsRenderTarget(false)
+        .setIsUAV(true)
+        .setInitialState(nvrhi::ResourceStates::UnorderedAccess)
+        .setDebugName("StorageTexture");
+    nvrhi::TextureHandle storageTexture = device->createTexture(textureDesc);
+
+    auto bufferDesc = nvrhi::BufferDesc()
+        .setByteSize(256)
+        .setCanHaveRawViews(true)
+        .setInitialState(nvrhi::ResourceStates::CopyDest)
+        .setKeepInitialState(true)
+        .setDebugName("ParameterBuffer");
+    nvrhi::BufferHandle parameterBuffer = device->createBuffer(bufferDesc);
+
+    // Draw into the color texture, then filter it into the storage texture twice.
+    // The parameter buffer isn't used by the draw, so its transition moves up into the first batch.
+    BarrierPlanner planner;
+    planner.BeginFrame();
+    const uint32_t drawPass = planner.AddPass("Draw");
+    planner.WriteTexture(drawPass, colorTexture, nvrhi::ResourceStates::RenderTarget);
+    const uint32_t filterPass = planner.AddPass("Filter");
+    planner.ReadTexture(filterPass, colorTexture, nvrhi::ResourceStates::ShaderResource);
+    planner.ReadBuffer(filterPass, parameterBuffer, nvrhi::ResourceStates::ShaderResource);
+    planner.WriteTexture(filterPass, storageTexture, nvrhi::ResourceStates::UnorderedAccess);
+    const uint32_t accumulatePass = planner.AddPass("Accumulate");
+    planner.ReadTexture(accumulatePass, colorTexture, nvrhi::ResourceStates::ShaderResource);
+    planner.WriteTexture(accumulatePass, storageTexture, nvrhi::ResourceStates::UnorderedAccess);
+
+    struct Expected
+    {
+        uint32_t barriersIssued;
+        uint32_t transitionsAvoided;
+        uint32_t barriersHoisted;
+        nvrhi::ResourceStates colorState;
+        nvrhi::ResourceStates parameterState;
+    };
+
+    const Expected expected[] = {
+        { 1, 0, 0, nvrhi::ResourceStates::RenderTarget, nvrhi::ResourceStates::ShaderResource },
+        // Color to SRV, the hoisted parameter transition, and a UAV barrier for the storage
+        { 3, 0, 1, nvrhi::ResourceStates::ShaderResource, nvrhi::ResourceStates::ShaderResource },
+        // The color is an SRV already, the storage write follows the filter's write
+        { 1, 1, 0, nvrhi::ResourceStates::ShaderResource, nvrhi::ResourceStates::ShaderResource },
+    };
+
+    nvrhi::CommandListHandle commandList = device->createCommandList();
+    commandList->open();
+    commandList->setEnableAutomaticBarriers(false);
+
+    nvrhi::ResourceStates colorStates[std::size(expected)];
+    nvrhi::ResourceStates parameterStates[std::size(expected)];
+    for (uint32_t pass = 0; pass < planner.GetNumPasses(); pass++)
+    {
+        planner.BeginPass(commandList, pass);
+        colorStates[pass] = commandList->getTextureSubresourceState(colorTexture, 0, 0);
+        parameterStates[pass] = commandList->getBufferState(parameterBuffer);
+    }
+
+    commandList->setEnableAutomaticBarriers(true);
+    commandList->close();
+    device->executeCommandList(commandList);
+    device->waitForIdle();
+
+    // Stats of later passes change while earlier passes begin, so they're checked at the end
+    bool passed = true;
+    for (uint32_t pass = 0; pass < planner.GetNumPasses(); pass++)
+    {
+        const BarrierPlanner::PassStats& stats = planner.GetPassStats(pass);
+        const Expected& expectedPass = expected[pass];
+
+        if (stats.barriersIssued != expectedPass.barriersIssued
+            || stats.transitionsAvoided != expectedPass.transitionsAvoided
+            || stats.barriersHoisted != expectedPass.barriersHoisted)
+        {
+            printf("Barrier planner: pass %s issued %u, avoided %u, hoisted %u barriers, expected %u, %u, %u\n",
+                planner.GetPassName(pass).c_str(), stats.barriersIssued, stats.transitionsAvoided, stats.barriersHoisted,
+                expectedPass.barriersIssued, expectedPass.transitionsAvoided, expectedPass.barriersHoisted);
+            passed = false;
+        }
+
+        if (colorStates[pass] != expectedPass.colorState || parameterStates[pass] != expectedPass.parameterState)
+        {
+            printf("Barrier planner: pass %s left the resources in the wrong states\n", planner.GetPassName(pass).c_str());
+            passed = false;
+        }
+    }
+
+    if (passed)
+        printf("Barrier planner test PASSED\n");
+    else
+        printf("Barrier planner test FAILED!\n");
+
+    return passed;
+}
+
+// Grows a bindless table past its initial capacity and releases descriptors, then checks that the indices
+// stay stable, that released slots are reused only after the GPU is done, and that the holes are compacted
+bool RunBindlessTableTest(nvrhi::IDevice* device)
+{
+    nvrhi::BindlessLayoutDesc layoutDesc;
+    layoutDesc.visibility = nvrhi::ShaderType::Compute;
+    layoutDesc.firstSlot = 0;
+    layoutDesc.maxCapacity = 64;
+    layoutDesc.registerSpaces = {
+        nvrhi::BindingLayoutItem::RawBuffer_SRV(1)
+    };
+    nvrhi::BindingLayoutHandle layout = device->createBindlessLayout(layoutDesc);
+
+    auto bufferDesc = nvrhi::BufferDesc()
+        .setByteSize(256)
+        .setCanHaveRawViews(true)
+        .setInitialState(nvrhi::ResourceStates::ShaderResource)
+        .setKeepInitialState(true)
+        .setDebugName("DescriptorBuffer");
+    nvrhi::BufferHandle buffer = device->createBuffer(bufferDesc);
+
+    nvrhi::CommandListHandle commandList = device->createCommandList();
+
+    auto table = std::make_shared<BindlessDescriptorTable>(device, layout, 4, 0.25f);
+
+    // Ends a frame and waits for the GPU, so that the next Update sees the frame as completed
+    auto finishFrame = [device, commandList, &table]()
+    {
+        commandList->open();
+        commandList->close();
+        device->executeCommandList(commandList);
+        table->Submit();
+        device->waitForIdle();
+        table->Update();
+    };
+
+    bool passed = true;
+
+    // Fill 12 slots from an initial capacity of 4, which grows the table twice
+    std::vector<BindlessDescriptorTable::Handle> descriptors;
+    for (uint32_t i = 0; i < 12; i++)
+        descriptors.push_back(table->CreateDescriptor(nvrhi::BindingSetItem::RawBuffer_SRV(0, buffer)));
+
+    for (uint32_t i = 0; i < 12; i++)
+    {
+        if (!descriptors[i] || descriptors[i]->Get() != i)
+        {
+            printf("Bindless table: descriptor %u didn't get slot %u\n", i, i);
+            passed = false;
+        }
+    }
+
+    if (table->GetStats().capacity != 16 || table->GetStats().numGrowths != 2)
+    {
+        printf("Bindless table: grown to %u slots in %u steps instead of 16 in 2\n", table->GetStats().capacity, table->GetStats().numGrowths);
+        passed = false;
+    }
+
+    // Release slots 1..8. They're still in flight, so a new descriptor must not reuse them.
+    for (uint32_t i = 1; i <= 8; i++)
+        descriptors[i].reset();
+
+    BindlessDescriptorTable::Handle late = table->CreateDescriptor(nvrhi::BindingSetItem::RawBuffer_SRV(0, buffer));
+    if (!late || late->Get() != 12 || table->GetStats().numPendingRelease != 8)
+    {
+        printf("Bindless table: a slot was reused while it was in flight\n");
+        passed = false;
+    }
+
+    // Once the frame completes, the top four descriptors move into the lowest holes
+    const uint64_t version = table->GetVersion();
+    finishFrame();
+
+    const BindlessDescriptorTable::Descriptor* live[] = { descriptors[0].get(), descriptors[9].get(), descriptors[10].get(), descriptors[11].get(), late.get() };
+    uint32_t occupied = 0;
+    for (const BindlessDescriptorTable::Descriptor* descriptor : live)
+    {
+        if (descriptor && descriptor->Get() < 32)
+            occupied |= 1u << descriptor->Get();
+    }
+
+    if (descriptors[0]->Get() != 0)
+    {
+        printf("Bindless table: the descriptor in slot 0 moved to slot %u\n", descriptors[0]->Get());
+        passed = false;
+    }
+
+    if (occupied != 0x1f || table->GetStats().numMoves != 4)
+    {
+        printf("Bindless table: compaction made %u moves and left the slot mask 0x%x\n", table->GetStats().numMoves, occupied);
+        passed = false;
+    }
+
+    if (table->GetVersion() == version)
+    {
+        printf("Bindless table: the version didn't change after the moves\n");
+        passed = false;
+    }
+
+    // The moved-from slots are released after the next frame
+    finishFrame();
+
+    const BindlessDescriptorTable::Stats& stats = table->GetStats();
+    if (stats.highWaterMark != 5 || stats.numPendingRelease != 0 || stats.fragmentation != 0.f)
+    {
+        printf("Bindless table: %u slots in use, %u pending release after compaction\n", stats.highWaterMark, stats.numPendingRelease);
+        passed = false;
+    }
+
+    BindlessDescriptorTable::Handle reused = table->CreateDescriptor(nvrhi::BindingSetItem::RawBuffer_SRV(0, buffer));
+    if (!reused || reused->Get() != 5)
+    {
+        printf("Bindless table: the lowest free slot wasn't reused\n");
+        passed = false;
+    }
+
+    if (passed)
+        printf("Bindless table test PASSED\n");
+    else
+        printf("Bindless table test FAILED!\n");
+
+    return passed;
+}
+
+// Rasterizes a known occluder in front of many small triangles and checks the box tests against it,
+// and that the tiles and test results are the same with any number of threads. Runs on the CPU only.
+bool RunOcclusionRasterizerTest()
+{
+    using dm::float3;
+    using dm::box3;
+
+    constexpr uint32_t width = 256;
+    constexpr uint32_t height = 128;
+
+    // Positions are in clip space with w = 1, so all transforms are identity.
+    // The occluder is a quad over the middle of the screen at depth 0.5, aligned with the tiles.
+    const float3 occluderPositions[] = {
+        float3(-0.5f, -0.5f, 0.5f), float3(0.5f, -0.5f, 0.5f), float3(0.5f, 0.5f, 0.5f), float3(-0.5f, 0.5f, 0.5f)
+    };
+    const uint32_t occluderIndices[] = { 0, 1, 2, 0, 2, 3 };
+
+    // Small triangles behind it all over the screen, in a few meshes so that the setup runs in parallel too
+    constexpr uint32_t numClutterMeshes = 4;
+    constexpr uint32_t trianglesPerMesh = 500;
+    std::vector<float3> clutterPositions(numClutterMeshes * trianglesPerMesh * 3);
+    std::vector<uint32_t> clutterIndices(trianglesPerMesh * 3);
+    for (uint32_t index = 0; index < trianglesPerMesh * 3; index++)
+        clutterIndices[index] = index;
+
+    std::mt19937 randomGenerator(1);
+    std::uniform_real_distribution<float> random(0.f, 1.f);
+    for (uint32_t triangle = 0; triangle < numClutterMeshes * trianglesPerMesh; triangle++)
+    {
+        const float3 center = float3(random(randomGenerator) * 2.f - 1.f, random(randomGenerator) * 2.f - 1.f, 0.9f + random(randomGenerator) * 0.09f);
+        for (uint32_t vertex = 0; vertex < 3; vertex++)
+            clutterPositions[triangle * 3 + vertex] = center + float3(random(randomGenerator) - 0.5f, random(randomGenerator) - 0.5f, 0.f) * 0.2f;
+    }
+
+    std::vector<MaskedOcclusionRasterizer::Mesh> meshes;
+    MaskedOcclusionRasterizer::Mesh& occluder = meshes.emplace_back();
+    occluder.positions = occluderPositions;
+    occluder.indices = occluderIndices;
+    occluder.numTriangles = 2;
+    for (uint32_t mesh = 0; mesh < numClutterMeshes; mesh++)
+    {
+        MaskedOcclusionRasterizer::Mesh& clutter = meshes.emplace_back();
+        clutter.positions = clutterPositions.data() + mesh * trianglesPerMesh * 3;
+        clutter.indices = clutterIndices.data();
+        clutter.numTriangles = trianglesPerMesh;
+    }
+
+    const dm::float4x4 worldToClip = dm::float4x4::identity();
+
+    struct BoxCase
+    {
+        const char* name;
+        box3 bounds;
+        bool visible;
+    };
+
+    const BoxCase boxCases[] = {
+        { "behind the occluder", box3(float3(-0.2f, -0.2f, 0.6f), float3(0.2f, 0.2f, 0.8f)), false },
+        { "in front of the occluder", box3(float3(-0.2f, -0.2f, 0.2f), float3(0.2f, 0.2f, 0.3f)), true },
+        { "beside the occluder", box3(float3(0.7f, -0.2f, 0.6f), float3(0.9f, 0.2f, 0.8f)), true },
+        { "across the occluder edge", box3(float3(0.4f, -0.2f, 0.6f), float3(0.7f, 0.2f, 0.8f)), true },
+    };
+
+    MaskedOcclusionRasterizer reference;
+    reference.SetResolution(width, height);
+    reference.Clear(false);
+    reference.RenderOccluders(meshes);
+
+    bool passed = true;
+    for (const BoxCase& boxCase : boxCases)
+    {
+        if (reference.TestBox(boxCase.bounds, worldToClip) != boxCase.visible)
+        {
+            printf("Occlusion rasterizer: the box %s should be %s\n", boxCase.name, boxCase.visible ? "visible" : "hidden");
+            passed = false;
+        }
+    }
+
+    const float centerDepth = reference.GetTileDepth(reference.GetNumTilesX() / 2, reference.GetNumTilesY() / 2);
+    if (centerDepth != 0.5f)
+    {
+        printf("Occlusion rasterizer: the occluder tile has depth %f, expected 0.5\n", centerDepth);
+        passed = false;
+    }
+
+#ifdef DONUT_WITH_TASKFLOW
+    // Small boxes at the depth of the clutter, whose results depend on all of the triangles
+    auto testBoxGrid = [&worldToClip](const MaskedOcclusionRasterizer& rasterizer)
+    {
+        std::vector<bool> results;
+        for (int y = 0; y < 8; y++)
+        {
+            for (int x = 0; x < 16; x++)
+            {
+                const float3 mins = float3(float(x) / 8.f - 1.f, float(y) / 4.f - 1.f, 0.95f);
+                results.push_back(rasterizer.TestBox(box3(mins, mins + float3(0.05f, 0.05f, 0.01f)), worldToClip));
+            }
+        }
+        return results;
+    };
+
+    const std::vector<bool> referenceGrid = testBoxGrid(reference);
+
+    for (uint32_t numThreads : { 1u, 2u, 4u, 8u })
+    {
+        tf::Executor executor(numThreads);
+
+        MaskedOcclusionRasterizer rasterizer;
+        rasterizer.SetResolution(width, height);
+        rasterizer.Clear(false);
+        rasterizer.RenderOccluders(meshes, &executor);
+
+        uint32_t numDifferentTiles = 0;
+        for (uint32_t tileY = 0; tileY < reference.GetNumTilesY(); tileY++)
+        {
+            for (uint32_t tileX = 0; tileX < reference.GetNumTilesX(); tileX++)
+            {
+                if (rasterizer.GetTileDepth(tileX, tileY) != reference.GetTileDepth(tileX, tileY))
+                    ++numDifferentTiles;
+            }
+        }
+
+        if (numDifferentTiles != 0 || testBoxGrid(rasterizer) != referenceGrid)
+        {
+            printf("Occlusion rasterizer: %u threads differ from the serial result in %u tiles\n", numThreads, numDifferentTiles);
+            passed = false;
+        }
+    }
+#endif
+
+    if (passed)
+        printf("Occlusion rasterizer test PASSED\n");
+    else
+        printf("Occlusion rasterizer test FAILED!\n");
+
+    return passed;
+}
 
 int main(int argc, const char** argv)
 {
@@ -225,6 +975,25 @@ int main(int argc, const char** argv)
     if (!RunTest(deviceManager->GetDevice()))
         return 1;
 
+    // The mip generation shaders use wave operations, which are not available on DX11
+    if (api != nvrhi::GraphicsAPI::D3D11 && !RunMipGenTest(deviceManager->GetDevice()))
+        return 1;
+
+    // The shading rate shader is built with the other shared shaders, which have no DX11 version
+    if (api != nvrhi::GraphicsAPI::D3D11 && !RunShadingRateTest(deviceManager->GetDevice()))
+        return 1;
+
+    if (!RunOcclusionRasterizerTest())
+        return 1;
+
+    // D3D11 has no resource states, so the planner has nothing to check there
+    if (api != nvrhi::GraphicsAPI::D3D11 && !RunBarrierPlannerTest(deviceManager->GetDevice()))
+        return 1;
+
+    // DX11 has no descriptor tables
+    if (api != nvrhi::GraphicsAPI::D3D11 && !RunBindlessTableTest(deviceManager->GetDevice()))
+        return 1;
+
     deviceManager->Shutdown();
 
     return 0;
@@ -33,14 +33,38 @@
 #include <donut/core/vfs/VFS.h>
 #include <donut/core/math/math.h>
 #include <nvrhi/utils.h>
+#include <AnimationEvaluator.h>
+#include <BindlessDescriptorTable.h>
+#include <TransformHierarchy.h>
+
+#include <algorithm>
+
+#ifdef DONUT_WITH_TASKFLOW
+#include <taskflow/taskflow.hpp>
+#endif
 
 using namespace donut;
 using namespace donut::math;
 
 #include "lighting_cb.h"
+#include "skinning_cb.h"
 
 static const char* g_WindowTitle = "Donut Example: Bindless Ray Tracing";
 
+// Per-instance state for the batched skinning pass
+struct SkinnedInstanceInfo
+{
+    std::shared_ptr<engine::SkinnedMeshInstance> instance;
+    engine::DescriptorHandle inputBufferDescriptor;
+    BindlessDescriptorTable::Handle outputBufferDescriptor;
+    // The instance node and its joints in the transform hierarchy; the instance is skinned again when any of them moves
+    std::vector<uint32_t> hierarchyNodes;
+    // Cleared when the output vertices have never been written, then the previous positions start out the same
+    bool skinningInitialized = false;
+    // Cleared when the BLAS has never been built, then it's built from scratch instead of refitted
+    bool blasBuilt = false;
+};
+
 class BindlessRayTracing : public app::ApplicationBase
 {
 private:
@@ -69,9 +93,41 @@ private:
     std::shared_ptr<engine::DirectionalLight> m_SunLight;
     std::unique_ptr<engine::BindingCache> m_BindingCache;
 
+    nvrhi::ShaderHandle m_SkinningShader;
+    nvrhi::ComputePipelineHandle m_SkinningPipeline;
+    nvrhi::BindingLayoutHandle m_SkinningBindingLayout;
+    nvrhi::BindingSetHandle m_SkinningBindingSet;
+    nvrhi::BindingLayoutHandle m_SkinningOutputLayout;
+    std::shared_ptr<BindlessDescriptorTable> m_SkinningOutputTable;
+    nvrhi::BufferHandle m_SkinningWorkBuffer;
+    nvrhi::BufferHandle m_JointMatrixBuffer;
+
+    std::vector<SkinnedInstanceInfo> m_SkinnedInstances;
+    std::vector<SkinnedInstanceInfo*> m_SkinnedInstancesToUpdate;
+    std::vector<SkinningWorkItem> m_SkinningWorkItems;
+    std::vector<float4x4> m_JointMatrices;
+
+    AnimationEvaluator m_AnimationEvaluator;
+    TransformHierarchy m_TransformHierarchy;
+    std::vector<uint32_t> m_AnimatedNodes;
+
+    // TLAS instances in transform hierarchy order, so that a range of dirty nodes maps to a range of instances
+    std::vector<nvrhi::rt::InstanceDesc> m_TlasInstances;
+    std::vector<uint32_t> m_TlasInstanceNodes;
+    std::vector<uint32_t> m_NodeFirstTlasInstance;
+    std::vector<nvrhi::rt::IAccelStruct*> m_BlasPendingCompaction;
+    bool m_TlasValid = false;
+
+#ifdef DONUT_WITH_TASKFLOW
+    std::unique_ptr<tf::Executor> m_Executor;
+#endif
+
     bool m_EnableAnimations = true;
     float m_WallclockTime = 0.f;
 
+    // Frame index passed to the scene: 0 when it is loaded, then counting the rendered frames from 1
+    uint32_t m_SceneFrameIndex = 0;
+
 public:
     using ApplicationBase::ApplicationBase;
 
@@ -89,15 +145,7 @@ public:
 		m_CommonPasses = std::make_shared<engine::CommonRenderPasses>(GetDevice(), m_ShaderFactory);
         m_BindingCache = std::make_unique<engine::BindingCache>(GetDevice());
 
-        nvrhi::BindlessLayoutDesc bindlessLayoutDesc;
-        bindlessLayoutDesc.visibility = nvrhi::ShaderType::All;
-        bindlessLayoutDesc.firstSlot = 0;
-        bindlessLayoutDesc.maxCapacity = 1024;
-        bindlessLayoutDesc.registerSpaces = {
-            nvrhi::BindingLayoutItem::RawBuffer_SRV(1),
-            nvrhi::BindingLayoutItem::Texture_SRV(2)
-        };
-        m_BindlessLayout = GetDevice()->createBindlessLayout(bindlessLayoutDesc);
+        m_BindlessLayout = CreateSceneBindlessLayout(GetDevice());
 
         nvrhi::BindingLayoutDesc globalBindingLayoutDesc;
         globalBindingLayoutDesc.visibility = nvrhi::ShaderType::All;
@@ -127,7 +175,17 @@ public:
         m_SunLight->angularSize = 0.53f;
         m_SunLight->irradiance = 5.f;
 
-        m_Scene->FinishedLoading(GetFrameIndex());
+        m_SceneFrameIndex = 0;
+        m_Scene->FinishedLoading(m_SceneFrameIndex);
+        m_AnimationEvaluator.Init(*m_Scene->GetSceneGraph());
+        m_TransformHierarchy.Init(*m_Scene->GetSceneGraph());
+
+        for (const auto& node : m_AnimationEvaluator.GetTargetNodes())
+            m_AnimatedNodes.push_back(m_TransformHierarchy.FindNode(node.get()));
+
+#ifdef DONUT_WITH_TASKFLOW
+        m_Executor = std::make_unique<tf::Executor>();
+#endif
         
         m_Camera.LookAt(float3(0.f, 1.8f, 0.f), float3(1.f, 1.8f, 0.f));
         m_Camera.SetMoveSpeed(3.f);
@@ -146,11 +204,15 @@ public:
                 return false;
         }
 
+        if (!CreateSkinningPass(*m_ShaderFactory))
+            return false;
+
         m_CommandList = GetDevice()->createCommandList();
 
         m_CommandList->open();
 
         CreateAccelStructs(m_CommandList);
+        CreateTlasInstances();
 
         m_CommandList->close();
         GetDevice()->executeCommandList(m_CommandList);
@@ -211,20 +273,32 @@ public:
         if (IsSceneLoaded() && m_EnableAnimations)
         {
             m_WallclockTime += fElapsedTimeSeconds;
-            float offset = 0;
 
-            for (const auto& anim : m_Scene->GetSceneGraph()->GetAnimations())
+            // Offset each animation by 1 second so that the instances don't move in sync
+#ifdef DONUT_WITH_TASKFLOW
+            m_AnimationEvaluator.Evaluate(m_WallclockTime, 1.0f, m_Executor.get());
+#else
+            m_AnimationEvaluator.Evaluate(m_WallclockTime, 1.0f);
+#endif
+            m_AnimationEvaluator.ApplyToSceneGraph();
+
+            for (size_t target = 0; target < m_AnimatedNodes.size(); target++)
             {
-                float duration = anim->GetDuration();
-                float integral;
-                float animationTime = std::modf((m_WallclockTime + offset) / duration, &integral) * duration;
-                (void)anim->Apply(animationTime);
-                offset += 1.0f;
+                if (m_AnimatedNodes[target] != TransformHierarchy::c_InvalidNode && m_AnimationEvaluator.IsTargetChanged(target))
+                    m_TransformHierarchy.SyncLocalTransform(m_AnimatedNodes[target]);
             }
         }
 
-        const char* extraInfo = (m_RayPipeline != nullptr) ? "- using RayPipeline" : "- using RayQuery";
-        GetDeviceManager()->SetInformativeWindowTitle(g_WindowTitle, extraInfo);
+        std::string extraInfo = (m_RayPipeline != nullptr) ? "- using RayPipeline" : "- using RayQuery";
+        if (m_SkinningOutputTable)
+        {
+            const BindlessDescriptorTable::Stats& tableStats = m_SkinningOutputTable->GetStats();
+            char tableInfo[128];
+            snprintf(tableInfo, sizeof(tableInfo), " - skinning outputs: %u of %u slots, %.0f%% fragmented",
+                tableStats.numUsed, tableStats.capacity, tableStats.fragmentation * 100.f);
+            extraInfo += tableInfo;
+        }
+        GetDeviceManager()->SetInformativeWindowTitle(g_WindowTitle, extraInfo.c_str());
     }
 
     bool CreateRayTracingPipeline(engine::ShaderFactory& shaderFactory)
@@ -291,6 +365,210 @@ public:
         return true;
     }
 
+    // Creates the pipeline and buffers that skin all skinned instances in the scene with one dispatch.
+    // The input and output vertex buffers are accessed through bindless descriptors, the joint matrices
+    // of all instances are packed into one buffer, and a work item table maps thread groups to instances.
+    bool CreateSkinningPass(engine::ShaderFactory& shaderFactory)
+    {
+        const auto& skinnedInstances = m_Scene->GetSceneGraph()->GetSkinnedMeshInstances();
+        if (skinnedInstances.empty())
+            return true;
+
+        m_SkinningShader = shaderFactory.CreateShader("app/skinning.hlsl", "main", nullptr, nvrhi::ShaderType::Compute);
+
+        if (!m_SkinningShader)
+            return false;
+
+        nvrhi::BindlessLayoutDesc outputLayoutDesc;
+        outputLayoutDesc.visibility = nvrhi::ShaderType::Compute;
+        outputLayoutDesc.firstSlot = 0;
+        outputLayoutDesc.maxCapacity = c_MaxBindlessDescriptors;
+        outputLayoutDesc.registerSpaces = {
+            nvrhi::BindingLayoutItem::RawBuffer_UAV(3)
+        };
+        m_SkinningOutputLayout = GetDevice()->createBindlessLayout(outputLayoutDesc);
+        m_SkinningOutputTable = std::make_shared<BindlessDescriptorTable>(GetDevice(), m_SkinningOutputLayout);
+
+        nvrhi::BindingLayoutDesc bindingLayoutDesc;
+        bindingLayoutDesc.visibility = nvrhi::ShaderType::Compute;
+        bindingLayoutDesc.bindings = {
+            nvrhi::BindingLayoutItem::PushConstants(0, sizeof(SkinningConstants)),
+            nvrhi::BindingLayoutItem::StructuredBuffer_SRV(0),
+            nvrhi::BindingLayoutItem::StructuredBuffer_SRV(1)
+        };
+        m_SkinningBindingLayout = GetDevice()->createBindingLayout(bindingLayoutDesc);
+
+        auto pipelineDesc = nvrhi::ComputePipelineDesc()
+            .setComputeShader(m_SkinningShader)
+            .addBindingLayout(m_SkinningBindingLayout)
+            .addBindingLayout(m_BindlessLayout)
+            .addBindingLayout(m_SkinningOutputLayout);
+
+        m_SkinningPipeline = GetDevice()->createComputePipeline(pipelineDesc);
+
+        if (!m_SkinningPipeline)
+            return false;
+
+        size_t totalJoints = 0;
+        m_SkinnedInstances.reserve(skinnedInstances.size());
+        for (const auto& skinnedInstance : skinnedInstances)
+        {
+            SkinnedInstanceInfo info;
+            info.instance = skinnedInstance;
+            info.inputBufferDescriptor = m_DescriptorTable->CreateDescriptorHandle(
+                nvrhi::BindingSetItem::RawBuffer_SRV(0, skinnedInstance->GetPrototypeMesh()->buffers->vertexBuffer));
+            info.outputBufferDescriptor = m_SkinningOutputTable->CreateDescriptor(
+                nvrhi::BindingSetItem::RawBuffer_UAV(0, skinnedInstance->GetMesh()->buffers->vertexBuffer));
+
+            info.hierarchyNodes.push_back(m_TransformHierarchy.FindNode(skinnedInstance->GetNode()));
+            for (const auto& joint : skinnedInstance->joints)
+                info.hierarchyNodes.push_back(m_TransformHierarchy.FindNode(joint.node.get()));
+            m_SkinnedInstances.push_back(std::move(info));
+
+            totalJoints += skinnedInstance->joints.size();
+        }
+
+        nvrhi::BufferDesc bufferDesc;
+        bufferDesc.byteSize = skinnedInstances.size() * sizeof(SkinningWorkItem);
+        bufferDesc.structStride = sizeof(SkinningWorkItem);
+        bufferDesc.initialState = nvrhi::ResourceStates::ShaderResource;
+        bufferDesc.keepInitialState = true;
+        bufferDesc.debugName = "SkinningWorkItems";
+        m_SkinningWorkBuffer = GetDevice()->createBuffer(bufferDesc);
+
+        bufferDesc.byteSize = std::max<size_t>(totalJoints, 1) * sizeof(float4x4);
+        bufferDesc.structStride = sizeof(float4x4);
+        bufferDesc.debugName = "PackedJointMatrices";
+        m_JointMatrixBuffer = GetDevice()->createBuffer(bufferDesc);
+
+        nvrhi::BindingSetDesc bindingSetDesc;
+        bindingSetDesc.bindings = {
+            nvrhi::BindingSetItem::PushConstants(0, sizeof(SkinningConstants)),
+            nvrhi::BindingSetItem::StructuredBuffer_SRV(0, m_SkinningWorkBuffer),
+            nvrhi::BindingSetItem::StructuredBuffer_SRV(1, m_JointMatrixBuffer)
+        };
+        m_SkinningBindingSet = GetDevice()->createBindingSet(bindingSetDesc, m_SkinningBindingLayout);
+
+        m_SkinningWorkItems.reserve(m_SkinnedInstances.size());
+        m_JointMatrices.reserve(totalJoints);
+
+        return true;
+    }
+
+    // Selects the skinned instances that have never been skinned, or whose node or joints moved in the
+    // last transform hierarchy update. Must be called after that update and before RefreshBuffers.
+    void CollectSkinnedInstances()
+    {
+        m_SkinnedInstancesToUpdate.clear();
+
+        for (auto& info : m_SkinnedInstances)
+        {
+            // The scene skins every instance marked as updated in the current frame on its own, one dispatch
+            // each. All instances are skinned here instead, so they're marked as updated when the scene was loaded.
+            info.instance->SetLastUpdateFrameIndex(0);
+
+            const bool moved = std::any_of(info.hierarchyNodes.begin(), info.hierarchyNodes.end(),
+                [this](uint32_t node) { return node != TransformHierarchy::c_InvalidNode && m_TransformHierarchy.IsWorldTransformDirty(node); });
+
+            if (info.skinningInitialized && info.blasBuilt && !moved)
+                continue;
+
+            m_SkinnedInstancesToUpdate.push_back(&info);
+        }
+    }
+
+    void DispatchSkinning(nvrhi::ICommandList* commandList)
+    {
+        if (m_SkinnedInstancesToUpdate.empty())
+            return;
+
+        commandList->beginMarker("Batched Skinning");
+
+        m_SkinningWorkItems.clear();
+        m_JointMatrices.clear();
+        uint32_t numGroups = 0;
+
+        for (SkinnedInstanceInfo* info : m_SkinnedInstancesToUpdate)
+        {
+            const auto& skinnedInstance = info->instance;
+            const auto& prototypeMesh = skinnedInstance->GetPrototypeMesh();
+            const auto& skinnedMesh = skinnedInstance->GetMesh();
+            const auto& inputBuffers = prototypeMesh->buffers;
+            const auto& outputBuffers = skinnedMesh->buffers;
+
+            const uint32_t inputVertex = prototypeMesh->vertexOffset;
+            const uint32_t outputVertex = skinnedMesh->vertexOffset;
+
+            SkinningWorkItem work = {};
+            work.firstGroup = numGroups;
+            work.numVertices = prototypeMesh->totalVertices;
+            work.firstJoint = uint32_t(m_JointMatrices.size());
+            work.inputBufferIndex = info->inputBufferDescriptor.Get();
+            work.outputBufferIndex = info->outputBufferDescriptor->Get();
+
+            work.inputPositionOffset = uint32_t(inputBuffers->getVertexBufferRange(engine::VertexAttribute::Position).byteOffset + inputVertex * sizeof(float3));
+            work.inputNormalOffset = uint32_t(inputBuffers->getVertexBufferRange(engine::VertexAttribute::Normal).byteOffset + inputVertex * sizeof(uint32_t));
+            work.inputTangentOffset = uint32_t(inputBuffers->getVertexBufferRange(engine::VertexAttribute::Tangent).byteOffset + inputVertex * sizeof(uint32_t));
+            work.inputJointIndexOffset = uint32_t(inputBuffers->getVertexBufferRange(engine::VertexAttribute::JointIndices).byteOffset + inputVertex * sizeof(dm::vector<uint16_t, 4>));
+            work.inputJointWeightOffset = uint32_t(inputBuffers->getVertexBufferRange(engine::VertexAttribute::JointWeights).byteOffset + inputVertex * sizeof(float4));
+            work.outputPositionOffset = uint32_t(outputBuffers->getVertexBufferRange(engine::VertexAttribute::Position).byteOffset + outputVertex * sizeof(float3));
+            work.outputPrevPositionOffset = uint32_t(outputBuffers->getVertexBufferRange(engine::VertexAttribute::PrevPosition).byteOffset + outputVertex * sizeof(float3));
+            work.outputNormalOffset = uint32_t(outputBuffers->getVertexBufferRange(engine::VertexAttribute::Normal).byteOffset + outputVertex * sizeof(uint32_t));
+            work.outputTangentOffset = uint32_t(outputBuffers->getVertexBufferRange(engine::VertexAttribute::Tangent).byteOffset + outputVertex * sizeof(uint32_t));
+
+            if (!info->skinningInitialized)
+                work.flags |= SkinningWorkFlag_FirstFrame;
+            if (outputBuffers->hasAttribute(engine::VertexAttribute::PrevPosition))
+                work.flags |= SkinningWorkFlag_PrevPositions;
+            if (inputBuffers->hasAttribute(engine::VertexAttribute::Normal) && outputBuffers->hasAttribute(engine::VertexAttribute::Normal))
+                work.flags |= SkinningWorkFlag_Normals;
+            if (inputBuffers->hasAttribute(engine::VertexAttribute::Tangent) && outputBuffers->hasAttribute(engine::VertexAttribute::Tangent))
+                work.flags |= SkinningWorkFlag_Tangents;
+
+            // Joint matrices are relative to the skinned instance node, same as in the scene's skinning path
+            const dm::daffine3 worldToRoot = inverse(skinnedInstance->GetNode()->GetLocalToWorldTransform());
+            for (const auto& joint : skinnedInstance->joints)
+            {
+                dm::float4x4 jointMatrix = dm::affineToHomogeneous(dm::affine3(joint.node->GetLocalToWorldTransform() * worldToRoot));
+                m_JointMatrices.push_back(joint.inverseBindMatrix * jointMatrix);
+            }
+
+            m_SkinningWorkItems.push_back(work);
+            numGroups += dm::div_ceil(work.numVertices, SKINNING_GROUP_SIZE);
+            info->skinningInitialized = true;
+        }
+
+        commandList->writeBuffer(m_SkinningWorkBuffer, m_SkinningWorkItems.data(), m_SkinningWorkItems.size() * sizeof(SkinningWorkItem));
+        commandList->writeBuffer(m_JointMatrixBuffer, m_JointMatrices.data(), m_JointMatrices.size() * sizeof(float4x4));
+
+        // The vertex buffers are only accessed through the descriptor tables, which are not state tracked.
+        // The tracked UAV state also makes the BLAS builds wait for the dispatch.
+        for (SkinnedInstanceInfo* info : m_SkinnedInstancesToUpdate)
+        {
+            commandList->setBufferState(info->instance->GetPrototypeMesh()->buffers->vertexBuffer, nvrhi::ResourceStates::ShaderResource);
+            commandList->setBufferState(info->instance->GetMesh()->buffers->vertexBuffer, nvrhi::ResourceStates::UnorderedAccess);
+        }
+        commandList->commitBarriers();
+
+        nvrhi::ComputeState state;
+        state.pipeline = m_SkinningPipeline;
+        state.bindings = { m_SkinningBindingSet, m_DescriptorTable->GetDescriptorTable(), m_SkinningOutputTable->GetDescriptorTable() };
+        commandList->setComputeState(state);
+
+        SkinningConstants constants = {};
+        constants.numWorkItems = uint32_t(m_SkinningWorkItems.size());
+
+        // The dispatches write different vertices, so they don't need barriers between them
+        for (uint32_t firstGroup = 0; firstGroup < numGroups; firstGroup += SKINNING_MAX_GROUPS_PER_DISPATCH)
+        {
+            constants.groupOffset = firstGroup;
+            commandList->setPushConstants(&constants, sizeof(constants));
+            commandList->dispatch(std::min(numGroups - firstGroup, uint32_t(SKINNING_MAX_GROUPS_PER_DISPATCH)));
+        }
+
+        commandList->endMarker();
+    }
+
     void GetMeshBlasDesc(engine::MeshInfo& mesh, nvrhi::rt::AccelStructDesc& blasDesc) const
     {
         blasDesc.isTopLevel = false;
@@ -316,10 +594,10 @@ public:
             blasDesc.bottomLevelGeometries.push_back(geometryDesc);
         }
 
-        // don't compact acceleration structures that are built per frame
+        // don't compact acceleration structures that are built per frame, refit them instead
         if (mesh.skinPrototype != nullptr)
         {
-            blasDesc.buildFlags = nvrhi::rt::AccelStructBuildFlags::PreferFastTrace;
+            blasDesc.buildFlags = nvrhi::rt::AccelStructBuildFlags::PreferFastTrace | nvrhi::rt::AccelStructBuildFlags::AllowUpdate;
         }
         else
         {
@@ -344,6 +622,9 @@ public:
                 nvrhi::utils::BuildBottomLevelAccelStruct(commandList, as, blasDesc);
 
             mesh->accelStruct = as;
+
+            if (!mesh->skinPrototype)
+                m_BlasPendingCompaction.push_back(as);
         }
 
 
@@ -353,57 +634,103 @@ public:
         m_TopLevelAS = GetDevice()->createAccelStruct(tlasDesc);
     }
 
-    void BuildTLAS(nvrhi::ICommandList* commandList, uint32_t frameIndex) const
+    void CreateTlasInstances()
     {
-        commandList->beginMarker("Skinned BLAS Updates");
+        const uint32_t numNodes = uint32_t(m_TransformHierarchy.GetNumNodes());
 
-        // Transition all the buffers to their necessary states before building the BLAS'es to allow BLAS batching
-        for (const auto& skinnedInstance : m_Scene->GetSceneGraph()->GetSkinnedMeshInstances())
+        m_TlasInstances.clear();
+        m_TlasInstanceNodes.clear();
+        m_NodeFirstTlasInstance.resize(numNodes + 1);
+
+        for (uint32_t nodeIndex = 0; nodeIndex < numNodes; nodeIndex++)
         {
-            if (skinnedInstance->GetLastUpdateFrameIndex() < frameIndex)
+            m_NodeFirstTlasInstance[nodeIndex] = uint32_t(m_TlasInstances.size());
+
+            auto instance = std::dynamic_pointer_cast<engine::MeshInstance>(m_TransformHierarchy.GetNode(nodeIndex)->GetLeaf());
+            if (!instance)
                 continue;
 
-            commandList->setAccelStructState(skinnedInstance->GetMesh()->accelStruct, nvrhi::ResourceStates::AccelStructWrite);
-            commandList->setBufferState(skinnedInstance->GetMesh()->buffers->vertexBuffer, nvrhi::ResourceStates::AccelStructBuildInput);
+            nvrhi::rt::InstanceDesc instanceDesc;
+            instanceDesc.bottomLevelAS = instance->GetMesh()->accelStruct;
+            assert(instanceDesc.bottomLevelAS);
+            instanceDesc.instanceMask = 1;
+            instanceDesc.instanceID = instance->GetInstanceIndex();
+
+            m_TlasInstances.push_back(instanceDesc);
+            m_TlasInstanceNodes.push_back(nodeIndex);
+        }
+
+        m_NodeFirstTlasInstance[numNodes] = uint32_t(m_TlasInstances.size());
+        m_TlasValid = false;
+    }
+
+    void BuildTLAS(nvrhi::ICommandList* commandList)
+    {
+        commandList->beginMarker("Skinned BLAS Updates");
+
+        // Transition all the buffers written by the skinning pass to their necessary states
+        // before building the BLAS'es to allow BLAS batching
+        for (const SkinnedInstanceInfo* info : m_SkinnedInstancesToUpdate)
+        {
+            commandList->setAccelStructState(info->instance->GetMesh()->accelStruct, nvrhi::ResourceStates::AccelStructWrite);
+            commandList->setBufferState(info->instance->GetMesh()->buffers->vertexBuffer, nvrhi::ResourceStates::AccelStructBuildInput);
         }
         commandList->commitBarriers();
 
-        // Now build the BLAS'es
-        for (const auto& skinnedInstance : m_Scene->GetSceneGraph()->GetSkinnedMeshInstances())
+        // Now build the BLAS'es. Skinning doesn't change the topology, so after the first build
+        // the BLAS'es are refitted in place.
+        for (SkinnedInstanceInfo* info : m_SkinnedInstancesToUpdate)
         {
-            if (skinnedInstance->GetLastUpdateFrameIndex() < frameIndex)
-                continue;
-            
             nvrhi::rt::AccelStructDesc blasDesc;
-            GetMeshBlasDesc(*skinnedInstance->GetMesh(), blasDesc);
-            
-            nvrhi::utils::BuildBottomLevelAccelStruct(commandList, skinnedInstance->GetMesh()->accelStruct, blasDesc);
+            GetMeshBlasDesc(*info->instance->GetMesh(), blasDesc);
+
+            if (info->blasBuilt)
+                blasDesc.buildFlags = blasDesc.buildFlags | nvrhi::rt::AccelStructBuildFlags::PerformUpdate;
+
+            commandList->buildBottomLevelAccelStruct(info->instance->GetMesh()->accelStruct,
+                blasDesc.bottomLevelGeometries.data(), blasDesc.bottomLevelGeometries.size(), blasDesc.buildFlags);
+
+            info->blasBuilt = true;
         }
         commandList->endMarker();
 
-        std::vector<nvrhi::rt::InstanceDesc> instances;
+        // Compact acceleration structures that are tagged for compaction and have finished executing the original build
+        commandList->compactBottomLevelAccelStructs();
+
+        // The TLAS needs a rebuild when any BLAS changed: refitted after skinning, or moved by compaction
+        bool rebuildTlas = !m_TlasValid || !m_SkinnedInstancesToUpdate.empty();
 
-        for (const auto& instance : m_Scene->GetSceneGraph()->GetMeshInstances())
+        auto compacted = std::remove_if(m_BlasPendingCompaction.begin(), m_BlasPendingCompaction.end(),
+            [](nvrhi::rt::IAccelStruct* as) { return as->isCompacted(); });
+        if (compacted != m_BlasPendingCompaction.end())
         {
-            nvrhi::rt::InstanceDesc instanceDesc;
-            instanceDesc.bottomLevelAS = instance->GetMesh()->accelStruct;
-            assert(instanceDesc.bottomLevelAS);
-            instanceDesc.instanceMask = 1;
-            instanceDesc.instanceID = instance->GetInstanceIndex();
+            m_BlasPendingCompaction.erase(compacted, m_BlasPendingCompaction.end());
+            rebuildTlas = true;
+        }
+
+        // Update the transforms of the instances whose nodes moved
+        for (const TransformHierarchy::NodeRange& range : m_TransformHierarchy.GetDirtyRanges())
+        {
+            const uint32_t firstInstance = m_NodeFirstTlasInstance[range.begin];
+            const uint32_t lastInstance = m_NodeFirstTlasInstance[range.end];
 
-            auto node = instance->GetNode();
-            assert(node);
-            dm::affineToColumnMajor(node->GetLocalToWorldTransformFloat(), instanceDesc.transform);
+            for (uint32_t index = firstInstance; index < lastInstance; index++)
+            {
+                const dm::affine3 transform = dm::affine3(m_TransformHierarchy.GetWorldTransform(m_TlasInstanceNodes[index]));
+                dm::affineToColumnMajor(transform, m_TlasInstances[index].transform);
+            }
 
-            instances.push_back(instanceDesc);
+            rebuildTlas |= firstInstance != lastInstance;
         }
 
-        // Compact acceleration structures that are tagged for compaction and have finished executing the original build
-        commandList->compactBottomLevelAccelStructs();
+        if (!rebuildTlas)
+            return;
 
         commandList->beginMarker("TLAS Update");
-        commandList->buildTopLevelAccelStruct(m_TopLevelAS, instances.data(), instances.size());
+        commandList->buildTopLevelAccelStruct(m_TopLevelAS, m_TlasInstances.data(), m_TlasInstances.size());
         commandList->endMarker();
+
+        m_TlasValid = true;
     }
 
 
@@ -448,10 +775,27 @@ public:
         m_View.SetMatrices(m_Camera.GetWorldToViewMatrix(), perspProjD3DStyleReverse(dm::PI_f * 0.25f, windowViewport.width() / windowViewport.height(), 0.1f));
         m_View.UpdateCache();
 
+        // Recycle slots freed by finished frames and compact the table before this frame's
+        // skinning work items pick up their output buffer indices.
+        if (m_SkinningOutputTable)
+            m_SkinningOutputTable->Update();
+
         m_CommandList->open();
 
-        m_Scene->Refresh(m_CommandList, GetFrameIndex());
-        BuildTLAS(m_CommandList, GetFrameIndex());
+        ++m_SceneFrameIndex;
+
+        // The scene graph refresh still writes the node transforms that the instance buffer and the
+        // joint matrices use. The flat hierarchy only selects the skinned instances and TLAS instances to update.
+        m_Scene->RefreshSceneGraph(m_SceneFrameIndex);
+#ifdef DONUT_WITH_TASKFLOW
+        m_TransformHierarchy.Update(m_Executor.get());
+#else
+        m_TransformHierarchy.Update();
+#endif
+        CollectSkinnedInstances();
+        m_Scene->RefreshBuffers(m_CommandList, m_SceneFrameIndex);
+        DispatchSkinning(m_CommandList);
+        BuildTLAS(m_CommandList);
         
         LightingConstants constants = {};
         constants.ambientColor = float4(0.05f);
@@ -487,6 +831,9 @@ public:
 
         m_CommandList->close();
         GetDevice()->executeCommandList(m_CommandList);
+
+        if (m_SkinningOutputTable)
+            m_SkinningOutputTable->Submit();
     }
 
 };
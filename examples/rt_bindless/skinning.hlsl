@@ -0,0 +1,122 @@
+/*
+* Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+// Skins the vertices of all skinned instances in the scene in a single dispatch.
+// The work item table maps thread groups to instances, see SkinningWorkItem.
+
+#pragma pack_matrix(row_major)
+
+#include <donut/shaders/vulkan.hlsli>
+#include <donut/shaders/packing.hlsli>
+#include "skinning_cb.h"
+
+VK_PUSH_CONSTANT ConstantBuffer<SkinningConstants> g_Const : register(b0);
+
+StructuredBuffer<SkinningWorkItem> t_WorkItems : register(t0);
+StructuredBuffer<float4x4> t_JointMatrices : register(t1);
+
+VK_BINDING(0, 1) ByteAddressBuffer t_BindlessBuffers[] : register(t0, space1);
+VK_BINDING(0, 2) RWByteAddressBuffer u_BindlessVertexBuffers[] : register(u0, space3);
+
+static const uint c_SizeOfPosition = 12;
+static const uint c_SizeOfNormal = 4;
+static const uint c_SizeOfJointIndices = 8;
+static const uint c_SizeOfJointWeights = 16;
+
+// Finds the last work item whose first group is not greater than groupIndex.
+uint findWorkItem(uint groupIndex)
+{
+    uint first = 0;
+    uint last = g_Const.numWorkItems;
+
+    while (last - first > 1)
+    {
+        uint middle = (first + last) / 2;
+
+        if (t_WorkItems[middle].firstGroup <= groupIndex)
+            first = middle;
+        else
+            last = middle;
+    }
+
+    return first;
+}
+
+[numthreads(SKINNING_GROUP_SIZE, 1, 1)]
+void main(uint dispatchGroupIndex : SV_GroupID, uint threadIndex : SV_GroupThreadID)
+{
+    const uint groupIndex = g_Const.groupOffset + dispatchGroupIndex;
+    const SkinningWorkItem work = t_WorkItems[findWorkItem(groupIndex)];
+
+    const uint vertexIndex = (groupIndex - work.firstGroup) * SKINNING_GROUP_SIZE + threadIndex;
+    if (vertexIndex >= work.numVertices)
+        return;
+
+    // The work item is uniform across the thread group, so no NonUniformResourceIndex is needed here.
+    ByteAddressBuffer input = t_BindlessBuffers[work.inputBufferIndex];
+    RWByteAddressBuffer output = u_BindlessVertexBuffers[work.outputBufferIndex];
+
+    const float4 position = float4(asfloat(input.Load3(work.inputPositionOffset + vertexIndex * c_SizeOfPosition)), 1.0);
+    const uint2 packedJointIndices = input.Load2(work.inputJointIndexOffset + vertexIndex * c_SizeOfJointIndices);
+    const float4 jointWeights = asfloat(input.Load4(work.inputJointWeightOffset + vertexIndex * c_SizeOfJointWeights));
+
+    const uint4 jointIndices = work.firstJoint + uint4(
+        packedJointIndices.x & 0xffff,
+        packedJointIndices.x >> 16,
+        packedJointIndices.y & 0xffff,
+        packedJointIndices.y >> 16);
+
+    const float4x4 skinMatrix =
+        t_JointMatrices[jointIndices.x] * jointWeights.x +
+        t_JointMatrices[jointIndices.y] * jointWeights.y +
+        t_JointMatrices[jointIndices.z] * jointWeights.z +
+        t_JointMatrices[jointIndices.w] * jointWeights.w;
+
+    const float3 skinnedPosition = mul(position, skinMatrix).xyz;
+
+    if (work.flags & SkinningWorkFlag_PrevPositions)
+    {
+        // Preserve the previous frame's position for motion vectors, or initialize it on the first frame.
+        const float3 prevPosition = (work.flags & SkinningWorkFlag_FirstFrame)
+            ? skinnedPosition
+            : asfloat(output.Load3(work.outputPositionOffset + vertexIndex * c_SizeOfPosition));
+
+        output.Store3(work.outputPrevPositionOffset + vertexIndex * c_SizeOfPosition, asuint(prevPosition));
+    }
+
+    output.Store3(work.outputPositionOffset + vertexIndex * c_SizeOfPosition, asuint(skinnedPosition));
+
+    if (work.flags & SkinningWorkFlag_Normals)
+    {
+        float4 normal = Unpack_RGBA8_SNORM(input.Load(work.inputNormalOffset + vertexIndex * c_SizeOfNormal));
+        normal.xyz = normalize(mul(normal.xyz, (float3x3)skinMatrix));
+        output.Store(work.outputNormalOffset + vertexIndex * c_SizeOfNormal, Pack_RGBA8_SNORM(normal));
+    }
+
+    if (work.flags & SkinningWorkFlag_Tangents)
+    {
+        // The tangent handedness sign in .w is kept as is.
+        float4 tangent = Unpack_RGBA8_SNORM(input.Load(work.inputTangentOffset + vertexIndex * c_SizeOfNormal));
+        tangent.xyz = normalize(mul(tangent.xyz, (float3x3)skinMatrix));
+        output.Store(work.outputTangentOffset + vertexIndex * c_SizeOfNormal, Pack_RGBA8_SNORM(tangent));
+    }
+}
@@ -0,0 +1,68 @@
+/*
+* Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef SKINNING_CB_H
+#define SKINNING_CB_H
+
+#define SKINNING_GROUP_SIZE 256
+
+// Limit of the X dimension of a dispatch, larger batches are split into several dispatches
+#define SKINNING_MAX_GROUPS_PER_DISPATCH 65535
+
+#define SkinningWorkFlag_FirstFrame     0x01
+#define SkinningWorkFlag_PrevPositions  0x02
+#define SkinningWorkFlag_Normals        0x04
+#define SkinningWorkFlag_Tangents       0x08
+
+// One entry per skinned instance in the batch.
+// Every instance occupies a whole number of thread groups starting at firstGroup,
+// so all threads in a group work on the same instance.
+struct SkinningWorkItem
+{
+    uint firstGroup;
+    uint numVertices;
+    uint firstJoint;        // Offset of the instance's joints in the packed joint matrix buffer
+    uint flags;
+
+    int inputBufferIndex;   // Bindless SRV index of the prototype mesh vertex buffer
+    int outputBufferIndex;  // Bindless UAV index of the skinned mesh vertex buffer
+    uint inputPositionOffset;
+    uint inputNormalOffset;
+
+    uint inputTangentOffset;
+    uint inputJointIndexOffset;
+    uint inputJointWeightOffset;
+    uint outputPositionOffset;
+
+    uint outputPrevPositionOffset;
+    uint outputNormalOffset;
+    uint outputTangentOffset;
+    uint padding;
+};
+
+struct SkinningConstants
+{
+    uint numWorkItems;
+    uint groupOffset;       // Index of the first group of the dispatch in the batch
+};
+
+#endif // SKINNING_CB_H
@@ -34,6 +34,7 @@
 #include <donut/core/vfs/VFS.h>
 #include <donut/core/math/math.h>
 #include <nvrhi/utils.h>
+#include <BindlessDescriptorTable.h>
 
 
 using namespace donut;
@@ -112,6 +113,11 @@ struct UIData
     bool reorientParticlesInSecondaryRays = true;
     uint orientationMode = ORIENTATION_MODE_QUATERNION;
     uint mlabFragments = 4;
+    bool enableEarlyTermination = true;
+    float transmittanceEpsilon = 0.01f;
+    bool skipParticlesBehindFullBuffer = true;
+    bool showHitStatistics = false;
+    int hitStatisticsMax = 32;
     ParticleTexture particleTexture = ParticleTexture::Smoke;
     float3 emitterPosition = 0.f;
 };
@@ -136,6 +142,7 @@ private:
     std::shared_ptr<engine::DescriptorTableManager> m_DescriptorTable;
     std::unique_ptr<engine::Scene> m_Scene;
     nvrhi::TextureHandle m_ColorBuffer;
+    nvrhi::TextureHandle m_HitStatisticsBuffer;
     app::ThirdPersonCamera m_Camera;
     engine::PlanarView m_View;
     std::shared_ptr<engine::DirectionalLight> m_SunLight;
@@ -181,15 +188,7 @@ public:
 		m_CommonPasses = std::make_shared<engine::CommonRenderPasses>(GetDevice(), m_ShaderFactory);
         m_BindingCache = std::make_unique<engine::BindingCache>(GetDevice());
 
-        nvrhi::BindlessLayoutDesc bindlessLayoutDesc;
-        bindlessLayoutDesc.visibility = nvrhi::ShaderType::All;
-        bindlessLayoutDesc.firstSlot = 0;
-        bindlessLayoutDesc.maxCapacity = 1024;
-        bindlessLayoutDesc.registerSpaces = {
-            nvrhi::BindingLayoutItem::RawBuffer_SRV(1),
-            nvrhi::BindingLayoutItem::Texture_SRV(2)
-        };
-        m_BindlessLayout = GetDevice()->createBindlessLayout(bindlessLayoutDesc);
+        m_BindlessLayout = CreateSceneBindlessLayout(GetDevice());
 
         nvrhi::BindingLayoutDesc globalBindingLayoutDesc;
         globalBindingLayoutDesc.visibility = nvrhi::ShaderType::All;
@@ -201,7 +200,8 @@ public:
             nvrhi::BindingLayoutItem::StructuredBuffer_SRV(3),
             nvrhi::BindingLayoutItem::StructuredBuffer_SRV(4),
             nvrhi::BindingLayoutItem::Sampler(0),
-            nvrhi::BindingLayoutItem::Texture_UAV(0)
+            nvrhi::BindingLayoutItem::Texture_UAV(0),
+            nvrhi::BindingLayoutItem::Texture_UAV(1)
         };
         m_BindingLayout = GetDevice()->createBindingLayout(globalBindingLayoutDesc);
 
@@ -670,6 +670,7 @@ public:
     void BackBufferResizing() override
     { 
         m_ColorBuffer = nullptr;
+        m_HitStatisticsBuffer = nullptr;
         m_BindingCache->Clear();
     }
 
@@ -700,6 +701,11 @@ public:
             desc.debugName = "ColorBuffer";
             m_ColorBuffer = GetDevice()->createTexture(desc);
 
+            // Per-pixel particle candidate counts written by the shader: .x = shaded, .y = skipped
+            desc.format = nvrhi::Format::RG32_UINT;
+            desc.debugName = "HitStatisticsBuffer";
+            m_HitStatisticsBuffer = GetDevice()->createTexture(desc);
+
             nvrhi::BindingSetDesc bindingSetDesc;
             bindingSetDesc.bindings = {
                 nvrhi::BindingSetItem::ConstantBuffer(0, m_ConstantBuffer),
@@ -709,7 +715,8 @@ public:
                 nvrhi::BindingSetItem::StructuredBuffer_SRV(3, m_Scene->GetMaterialBuffer()),
                 nvrhi::BindingSetItem::StructuredBuffer_SRV(4, m_ParticleInfoBuffer),
                 nvrhi::BindingSetItem::Sampler(0, m_CommonPasses->m_AnisotropicWrapSampler),
-                nvrhi::BindingSetItem::Texture_UAV(0, m_ColorBuffer)
+                nvrhi::BindingSetItem::Texture_UAV(0, m_ColorBuffer),
+                nvrhi::BindingSetItem::Texture_UAV(1, m_HitStatisticsBuffer)
             };
 
             m_BindingSet = GetDevice()->createBindingSet(bindingSetDesc, m_BindingLayout);
@@ -746,6 +753,11 @@ public:
         constants.reorientParticlesInSecondaryRays = m_ui->reorientParticlesInSecondaryRays;
         constants.orientationMode = m_ui->orientationMode;
         constants.environmentMapTextureIndex = m_EnvironmentMap->bindlessDescriptor.Get();
+        constants.enableEarlyTermination = m_ui->enableEarlyTermination;
+        constants.transmittanceEpsilon = m_ui->transmittanceEpsilon;
+        constants.skipParticlesBehindFullBuffer = m_ui->skipParticlesBehindFullBuffer;
+        constants.showHitStatistics = m_ui->showHitStatistics;
+        constants.hitStatisticsScale = 1.f / float(std::max(m_ui->hitStatisticsMax, 1));
         m_CommandList->writeBuffer(m_ConstantBuffer, &constants, sizeof(constants));
         
         nvrhi::ComputeState state;
@@ -825,6 +837,22 @@ public:
             m_ui->mlabFragments = newFragmentCount;
             m_ui->updatePipeline = true;
         }
+
+        ImGui::Checkbox("Early ray termination", &m_ui->enableEarlyTermination);
+        if (m_ui->enableEarlyTermination)
+        {
+            ImGui::Indent();
+            ImGui::SliderFloat("Transmittance epsilon", &m_ui->transmittanceEpsilon, 0.f, 0.1f, "%.3f");
+            ImGui::Unindent();
+        }
+        ImGui::Checkbox("Skip particles behind full k-buffer", &m_ui->skipParticlesBehindFullBuffer);
+        ImGui::Checkbox("Show hit statistics", &m_ui->showHitStatistics);
+        if (m_ui->showHitStatistics)
+        {
+            ImGui::Indent();
+            ImGui::SliderInt("Max hits (red)", &m_ui->hitStatisticsMax, 1, 256);
+            ImGui::Unindent();
+        }
         ImGui::Separator();
 
         ImGui::Text("Emitter position:");
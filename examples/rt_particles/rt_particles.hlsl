@@ -30,7 +30,7 @@
 #include <donut/shaders/lighting.hlsli>
 #include <donut/shaders/scene_material.hlsli>
 #include "rt_particles_cb.h"
-#include "mlab.hlsli"
+#include "../common/mlab.hlsli"
 #include "utils.hlsli"
 
 VK_BINDING(0, 1) ByteAddressBuffer t_BindlessBuffers[] : register(t0, space1);
@@ -41,6 +41,7 @@ VK_BINDING(1, 1) Texture2D t_BindlessTextures[] : register(t0, space2);
 ConstantBuffer<GlobalConstants> g_Const : register(b0);
 
 RWTexture2D<float4> u_Output : register(u0);
+RWTexture2D<uint2> u_HitStatistics : register(u1);
 
 RaytracingAccelerationStructure SceneBVH : register(t0);
 StructuredBuffer<InstanceData> t_InstanceData : register(t1);
@@ -236,8 +237,27 @@ float4 getIntersectionParticleColor(RayDesc ray, uint particleIndex, float accum
     return baseColor;
 }
 
+// Returns the ray distance beyond which particles cannot visibly contribute to the blending array anymore.
+float getParticleCullDistance(BlendFragment buffer[MLAB_FRAGMENTS], float rayTMax)
+{
+    float cullDistance = rayTMax;
+
+    // Fragments behind the point where the accumulated transmittance becomes negligible are invisible.
+    if (g_Const.enableEarlyTermination)
+        cullDistance = min(cullDistance, blendGetOpaqueDepth(buffer, g_Const.transmittanceEpsilon));
+
+    // When the k-buffer is full, fragments behind the last slot would only be merged into it.
+    // Dropping them is an approximation, but a reasonable one for dense particle volumes.
+    if (g_Const.skipParticlesBehindFullBuffer && blendIsFull(buffer))
+        cullDistance = min(cullDistance, buffer[MLAB_FRAGMENTS-1].depth);
+
+    return cullDistance;
+}
+
 // Traces a ray looking for particles, returns the accumulated radiance and transmittance.
-BlendFragment accumulateParticles(RayDesc ray, float accumulatedHitDistance, float3x3 accumulatedVectorTransform, bool isSecondaryRay)
+// Adds the number of shaded (.x) and skipped (.y) particle candidates to hitStatistics.
+BlendFragment accumulateParticles(RayDesc ray, float accumulatedHitDistance, float3x3 accumulatedVectorTransform, bool isSecondaryRay,
+    inout uint2 hitStatistics)
 {
     // Use intersection particles if re-orientation is needed for this type of ray
     // (primary or secondary), per user settings. Primary and secondary rays generally
@@ -260,14 +280,34 @@ BlendFragment accumulateParticles(RayDesc ray, float accumulatedHitDistance, flo
     BlendFragment buffer[MLAB_FRAGMENTS];
     blendInit(buffer);
 
+    // Candidates farther than cullDistance are skipped without shading.
+    // The committed hit distance is the range still being traversed by the ray query: committing
+    // a hit makes the traversal reject all candidates behind it, which is how we terminate early.
+    // Candidates arrive in no particular order, so the traversal cannot simply be aborted.
+    float cullDistance = ray.TMax;
+    float committedDistance = ray.TMax;
+
     while (rayQuery.Proceed())
     {
         float4 particleColor = 0;
         float particleDistance = 0;
         uint particleIndex = 0;
+        bool isTriangle = false;
 
         if (rayQuery.CandidateType() == CANDIDATE_NON_OPAQUE_TRIANGLE)
         {
+            isTriangle = true;
+
+            // Reject the candidate before doing any material work if it's hidden behind the blended fragments.
+            // Committing it shrinks the traversal range to its distance.
+            if (rayQuery.CandidateTriangleRayT() > cullDistance)
+            {
+                rayQuery.CommitNonOpaqueTriangleHit();
+                committedDistance = rayQuery.CandidateTriangleRayT();
+                ++hitStatistics.y;
+                continue;
+            }
+
             RayHitInfo hitInfo;
 
             // Fill the hitInfo structure with candidate hit parameters.
@@ -286,10 +326,28 @@ BlendFragment accumulateParticles(RayDesc ray, float accumulatedHitDistance, flo
             // Particle index is stored in the instance's custom ID field.
             particleIndex = rayQuery.CandidateInstanceID();
 
+            // Any point of the billboard is within (radius * sqrt(2)) of its center, regardless of orientation,
+            // which gives a conservative lower bound on the hit distance.
+            const ParticleInfo particle = t_ParticleInfos[particleIndex];
+            const float minParticleDistance = length(particle.center - ray.Origin) - 1.4142136 / particle.inverseRadius;
+
+            if (minParticleDistance > cullDistance)
+            {
+                if (cullDistance < committedDistance)
+                {
+                    rayQuery.CommitProceduralPrimitiveHit(cullDistance);
+                    committedDistance = cullDistance;
+                }
+                ++hitStatistics.y;
+                continue;
+            }
+
             particleColor = getIntersectionParticleColor(ray, particleIndex, accumulatedHitDistance, accumulatedVectorTransform,
                 /* out */ particleDistance);
         }
 
+        ++hitStatistics.x;
+
         // Skip fragments that are completely transparent.
         if (particleColor.a == 0)
             continue;
@@ -300,12 +358,37 @@ BlendFragment accumulateParticles(RayDesc ray, float accumulatedHitDistance, flo
         f.attenuation = 1.0 - particleColor.a;
         f.depth = particleDistance;
         blendInsert(f, buffer);
+
+        cullDistance = getParticleCullDistance(buffer, ray.TMax);
+
+        // If this fragment is the one that made everything behind it invisible, commit it to let
+        // the traversal skip the rest of the ray. Procedural candidates can commit at any distance.
+        if (cullDistance < committedDistance)
+        {
+            if (!isTriangle)
+            {
+                rayQuery.CommitProceduralPrimitiveHit(cullDistance);
+                committedDistance = cullDistance;
+            }
+            else if (particleDistance >= cullDistance)
+            {
+                rayQuery.CommitNonOpaqueTriangleHit();
+                committedDistance = particleDistance;
+            }
+        }
     }
 
     // Integrate the blending array into one fragment.
     return blendIntegrate(buffer);
 }
 
+// Maps a hit count to a blue-green-red color ramp for the statistics overlay.
+float3 getHitStatisticsColor(uint hitCount)
+{
+    const float x = saturate(float(hitCount) * g_Const.hitStatisticsScale);
+    return saturate(float3(2.0 * x - 1.0, 1.0 - abs(2.0 * x - 1.0), 1.0 - 2.0 * x));
+}
+
 // Traces a ray looking for an opaque surface, returns the hit (if found) or instanceID = c_MissInstanceID (if not)
 RayHitInfo findOpaqueSurface(RayDesc ray, uint rayMask, float accumulatedHitDistance)
 {
@@ -357,6 +440,7 @@ void main(uint2 pixelPosition : SV_DispatchThreadID)
     float attenuation = 1.0;
     float accumulatedHitDistance = 0;
     float3x3 accumulatedVectorTransform = getIdentityMatrix();
+    uint2 hitStatistics = 0;
 
     // Trace a path starting at the camera.
     for (int bounce = 0; bounce < 8; ++bounce)
@@ -374,7 +458,8 @@ void main(uint2 pixelPosition : SV_DispatchThreadID)
         }
 
         // Trace a ray looking for particles.
-        BlendFragment particles = accumulateParticles(ray, accumulatedHitDistance, accumulatedVectorTransform, bounce > 0);
+        BlendFragment particles = accumulateParticles(ray, accumulatedHitDistance, accumulatedVectorTransform, bounce > 0,
+            /* inout */ hitStatistics);
 
         // Blend the particles over the regular geometry.
         float3 segmentColor = particles.color + surfaceColor * particles.attenuation;
@@ -409,5 +494,11 @@ void main(uint2 pixelPosition : SV_DispatchThreadID)
         finalColor += environmentRadiance * attenuation;
     }
 
+    // Per-pixel particle candidate counts: .x = shaded, .y = skipped
+    u_HitStatistics[pixelPosition] = hitStatistics;
+
+    if (g_Const.showHitStatistics)
+        finalColor = getHitStatisticsColor(hitStatistics.x);
+
     u_Output[pixelPosition] = float4(finalColor, 0);
 }
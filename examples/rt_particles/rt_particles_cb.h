@@ -35,6 +35,12 @@ struct GlobalConstants
     uint orientationMode;
 
     int environmentMapTextureIndex;
+    uint enableEarlyTermination;
+    float transmittanceEpsilon;
+    uint skipParticlesBehindFullBuffer;
+
+    uint showHitStatistics;
+    float hitStatisticsScale;
 };
 
 struct ParticleInfo
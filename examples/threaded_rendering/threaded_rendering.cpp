@@ -35,6 +35,7 @@
 #include <donut/core/vfs/VFS.h>
 #include <donut/core/math/math.h>
 #include <taskflow/taskflow.hpp>
+#include <BarrierPlanner.h>
 
 using namespace donut;
 
@@ -47,6 +48,8 @@ private:
 
     nvrhi::CommandListHandle m_CommandList;
     std::array<nvrhi::CommandListHandle, 6> m_FaceCommandLists;
+    std::array<BarrierPlanner, 6> m_FacePlanners;
+    BarrierPlanner m_BlitPlanner;
 
     bool m_UseThreads = true;
     std::unique_ptr<tf::Executor> m_Executor;
@@ -177,7 +180,32 @@ public:
     {
         m_Camera.Animate(fElapsedTimeSeconds);
 
-        GetDeviceManager()->SetInformativeWindowTitle(g_WindowTitle,m_UseThreads ? "(With threads)" : "(No threads)");
+        GetDeviceManager()->SetInformativeWindowTitle(g_WindowTitle, GetBarrierStats().c_str());
+    }
+
+    // Barrier counters of the previous frame, with the faces added up
+    std::string GetBarrierStats() const
+    {
+        BarrierPlanner::PassStats faceStats;
+        for (const BarrierPlanner& planner : m_FacePlanners)
+        {
+            for (uint32_t pass = 0; pass < planner.GetNumPasses(); pass++)
+            {
+                faceStats.barriersIssued += planner.GetPassStats(pass).barriersIssued;
+                faceStats.transitionsAvoided += planner.GetPassStats(pass).transitionsAvoided;
+            }
+        }
+
+        BarrierPlanner::PassStats blitStats;
+        if (m_BlitPlanner.GetNumPasses() > 0)
+            blitStats = m_BlitPlanner.GetPassStats(0);
+
+        char text[256];
+        snprintf(text, sizeof(text), "%s - barriers: faces %u issued, %u avoided; blit %u issued, %u avoided",
+            m_UseThreads ? "(With threads)" : "(No threads)",
+            faceStats.barriersIssued, faceStats.transitionsAvoided,
+            blitStats.barriersIssued, blitStats.transitionsAvoided);
+        return text;
     }
 
     void BackBufferResizing() override
@@ -190,17 +218,28 @@ public:
         const engine::IView* faceView = m_CubemapView.GetChildView(engine::ViewType::PLANAR, face);
 
         nvrhi::ICommandList* commandList = m_FaceCommandLists[face];
+        nvrhi::IFramebuffer* framebuffer = m_Framebuffer->GetFramebuffer(*faceView);
+
+        // The face only touches its own slices of the targets, so the transitions are planned
+        // once for the whole face instead of being tracked for every draw
+        BarrierPlanner& planner = m_FacePlanners[face];
+        planner.BeginFrame();
+        const uint32_t facePass = planner.AddPass("Face");
+        planner.WriteFramebuffer(facePass, framebuffer);
+
         commandList->open();
+
+        // Clears need different states on different APIs, so they keep the automatic barriers,
+        // and the planner picks up the states they leave the slices in
         commandList->clearDepthStencilTexture(m_DepthBuffer, faceView->GetSubresources(), true, 0.f, false, 0);
         commandList->clearTextureFloat(m_ColorBuffer, faceView->GetSubresources(), nvrhi::Color(0.f));
 
+        commandList->setEnableAutomaticBarriers(false);
+        planner.BeginPass(commandList, facePass);
+
         render::ForwardShadingPass::Context context;
         m_ForwardShadingPass->PrepareLights(context, commandList, {}, 1.0f, 0.3f, {});
 
-        commandList->setEnableAutomaticBarriers(false);
-        commandList->setResourceStatesForFramebuffer(m_Framebuffer->GetFramebuffer(*faceView));
-        commandList->commitBarriers();
-
         render::InstancedOpaqueDrawStrategy strategy;
 
         render::RenderCompositeView(commandList, faceView, faceView, *m_Framebuffer,
@@ -237,6 +276,14 @@ public:
         
         m_CommandList->open();
 
+        m_BlitPlanner.BeginFrame();
+        const uint32_t blitPass = m_BlitPlanner.AddPass("Blit");
+        m_BlitPlanner.ReadTexture(blitPass, m_ColorBuffer, nvrhi::ResourceStates::ShaderResource);
+        m_BlitPlanner.WriteFramebuffer(blitPass, framebuffer);
+
+        m_CommandList->setEnableAutomaticBarriers(false);
+        m_BlitPlanner.BeginPass(m_CommandList, blitPass);
+
         const std::vector<std::pair<int, int>> faceLayout = {
             { 3, 1 },
             { 1, 1 },
@@ -266,7 +313,8 @@ public:
             blitParams.sourceArraySlice = face;
             m_CommonPasses->BlitTexture(m_CommandList, blitParams, m_BindingCache.get());
         }
-        
+
+        m_CommandList->setEnableAutomaticBarriers(true);
         m_CommandList->close();
 
         if (m_UseThreads)
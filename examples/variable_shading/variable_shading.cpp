@@ -37,6 +37,8 @@
 #include <donut/core/vfs/VFS.h>
 #include <donut/core/math/math.h>
 #include <nvrhi/utils.h>
+#include <ReadbackQueue.h>
+#include <ShadingRateGenerator.h>
 
 
 using namespace donut;
@@ -168,12 +170,14 @@ private:
     std::unique_ptr<render::TransparentDrawStrategy> m_TransparentDrawStrategy;
     std::unique_ptr<engine::BindingCache> m_BindingCache;
 
-    nvrhi::ShaderHandle m_shadingRateSurfaceShader;
-    nvrhi::ComputePipelineHandle m_Pipeline;
-    nvrhi::BindingLayoutHandle m_bindingLayout;
-    nvrhi::BindingSetHandle m_bindingSet;
     nvrhi::TextureHandle m_shadingRateSurface;
     uint m_vrsTileSize;
+    bool m_vrsAdditionalRates = false;
+
+    std::unique_ptr<ShadingRateGenerator> m_ShadingRateGenerator;
+    std::unique_ptr<ReadbackQueue> m_ReadbackQueue;
+    ShadingRateQuality m_ShadingRateQuality = ShadingRateQuality::Balanced;
+    bool m_AdaptiveShadingRate = true;
 
     engine::PlanarView m_ViewPrevious;
     bool m_PreviousViewsValid = false;
@@ -189,22 +193,16 @@ public:
 
         std::filesystem::path sceneFileName = app::GetDirectoryWithExecutable().parent_path() / "media/glTF-Sample-Assets/Models/Sponza/glTF/Sponza.gltf";
         std::filesystem::path frameworkShaderPath = app::GetDirectoryWithExecutable() / "shaders/framework" / app::GetShaderTypeName(GetDevice()->getGraphicsAPI());
-        std::filesystem::path appShaderPath = app::GetDirectoryWithExecutable() / "shaders/variable_shading" / app::GetShaderTypeName(GetDevice()->getGraphicsAPI());
+        std::filesystem::path commonShaderPath = app::GetDirectoryWithExecutable() / "shaders/common" / app::GetShaderTypeName(GetDevice()->getGraphicsAPI());
         
         m_RootFS = std::make_shared<vfs::RootFileSystem>();
         m_RootFS->mount("/shaders/donut", frameworkShaderPath);
-        m_RootFS->mount("/shaders/app", appShaderPath);
+        m_RootFS->mount("/shaders/common", commonShaderPath);
 
         m_ShaderFactory = std::make_shared<engine::ShaderFactory>(GetDevice(), m_RootFS, "/shaders");
         m_CommonPasses = std::make_shared<engine::CommonRenderPasses>(GetDevice(), m_ShaderFactory);
         m_BindingCache = std::make_unique<engine::BindingCache>(GetDevice());
 
-        m_shadingRateSurfaceShader = m_ShaderFactory->CreateShader("/shaders/app/shaders.hlsl", "main_cs", nullptr, nvrhi::ShaderType::Compute);
-        if (!m_shadingRateSurfaceShader)
-        {
-            return false;
-        }
-
         auto nativeFS = std::make_shared<vfs::NativeFileSystem>();
         m_TextureCache = std::make_shared<engine::TextureCache>(GetDevice(), nativeFS, nullptr);
 
@@ -238,6 +236,7 @@ public:
             ID3D12Device* device = GetDevice()->getNativeObject(nvrhi::ObjectTypes::D3D12_Device);
             auto hr = device->CheckFeatureSupport(D3D12_FEATURE_D3D12_OPTIONS6, &options, sizeof(options));
             m_vrsTileSize = options.ShadingRateImageTileSize;
+            m_vrsAdditionalRates = options.AdditionalShadingRatesSupported;
         }
         else
 #endif
@@ -247,6 +246,14 @@ public:
             m_vrsTileSize = info.shadingRateImageTileSize;
         }
 
+        m_ShadingRateGenerator = std::make_unique<ShadingRateGenerator>(GetDevice(), *m_ShaderFactory, "common/shading_rate.hlsl", m_vrsTileSize);
+        if (!m_ShadingRateGenerator->IsValid())
+        {
+            return false;
+        }
+        m_ShadingRateGenerator->SetAllowAdditionalRates(m_vrsAdditionalRates);
+        m_ReadbackQueue = std::make_unique<ReadbackQueue>(GetDevice());
+
         GetDevice()->waitForIdle();
 
         return true;
@@ -267,6 +274,18 @@ public:
 
     bool KeyboardUpdate(int key, int scancode, int action, int mods) override
     {
+        if (key == GLFW_KEY_V && action == GLFW_PRESS)
+        {
+            m_AdaptiveShadingRate = !m_AdaptiveShadingRate;
+            return true;
+        }
+
+        if (key == GLFW_KEY_Q && action == GLFW_PRESS)
+        {
+            m_ShadingRateQuality = ShadingRateQuality((int(m_ShadingRateQuality) + 1) % int(ShadingRateQuality::Count));
+            return true;
+        }
+
         m_Camera.KeyboardUpdate(key, scancode, action, mods);
         return true;
     }
@@ -286,7 +305,26 @@ public:
     void Animate(float fElapsedTimeSeconds) override
     {
         m_Camera.Animate(fElapsedTimeSeconds);
-        GetDeviceManager()->SetInformativeWindowTitle(g_WindowTitle);
+
+        char extraInfo[256];
+        if (m_AdaptiveShadingRate)
+        {
+            // Rates are shown as fractions of the tiles from a few frames ago, the readback is asynchronous
+            const ShadingRateGenerator::Stats& stats = m_ShadingRateGenerator->GetStats();
+            snprintf(extraInfo, sizeof(extraInfo), "- VRS %s (Q): 1x1 %.0f%%, 1x2/2x1 %.0f%%, 2x2 %.0f%%, 2x4/4x2 %.0f%%, 4x4 %.0f%%, %.0f%% of full rate shading",
+                ShadingRateGenerator::GetQualityName(m_ShadingRateQuality),
+                stats.GetFraction(0x0) * 100.f,
+                (stats.GetFraction(0x1) + stats.GetFraction(0x4)) * 100.f,
+                stats.GetFraction(0x5) * 100.f,
+                (stats.GetFraction(0x6) + stats.GetFraction(0x9)) * 100.f,
+                stats.GetFraction(0xa) * 100.f,
+                stats.GetShadingRatio() * 100.f);
+        }
+        else
+        {
+            snprintf(extraInfo, sizeof(extraInfo), "- VRS off (V)");
+        }
+        GetDeviceManager()->SetInformativeWindowTitle(g_WindowTitle, extraInfo);
     }
 
     void BackBufferResizing() override
@@ -296,13 +334,16 @@ public:
         m_ForwardPass = nullptr;
         m_shadingRateSurface = nullptr;
         m_temporalPass = nullptr;
-        m_Pipeline = nullptr;
+        if (m_ShadingRateGenerator)
+            m_ShadingRateGenerator->ResetBindingCache();
     }
 
     void Render(nvrhi::IFramebuffer* framebuffer) override
     {
         const auto& fbinfo = framebuffer->getFramebufferInfo();
 
+        m_ReadbackQueue->Poll();
+
         if (!m_RenderTargets)
         {
             m_RenderTargets = std::make_unique<RenderTargets>(GetDevice(), int2(fbinfo.width, fbinfo.height));
@@ -363,33 +404,6 @@ public:
             m_temporalPass = std::make_unique<render::TemporalAntiAliasingPass>(GetDevice(), m_ShaderFactory, m_CommonPasses, m_View, taaParams);
         }
 
-        // A pipeline state for the compute shader which will generate the VRS surface
-        if (!m_Pipeline)
-        {
-            nvrhi::BindingLayoutDesc layoutDesc;
-            layoutDesc.visibility = nvrhi::ShaderType::Compute;
-            layoutDesc.bindings = {
-                nvrhi::BindingLayoutItem::Texture_UAV(0),
-                nvrhi::BindingLayoutItem::Texture_SRV(0),
-                nvrhi::BindingLayoutItem::Texture_SRV(1)
-            };
-            m_bindingLayout = GetDevice()->createBindingLayout(layoutDesc);
-
-            nvrhi::BindingSetDesc bindingSetDesc;
-            bindingSetDesc.bindings = {
-                nvrhi::BindingSetItem::Texture_UAV(0, m_shadingRateSurface, nvrhi::Format::R8_UINT),
-                nvrhi::BindingSetItem::Texture_SRV(0, m_RenderTargets->m_MotionVectors, nvrhi::Format::RG16_FLOAT),
-                nvrhi::BindingSetItem::Texture_SRV(1, m_RenderTargets->m_HdrColor, nvrhi::Format::RGBA16_FLOAT)
-            };
-            m_bindingSet = GetDevice()->createBindingSet(bindingSetDesc, m_bindingLayout);
-
-            nvrhi::ComputePipelineDesc psoDesc = {};
-            psoDesc.CS = m_shadingRateSurfaceShader;
-            psoDesc.bindingLayouts = { m_bindingLayout };
-
-            m_Pipeline = GetDevice()->createComputePipeline(psoDesc);
-        }
-
         m_CommandList->open();
 
         if (m_PreviousViewsValid)
@@ -397,13 +411,17 @@ public:
             m_temporalPass->RenderMotionVectors(m_CommandList, m_View, m_ViewPrevious);
         }
 
-        nvrhi::ComputeState state;
-        state.pipeline = m_Pipeline;
-        state.bindings = { m_bindingSet };
-        m_CommandList->setComputeState(state);
-
-        // Dispatch call to generate the VRS surface
-        m_CommandList->dispatch(surfaceDimensions.x, surfaceDimensions.y, 1);
+        // Generate the VRS surface from the previous frame's final image, reprojected with the motion vectors.
+        // Without a previous frame, or with adaptive shading off, everything is shaded at full rate.
+        if (m_AdaptiveShadingRate && m_PreviousViewsValid)
+        {
+            m_ShadingRateGenerator->Generate(m_CommandList, m_shadingRateSurface, m_RenderTargets->m_ResolvedColor,
+                m_RenderTargets->m_MotionVectors, m_ShadingRateQuality, m_ReadbackQueue.get());
+        }
+        else
+        {
+            m_CommandList->clearTextureUInt(m_shadingRateSurface, nvrhi::AllSubresources, 0);
+        }
 
         m_RenderTargets->Clear(m_CommandList);
 
@@ -494,6 +512,7 @@ public:
 
         m_CommandList->close();
         GetDevice()->executeCommandList(m_CommandList);
+        m_ReadbackQueue->Submit();
     }
 
 };
@@ -0,0 +1,218 @@
+/*
+* Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#include "CachedSky.h"
+
+#include <donut/engine/CommonRenderPasses.h>
+#include <donut/engine/FramebufferFactory.h>
+#include <donut/engine/SceneGraph.h>
+#include <donut/engine/ShaderFactory.h>
+#include <donut/engine/View.h>
+#include <nvrhi/utils.h>
+
+#include <cstring>
+
+using namespace donut;
+using namespace donut::math;
+using namespace donut::engine;
+using namespace donut::render;
+
+#include "cached_sky_cb.h"
+
+SkyLookupTables::SkyLookupTables(nvrhi::IDevice* device, const std::shared_ptr<ShaderFactory>& shaderFactory,
+    const std::shared_ptr<CommonRenderPasses>& commonPasses)
+    : m_Device(device)
+    , m_CommonPasses(commonPasses)
+    , m_BakedParams(std::make_unique<ProceduralSkyShaderParameters>())
+{
+    nvrhi::TextureDesc textureDesc;
+    textureDesc.width = c_LutWidth;
+    textureDesc.height = c_LutHeight;
+    textureDesc.format = nvrhi::Format::RGBA16_FLOAT;
+    textureDesc.isUAV = true;
+    textureDesc.initialState = nvrhi::ResourceStates::ShaderResource;
+    textureDesc.keepInitialState = true;
+    textureDesc.debugName = "SkyViewLut";
+    m_SkyViewLut = m_Device->createTexture(textureDesc);
+
+    textureDesc.width = c_CubemapSize;
+    textureDesc.height = c_CubemapSize;
+    textureDesc.arraySize = 6;
+    textureDesc.dimension = nvrhi::TextureDimension::TextureCube;
+    textureDesc.debugName = "SkyCubemap";
+    m_Cubemap = m_Device->createTexture(textureDesc);
+
+    m_ConstantBuffer = m_Device->createBuffer(nvrhi::utils::CreateVolatileConstantBufferDesc(
+        sizeof(CachedSkyConstants), "CachedSkyBakeConstants", engine::c_MaxRenderPassConstantBufferVersions));
+
+    nvrhi::BindingSetDesc lutBindings;
+    lutBindings.bindings = {
+        nvrhi::BindingSetItem::ConstantBuffer(0, m_ConstantBuffer),
+        nvrhi::BindingSetItem::Texture_UAV(0, m_SkyViewLut)
+    };
+    nvrhi::utils::CreateBindingSetAndLayout(m_Device, nvrhi::ShaderType::Compute, 0, lutBindings, m_LutBindingLayout, m_LutBindingSet);
+
+    nvrhi::BindingSetDesc cubemapBindings;
+    cubemapBindings.bindings = {
+        nvrhi::BindingSetItem::ConstantBuffer(0, m_ConstantBuffer),
+        nvrhi::BindingSetItem::Texture_SRV(0, m_SkyViewLut),
+        nvrhi::BindingSetItem::Sampler(0, m_CommonPasses->m_LinearWrapSampler),
+        nvrhi::BindingSetItem::Texture_UAV(1, m_Cubemap, nvrhi::Format::UNKNOWN, nvrhi::AllSubresources, nvrhi::TextureDimension::Texture2DArray)
+    };
+    nvrhi::utils::CreateBindingSetAndLayout(m_Device, nvrhi::ShaderType::Compute, 0, cubemapBindings, m_CubemapBindingLayout, m_CubemapBindingSet);
+
+    nvrhi::ComputePipelineDesc pipelineDesc;
+    pipelineDesc.CS = shaderFactory->CreateShader("app/cached_sky.hlsl", "bake_lut_cs", nullptr, nvrhi::ShaderType::Compute);
+    pipelineDesc.bindingLayouts = { m_LutBindingLayout };
+    m_LutPipeline = m_Device->createComputePipeline(pipelineDesc);
+
+    pipelineDesc.CS = shaderFactory->CreateShader("app/cached_sky.hlsl", "bake_cubemap_cs", nullptr, nvrhi::ShaderType::Compute);
+    pipelineDesc.bindingLayouts = { m_CubemapBindingLayout };
+    m_CubemapPipeline = m_Device->createComputePipeline(pipelineDesc);
+}
+
+SkyLookupTables::~SkyLookupTables() = default;
+
+bool SkyLookupTables::Update(nvrhi::ICommandList* commandList, const DirectionalLight& sun, const SkyParameters& params)
+{
+    ProceduralSkyShaderParameters shaderParams = {};
+    SkyPass::FillShaderParameters(sun, params, shaderParams);
+
+    // Everything that affects the tables, including the sun direction and color, ends up in the shader parameters
+    if (m_Valid && memcmp(&shaderParams, m_BakedParams.get(), sizeof(shaderParams)) == 0)
+        return false;
+
+    *m_BakedParams = shaderParams;
+    m_Valid = true;
+    ++m_NumBakes;
+
+    CachedSkyConstants constants = {};
+    constants.params = shaderParams;
+    constants.lutSize = float2(float(c_LutWidth), float(c_LutHeight));
+    constants.lutInvSize = 1.f / constants.lutSize;
+    constants.cubemapSize = c_CubemapSize;
+    constants.cubemapInvSize = 1.f / float(c_CubemapSize);
+
+    commandList->beginMarker("BakeSkyTables");
+    commandList->writeBuffer(m_ConstantBuffer, &constants, sizeof(constants));
+
+    nvrhi::ComputeState state;
+    state.pipeline = m_LutPipeline;
+    state.bindings = { m_LutBindingSet };
+    commandList->setComputeState(state);
+    commandList->dispatch(
+        (c_LutWidth + CACHED_SKY_GROUP_SIZE - 1) / CACHED_SKY_GROUP_SIZE,
+        (c_LutHeight + CACHED_SKY_GROUP_SIZE - 1) / CACHED_SKY_GROUP_SIZE, 1);
+
+    state.pipeline = m_CubemapPipeline;
+    state.bindings = { m_CubemapBindingSet };
+    commandList->setComputeState(state);
+    commandList->dispatch(
+        (c_CubemapSize + CACHED_SKY_GROUP_SIZE - 1) / CACHED_SKY_GROUP_SIZE,
+        (c_CubemapSize + CACHED_SKY_GROUP_SIZE - 1) / CACHED_SKY_GROUP_SIZE, 6);
+
+    commandList->endMarker();
+    return true;
+}
+
+CachedSkyPass::CachedSkyPass(nvrhi::IDevice* device,
+    const std::shared_ptr<ShaderFactory>& shaderFactory,
+    const std::shared_ptr<CommonRenderPasses>& commonPasses,
+    const std::shared_ptr<FramebufferFactory>& framebufferFactory,
+    const ICompositeView& compositeView,
+    Source source)
+    : m_Device(device)
+    , m_CommonPasses(commonPasses)
+    , m_FramebufferFactory(framebufferFactory)
+    , m_BindingCache(device)
+{
+    nvrhi::BindingLayoutDesc layoutDesc;
+    layoutDesc.visibility = nvrhi::ShaderType::Pixel;
+    layoutDesc.bindings = {
+        nvrhi::BindingLayoutItem::VolatileConstantBuffer(0),
+        nvrhi::BindingLayoutItem::Texture_SRV(0),
+        nvrhi::BindingLayoutItem::Texture_SRV(1),
+        nvrhi::BindingLayoutItem::Sampler(0)
+    };
+    m_BindingLayout = m_Device->createBindingLayout(layoutDesc);
+
+    std::vector<ShaderMacro> macros = { ShaderMacro("USE_CUBEMAP", source == Source::Cubemap ? "1" : "0") };
+    nvrhi::ShaderHandle pixelShader = shaderFactory->CreateShader("app/cached_sky.hlsl", "main_ps", &macros, nvrhi::ShaderType::Pixel);
+
+    const IView* sampleView = compositeView.GetChildView(ViewType::PLANAR, 0);
+    nvrhi::IFramebuffer* sampleFramebuffer = m_FramebufferFactory->GetFramebuffer(*sampleView);
+
+    // The fullscreen quad sits on the far plane, so the depth test keeps it behind the geometry
+    nvrhi::GraphicsPipelineDesc pipelineDesc;
+    pipelineDesc.primType = nvrhi::PrimitiveType::TriangleStrip;
+    pipelineDesc.VS = sampleView->IsReverseDepth() ? m_CommonPasses->m_FullscreenVS : m_CommonPasses->m_FullscreenAtOneVS;
+    pipelineDesc.PS = pixelShader;
+    pipelineDesc.bindingLayouts = { m_BindingLayout };
+    pipelineDesc.renderState.rasterState.setCullNone();
+    pipelineDesc.renderState.depthStencilState
+        .setDepthTestEnable(true)
+        .setDepthWriteEnable(false)
+        .setDepthFunc(sampleView->IsReverseDepth() ? nvrhi::ComparisonFunc::GreaterOrEqual : nvrhi::ComparisonFunc::LessOrEqual)
+        .setStencilEnable(false);
+    m_Pipeline = m_Device->createGraphicsPipeline(pipelineDesc, sampleFramebuffer);
+
+    m_ConstantBuffer = m_Device->createBuffer(nvrhi::utils::CreateVolatileConstantBufferDesc(
+        sizeof(CachedSkyConstants), "CachedSkyConstants", engine::c_MaxRenderPassConstantBufferVersions));
+}
+
+void CachedSkyPass::Render(nvrhi::ICommandList* commandList, const ICompositeView& compositeView, const SkyLookupTables& tables)
+{
+    nvrhi::BindingSetDesc bindingSetDesc;
+    bindingSetDesc.bindings = {
+        nvrhi::BindingSetItem::ConstantBuffer(0, m_ConstantBuffer),
+        nvrhi::BindingSetItem::Texture_SRV(0, tables.GetSkyViewLut()),
+        nvrhi::BindingSetItem::Texture_SRV(1, tables.GetCubemap()),
+        nvrhi::BindingSetItem::Sampler(0, m_CommonPasses->m_LinearWrapSampler)
+    };
+    nvrhi::BindingSetHandle bindingSet = m_BindingCache.GetOrCreateBindingSet(bindingSetDesc, m_BindingLayout);
+
+    commandList->beginMarker("CachedSky");
+
+    for (uint32_t viewIndex = 0; viewIndex < compositeView.GetNumChildViews(ViewType::PLANAR); viewIndex++)
+    {
+        const IView* view = compositeView.GetChildView(ViewType::PLANAR, viewIndex);
+
+        CachedSkyConstants constants = {};
+        constants.matClipToTranslatedWorld = view->GetInverseViewProjectionMatrix() * affineToHomogeneous(translation(-view->GetViewOrigin()));
+        constants.params = tables.GetShaderParameters();
+        commandList->writeBuffer(m_ConstantBuffer, &constants, sizeof(constants));
+
+        nvrhi::GraphicsState state;
+        state.pipeline = m_Pipeline;
+        state.framebuffer = m_FramebufferFactory->GetFramebuffer(*view);
+        state.bindings = { bindingSet };
+        state.viewport = view->GetViewportState();
+        commandList->setGraphicsState(state);
+
+        nvrhi::DrawArguments args;
+        args.instanceCount = 1;
+        args.vertexCount = 4;
+        commandList->draw(args);
+    }
+
+    commandList->endMarker();
+}
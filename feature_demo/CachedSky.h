@@ -0,0 +1,118 @@
+/*
+* Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <donut/engine/BindingCache.h>
+#include <donut/render/SkyPass.h>
+#include <nvrhi/nvrhi.h>
+#include <memory>
+
+struct ProceduralSkyShaderParameters;
+
+namespace donut::engine
+{
+    class CommonRenderPasses;
+    class DirectionalLight;
+    class FramebufferFactory;
+    class ICompositeView;
+    class IView;
+    class ShaderFactory;
+}
+
+// Precomputed tables for the procedural sky: a sky view LUT over azimuth and elevation, and a
+// low resolution cubemap sampled from it. They hold everything except the sun disc and are only
+// re-baked when the sky parameters or the sun change, which Update checks every frame.
+class SkyLookupTables
+{
+public:
+    SkyLookupTables(nvrhi::IDevice* device, const std::shared_ptr<donut::engine::ShaderFactory>& shaderFactory,
+        const std::shared_ptr<donut::engine::CommonRenderPasses>& commonPasses);
+    ~SkyLookupTables();
+
+    // Re-bakes the tables if the inputs differ from the last bake. Returns true when it did.
+    bool Update(nvrhi::ICommandList* commandList, const donut::engine::DirectionalLight& sun, const donut::render::SkyParameters& params);
+
+    [[nodiscard]] nvrhi::ITexture* GetSkyViewLut() const { return m_SkyViewLut; }
+    [[nodiscard]] nvrhi::ITexture* GetCubemap() const { return m_Cubemap; }
+    // Parameters of the last bake, with the sun that the lookup pass draws on top
+    [[nodiscard]] const ProceduralSkyShaderParameters& GetShaderParameters() const { return *m_BakedParams; }
+    [[nodiscard]] uint32_t GetNumBakes() const { return m_NumBakes; }
+
+    static constexpr uint32_t c_LutWidth = 256;
+    static constexpr uint32_t c_LutHeight = 128;
+    static constexpr uint32_t c_CubemapSize = 64;
+
+private:
+    nvrhi::DeviceHandle m_Device;
+    std::shared_ptr<donut::engine::CommonRenderPasses> m_CommonPasses;
+
+    nvrhi::BindingLayoutHandle m_LutBindingLayout;
+    nvrhi::BindingLayoutHandle m_CubemapBindingLayout;
+    nvrhi::BindingSetHandle m_LutBindingSet;
+    nvrhi::BindingSetHandle m_CubemapBindingSet;
+    nvrhi::ComputePipelineHandle m_LutPipeline;
+    nvrhi::ComputePipelineHandle m_CubemapPipeline;
+    nvrhi::BufferHandle m_ConstantBuffer;
+
+    nvrhi::TextureHandle m_SkyViewLut;
+    nvrhi::TextureHandle m_Cubemap;
+
+    std::unique_ptr<ProceduralSkyShaderParameters> m_BakedParams;
+    bool m_Valid = false;
+    uint32_t m_NumBakes = 0;
+};
+
+// Replacement for donut's SkyPass that draws the sky from SkyLookupTables, so that the per-pixel
+// cost is one table fetch and the sun disc. The main view samples the sky view LUT; passes that
+// render many low resolution views, such as light probe faces, can use the cubemap instead.
+class CachedSkyPass
+{
+public:
+    enum class Source
+    {
+        SkyViewLut,
+        Cubemap
+    };
+
+    CachedSkyPass(nvrhi::IDevice* device,
+        const std::shared_ptr<donut::engine::ShaderFactory>& shaderFactory,
+        const std::shared_ptr<donut::engine::CommonRenderPasses>& commonPasses,
+        const std::shared_ptr<donut::engine::FramebufferFactory>& framebufferFactory,
+        const donut::engine::ICompositeView& compositeView,
+        Source source);
+
+    // Draws the sky behind the depth buffer contents. The tables must be up to date.
+    void Render(nvrhi::ICommandList* commandList, const donut::engine::ICompositeView& compositeView, const SkyLookupTables& tables);
+
+    void ResetBindingCache() { m_BindingCache.Clear(); }
+
+private:
+    nvrhi::DeviceHandle m_Device;
+    std::shared_ptr<donut::engine::CommonRenderPasses> m_CommonPasses;
+    std::shared_ptr<donut::engine::FramebufferFactory> m_FramebufferFactory;
+
+    nvrhi::BindingLayoutHandle m_BindingLayout;
+    nvrhi::GraphicsPipelineHandle m_Pipeline;
+    nvrhi::BufferHandle m_ConstantBuffer;
+    donut::engine::BindingCache m_BindingCache;
+};
@@ -0,0 +1,332 @@
+/*
+* Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#include "DrawBundleCache.h"
+#include "ShadowCache.h"
+
+#include <donut/engine/FramebufferFactory.h>
+#include <donut/engine/SceneGraph.h>
+#include <donut/engine/View.h>
+#include <donut/render/DrawStrategy.h>
+
+#include <cstring>
+
+using namespace donut;
+using namespace donut::math;
+using namespace donut::engine;
+using namespace donut::render;
+
+namespace
+{
+    // Bundles that are not used for this many frames are dropped
+    constexpr uint64_t c_MaxUnusedFrames = 8;
+
+    bool AreViewportsEqual(const nvrhi::ViewportState& a, const nvrhi::ViewportState& b)
+    {
+        if (a.viewports.size() != b.viewports.size() || a.scissorRects.size() != b.scissorRects.size())
+            return false;
+
+        for (size_t index = 0; index < a.viewports.size(); index++)
+        {
+            if (!(a.viewports[index] == b.viewports[index]))
+                return false;
+        }
+
+        for (size_t index = 0; index < a.scissorRects.size(); index++)
+        {
+            if (!(a.scissorRects[index] == b.scissorRects[index]))
+                return false;
+        }
+
+        return true;
+    }
+}
+
+void DrawBundleCache::SetDynamicNodes(const SceneGraph& sceneGraph, const std::vector<std::shared_ptr<SceneGraphNode>>& animatedNodes)
+{
+    m_DynamicInstances.clear();
+
+    for (const auto& node : animatedNodes)
+    {
+        for (SceneGraphWalker walker(node.get()); walker; walker.Next(true))
+        {
+            if (auto meshInstance = dynamic_cast<MeshInstance*>(walker->GetLeaf().get()))
+                m_DynamicInstances.insert(meshInstance);
+        }
+    }
+
+    for (const auto& skinnedInstance : sceneGraph.GetSkinnedMeshInstances())
+        m_DynamicInstances.insert(skinnedInstance.get());
+
+    m_Bundles.clear();
+}
+
+void DrawBundleCache::Clear()
+{
+    m_Bundles.clear();
+    m_DynamicInstances.clear();
+    m_Stats = Stats();
+}
+
+void DrawBundleCache::BeginFrame()
+{
+    m_FrameIndex++;
+    m_Stats = Stats();
+
+    for (auto it = m_Bundles.begin(); it != m_Bundles.end(); )
+    {
+        if (it->second.lastUsedFrame + c_MaxUnusedFrames < m_FrameIndex)
+            it = m_Bundles.erase(it);
+        else
+            ++it;
+    }
+
+    m_Stats.numBundles = uint32_t(m_Bundles.size());
+}
+
+void DrawBundleCache::RenderCompositeView(
+    nvrhi::ICommandList* commandList,
+    const ICompositeView* compositeView,
+    const ICompositeView* compositeViewPrev,
+    FramebufferFactory& framebufferFactory,
+    const std::shared_ptr<SceneGraphNode>& rootNode,
+    IDrawStrategy& drawStrategy,
+    IGeometryPass& pass,
+    GeometryPassContext& passContext,
+    const char* passEvent,
+    bool materialEvents)
+{
+    if (materialEvents)
+    {
+        render::RenderCompositeView(commandList, compositeView, compositeViewPrev, framebufferFactory,
+            rootNode, drawStrategy, pass, passContext, passEvent, materialEvents);
+        return;
+    }
+
+    if (passEvent)
+        commandList->beginMarker(passEvent);
+
+    const ViewType::Enum supportedViewTypes = pass.GetSupportedViewTypes();
+
+    for (uint32_t viewIndex = 0; viewIndex < compositeView->GetNumChildViews(supportedViewTypes); viewIndex++)
+    {
+        const IView* view = compositeView->GetChildView(supportedViewTypes, viewIndex);
+        const IView* viewPrev = compositeViewPrev ? compositeViewPrev->GetChildView(supportedViewTypes, viewIndex) : nullptr;
+
+        RenderView(commandList, view, viewPrev, framebufferFactory.GetFramebuffer(*view), rootNode, drawStrategy, pass, passContext);
+    }
+
+    if (passEvent)
+        commandList->endMarker();
+}
+
+void DrawBundleCache::RenderView(
+    nvrhi::ICommandList* commandList,
+    const IView* view,
+    const IView* viewPrev,
+    nvrhi::IFramebuffer* framebuffer,
+    const std::shared_ptr<SceneGraphNode>& rootNode,
+    IDrawStrategy& drawStrategy,
+    IGeometryPass& pass,
+    GeometryPassContext& passContext)
+{
+    auto [bundleIt, inserted] = m_Bundles.try_emplace(std::make_pair(&pass, view));
+    Bundle& bundle = bundleIt->second;
+    bundle.lastUsedFrame = m_FrameIndex;
+    if (inserted)
+        m_Stats.numBundles++;
+
+    // The draws don't depend on the jitter, only the view constants do, and those are written every frame
+    const float4x4 viewProjection = view->GetViewProjectionMatrix(false);
+    const nvrhi::ViewportState viewport = view->GetViewportState();
+
+    const bool valid = bundle.valid
+        && bundle.version == m_Version
+        && bundle.framebuffer.Get() == framebuffer
+        && memcmp(&viewProjection, &bundle.viewProjection, sizeof(viewProjection)) == 0
+        && AreViewportsEqual(viewport, bundle.viewport);
+
+    pass.SetupView(passContext, commandList, view, viewPrev);
+
+    if (valid)
+    {
+        Replay(bundle, commandList, pass, passContext);
+        m_Stats.numReplayed++;
+        m_Stats.numReplayedDraws += uint32_t(bundle.draws.size());
+    }
+    else
+    {
+        bundle.version = m_Version;
+        bundle.framebuffer = framebuffer;
+        bundle.viewProjection = viewProjection;
+        bundle.viewport = viewport;
+
+        Record(bundle, commandList, view, framebuffer, rootNode, drawStrategy, pass, passContext);
+        m_Stats.numRecorded++;
+        m_Stats.numRecordedDraws += uint32_t(bundle.draws.size());
+    }
+
+    if (!m_DynamicInstances.empty())
+    {
+        ShadowCasterDrawStrategy dynamicStrategy(drawStrategy, m_DynamicInstances, true);
+        dynamicStrategy.PrepareForView(rootNode, *view);
+        render::RenderView(commandList, view, viewPrev, framebuffer, dynamicStrategy, pass, passContext, false);
+    }
+}
+
+void DrawBundleCache::Record(
+    Bundle& bundle,
+    nvrhi::ICommandList* commandList,
+    const IView* view,
+    nvrhi::IFramebuffer* framebuffer,
+    const std::shared_ptr<SceneGraphNode>& rootNode,
+    IDrawStrategy& drawStrategy,
+    IGeometryPass& pass,
+    GeometryPassContext& passContext)
+{
+    bundle.states.clear();
+    bundle.draws.clear();
+    bundle.valid = true;
+
+    ShadowCasterDrawStrategy staticStrategy(drawStrategy, m_DynamicInstances, false);
+    staticStrategy.PrepareForView(rootNode, *view);
+
+    nvrhi::GraphicsState graphicsState;
+    graphicsState.framebuffer = framebuffer;
+    graphicsState.viewport = view->GetViewportState();
+    graphicsState.shadingRateState = view->GetVariableRateShadingState();
+
+    const Material* lastMaterial = nullptr;
+    const BufferGroup* lastBuffers = nullptr;
+    nvrhi::RasterCullMode lastCullMode = nvrhi::RasterCullMode::Back;
+    bool drawMaterial = true;
+    bool stateValid = false;
+
+    // Consecutive instances of the same geometry are merged into one instanced draw
+    const MeshGeometry* pendingGeometry = nullptr;
+    nvrhi::DrawArguments pendingArgs;
+
+    auto flushDraw = [&]()
+    {
+        if (!pendingGeometry)
+            return;
+
+        if (!stateValid)
+        {
+            commandList->setGraphicsState(graphicsState);
+            bundle.states.push_back(graphicsState);
+            stateValid = true;
+        }
+
+        Draw& draw = bundle.draws.emplace_back();
+        draw.state = uint32_t(bundle.states.size() - 1);
+        draw.buffers = lastBuffers;
+        draw.args = pendingArgs;
+
+        pass.SetPushConstants(passContext, commandList, graphicsState, pendingArgs);
+        commandList->drawIndexed(pendingArgs);
+
+        pendingGeometry = nullptr;
+    };
+
+    while (const DrawItem* item = staticStrategy.GetNextItem())
+    {
+        if (!item->material)
+            continue;
+
+        const uint32_t instanceIndex = item->instance->GetInstanceIndex();
+
+        if (item->geometry == pendingGeometry
+            && item->buffers == lastBuffers
+            && item->material == lastMaterial
+            && item->cullMode == lastCullMode
+            && instanceIndex == pendingArgs.startInstanceLocation + pendingArgs.instanceCount)
+        {
+            pendingArgs.instanceCount++;
+            continue;
+        }
+
+        // The pending draw still needs the context of its own buffers and material
+        flushDraw();
+
+        if (item->buffers != lastBuffers)
+        {
+            pass.SetupInputBuffers(passContext, item->buffers, graphicsState);
+            lastBuffers = item->buffers;
+            stateValid = false;
+        }
+
+        if (item->material != lastMaterial || item->cullMode != lastCullMode)
+        {
+            drawMaterial = pass.SetupMaterial(passContext, item->material, item->cullMode, graphicsState);
+            lastMaterial = item->material;
+            lastCullMode = item->cullMode;
+            stateValid = false;
+        }
+
+        if (!drawMaterial)
+            continue;
+
+        pendingGeometry = item->geometry;
+        pendingArgs = nvrhi::DrawArguments();
+        pendingArgs.vertexCount = item->geometry->numIndices;
+        pendingArgs.instanceCount = 1;
+        pendingArgs.startVertexLocation = item->mesh->vertexOffset + item->geometry->vertexOffsetInMesh;
+        pendingArgs.startIndexLocation = item->mesh->indexOffset + item->geometry->indexOffsetInMesh;
+        pendingArgs.startInstanceLocation = instanceIndex;
+    }
+
+    flushDraw();
+}
+
+void DrawBundleCache::Replay(
+    Bundle& bundle,
+    nvrhi::ICommandList* commandList,
+    IGeometryPass& pass,
+    GeometryPassContext& passContext)
+{
+    const BufferGroup* lastBuffers = nullptr;
+    uint32_t lastState = ~0u;
+
+    for (const Draw& draw : bundle.draws)
+    {
+        nvrhi::GraphicsState& state = bundle.states[draw.state];
+
+        // The input buffer setup is repeated only for the offsets that the pass keeps in its context
+        // and writes into the push constants. The state it produces is the recorded one already.
+        if (draw.buffers != lastBuffers)
+        {
+            pass.SetupInputBuffers(passContext, draw.buffers, state);
+            lastBuffers = draw.buffers;
+        }
+
+        if (draw.state != lastState)
+        {
+            commandList->setGraphicsState(state);
+            lastState = draw.state;
+        }
+
+        nvrhi::DrawArguments args = draw.args;
+        pass.SetPushConstants(passContext, commandList, state, args);
+        commandList->drawIndexed(args);
+    }
+}
@@ -0,0 +1,153 @@
+/*
+* Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <donut/core/math/math.h>
+#include <donut/render/GeometryPasses.h>
+#include <nvrhi/nvrhi.h>
+#include <map>
+#include <memory>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace donut::engine
+{
+    class BufferGroup;
+    class FramebufferFactory;
+    class ICompositeView;
+    class IView;
+    class MeshInstance;
+    class SceneGraph;
+    class SceneGraphNode;
+}
+
+namespace donut::render
+{
+    class IDrawStrategy;
+}
+
+// Pre-recorded draws of the static items of geometry passes, replayed in later frames.
+//
+// NVRHI has no bundles or secondary command lists, so a bundle is recorded on the CPU instead: the
+// graphics states and draw arguments that the pass produces for the static items of one view are
+// kept, and replaying them skips the draw strategy, the material setup and the binding lookups,
+// leaving one setGraphicsState per state change and the draws. The items of dynamic instances are
+// drawn live after the replay, so this is only valid for passes where the draw order between static
+// and dynamic items doesn't matter: opaque passes and order-independent transparency.
+//
+// A bundle is re-recorded when its view, its framebuffer or the static scene changes. Invalidate()
+// only forces the re-recording, for pipeline or binding changes, while SetDynamicNodes() and Clear()
+// follow scene loads. Bundles are kept per pass and view object, and dropped when not used for a few frames.
+class DrawBundleCache
+{
+public:
+    struct Stats
+    {
+        uint32_t numBundles = 0;
+        uint32_t numReplayed = 0;
+        uint32_t numRecorded = 0;
+        uint32_t numReplayedDraws = 0;
+        uint32_t numRecordedDraws = 0;
+    };
+
+    // Marks the mesh instances under the animated nodes, and all skinned instances, as dynamic
+    void SetDynamicNodes(const donut::engine::SceneGraph& sceneGraph, const std::vector<std::shared_ptr<donut::engine::SceneGraphNode>>& animatedNodes);
+
+    // Re-records all bundles on their next use, call after pipelines, bindings or materials have changed
+    void Invalidate() { m_Version++; }
+
+    // Drops all bundles, call before unloading the scene
+    void Clear();
+
+    void BeginFrame();
+
+    // Replacement for donut's RenderCompositeView that replays the static items of each child view
+    // from its bundle. Falls back to the live path with material events, which bundles don't record.
+    void RenderCompositeView(
+        nvrhi::ICommandList* commandList,
+        const donut::engine::ICompositeView* compositeView,
+        const donut::engine::ICompositeView* compositeViewPrev,
+        donut::engine::FramebufferFactory& framebufferFactory,
+        const std::shared_ptr<donut::engine::SceneGraphNode>& rootNode,
+        donut::render::IDrawStrategy& drawStrategy,
+        donut::render::IGeometryPass& pass,
+        donut::render::GeometryPassContext& passContext,
+        const char* passEvent = nullptr,
+        bool materialEvents = false);
+
+    [[nodiscard]] const Stats& GetStats() const { return m_Stats; }
+
+private:
+    struct Draw
+    {
+        uint32_t state;
+        // The passes derive their push constants from the input buffers, see Replay
+        const donut::engine::BufferGroup* buffers;
+        nvrhi::DrawArguments args;
+    };
+
+    struct Bundle
+    {
+        uint64_t version = 0;
+        uint64_t lastUsedFrame = 0;
+        donut::math::float4x4 viewProjection = donut::math::float4x4::identity();
+        nvrhi::ViewportState viewport;
+        nvrhi::FramebufferHandle framebuffer;
+        std::vector<nvrhi::GraphicsState> states;
+        std::vector<Draw> draws;
+        bool valid = false;
+    };
+
+    void RenderView(
+        nvrhi::ICommandList* commandList,
+        const donut::engine::IView* view,
+        const donut::engine::IView* viewPrev,
+        nvrhi::IFramebuffer* framebuffer,
+        const std::shared_ptr<donut::engine::SceneGraphNode>& rootNode,
+        donut::render::IDrawStrategy& drawStrategy,
+        donut::render::IGeometryPass& pass,
+        donut::render::GeometryPassContext& passContext);
+
+    void Record(
+        Bundle& bundle,
+        nvrhi::ICommandList* commandList,
+        const donut::engine::IView* view,
+        nvrhi::IFramebuffer* framebuffer,
+        const std::shared_ptr<donut::engine::SceneGraphNode>& rootNode,
+        donut::render::IDrawStrategy& drawStrategy,
+        donut::render::IGeometryPass& pass,
+        donut::render::GeometryPassContext& passContext);
+
+    void Replay(
+        Bundle& bundle,
+        nvrhi::ICommandList* commandList,
+        donut::render::IGeometryPass& pass,
+        donut::render::GeometryPassContext& passContext);
+
+    std::map<std::pair<const donut::render::IGeometryPass*, const donut::engine::IView*>, Bundle> m_Bundles;
+    std::unordered_set<const donut::engine::MeshInstance*> m_DynamicInstances;
+    uint64_t m_Version = 1;
+    uint64_t m_FrameIndex = 0;
+    Stats m_Stats;
+};
@@ -0,0 +1,545 @@
+/*
+* Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#include "DrawListCache.h"
+
+#include <donut/engine/SceneGraph.h>
+#include <donut/engine/View.h>
+
+#ifdef DONUT_WITH_TASKFLOW
+#include <taskflow/taskflow.hpp>
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <functional>
+
+using namespace donut;
+using namespace donut::math;
+using namespace donut::engine;
+using namespace donut::render;
+
+namespace
+{
+    // Lists of views that are not prepared for this many frames are dropped
+    constexpr uint64_t c_MaxUnusedFrames = 8;
+
+    // The insertion pass gives up after this many moves per item and the list is radix sorted
+    constexpr size_t c_MaxInsertionMovesPerItem = 4;
+
+    // Shorter lists are sorted with std::stable_sort instead of the radix sort
+    constexpr size_t c_MinRadixSortItems = 256;
+
+    // Radix sorts are split into chunks of at least this many items for the executor
+    constexpr size_t c_MinRadixChunkItems = 8192;
+
+    // Distances are not negative, so their bits sort like the values
+    uint32_t DistanceBits(float distance)
+    {
+        uint32_t bits;
+        memcpy(&bits, &distance, sizeof(bits));
+        return bits;
+    }
+}
+
+void DrawListCache::ListStrategy::PrepareForView(const std::shared_ptr<SceneGraphNode>& rootNode, const IView& view)
+{
+    m_Items = &m_Cache.Prepare(m_Type, m_Order, rootNode, view);
+    m_NextItem = 0;
+}
+
+const DrawItem* DrawListCache::ListStrategy::GetNextItem()
+{
+    if (!m_Items || m_NextItem >= m_Items->size())
+        return nullptr;
+
+    return &(*m_Items)[m_NextItem++];
+}
+
+#ifdef DONUT_WITH_TASKFLOW
+DrawListCache::DrawListCache(tf::Executor* executor)
+    : m_Executor(executor)
+    , m_OpaqueStrategy(*this, ListType_Opaque, SortOrder_State)
+#else
+DrawListCache::DrawListCache()
+    : m_OpaqueStrategy(*this, ListType_Opaque, SortOrder_State)
+#endif
+    , m_TransparentStrategy(*this, ListType_Transparent, SortOrder_BackToFront)
+    , m_UnsortedTransparentStrategy(*this, ListType_Transparent, SortOrder_State)
+{
+}
+
+void DrawListCache::SetDynamicNodes(const SceneGraph& sceneGraph, const std::vector<std::shared_ptr<SceneGraphNode>>& animatedNodes)
+{
+    m_DynamicInstances.clear();
+
+    for (const auto& node : animatedNodes)
+    {
+        for (SceneGraphWalker walker(node.get()); walker; walker.Next(true))
+        {
+            if (auto meshInstance = dynamic_cast<MeshInstance*>(walker->GetLeaf().get()))
+                m_DynamicInstances.insert(meshInstance);
+        }
+    }
+
+    for (const auto& skinnedInstance : sceneGraph.GetSkinnedMeshInstances())
+        m_DynamicInstances.insert(skinnedInstance.get());
+
+    Invalidate();
+}
+
+void DrawListCache::Clear()
+{
+    for (List& list : m_Lists)
+        list = List();
+
+    m_DynamicInstances.clear();
+    m_RootNode = nullptr;
+    m_TableValid = false;
+    m_Stats = Stats();
+}
+
+void DrawListCache::BeginFrame()
+{
+    m_FrameIndex++;
+    m_Stats = Stats();
+
+    for (List& list : m_Lists)
+    {
+        for (auto& views : list.views)
+        {
+            for (auto it = views.begin(); it != views.end(); )
+            {
+                if (it->second.lastUsedFrame + c_MaxUnusedFrames < m_FrameIndex)
+                    it = views.erase(it);
+                else
+                    ++it;
+            }
+
+            m_Stats.numViews += uint32_t(views.size());
+        }
+
+        m_Stats.numEntries += uint32_t(list.entries.size());
+    }
+
+    if (!m_TableValid)
+        return;
+
+    bool changed = false;
+    for (List& list : m_Lists)
+    {
+        list.changedEntries.clear();
+
+        for (uint32_t index : list.dynamicEntries)
+        {
+            Entry& entry = list.entries[index];
+            const affine3 transform = entry.item.instance->GetNode()->GetLocalToWorldTransformFloat();
+            if (memcmp(&transform, &entry.transform, sizeof(transform)) == 0)
+                continue;
+
+            entry.transform = transform;
+            entry.bounds = entry.item.geometry->objectSpaceBounds * transform;
+            list.changedEntries.push_back(index);
+        }
+
+        changed |= !list.changedEntries.empty();
+        m_Stats.numDirtyEntries += uint32_t(list.changedEntries.size());
+    }
+
+    // The dirty entries always belong to the latest change version, so that views which missed
+    // no version since their last update can apply them even a few frames later
+    if (!changed)
+        return;
+
+    for (List& list : m_Lists)
+    {
+        for (uint32_t index : list.dirtyEntries)
+            list.dirtyMask[index] = false;
+        for (uint32_t index : list.changedEntries)
+            list.dirtyMask[index] = true;
+
+        std::swap(list.dirtyEntries, list.changedEntries);
+    }
+
+    m_ChangeVersion++;
+}
+
+void DrawListCache::BuildTable(const std::shared_ptr<SceneGraphNode>& rootNode)
+{
+    for (List& list : m_Lists)
+    {
+        list.entries.clear();
+        list.dynamicEntries.clear();
+        list.dirtyEntries.clear();
+        list.changedEntries.clear();
+    }
+
+    // Small sequential ids for the sort keys, shared by both lists
+    std::unordered_map<const void*, uint32_t> materialIds;
+    std::unordered_map<const void*, uint32_t> buffersIds;
+    std::unordered_map<const void*, uint32_t> geometryIds;
+    auto getId = [](std::unordered_map<const void*, uint32_t>& ids, const void* object)
+    {
+        return ids.try_emplace(object, uint32_t(ids.size())).first->second;
+    };
+
+    for (SceneGraphWalker walker(rootNode.get()); walker; walker.Next(true))
+    {
+        const auto* instance = dynamic_cast<MeshInstance*>(walker->GetLeaf().get());
+        if (!instance)
+            continue;
+
+        const MeshInfo* mesh = instance->GetMesh().get();
+        const affine3 transform = walker->GetLocalToWorldTransformFloat();
+        const bool dynamic = m_DynamicInstances.find(instance) != m_DynamicInstances.end();
+
+        for (const auto& geometry : mesh->geometries)
+        {
+            const Material* material = geometry->material.get();
+            if (!material)
+                continue;
+
+            const bool opaque = material->domain == MaterialDomain::Opaque || material->domain == MaterialDomain::AlphaTested;
+            List& list = m_Lists[opaque ? ListType_Opaque : ListType_Transparent];
+
+            if (dynamic)
+                list.dynamicEntries.push_back(uint32_t(list.entries.size()));
+
+            Entry& entry = list.entries.emplace_back();
+            entry.item.instance = instance;
+            entry.item.mesh = mesh;
+            entry.item.geometry = geometry.get();
+            entry.item.material = material;
+            entry.item.buffers = mesh->buffers.get();
+            entry.transform = transform;
+            entry.bounds = geometry->objectSpaceBounds * transform;
+            entry.materialId = getId(materialIds, material);
+            entry.buffersId = getId(buffersIds, mesh->buffers.get());
+            entry.geometryId = getId(geometryIds, geometry.get());
+        }
+    }
+
+    for (List& list : m_Lists)
+        list.dirtyMask.assign(list.entries.size(), false);
+
+    m_RootNode = rootNode.get();
+    m_TableValid = true;
+    m_TableVersion++;
+}
+
+uint64_t DrawListCache::GetSortKey(SortOrder order, const Entry& entry, uint32_t entryIndex, nvrhi::RasterCullMode cullMode, float distance)
+{
+    if (order == SortOrder_BackToFront)
+    {
+        // Back to front. The entry index makes the keys unique, and puts the back faces of an entry
+        // before its front faces.
+        return (uint64_t(~DistanceBits(distance)) << 32)
+            | (uint64_t(entryIndex & 0x7fffffff) << 1)
+            | (cullMode == nvrhi::RasterCullMode::Front ? 0 : 1);
+    }
+
+    // Pipeline state: material domain and culling
+    const uint64_t pipeline = (uint64_t(entry.item.material->domain) << 1)
+        | (cullMode == nvrhi::RasterCullMode::None ? 1 : 0);
+
+    // The exponent of the distance is a log2 depth bucket, coarse enough to keep instances batched
+    const uint64_t depth = DistanceBits(distance) >> 23;
+    const uint64_t instanceIndex = uint64_t(entry.item.instance->GetInstanceIndex()) & 0x3ff;
+
+    return (pipeline << 60)
+        | (uint64_t(entry.materialId & 0x3ffff) << 42)
+        | (uint64_t(entry.buffersId & 0x3ff) << 32)
+        | (uint64_t(entry.geometryId & 0x3fff) << 18)
+        | (depth << 10)
+        | instanceIndex;
+}
+
+void DrawListCache::AppendItems(ListType type, SortOrder order, uint32_t entryIndex, const float3& viewOrigin, std::vector<SortedItem>& sorted) const
+{
+    const Entry& entry = m_Lists[type].entries[entryIndex];
+    const float distance = length(entry.bounds.center() - viewOrigin);
+
+    auto append = [&](nvrhi::RasterCullMode cullMode)
+    {
+        SortedItem& item = sorted.emplace_back();
+        item.key = GetSortKey(order, entry, entryIndex, cullMode, distance);
+        item.entry = entryIndex;
+        item.distance = distance;
+        item.cullMode = cullMode;
+    };
+
+    if (!entry.item.material->doubleSided)
+        append(nvrhi::RasterCullMode::Back);
+    else if (order == SortOrder_State)
+        append(nvrhi::RasterCullMode::None);
+    else
+    {
+        // Double-sided transparent materials draw their back faces first, like TransparentDrawStrategy
+        append(nvrhi::RasterCullMode::Front);
+        append(nvrhi::RasterCullMode::Back);
+    }
+}
+
+void DrawListCache::UpdateKeys(ListType type, SortOrder order, const float3& viewOrigin, std::vector<SortedItem>& sorted) const
+{
+    const std::vector<Entry>& entries = m_Lists[type].entries;
+
+    for (SortedItem& item : sorted)
+    {
+        const Entry& entry = entries[item.entry];
+        item.distance = length(entry.bounds.center() - viewOrigin);
+        item.key = GetSortKey(order, entry, item.entry, item.cullMode, item.distance);
+    }
+}
+
+void DrawListCache::SortItems(ListType type, std::vector<SortedItem>& sorted, size_t numOrdered)
+{
+    using namespace std::chrono;
+    const auto startTime = high_resolution_clock::now();
+
+    const size_t numAppended = sorted.size() - numOrdered;
+
+    if (sorted.size() < c_MinRadixSortItems)
+    {
+        std::stable_sort(sorted.begin(), sorted.end());
+    }
+    else if (numAppended * 4 > sorted.size())
+    {
+        // Mostly new items, the previous order is of no use
+        RadixSort(sorted);
+        m_Stats.numRadixSorts++;
+    }
+    else
+    {
+        // The previous order with new keys: insertion pass, near-linear when the view moved a little
+        const size_t maxMoves = numOrdered * c_MaxInsertionMovesPerItem;
+        size_t numMoves = 0;
+        for (size_t index = 1; index < numOrdered && numMoves <= maxMoves; index++)
+        {
+            if (!(sorted[index] < sorted[index - 1]))
+                continue;
+
+            const SortedItem item = sorted[index];
+            size_t position = index;
+            do
+            {
+                sorted[position] = sorted[position - 1];
+                --position;
+                ++numMoves;
+            } while (position > 0 && item < sorted[position - 1]);
+            sorted[position] = item;
+        }
+
+        if (numMoves > maxMoves)
+        {
+            RadixSort(sorted);
+            m_Stats.numRadixSorts++;
+        }
+        else
+        {
+            std::stable_sort(sorted.begin() + numOrdered, sorted.end());
+            std::inplace_merge(sorted.begin(), sorted.begin() + numOrdered, sorted.end());
+            m_Stats.numCoherentSorts++;
+        }
+    }
+
+    const float timeMs = duration<float, std::milli>(high_resolution_clock::now() - startTime).count();
+    if (type == ListType_Opaque)
+        m_Stats.opaqueSortTimeMs += timeMs;
+    else
+        m_Stats.transparentSortTimeMs += timeMs;
+}
+
+void DrawListCache::RadixSort(std::vector<SortedItem>& sorted)
+{
+    const size_t numItems = sorted.size();
+    m_RadixScratch.resize(numItems);
+    SortedItem* source = sorted.data();
+    SortedItem* destination = m_RadixScratch.data();
+
+    size_t numChunks = 1;
+#ifdef DONUT_WITH_TASKFLOW
+    if (m_Executor)
+        numChunks = std::max<size_t>(1, std::min<size_t>(m_Executor->num_workers(), numItems / c_MinRadixChunkItems));
+#endif
+    const size_t chunkSize = (numItems + numChunks - 1) / numChunks;
+    m_RadixHistograms.resize(numChunks);
+
+    auto forEachChunk = [&](const std::function<void(size_t first, size_t end, std::array<uint32_t, 256>& histogram)>& func)
+    {
+#ifdef DONUT_WITH_TASKFLOW
+        if (numChunks > 1)
+        {
+            tf::Taskflow taskflow;
+            for (size_t chunk = 0; chunk < numChunks; chunk++)
+            {
+                const size_t first = chunk * chunkSize;
+                const size_t end = std::min(first + chunkSize, numItems);
+                taskflow.emplace([this, &func, first, end, chunk]() { func(first, end, m_RadixHistograms[chunk]); });
+            }
+            m_Executor->run(taskflow).wait();
+            return;
+        }
+#endif
+        for (size_t chunk = 0; chunk < numChunks; chunk++)
+        {
+            const size_t first = chunk * chunkSize;
+            func(first, std::min(first + chunkSize, numItems), m_RadixHistograms[chunk]);
+        }
+    };
+
+    for (uint32_t shift = 0; shift < 64; shift += 8)
+    {
+        forEachChunk([source, shift](size_t first, size_t end, std::array<uint32_t, 256>& histogram)
+        {
+            histogram.fill(0);
+            for (size_t index = first; index < end; index++)
+                histogram[(source[index].key >> shift) & 0xff]++;
+        });
+
+        // Most bytes of the keys are the same in all items: material ids are small, distances are similar
+        const uint32_t firstDigit = uint32_t(source[0].key >> shift) & 0xff;
+        size_t numFirstDigit = 0;
+        for (const auto& histogram : m_RadixHistograms)
+            numFirstDigit += histogram[firstDigit];
+        if (numFirstDigit == numItems)
+            continue;
+
+        // Digit-major, chunk-minor offsets keep the sort stable
+        uint32_t offset = 0;
+        for (uint32_t digit = 0; digit < 256; digit++)
+        {
+            for (auto& histogram : m_RadixHistograms)
+            {
+                const uint32_t count = histogram[digit];
+                histogram[digit] = offset;
+                offset += count;
+            }
+        }
+
+        forEachChunk([source, destination, shift](size_t first, size_t end, std::array<uint32_t, 256>& histogram)
+        {
+            for (size_t index = first; index < end; index++)
+                destination[histogram[(source[index].key >> shift) & 0xff]++] = source[index];
+        });
+
+        std::swap(source, destination);
+    }
+
+    if (source != sorted.data())
+        std::copy(source, source + numItems, sorted.data());
+}
+
+const std::vector<DrawItem>& DrawListCache::Prepare(ListType type, SortOrder order, const std::shared_ptr<SceneGraphNode>& rootNode, const IView& view)
+{
+    if (!m_TableValid || rootNode.get() != m_RootNode)
+        BuildTable(rootNode);
+
+    List& list = m_Lists[type];
+    auto [viewIt, inserted] = list.views[order].try_emplace(&view);
+    ViewList& viewList = viewIt->second;
+    viewList.lastUsedFrame = m_FrameIndex;
+    if (inserted)
+        m_Stats.numViews++;
+
+    const float4x4 viewProjection = view.GetViewProjectionMatrix();
+    const bool tableChanged = viewList.tableVersion != m_TableVersion;
+    const bool viewChanged = tableChanged || memcmp(&viewProjection, &viewList.viewProjection, sizeof(viewProjection)) != 0;
+
+    if (!viewChanged && viewList.changeVersion == m_ChangeVersion)
+    {
+        m_Stats.numReused++;
+        return viewList.items;
+    }
+
+    const frustum viewFrustum = view.GetViewFrustum();
+    const float3 viewOrigin = view.GetViewOrigin();
+    std::vector<SortedItem>& sorted = viewList.sorted;
+
+    if (tableChanged)
+    {
+        viewList.visible.assign(list.entries.size(), false);
+        sorted.clear();
+        m_Stats.numRebuilt++;
+    }
+    else
+        m_Stats.numUpdated++;
+
+    if (viewChanged || viewList.changeVersion + 1 != m_ChangeVersion)
+    {
+        // Re-test the whole table. The items that stay visible keep their previous order with new keys,
+        // which after small view changes is mostly still sorted, and the new items go at the end.
+        m_EnteredEntries.clear();
+        for (uint32_t index = 0; index < uint32_t(list.entries.size()); index++)
+        {
+            const bool visible = viewFrustum.intersectsWith(list.entries[index].bounds);
+            if (visible && !viewList.visible[index])
+                m_EnteredEntries.push_back(index);
+            viewList.visible[index] = visible;
+        }
+        m_Stats.numEntriesTested += uint32_t(list.entries.size());
+
+        sorted.erase(std::remove_if(sorted.begin(), sorted.end(),
+            [&viewList](const SortedItem& item) { return !viewList.visible[item.entry]; }), sorted.end());
+
+        UpdateKeys(type, order, viewOrigin, sorted);
+
+        const size_t numKept = sorted.size();
+        for (uint32_t index : m_EnteredEntries)
+            AppendItems(type, order, index, viewOrigin, sorted);
+
+        SortItems(type, sorted, numKept);
+    }
+    else
+    {
+        // Same view, only the entries that moved in the latest change need to be re-inserted
+        sorted.erase(std::remove_if(sorted.begin(), sorted.end(),
+            [&list](const SortedItem& item) { return list.dirtyMask[item.entry]; }), sorted.end());
+
+        const size_t numKept = sorted.size();
+        for (uint32_t index : list.dirtyEntries)
+        {
+            viewList.visible[index] = viewFrustum.intersectsWith(list.entries[index].bounds);
+            if (viewList.visible[index])
+                AppendItems(type, order, index, viewOrigin, sorted);
+        }
+        m_Stats.numEntriesTested += uint32_t(list.dirtyEntries.size());
+
+        SortItems(type, sorted, numKept);
+    }
+
+    viewList.items.resize(sorted.size());
+    for (size_t index = 0; index < sorted.size(); index++)
+    {
+        DrawItem& item = viewList.items[index];
+        item = list.entries[sorted[index].entry].item;
+        item.cullMode = sorted[index].cullMode;
+        item.distanceToCamera = sorted[index].distance;
+    }
+
+    viewList.tableVersion = m_TableVersion;
+    viewList.changeVersion = m_ChangeVersion;
+    viewList.viewProjection = viewProjection;
+
+    return viewList.items;
+}
@@ -0,0 +1,218 @@
+/*
+* Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <donut/core/math/math.h>
+#include <donut/render/DrawStrategy.h>
+#include <array>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#ifdef DONUT_WITH_TASKFLOW
+namespace tf
+{
+    class Executor;
+}
+#endif
+
+namespace donut::engine
+{
+    class IView;
+    class MeshInstance;
+    class SceneGraph;
+    class SceneGraphNode;
+}
+
+// Draw lists that persist across frames, replacing the scene graph walk and the sort that
+// InstancedOpaqueDrawStrategy and TransparentDrawStrategy do for every view, every frame.
+//
+// The mesh geometries of the scene are flattened into a table of entries with world-space bounds.
+// Every view that the strategies are prepared for keeps its visible entries and its sorted items:
+// - an unchanged view of an unchanged scene reuses its list as is;
+// - when the view moves, the table is re-tested against the new frustum and the keys are updated,
+//   which keeps most of the previous order;
+// - entries of animated instances are checked for transform changes once per frame, and views
+//   that are otherwise unchanged only re-test and re-insert those entries.
+//
+// Opaque items are sorted by pipeline state, material, buffers and geometry, with a coarse depth
+// and the instance index in the low bits so that instances of the same geometry stay batched.
+// Transparent items are sorted back to front, or like the opaque items for order-independent
+// transparency, where double-sided materials are drawn in one pass without culling.
+//
+// Updated lists are sorted starting from the previous order: the re-keyed items go through an
+// insertion pass with a budget of moves, and the new items are sorted separately and merged in.
+// When the order changed too much for that, the list falls back to an LSD radix sort of the keys,
+// which runs on the executor for long lists.
+//
+// Lists are kept per IView object, so views must outlive the frame they are rendered in, or be
+// recreated at a different address. Lists of views that are not used for a few frames are dropped.
+class DrawListCache
+{
+public:
+    struct Stats
+    {
+        uint32_t numEntries = 0;
+        uint32_t numViews = 0;
+        uint32_t numReused = 0;
+        uint32_t numUpdated = 0;
+        uint32_t numRebuilt = 0;
+        uint32_t numEntriesTested = 0;
+        uint32_t numDirtyEntries = 0;
+        uint32_t numCoherentSorts = 0;
+        uint32_t numRadixSorts = 0;
+        float opaqueSortTimeMs = 0.f;
+        float transparentSortTimeMs = 0.f;
+    };
+
+#ifdef DONUT_WITH_TASKFLOW
+    explicit DrawListCache(tf::Executor* executor = nullptr);
+#else
+    DrawListCache();
+#endif
+
+    // Marks the mesh instances under the animated nodes, and all skinned instances, as dynamic
+    void SetDynamicNodes(const donut::engine::SceneGraph& sceneGraph, const std::vector<std::shared_ptr<donut::engine::SceneGraphNode>>& animatedNodes);
+
+    // Rebuilds the entry table on the next use, call after structure or material changes
+    void Invalidate() { m_TableValid = false; }
+
+    // Drops the table and all lists, call before unloading the scene
+    void Clear();
+
+    // Checks the dynamic entries for transform changes, call after the scene graph is refreshed
+    void BeginFrame();
+
+    [[nodiscard]] donut::render::IDrawStrategy& GetOpaqueStrategy() { return m_OpaqueStrategy; }
+    [[nodiscard]] donut::render::IDrawStrategy& GetTransparentStrategy() { return m_TransparentStrategy; }
+    // Transparent items in state order, with consecutive instances batched, for order-independent transparency
+    [[nodiscard]] donut::render::IDrawStrategy& GetUnsortedTransparentStrategy() { return m_UnsortedTransparentStrategy; }
+    [[nodiscard]] const Stats& GetStats() const { return m_Stats; }
+
+private:
+    enum ListType
+    {
+        ListType_Opaque,
+        ListType_Transparent,
+        ListType_Count
+    };
+
+    enum SortOrder
+    {
+        SortOrder_State,
+        SortOrder_BackToFront,
+        SortOrder_Count
+    };
+
+    class ListStrategy : public donut::render::IDrawStrategy
+    {
+    public:
+        ListStrategy(DrawListCache& cache, ListType type, SortOrder order)
+            : m_Cache(cache)
+            , m_Type(type)
+            , m_Order(order)
+        { }
+
+        void PrepareForView(const std::shared_ptr<donut::engine::SceneGraphNode>& rootNode, const donut::engine::IView& view) override;
+        const donut::engine::DrawItem* GetNextItem() override;
+
+    private:
+        DrawListCache& m_Cache;
+        ListType m_Type;
+        SortOrder m_Order;
+        const std::vector<donut::engine::DrawItem>* m_Items = nullptr;
+        size_t m_NextItem = 0;
+    };
+
+    // One mesh geometry of one instance
+    struct Entry
+    {
+        donut::engine::DrawItem item;
+        donut::math::affine3 transform;
+        donut::math::box3 bounds;
+        uint32_t materialId = 0;
+        uint32_t buffersId = 0;
+        uint32_t geometryId = 0;
+    };
+
+    struct SortedItem
+    {
+        uint64_t key;
+        uint32_t entry;
+        float distance;
+        nvrhi::RasterCullMode cullMode;
+
+        // All sorts are stable, so items with equal keys keep their order from frame to frame
+        bool operator<(const SortedItem& other) const { return key < other.key; }
+    };
+
+    struct ViewList
+    {
+        uint64_t tableVersion = 0;
+        uint64_t changeVersion = 0;
+        uint64_t lastUsedFrame = 0;
+        donut::math::float4x4 viewProjection = donut::math::float4x4::identity();
+        std::vector<bool> visible;
+        std::vector<SortedItem> sorted;
+        std::vector<donut::engine::DrawItem> items;
+    };
+
+    struct List
+    {
+        std::vector<Entry> entries;
+        std::vector<uint32_t> dynamicEntries;
+        // Entries whose transform changed in the frame of the last change version
+        std::vector<uint32_t> dirtyEntries;
+        std::vector<bool> dirtyMask;
+        std::vector<uint32_t> changedEntries;
+        std::unordered_map<const donut::engine::IView*, ViewList> views[SortOrder_Count];
+    };
+
+    static uint64_t GetSortKey(SortOrder order, const Entry& entry, uint32_t entryIndex, nvrhi::RasterCullMode cullMode, float distance);
+
+    const std::vector<donut::engine::DrawItem>& Prepare(ListType type, SortOrder order, const std::shared_ptr<donut::engine::SceneGraphNode>& rootNode, const donut::engine::IView& view);
+    void BuildTable(const std::shared_ptr<donut::engine::SceneGraphNode>& rootNode);
+    void AppendItems(ListType type, SortOrder order, uint32_t entryIndex, const donut::math::float3& viewOrigin, std::vector<SortedItem>& sorted) const;
+    void UpdateKeys(ListType type, SortOrder order, const donut::math::float3& viewOrigin, std::vector<SortedItem>& sorted) const;
+    void SortItems(ListType type, std::vector<SortedItem>& sorted, size_t numOrdered);
+    void RadixSort(std::vector<SortedItem>& sorted);
+
+#ifdef DONUT_WITH_TASKFLOW
+    tf::Executor* m_Executor;
+#endif
+    ListStrategy m_OpaqueStrategy;
+    ListStrategy m_TransparentStrategy;
+    ListStrategy m_UnsortedTransparentStrategy;
+    List m_Lists[ListType_Count];
+    std::unordered_set<const donut::engine::MeshInstance*> m_DynamicInstances;
+    std::vector<uint32_t> m_EnteredEntries;
+    std::vector<SortedItem> m_RadixScratch;
+    std::vector<std::array<uint32_t, 256>> m_RadixHistograms;
+    const donut::engine::SceneGraphNode* m_RootNode = nullptr;
+    bool m_TableValid = false;
+    uint64_t m_TableVersion = 0;
+    uint64_t m_ChangeVersion = 0;
+    uint64_t m_FrameIndex = 0;
+    Stats m_Stats;
+};
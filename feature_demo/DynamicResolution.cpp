@@ -0,0 +1,119 @@
+/*
+* Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#include "DynamicResolution.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace donut::math;
+
+GpuFrameTimer::GpuFrameTimer(nvrhi::IDevice* device)
+    : m_Device(device)
+{
+    for (auto& query : m_Queries)
+        query = m_Device->createTimerQuery();
+}
+
+void GpuFrameTimer::BeginFrame(nvrhi::ICommandList* commandList)
+{
+    // Skip the measurement if all queries are still in flight
+    if (m_Pending[m_WriteIndex])
+        return;
+
+    commandList->beginTimerQuery(m_Queries[m_WriteIndex]);
+}
+
+void GpuFrameTimer::EndFrame(nvrhi::ICommandList* commandList)
+{
+    if (m_Pending[m_WriteIndex])
+        return;
+
+    commandList->endTimerQuery(m_Queries[m_WriteIndex]);
+    m_Pending[m_WriteIndex] = true;
+    m_WriteIndex = (m_WriteIndex + 1) % c_NumQueries;
+}
+
+std::optional<float> GpuFrameTimer::Poll()
+{
+    if (!m_Pending[m_ReadIndex] || !m_Device->pollTimerQuery(m_Queries[m_ReadIndex]))
+        return std::nullopt;
+
+    const float timeMs = m_Device->getTimerQueryTime(m_Queries[m_ReadIndex]) * 1000.f;
+    m_Device->resetTimerQuery(m_Queries[m_ReadIndex]);
+    m_Pending[m_ReadIndex] = false;
+    m_ReadIndex = (m_ReadIndex + 1) % c_NumQueries;
+
+    return timeMs;
+}
+
+void DynamicResolutionController::Reset(const Parameters& params)
+{
+    m_Scale = params.maxScale;
+    m_FilteredFrameTimeMs = 0.f;
+    m_FramesSinceChange = 0;
+    m_ScaleHistory.fill(m_Scale);
+}
+
+void DynamicResolutionController::AddFrameTime(const Parameters& params, float gpuFrameTimeMs)
+{
+    // Light smoothing; single slow frames are mostly absorbed, sustained changes get through in a few frames
+    if (m_FilteredFrameTimeMs <= 0.f)
+        m_FilteredFrameTimeMs = gpuFrameTimeMs;
+    else
+        m_FilteredFrameTimeMs = lerp(m_FilteredFrameTimeMs, gpuFrameTimeMs, 0.3f);
+
+    m_FramesSinceChange++;
+
+    float newScale = clamp(m_Scale, params.minScale, params.maxScale);
+
+    if (m_FramesSinceChange > params.settleFrames && m_FilteredFrameTimeMs > 0.f)
+    {
+        const float budgetMs = params.targetFrameTimeMs * params.headroom;
+        const float desiredScale = m_Scale * sqrtf(budgetMs / m_FilteredFrameTimeMs);
+
+        // Always react to going over the target itself; only grow when there is headroom
+        const bool overBudget = m_FilteredFrameTimeMs > params.targetFrameTimeMs;
+        const float change = clamp(desiredScale - m_Scale, -params.maxScaleDecrease, params.maxScaleIncrease);
+
+        if ((overBudget && change < 0.f) || fabsf(change) >= params.minScaleChange)
+            newScale = clamp(m_Scale + change, params.minScale, params.maxScale);
+    }
+
+    if (newScale != m_Scale)
+    {
+        m_Scale = newScale;
+        m_FramesSinceChange = 0;
+        m_NumScaleChanges++;
+    }
+
+    m_ScaleHistory[m_HistoryOffset] = m_Scale;
+    m_HistoryOffset = (m_HistoryOffset + 1) % c_HistoryLength;
+}
+
+uint2 DynamicResolutionController::GetRenderSize(uint2 outputSize) const
+{
+    uint2 size;
+    size.x = std::max(8u, uint32_t(float(outputSize.x) * m_Scale) & ~1u);
+    size.y = std::max(8u, uint32_t(float(outputSize.y) * m_Scale) & ~1u);
+    return min(size, outputSize);
+}
@@ -0,0 +1,103 @@
+/*
+* Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <donut/core/math/math.h>
+#include <nvrhi/nvrhi.h>
+#include <array>
+#include <optional>
+
+// Measures the GPU time of whole frames with a ring of timer queries.
+// Results become available a few frames after they were recorded.
+class GpuFrameTimer
+{
+public:
+    explicit GpuFrameTimer(nvrhi::IDevice* device);
+
+    void BeginFrame(nvrhi::ICommandList* commandList);
+    void EndFrame(nvrhi::ICommandList* commandList);
+
+    // Returns the GPU time of the oldest finished frame in milliseconds, if there is a new one.
+    std::optional<float> Poll();
+
+private:
+    static constexpr uint32_t c_NumQueries = 4;
+
+    nvrhi::DeviceHandle m_Device;
+    std::array<nvrhi::TimerQueryHandle, c_NumQueries> m_Queries;
+    std::array<bool, c_NumQueries> m_Pending = {};
+    uint32_t m_WriteIndex = 0;
+    uint32_t m_ReadIndex = 0;
+};
+
+// Picks the render resolution scale from measured GPU frame times so that the frame time stays
+// under the target.
+//
+// The frame time is assumed to be roughly proportional to the number of rendered pixels, so the
+// scale moves towards sqrt(target / time) of its current value. Decreases are applied quickly
+// to absorb spikes, increases are slower and only happen with some headroom, so that the scale
+// doesn't oscillate around the target. After each change the controller waits for the timer
+// latency to pass before it looks at the frame times again.
+class DynamicResolutionController
+{
+public:
+    struct Parameters
+    {
+        float targetFrameTimeMs = 16.6f;
+        float minScale = 0.5f;
+        float maxScale = 1.f;
+        // Fraction of the target that the controller aims for, to leave room for variance
+        float headroom = 0.9f;
+        // Scale changes smaller than this are ignored
+        float minScaleChange = 0.02f;
+        float maxScaleIncrease = 0.05f;
+        float maxScaleDecrease = 0.25f;
+        // Frames to wait after a change before the next one, covering the timer query latency
+        uint32_t settleFrames = 4;
+    };
+
+    void Reset(const Parameters& params);
+
+    // Feeds the GPU time of a finished frame.
+    void AddFrameTime(const Parameters& params, float gpuFrameTimeMs);
+
+    [[nodiscard]] float GetScale() const { return m_Scale; }
+    [[nodiscard]] float GetFilteredFrameTimeMs() const { return m_FilteredFrameTimeMs; }
+    [[nodiscard]] uint32_t GetNumScaleChanges() const { return m_NumScaleChanges; }
+
+    // Scales the output size, keeping the result even and at least 8 pixels.
+    [[nodiscard]] donut::math::uint2 GetRenderSize(donut::math::uint2 outputSize) const;
+
+    // Recent scale values for display, oldest first starting at GetHistoryOffset().
+    static constexpr uint32_t c_HistoryLength = 128;
+    [[nodiscard]] const std::array<float, c_HistoryLength>& GetScaleHistory() const { return m_ScaleHistory; }
+    [[nodiscard]] uint32_t GetHistoryOffset() const { return m_HistoryOffset; }
+
+private:
+    float m_Scale = 1.f;
+    float m_FilteredFrameTimeMs = 0.f;
+    uint32_t m_FramesSinceChange = 0;
+    uint32_t m_NumScaleChanges = 0;
+    std::array<float, c_HistoryLength> m_ScaleHistory = {};
+    uint32_t m_HistoryOffset = 0;
+};
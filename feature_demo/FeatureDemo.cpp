@@ -23,6 +23,7 @@
 #include <string>
 #include <vector>
 #include <memory>
+#include <optional>
 #include <chrono>
 
 #include <donut/core/vfs/VFS.h>
@@ -31,6 +32,7 @@
 #include <donut/engine/CommonRenderPasses.h>
 #include <donut/engine/ConsoleInterpreter.h>
 #include <donut/engine/ConsoleObjects.h>
+#include <donut/engine/DescriptorTableManager.h>
 #include <donut/engine/FramebufferFactory.h>
 #include <donut/engine/Scene.h>
 #include <donut/engine/ShaderFactory.h>
@@ -43,13 +45,12 @@
 #include <donut/render/ForwardShadingPass.h>
 #include <donut/render/GBuffer.h>
 #include <donut/render/GBufferFillPass.h>
-#include <donut/render/LightProbeProcessingPass.h>
+#include <donut/render/MipMapGenPass.h>
 #include <donut/render/PixelReadbackPass.h>
 #include <donut/render/SkyPass.h>
 #include <donut/render/SsaoPass.h>
 #include <donut/render/TemporalAntiAliasingPass.h>
 #include <donut/render/ToneMappingPasses.h>
-#include <donut/render/MipMapGenPass.h>
 #include <donut/app/ApplicationBase.h>
 #include <donut/app/UserInterfaceUtils.h>
 #include <donut/app/Camera.h>
@@ -63,6 +64,30 @@
 #include <taskflow/taskflow.hpp>
 #endif
 
+#include <AnimationEvaluator.h>
+#include <BindlessDescriptorTable.h>
+#include <CompactGBuffer.h>
+#include <ReadbackQueue.h>
+#include <SinglePassMipGen.h>
+
+#include <algorithm>
+#include <fstream>
+
+#include "CachedSky.h"
+#include "DrawBundleCache.h"
+#include "DrawListCache.h"
+#include "DynamicResolution.h"
+#include "LightProbeBaker.h"
+#include "OcclusionCulling.h"
+#include "OrderIndependentTransparency.h"
+#include "PyramidBloom.h"
+#include "ReducedResolutionSsao.h"
+#include "ShadowCache.h"
+#include "SoftwareOcclusion.h"
+#include "StereoRendering.h"
+#include "TiledLightingPass.h"
+#include "VisibilityBuffer.h"
+
 using namespace donut;
 using namespace donut::math;
 using namespace donut::app;
@@ -73,6 +98,51 @@ using namespace donut::render;
 static bool g_PrintSceneGraph = false;
 static bool g_PrintFormats = false;
 
+// Number of picking requests that can be in flight at the same time
+static constexpr uint32_t c_NumPickReadbackSlots = 3;
+
+// Writes an 8-bit RGBA or BGRA image into a 24-bit BMP file
+static bool WriteBmpFile(const char* fileName, const void* data, size_t rowPitch, uint32_t width, uint32_t height, bool bgra)
+{
+    const uint32_t bmpRowPitch = (width * 3 + 3) & ~3u;
+    const uint32_t imageSize = bmpRowPitch * height;
+
+    uint8_t header[54] = {};
+    auto write32 = [&header](size_t offset, uint32_t value) { memcpy(header + offset, &value, sizeof(value)); };
+    header[0] = 'B';
+    header[1] = 'M';
+    write32(2, sizeof(header) + imageSize);
+    write32(10, sizeof(header));
+    write32(14, 40);
+    write32(18, width);
+    write32(22, height);
+    header[26] = 1;  // planes
+    header[28] = 24; // bits per pixel
+    write32(34, imageSize);
+
+    std::ofstream file(fileName, std::ios::binary);
+    if (!file.is_open())
+        return false;
+
+    file.write(reinterpret_cast<const char*>(header), sizeof(header));
+
+    // BMP rows go bottom-up and store pixels as BGR
+    std::vector<uint8_t> row(bmpRowPitch, 0);
+    for (uint32_t y = 0; y < height; y++)
+    {
+        const uint8_t* src = static_cast<const uint8_t*>(data) + rowPitch * (height - 1 - y);
+        for (uint32_t x = 0; x < width; x++)
+        {
+            row[x * 3 + 0] = src[x * 4 + (bgra ? 0 : 2)];
+            row[x * 3 + 1] = src[x * 4 + 1];
+            row[x * 3 + 2] = src[x * 4 + (bgra ? 2 : 0)];
+        }
+        file.write(reinterpret_cast<const char*>(row.data()), bmpRowPitch);
+    }
+
+    return file.good();
+}
+
 class RenderTargets : public GBufferRenderTargets
 {
 public:
@@ -83,6 +153,11 @@ public:
     nvrhi::TextureHandle TemporalFeedback1;
     nvrhi::TextureHandle TemporalFeedback2;
     nvrhi::TextureHandle AmbientOcclusion;
+    nvrhi::TextureHandle VisibilityIDs; // Only with single-sample targets
+    nvrhi::TextureHandle CompactBaseColor; // The compact GBuffer is only created with single-sample targets
+    nvrhi::TextureHandle CompactNormals;
+    nvrhi::TextureHandle CompactMaterial;
+    nvrhi::TextureHandle CompactEmissive;
 
     nvrhi::HeapHandle Heap;
 
@@ -91,6 +166,8 @@ public:
     std::shared_ptr<FramebufferFactory> LdrFramebuffer;
     std::shared_ptr<FramebufferFactory> ResolvedFramebuffer;
     std::shared_ptr<FramebufferFactory> MaterialIDFramebuffer;
+    std::shared_ptr<FramebufferFactory> VisibilityFramebuffer;
+    std::shared_ptr<FramebufferFactory> CompactGBufferFramebuffer;
     
     void Init(
         nvrhi::IDevice* device,
@@ -131,7 +208,7 @@ public:
 
         desc.format = nvrhi::Format::RGBA16_FLOAT;
         desc.isUAV = true;
-        desc.mipLevels = uint32_t(floorf(::log2f(float(std::max(desc.width, desc.height)))) + 1.f); // Used to test the MipMapGen pass
+        desc.mipLevels = uint32_t(floorf(::log2f(float(std::max(desc.width, desc.height)))) + 1.f); // Used to test the mip generation pass
         desc.debugName = "ResolvedColor";
         ResolvedColor = device->createTexture(desc);
 
@@ -152,6 +229,30 @@ public:
         desc.debugName = "AmbientOcclusion";
         AmbientOcclusion = device->createTexture(desc);
 
+        if (sampleCount == 1)
+        {
+            desc.format = nvrhi::Format::RG32_UINT;
+            desc.debugName = "VisibilityIDs";
+            VisibilityIDs = device->createTexture(desc);
+
+            desc.isUAV = false;
+            desc.format = CompactGBufferLayout::BaseColorFormat;
+            desc.debugName = "CompactBaseColor";
+            CompactBaseColor = device->createTexture(desc);
+
+            desc.format = CompactGBufferLayout::NormalsFormat;
+            desc.debugName = "CompactNormals";
+            CompactNormals = device->createTexture(desc);
+
+            desc.format = CompactGBufferLayout::MaterialFormat;
+            desc.debugName = "CompactMaterial";
+            CompactMaterial = device->createTexture(desc);
+
+            desc.format = CompactGBufferLayout::EmissiveFormat;
+            desc.debugName = "CompactEmissive";
+            CompactEmissive = device->createTexture(desc);
+        }
+
         if (desc.isVirtual)
         {
             uint64_t heapSize = 0;
@@ -162,11 +263,19 @@ public:
                 TemporalFeedback1,
                 TemporalFeedback2,
                 LdrColor,
-                AmbientOcclusion
+                AmbientOcclusion,
+                VisibilityIDs,
+                CompactBaseColor,
+                CompactNormals,
+                CompactMaterial,
+                CompactEmissive
             };
 
             for (auto texture : textures)
             {
+                if (!texture)
+                    continue;
+
                 nvrhi::MemoryRequirements memReq = device->getTextureMemoryRequirements(texture);
                 heapSize = nvrhi::align(heapSize, memReq.alignment);
                 heapSize += memReq.size;
@@ -182,6 +291,9 @@ public:
             uint64_t offset = 0;
             for (auto texture : textures)
             {
+                if (!texture)
+                    continue;
+
                 nvrhi::MemoryRequirements memReq = device->getTextureMemoryRequirements(texture);
                 offset = nvrhi::align(offset, memReq.alignment);
 
@@ -207,6 +319,23 @@ public:
         MaterialIDFramebuffer = std::make_shared<FramebufferFactory>(device);
         MaterialIDFramebuffer->RenderTargets = { MaterialIDs };
         MaterialIDFramebuffer->DepthTarget = Depth;
+
+        if (VisibilityIDs)
+        {
+            VisibilityFramebuffer = std::make_shared<FramebufferFactory>(device);
+            VisibilityFramebuffer->RenderTargets = { VisibilityIDs };
+            VisibilityFramebuffer->DepthTarget = Depth;
+
+            CompactGBufferFramebuffer = std::make_shared<FramebufferFactory>(device);
+            CompactGBufferFramebuffer->RenderTargets = {
+                CompactBaseColor,
+                CompactNormals,
+                CompactMaterial,
+                CompactEmissive };
+            if (enableMotionVectors)
+                CompactGBufferFramebuffer->RenderTargets.push_back(MotionVectors);
+            CompactGBufferFramebuffer->DepthTarget = Depth;
+        }
     }
 
     [[nodiscard]] bool IsUpdateRequired(uint2 size, uint sampleCount) const
@@ -222,6 +351,20 @@ public:
         GBufferRenderTargets::Clear(commandList);
 
         commandList->clearTextureFloat(HdrColor, nvrhi::AllSubresources, nvrhi::Color(0.f));
+
+        // The chroma reconstruction reads the neighbors of the geometry edges
+        if (CompactBaseColor)
+            commandList->clearTextureFloat(CompactBaseColor, nvrhi::AllSubresources, nvrhi::Color(0.f));
+    }
+
+    [[nodiscard]] uint32_t GetGBufferBytesPerPixel() const
+    {
+        return CompactGBufferLayout::GetBytesPerPixel({ GBufferDiffuse, GBufferSpecular, GBufferNormals, GBufferEmissive });
+    }
+
+    [[nodiscard]] uint32_t GetCompactGBufferBytesPerPixel() const
+    {
+        return CompactGBufferLayout::GetBytesPerPixel({ CompactBaseColor, CompactNormals, CompactMaterial, CompactEmissive });
     }
 };
 
@@ -239,11 +382,24 @@ struct UIData
     bool                                ShowUI = true;
 	bool                                ShowConsole = false;
     bool                                UseDeferredShading = true;
+    bool                                UseVisibilityBuffer = false;
+    bool                                UseCompactGBuffer = false;
+    bool                                EnableOcclusionCulling = false;
+    bool                                EnableSoftwareOcclusion = false;
+    bool                                EnableDrawListCache = true;
+    bool                                EnableDrawBundles = true;
+    bool                                EnableTiledLighting = true;
     bool                                Stereo = false;
+    bool                                SinglePassStereo = true;
     bool                                EnableSsao = true;
     SsaoParameters                      SsaoParams;
+    bool                                EnableReducedSsao = false;
+    bool                                SsaoSplitScreen = false;
+    ReducedResolutionSsaoPass::Parameters ReducedSsaoParams;
     ToneMappingParameters               ToneMappingParams;
     TemporalAntiAliasingParameters      TemporalAntiAliasingParams;
+    bool                                EnableDynamicResolution = false;
+    DynamicResolutionController::Parameters DynamicResolutionParams;
     SkyParameters                       SkyParams;
     enum AntiAliasingMode               AntiAliasingMode = AntiAliasingMode::TEMPORAL;
     enum TemporalAntiAliasingJitter     TemporalAntiAliasingJitter = TemporalAntiAliasingJitter::MSAA;
@@ -251,15 +407,20 @@ struct UIData
     bool                                ShaderReoladRequested = false;
     bool                                EnableProceduralSky = true;
     bool                                EnableBloom = true;
+    bool                                UsePyramidBloom = true;
     float                               BloomSigma = 32.f;
     float                               BloomAlpha = 0.05f;
     bool                                EnableTranslucency = true;
+    bool                                EnableOit = false;
+    OitMode                             OitTechnique = OitMode::MultiLayer;
     bool                                EnableMaterialEvents = false;
     bool                                EnableShadows = true;
+    bool                                EnableShadowCache = true;
     float                               AmbientIntensity = 1.0f;
     bool                                EnableLightProbe = true;
     float                               LightProbeDiffuseScale = 1.f;
     float                               LightProbeSpecularScale = 1.f;
+    float                               LightProbeBakeBudgetMs = 2.f;
     float                               CsmExponent = 4.f;
     bool                                DisplayShadowMap = false;
     bool                                UseThirdPersonCamera = false;
@@ -285,24 +446,72 @@ private:
     std::shared_ptr<CascadedShadowMap>  m_ShadowMap;
     std::shared_ptr<FramebufferFactory> m_ShadowFramebuffer;
     std::shared_ptr<DepthPass>          m_ShadowDepthPass;
+    std::unique_ptr<ShadowCache>        m_ShadowCache;
+    bool                                m_ShadowCacheWasEnabled = false;
     std::shared_ptr<InstancedOpaqueDrawStrategy> m_OpaqueDrawStrategy;
     std::shared_ptr<TransparentDrawStrategy> m_TransparentDrawStrategy;
+    std::shared_ptr<UnsortedTransparentDrawStrategy> m_UnsortedTransparentDrawStrategy;
+    std::unique_ptr<DrawListCache>      m_DrawListCache;
+    std::unique_ptr<DrawBundleCache>    m_DrawBundles;
     std::unique_ptr<RenderTargets>      m_RenderTargets;
     std::shared_ptr<ForwardShadingPass> m_ForwardPass;
     std::unique_ptr<GBufferFillPass>    m_GBufferPass;
+    std::unique_ptr<VisibilityBufferPass> m_VisibilityBufferPass;
+    std::unique_ptr<CompactGBufferFillPass> m_CompactGBufferPass;
+    std::unique_ptr<CompactDeferredLightingPass> m_CompactLightingPass;
+    bool                                m_CompactGBufferPasses = false;
+    nvrhi::BindingLayoutHandle          m_BindlessLayout;
+    std::shared_ptr<DescriptorTableManager> m_DescriptorTableManager;
+    std::unique_ptr<GpuFrameTimer>      m_GBufferTimer;
+    std::unique_ptr<GpuFrameTimer>      m_VisibilityBufferTimer;
+    float                               m_GBufferTimeMs = 0.f;
+    float                               m_VisibilityBufferTimeMs = 0.f;
+    std::unique_ptr<StereoGBufferFillPass> m_StereoGBufferPass;
     std::unique_ptr<DeferredLightingPass> m_DeferredLightingPass;
-    std::unique_ptr<SkyPass>            m_SkyPass;
+    std::unique_ptr<TiledLightingPass>  m_TiledLightingPass;
+    std::unique_ptr<CachedSkyPass>      m_SkyPass;
+    // Draws the sky on D3D11, where the cached sky has no shaders
+    std::unique_ptr<SkyPass>            m_FallbackSkyPass;
+    std::unique_ptr<SkyLookupTables>    m_SkyTables;
     std::unique_ptr<TemporalAntiAliasingPass> m_TemporalAntiAliasingPass;
     std::unique_ptr<BloomPass>          m_BloomPass;
+    std::unique_ptr<PyramidBloomPass>   m_PyramidBloomPass;
+    std::unique_ptr<OrderIndependentTransparencyPass> m_OitPass;
     std::unique_ptr<ToneMappingPass>    m_ToneMappingPass;
     std::unique_ptr<SsaoPass>           m_SsaoPass;
-    std::shared_ptr<LightProbeProcessingPass> m_LightProbePass;
+    std::unique_ptr<ReducedResolutionSsaoPass> m_ReducedSsaoPass;
+    std::unique_ptr<GpuFrameTimer>      m_SsaoTimer;
+    std::unique_ptr<GpuFrameTimer>      m_ReducedSsaoTimer;
+    float                               m_SsaoTimeMs = 0.f;
+    float                               m_ReducedSsaoTimeMs = 0.f;
+    std::unique_ptr<GpuFrameTimer>      m_BloomTimer;
+    std::unique_ptr<GpuFrameTimer>      m_PyramidBloomTimer;
+    float                               m_BloomTimeMs = 0.f;
+    float                               m_PyramidBloomTimeMs = 0.f;
+    std::unique_ptr<LightProbeBaker>    m_LightProbeBaker;
     std::unique_ptr<MaterialIDPass>     m_MaterialIDPass;
-    std::unique_ptr<PixelReadbackPass>  m_PixelReadbackPass;
+    std::shared_ptr<PixelReadbackPass>  m_PickReadbackPasses[c_NumPickReadbackSlots];
+    bool                                m_PickReadbackBusy[c_NumPickReadbackSlots] = {};
+    uint32_t                            m_PickReadbackSlot = 0;
+    std::unique_ptr<ReadbackQueue>      m_ReadbackQueue;
+    std::unique_ptr<SinglePassMipGen>   m_MipGenPass;
+    // Used for the mip generation test on D3D11, where the single-pass generator has no shaders
     std::unique_ptr<MipMapGenPass>      m_MipMapGenPass;
+    std::unique_ptr<OcclusionCullingPass> m_OcclusionCullingPass;
+    // One per shadow cascade
+    std::vector<std::unique_ptr<OcclusionCullingPass>> m_ShadowOcclusionCullingPasses;
+    std::unique_ptr<SoftwareOcclusionCuller> m_SoftwareOcclusion;
+#ifdef DONUT_WITH_TASKFLOW
+    std::unique_ptr<tf::Executor>       m_Executor;
+#endif
+    std::unique_ptr<GpuFrameTimer>      m_GpuFrameTimer;
+    DynamicResolutionController         m_DynamicResolution;
+    uint2                               m_RenderSize = 0u;
 
     std::shared_ptr<IView>              m_View;
     std::shared_ptr<IView>              m_ViewPrevious;
+    std::shared_ptr<IView>              m_OutputView;
+    PlanarView                          m_StereoCullingView;
     
     nvrhi::CommandListHandle            m_CommandList;
     bool                                m_PreviousViewsValid = false;
@@ -317,10 +526,13 @@ private:
     bool                                m_Pick = false;
     
     std::vector<std::shared_ptr<LightProbe>> m_LightProbes;
+    std::vector<std::shared_ptr<Light>> m_DeferredLights;
+    std::vector<std::shared_ptr<Light>> m_ForwardLights;
     nvrhi::TextureHandle                m_LightProbeDiffuseTexture;
     nvrhi::TextureHandle                m_LightProbeSpecularTexture;
 
     float                               m_WallclockTime = 0.f;
+    AnimationEvaluator                  m_AnimationEvaluator;
     
     UIData&                             m_ui;
 
@@ -335,10 +547,14 @@ public:
 
         std::filesystem::path mediaPath = app::GetDirectoryWithExecutable().parent_path() / "media";
         std::filesystem::path frameworkShaderPath = app::GetDirectoryWithExecutable() / "shaders/framework" / app::GetShaderTypeName(GetDevice()->getGraphicsAPI());
+        std::filesystem::path appShaderPath = app::GetDirectoryWithExecutable() / "shaders/feature_demo" / app::GetShaderTypeName(GetDevice()->getGraphicsAPI());
+        std::filesystem::path commonShaderPath = app::GetDirectoryWithExecutable() / "shaders/common" / app::GetShaderTypeName(GetDevice()->getGraphicsAPI());
         
         m_RootFs = std::make_shared<RootFileSystem>();
         m_RootFs->mount("/media", mediaPath);
         m_RootFs->mount("/shaders/donut", frameworkShaderPath);
+        m_RootFs->mount("/shaders/app", appShaderPath);
+        m_RootFs->mount("/shaders/common", commonShaderPath);
         m_RootFs->mount("/native", nativeFS);
 
         std::filesystem::path scenePath = "/media/glTF-Sample-Assets/Models";
@@ -350,13 +566,42 @@ public:
                 "Please make sure that folder contains valid scene files.", scenePath.generic_string().c_str());
         }
         
-        m_TextureCache = std::make_shared<TextureCache>(GetDevice(), m_RootFs, nullptr);
+        // The visibility buffer path fetches the scene geometry and textures through bindless resources
+        if (GetDevice()->getGraphicsAPI() != nvrhi::GraphicsAPI::D3D11)
+        {
+            m_BindlessLayout = CreateSceneBindlessLayout(GetDevice());
+            m_DescriptorTableManager = std::make_shared<DescriptorTableManager>(GetDevice(), m_BindlessLayout);
+        }
+
+        m_TextureCache = std::make_shared<TextureCache>(GetDevice(), m_RootFs, m_DescriptorTableManager);
 
         m_ShaderFactory = std::make_shared<ShaderFactory>(GetDevice(), m_RootFs, "/shaders");
         m_CommonPasses = std::make_shared<CommonRenderPasses>(GetDevice(), m_ShaderFactory);
+        m_ReadbackQueue = std::make_unique<ReadbackQueue>(GetDevice());
+        m_GpuFrameTimer = std::make_unique<GpuFrameTimer>(GetDevice());
+        m_SsaoTimer = std::make_unique<GpuFrameTimer>(GetDevice());
+        m_ReducedSsaoTimer = std::make_unique<GpuFrameTimer>(GetDevice());
+        m_BloomTimer = std::make_unique<GpuFrameTimer>(GetDevice());
+        m_PyramidBloomTimer = std::make_unique<GpuFrameTimer>(GetDevice());
+        m_GBufferTimer = std::make_unique<GpuFrameTimer>(GetDevice());
+        m_VisibilityBufferTimer = std::make_unique<GpuFrameTimer>(GetDevice());
+
+#ifdef DONUT_WITH_TASKFLOW
+        m_Executor = std::make_unique<tf::Executor>();
+        m_SoftwareOcclusion = std::make_unique<SoftwareOcclusionCuller>(SoftwareOcclusionCuller::Parameters(), m_Executor.get());
+#else
+        m_SoftwareOcclusion = std::make_unique<SoftwareOcclusionCuller>();
+#endif
 
         m_OpaqueDrawStrategy = std::make_shared<InstancedOpaqueDrawStrategy>();
         m_TransparentDrawStrategy = std::make_shared<TransparentDrawStrategy>();
+        m_UnsortedTransparentDrawStrategy = std::make_shared<UnsortedTransparentDrawStrategy>();
+#ifdef DONUT_WITH_TASKFLOW
+        m_DrawListCache = std::make_unique<DrawListCache>(m_Executor.get());
+#else
+        m_DrawListCache = std::make_unique<DrawListCache>();
+#endif
+        m_DrawBundles = std::make_unique<DrawBundleCache>();
 
 
         const nvrhi::Format shadowMapFormats[] = {
@@ -384,6 +629,14 @@ public:
         m_ShadowDepthPass = std::make_shared<DepthPass>(GetDevice(), m_CommonPasses);
         m_ShadowDepthPass->Init(*m_ShaderFactory, shadowDepthParams);
 
+        m_ShadowCache = std::make_unique<ShadowCache>(GetDevice(), *m_ShadowMap);
+
+        if (GetDevice()->getGraphicsAPI() != nvrhi::GraphicsAPI::D3D11)
+            m_SkyTables = std::make_unique<SkyLookupTables>(GetDevice(), m_ShaderFactory, m_CommonPasses);
+
+        m_LightProbeBaker = std::make_unique<LightProbeBaker>(GetDevice(), m_ShaderFactory, m_CommonPasses,
+            m_ReadbackQueue.get(), shadowMapFormat, app::GetDirectoryWithExecutable() / "light_probe_cache");
+
         m_CommandList = GetDevice()->createCommandList();
 
         m_FirstPersonCamera.SetMoveSpeed(3.0f);
@@ -524,28 +777,53 @@ public:
         {
             m_WallclockTime += fElapsedTimeSeconds;
 
-            for (const auto& anim : m_Scene->GetSceneGraph()->GetAnimations())
-            {
-                float duration = anim->GetDuration();
-                float integral;
-                float animationTime = std::modf(m_WallclockTime / duration, &integral) * duration;
-                (void)anim->Apply(animationTime);
-            }
+#ifdef DONUT_WITH_TASKFLOW
+            m_AnimationEvaluator.Evaluate(m_WallclockTime, 0.f, m_Executor.get());
+#else
+            m_AnimationEvaluator.Evaluate(m_WallclockTime);
+#endif
+            m_AnimationEvaluator.ApplyToSceneGraph();
         }
     }
 
 
     virtual void SceneUnloading() override
     {
+        // Deliver the pending picks and screenshots while the scene is still alive
+        m_ReadbackQueue->Flush();
+
         if (m_ForwardPass) m_ForwardPass->ResetBindingCache();
         if (m_DeferredLightingPass) m_DeferredLightingPass->ResetBindingCache();
+        if (m_TiledLightingPass) m_TiledLightingPass->ResetBindingCache();
         if (m_GBufferPass) m_GBufferPass->ResetBindingCache();
-        if (m_LightProbePass) m_LightProbePass->ResetCaches();
+        if (m_VisibilityBufferPass) m_VisibilityBufferPass->ResetBindingCache();
+        if (m_CompactGBufferPass) m_CompactGBufferPass->ResetBindingCache();
+        if (m_CompactLightingPass) m_CompactLightingPass->ResetBindingCache();
+        if (m_StereoGBufferPass) m_StereoGBufferPass->ResetBindingCache();
+        if (m_ReducedSsaoPass) m_ReducedSsaoPass->ResetBindingCache();
+        if (m_PyramidBloomPass) m_PyramidBloomPass->ResetBindingCache();
+        if (m_OitPass) m_OitPass->ResetBindingCache();
+        if (m_MipGenPass) m_MipGenPass->ResetBindingCache();
+        if (m_OcclusionCullingPass)
+        {
+            m_OcclusionCullingPass->Reset();
+            m_OcclusionCullingPass->ResetBindingCache();
+        }
+        for (auto& cullingPass : m_ShadowOcclusionCullingPasses)
+        {
+            cullingPass->Reset();
+            cullingPass->ResetBindingCache();
+        }
+        m_LightProbeBaker->Reset();
+        m_SoftwareOcclusion->Clear();
+        m_DrawListCache->Clear();
+        m_DrawBundles->Clear();
         if (m_ShadowDepthPass) m_ShadowDepthPass->ResetBindingCache();
         m_BindingCache.Clear();
         m_SunLight.reset();
         m_ui.SelectedMaterial = nullptr;
         m_ui.SelectedNode = nullptr;
+        m_AnimationEvaluator.Clear();
 
         for (auto probe : m_LightProbes)
         {
@@ -557,7 +835,7 @@ public:
     {
         using namespace std::chrono;
 
-        Scene* scene = new Scene(GetDevice(), *m_ShaderFactory, fs, m_TextureCache, nullptr, nullptr);
+        Scene* scene = new Scene(GetDevice(), *m_ShaderFactory, fs, m_TextureCache, m_DescriptorTableManager, nullptr);
 
         auto startTime = high_resolution_clock::now();
 
@@ -580,9 +858,16 @@ public:
         Super::SceneLoaded();
         
         m_Scene->FinishedLoading(GetFrameIndex());
+        m_AnimationEvaluator.Init(*m_Scene->GetSceneGraph());
+        m_ShadowCache->SetDynamicNodes(*m_Scene->GetSceneGraph(), m_AnimationEvaluator.GetTargetNodes());
+        m_SoftwareOcclusion->SelectOccluders(*m_Scene->GetSceneGraph());
+        m_DrawListCache->SetDynamicNodes(*m_Scene->GetSceneGraph(), m_AnimationEvaluator.GetTargetNodes());
+        m_DrawBundles->SetDynamicNodes(*m_Scene->GetSceneGraph(), m_AnimationEvaluator.GetTargetNodes());
 
         m_WallclockTime = 0.f;
         m_PreviousViewsValid = false;
+        m_DynamicResolution.Reset(m_ui.DynamicResolutionParams);
+        if (m_ReducedSsaoPass) m_ReducedSsaoPass->ResetHistory();
 
         for (auto light : m_Scene->GetSceneGraph()->GetLights())
         {
@@ -648,6 +933,11 @@ public:
         return m_ui.Stereo;
     }
 
+    bool IsSinglePassStereo()
+    {
+        return m_ui.Stereo && m_ui.SinglePassStereo && m_StereoGBufferPass;
+    }
+
     std::shared_ptr<TextureCache> GetTextureCache()
     {
         return m_TextureCache;
@@ -658,9 +948,51 @@ public:
         return m_Scene;
     }
 
+    // Copies the view with its viewports expanded to the whole render targets, where TAA resolves to
+    void SetupOutputView()
+    {
+        const float2 outputSize = float2(m_RenderTargets->GetSize());
+
+        if (auto stereoView = std::dynamic_pointer_cast<StereoPlanarView>(m_View))
+        {
+            auto outputView = std::dynamic_pointer_cast<StereoPlanarView>(m_OutputView);
+            if (!outputView)
+                m_OutputView = outputView = std::make_shared<StereoPlanarView>();
+
+            *outputView = *stereoView;
+            outputView->LeftView.SetViewport(nvrhi::Viewport(outputSize.x * 0.5f, outputSize.y));
+            outputView->RightView.SetViewport(nvrhi::Viewport(outputSize.x * 0.5f, outputSize.x, 0.f, outputSize.y, 0.f, 1.f));
+            outputView->LeftView.UpdateCache();
+            outputView->RightView.UpdateCache();
+        }
+        else
+        {
+            auto planarView = std::static_pointer_cast<PlanarView>(m_View);
+            auto outputView = std::dynamic_pointer_cast<PlanarView>(m_OutputView);
+            if (!outputView)
+                m_OutputView = outputView = std::make_shared<PlanarView>();
+
+            *outputView = *planarView;
+            outputView->SetViewport(nvrhi::Viewport(outputSize.x, outputSize.y));
+            outputView->UpdateCache();
+        }
+    }
+
+    // Motion vectors are computed in the current render resolution, so the previous view needs the same viewport
+    static void MatchViewport(PlanarView& previousView, const PlanarView& view)
+    {
+        const nvrhi::Viewport& viewport = view.GetViewportState().viewports[0];
+        const nvrhi::Viewport& previousViewport = previousView.GetViewportState().viewports[0];
+        if (viewport.maxX != previousViewport.maxX || viewport.maxY != previousViewport.maxY || viewport.minX != previousViewport.minX)
+        {
+            previousView.SetViewport(viewport);
+            previousView.UpdateCache();
+        }
+    }
+
     bool SetupView()
     {
-        float2 renderTargetSize = float2(m_RenderTargets->GetSize());
+        float2 renderTargetSize = float2(m_RenderSize);
 
         if (m_TemporalAntiAliasingPass)
             m_TemporalAntiAliasingPass->SetJitter(m_ui.TemporalAntiAliasingJitter);
@@ -717,6 +1049,9 @@ public:
                 affine3 rightView = leftView;
                 rightView.m_translation -= float3(0.2f, 0, 0);
                 stereoView->RightView.SetMatrices(rightView, projection);
+
+                SetupStereoCullingView(m_StereoCullingView, leftView, 0.2f, verticalFov, renderTargetSize.x / renderTargetSize.y * 0.5f, zNear,
+                    nvrhi::Viewport(renderTargetSize.x, renderTargetSize.y));
             }
 
             stereoView->LeftView.UpdateCache();
@@ -728,6 +1063,10 @@ public:
             {
                 *std::static_pointer_cast<StereoPlanarView>(m_ViewPrevious) = *std::static_pointer_cast<StereoPlanarView>(m_View);
             }
+
+            auto previousView = std::static_pointer_cast<StereoPlanarView>(m_ViewPrevious);
+            MatchViewport(previousView->LeftView, stereoView->LeftView);
+            MatchViewport(previousView->RightView, stereoView->RightView);
         }
         else
         {
@@ -752,7 +1091,11 @@ public:
             {
                 *std::static_pointer_cast<PlanarView>(m_ViewPrevious) = *std::static_pointer_cast<PlanarView>(m_View);
             }
+
+            MatchViewport(*std::static_pointer_cast<PlanarView>(m_ViewPrevious), *planarView);
         }
+
+        SetupOutputView();
         
         return topologyChanged;
     }
@@ -760,11 +1103,21 @@ public:
     void CreateRenderPasses(bool& exposureResetRequired)
     {
         uint32_t motionVectorStencilMask = 0x01;
+
+        // The recorded draws reference the pipelines and binding sets of the old passes
+        if (m_DrawBundles)
+            m_DrawBundles->Invalidate();
         
         ForwardShadingPass::CreateParameters ForwardParams;
         ForwardParams.trackLiveness = false;
         m_ForwardPass = std::make_unique<ForwardShadingPass>(GetDevice(), m_CommonPasses);
         m_ForwardPass->Init(*m_ShaderFactory, ForwardParams);
+
+        // The OIT buffers are composited over the HDR target in compute, which needs a UAV on it.
+        // There are no D3D11 shaders for OIT, translucency is blended in sorted order there.
+        m_OitPass = nullptr;
+        if (GetDevice()->getGraphicsAPI() != nvrhi::GraphicsAPI::D3D11 && m_RenderTargets->GetSampleCount() == 1)
+            m_OitPass = std::make_unique<OrderIndependentTransparencyPass>(GetDevice(), m_ShaderFactory, m_CommonPasses);
         
         GBufferFillPass::CreateParameters GBufferParams;
         GBufferParams.enableMotionVectors = true;
@@ -772,17 +1125,75 @@ public:
         m_GBufferPass = std::make_unique<GBufferFillPass>(GetDevice(), m_CommonPasses);
         m_GBufferPass->Init(*m_ShaderFactory, GBufferParams);
 
+        // The stereo GBuffer vertex shader has no D3D11 version, stereo is drawn one eye at a time there
+        m_StereoGBufferPass = nullptr;
+        if (GetDevice()->getGraphicsAPI() != nvrhi::GraphicsAPI::D3D11)
+        {
+            m_StereoGBufferPass = std::make_unique<StereoGBufferFillPass>(GetDevice(), m_CommonPasses);
+            m_StereoGBufferPass->Init(*m_ShaderFactory, GBufferParams);
+        }
+
+        // The compact passes are shared with the other examples and have no D3D11 shaders
+        m_CompactGBufferPass = nullptr;
+        m_CompactLightingPass = nullptr;
+        if (GetDevice()->getGraphicsAPI() != nvrhi::GraphicsAPI::D3D11 && m_RenderTargets->CompactGBufferFramebuffer)
+        {
+            m_CompactGBufferPass = std::make_unique<CompactGBufferFillPass>(GetDevice(), m_CommonPasses);
+            m_CompactGBufferPass->Init(*m_ShaderFactory, GBufferParams);
+
+            m_CompactLightingPass = std::make_unique<CompactDeferredLightingPass>(GetDevice(), m_ShaderFactory, m_CommonPasses);
+        }
+
         GBufferParams.enableMotionVectors = false;
         m_MaterialIDPass = std::make_unique<MaterialIDPass>(GetDevice(), m_CommonPasses);
         m_MaterialIDPass->Init(*m_ShaderFactory, GBufferParams);
 
-        m_PixelReadbackPass = std::make_unique<PixelReadbackPass>(GetDevice(), m_ShaderFactory, m_RenderTargets->MaterialIDs, nvrhi::Format::RGBA32_UINT);
-        m_MipMapGenPass = std::make_unique <MipMapGenPass>(GetDevice(), m_ShaderFactory, m_RenderTargets->ResolvedColor, MipMapGenPass::Mode::MODE_COLOR);
+        // The visibility buffer resolve writes one of the GBuffer layouts, so it is recreated when the layout changes
+        m_CompactGBufferPasses = m_ui.UseCompactGBuffer && m_CompactGBufferPass;
+        m_VisibilityBufferPass = nullptr;
+        if (m_BindlessLayout && m_RenderTargets->VisibilityFramebuffer)
+        {
+            m_VisibilityBufferPass = std::make_unique<VisibilityBufferPass>(GetDevice(), m_ShaderFactory, m_CommonPasses, m_BindlessLayout,
+                m_RenderTargets->VisibilityFramebuffer,
+                m_CompactGBufferPasses ? m_RenderTargets->CompactGBufferFramebuffer : m_RenderTargets->GBufferFramebuffer,
+                *m_View->GetChildView(ViewType::PLANAR, 0),
+                motionVectorStencilMask,
+                m_CompactGBufferPasses);
+        }
+
+        for (auto& pickReadbackPass : m_PickReadbackPasses)
+            pickReadbackPass = std::make_shared<PixelReadbackPass>(GetDevice(), m_ShaderFactory, m_RenderTargets->MaterialIDs, nvrhi::Format::RGBA32_UINT);
+        m_MipGenPass = nullptr;
+        m_MipMapGenPass = nullptr;
+        if (GetDevice()->getGraphicsAPI() != nvrhi::GraphicsAPI::D3D11)
+            m_MipGenPass = std::make_unique<SinglePassMipGen>(GetDevice(), m_ShaderFactory, "common/single_pass_mipgen.hlsl");
+        else
+            m_MipMapGenPass = std::make_unique<MipMapGenPass>(GetDevice(), m_ShaderFactory, m_RenderTargets->ResolvedColor, MipMapGenPass::Mode::MODE_COLOR);
+
+        // The Hi-Z pyramid is built with the single-pass mip generator, which needs wave operations
+        m_OcclusionCullingPass = nullptr;
+        m_ShadowOcclusionCullingPasses.clear();
+        if (GetDevice()->getGraphicsAPI() != nvrhi::GraphicsAPI::D3D11 && m_RenderTargets->GetSampleCount() == 1)
+        {
+            m_OcclusionCullingPass = std::make_unique<OcclusionCullingPass>(GetDevice(), m_ShaderFactory, m_MipGenPass.get(), m_ReadbackQueue.get());
+            for (int cascade = 0; cascade < m_ShadowMap->GetNumberOfCascades(); cascade++)
+                m_ShadowOcclusionCullingPasses.push_back(std::make_unique<OcclusionCullingPass>(GetDevice(), m_ShaderFactory, m_MipGenPass.get(), m_ReadbackQueue.get()));
+        }
 
         m_DeferredLightingPass = std::make_unique<DeferredLightingPass>(GetDevice(), m_CommonPasses);
         m_DeferredLightingPass->Init(m_ShaderFactory);
 
-        m_SkyPass = std::make_unique<SkyPass>(GetDevice(), m_ShaderFactory, m_CommonPasses, m_RenderTargets->ForwardFramebuffer, *m_View);
+        // Without the tiled pass, all local lights go through the deferred lighting pass
+        m_TiledLightingPass = nullptr;
+        if (GetDevice()->getGraphicsAPI() != nvrhi::GraphicsAPI::D3D11)
+            m_TiledLightingPass = std::make_unique<TiledLightingPass>(GetDevice(), m_ShaderFactory, m_ReadbackQueue.get());
+
+        m_SkyPass = nullptr;
+        m_FallbackSkyPass = nullptr;
+        if (m_SkyTables)
+            m_SkyPass = std::make_unique<CachedSkyPass>(GetDevice(), m_ShaderFactory, m_CommonPasses, m_RenderTargets->ForwardFramebuffer, *m_View, CachedSkyPass::Source::SkyViewLut);
+        else
+            m_FallbackSkyPass = std::make_unique<SkyPass>(GetDevice(), m_ShaderFactory, m_CommonPasses, m_RenderTargets->ForwardFramebuffer, *m_View);
         
         {
             TemporalAntiAliasingPass::CreateParameters taaParams;
@@ -801,9 +1212,12 @@ public:
         if (m_RenderTargets->GetSampleCount() == 1)
         {
             m_SsaoPass = std::make_unique<SsaoPass>(GetDevice(), m_ShaderFactory, m_CommonPasses, m_RenderTargets->Depth, m_RenderTargets->GBufferNormals, m_RenderTargets->AmbientOcclusion);
-        }
 
-        m_LightProbePass = std::make_shared<LightProbeProcessingPass>(GetDevice(), m_ShaderFactory, m_CommonPasses);
+            // There are no D3D11 shaders for the reduced resolution pass, donut's pass is used alone there
+            m_ReducedSsaoPass = nullptr;
+            if (GetDevice()->getGraphicsAPI() != nvrhi::GraphicsAPI::D3D11)
+                m_ReducedSsaoPass = std::make_unique<ReducedResolutionSsaoPass>(GetDevice(), m_ShaderFactory);
+        }
 
         nvrhi::BufferHandle exposureBuffer = nullptr;
         if (m_ToneMappingPass)
@@ -816,10 +1230,31 @@ public:
         m_ToneMappingPass = std::make_unique<ToneMappingPass>(GetDevice(), m_ShaderFactory, m_CommonPasses, m_RenderTargets->LdrFramebuffer, *m_View, toneMappingParams);
 
         m_BloomPass = std::make_unique<BloomPass>(GetDevice(), m_ShaderFactory, m_CommonPasses, m_RenderTargets->ResolvedFramebuffer, *m_View);
+        m_PyramidBloomPass = nullptr;
+        if (GetDevice()->getGraphicsAPI() != nvrhi::GraphicsAPI::D3D11)
+            m_PyramidBloomPass = std::make_unique<PyramidBloomPass>(GetDevice(), m_ShaderFactory, m_CommonPasses);
 
         m_PreviousViewsValid = false;
     }
 
+    void RenderBloom(const std::shared_ptr<FramebufferFactory>& framebuffer, const IView& view, nvrhi::ITexture* color)
+    {
+        // The pyramid bloom works in place through a UAV, which all single-sample color targets have.
+        // It has no D3D11 shaders, so donut's pass is used there.
+        if (m_ui.UsePyramidBloom && m_PyramidBloomPass && color->getDesc().isUAV)
+        {
+            m_PyramidBloomTimer->BeginFrame(m_CommandList);
+            m_PyramidBloomPass->Render(m_CommandList, view, color, m_ui.BloomSigma, m_ui.BloomAlpha);
+            m_PyramidBloomTimer->EndFrame(m_CommandList);
+        }
+        else
+        {
+            m_BloomTimer->BeginFrame(m_CommandList);
+            m_BloomPass->Render(m_CommandList, framebuffer, view, color, m_ui.BloomSigma, m_ui.BloomAlpha);
+            m_BloomTimer->EndFrame(m_CommandList);
+        }
+    }
+
     virtual void RenderSplashScreen(nvrhi::IFramebuffer* framebuffer) override
     {
         nvrhi::ITexture* framebufferTexture = framebuffer->getDesc().colorAttachments[0].texture;
@@ -837,6 +1272,9 @@ public:
         nvrhi::Viewport windowViewport = nvrhi::Viewport(float(windowWidth), float(windowHeight));
         nvrhi::Viewport renderViewport = windowViewport;
 
+        // Deliver the picking results and screenshots from previous frames that the GPU has finished
+        m_ReadbackQueue->Poll();
+
         m_Scene->RefreshSceneGraph(GetFrameIndex());
 
         bool exposureResetRequired = false;
@@ -866,11 +1304,45 @@ public:
                 needNewPasses = true;
             }
 
+            // The render targets are always allocated at the output size, and dynamic resolution
+            // renders into their top-left corner. TAA then upsamples into the full targets.
+            const bool dynamicResolution = m_ui.EnableDynamicResolution && m_ui.AntiAliasingMode == AntiAliasingMode::TEMPORAL;
+            while (std::optional<float> gpuFrameTimeMs = m_GpuFrameTimer->Poll())
+            {
+                if (dynamicResolution)
+                    m_DynamicResolution.AddFrameTime(m_ui.DynamicResolutionParams, *gpuFrameTimeMs);
+            }
+
+            if (!dynamicResolution)
+                m_DynamicResolution.Reset(m_ui.DynamicResolutionParams);
+
+            // Smoothed SSAO and bloom timings for the comparisons in the UI
+            auto filterTime = [](float& filtered, float timeMs) { filtered = (filtered > 0.f) ? filtered * 0.9f + timeMs * 0.1f : timeMs; };
+            while (std::optional<float> ssaoTimeMs = m_SsaoTimer->Poll())
+                filterTime(m_SsaoTimeMs, *ssaoTimeMs);
+            while (std::optional<float> ssaoTimeMs = m_ReducedSsaoTimer->Poll())
+                filterTime(m_ReducedSsaoTimeMs, *ssaoTimeMs);
+            while (std::optional<float> bloomTimeMs = m_BloomTimer->Poll())
+                filterTime(m_BloomTimeMs, *bloomTimeMs);
+            while (std::optional<float> bloomTimeMs = m_PyramidBloomTimer->Poll())
+                filterTime(m_PyramidBloomTimeMs, *bloomTimeMs);
+            while (std::optional<float> gbufferTimeMs = m_GBufferTimer->Poll())
+                filterTime(m_GBufferTimeMs, *gbufferTimeMs);
+            while (std::optional<float> gbufferTimeMs = m_VisibilityBufferTimer->Poll())
+                filterTime(m_VisibilityBufferTimeMs, *gbufferTimeMs);
+
+            m_RenderSize = dynamicResolution ? m_DynamicResolution.GetRenderSize(uint2(width, height)) : uint2(width, height);
+
             if (SetupView())
             {
                 needNewPasses = true;
             }
 
+            if (m_ui.UseCompactGBuffer != m_CompactGBufferPasses && m_CompactGBufferPass)
+            {
+                needNewPasses = true;
+            }
+
             if (m_ui.ShaderReoladRequested)
             {
                 m_ShaderFactory->ClearCache();
@@ -886,6 +1358,7 @@ public:
         }
 
         m_CommandList->open();
+        m_GpuFrameTimer->BeginFrame(m_CommandList);
 
         m_Scene->RefreshBuffers(m_CommandList, GetFrameIndex());
 
@@ -894,6 +1367,24 @@ public:
         
         m_AmbientTop = m_ui.AmbientIntensity * m_ui.SkyParams.skyColor * m_ui.SkyParams.brightness;
         m_AmbientBottom = m_ui.AmbientIntensity * m_ui.SkyParams.groundColor * m_ui.SkyParams.brightness;
+
+        // No-op unless the sky parameters or the sun changed since the last frame
+        if (m_SkyTables)
+            m_SkyTables->Update(m_CommandList, *m_SunLight, m_ui.SkyParams);
+
+        // The persistent draw lists replace the per-view scene graph walks for all scene passes
+        if (m_ui.EnableDrawListCache)
+            m_DrawListCache->BeginFrame();
+        m_DrawBundles->BeginFrame();
+        IDrawStrategy& sceneOpaqueDrawStrategy = m_ui.EnableDrawListCache
+            ? m_DrawListCache->GetOpaqueStrategy() : static_cast<IDrawStrategy&>(*m_OpaqueDrawStrategy);
+        // OIT does not need the transparent items sorted back to front. The cache keeps them in state order
+        // instead, and without the cache they are taken in scene graph order.
+        const bool oit = m_ui.EnableTranslucency && m_ui.EnableOit && m_OitPass;
+        IDrawStrategy& sceneTransparentDrawStrategy = m_ui.EnableDrawListCache
+            ? (oit ? m_DrawListCache->GetUnsortedTransparentStrategy() : m_DrawListCache->GetTransparentStrategy())
+            : (oit ? static_cast<IDrawStrategy&>(*m_UnsortedTransparentDrawStrategy) : static_cast<IDrawStrategy&>(*m_TransparentDrawStrategy));
+
         if (m_ui.EnableShadows)
         {
             m_SunLight->shadowMap = m_ShadowMap;
@@ -907,23 +1398,67 @@ public:
             float zRange = length(sceneBounds.diagonal()) * 0.5f;
             m_ShadowMap->SetupForPlanarViewStable(*m_SunLight, projectionFrustum, viewMatrixInv, maxShadowDistance, zRange, zRange, m_ui.CsmExponent);
 
-            m_ShadowMap->Clear(m_CommandList);
+            if (m_ui.EnableShadowCache)
+            {
+                // The shadow map contents are stale after rendering without the cache
+                if (!m_ShadowCacheWasEnabled)
+                    m_ShadowCache->InvalidateStaticGeometry();
 
-            DepthPass::Context context;
+                m_ShadowCache->Render(m_CommandList,
+                    *m_ShadowMap,
+                    *m_ShadowFramebuffer,
+                    m_Scene->GetSceneGraph()->GetRootNode(),
+                    sceneOpaqueDrawStrategy,
+                    *m_ShadowDepthPass,
+                    m_ui.EnableMaterialEvents);
+            }
+            else if (m_ui.EnableOcclusionCulling && !m_ShadowOcclusionCullingPasses.empty())
+            {
+                m_ShadowMap->Clear(m_CommandList);
 
-            RenderCompositeView(m_CommandList, 
-                &m_ShadowMap->GetView(), nullptr, 
-                *m_ShadowFramebuffer,
-                m_Scene->GetSceneGraph()->GetRootNode(),
-                *m_OpaqueDrawStrategy, 
-                *m_ShadowDepthPass,
-                context,
-                "ShadowMap",
-                m_ui.EnableMaterialEvents);
+                DepthPass::Context context;
+
+                // Every cascade keeps its own visible set and Hi-Z pyramid
+                const ICompositeView& shadowView = m_ShadowMap->GetView();
+                const uint32_t numCascades = std::min(shadowView.GetNumChildViews(ViewType::PLANAR), uint32_t(m_ShadowOcclusionCullingPasses.size()));
+                for (uint32_t cascade = 0; cascade < numCascades; cascade++)
+                {
+                    const IView* cascadeView = shadowView.GetChildView(ViewType::PLANAR, cascade);
+
+                    m_ShadowOcclusionCullingPasses[cascade]->Render(m_CommandList,
+                        *cascadeView, nullptr,
+                        m_ShadowFramebuffer->GetFramebuffer(*cascadeView),
+                        m_ShadowMap->GetTexture(), cascadeView->GetSubresources().baseArraySlice,
+                        m_Scene->GetSceneGraph()->GetRootNode(),
+                        sceneOpaqueDrawStrategy,
+                        *m_ShadowDepthPass,
+                        context,
+                        "ShadowMap - Occlusion Culling");
+                }
+            }
+            else
+            {
+                m_ShadowMap->Clear(m_CommandList);
+
+                DepthPass::Context context;
+
+                RenderCompositeView(m_CommandList, 
+                    &m_ShadowMap->GetView(), nullptr, 
+                    *m_ShadowFramebuffer,
+                    m_Scene->GetSceneGraph()->GetRootNode(),
+                    sceneOpaqueDrawStrategy, 
+                    *m_ShadowDepthPass,
+                    context,
+                    "ShadowMap",
+                    m_ui.EnableMaterialEvents);
+            }
+
+            m_ShadowCacheWasEnabled = m_ui.EnableShadowCache;
         }
         else
         {
             m_SunLight->shadowMap = nullptr;
+            m_ShadowCacheWasEnabled = false;
         }
 
         std::vector<std::shared_ptr<LightProbe>> lightProbes;
@@ -947,57 +1482,242 @@ public:
 
         ForwardShadingPass::Context forwardContext;
 
+        // Local lights are binned into screen tiles for deferred shading, which needs a UAV on the HDR target
+        const auto& sceneLights = m_Scene->GetSceneGraph()->GetLights();
+        const bool tiledLighting = m_ui.EnableTiledLighting && m_TiledLightingPass && m_ui.UseDeferredShading && m_RenderTargets->GetSampleCount() == 1;
+
+        // Without the tiled pass, the forward passes shade all lights like they did before it
+        const bool selectForwardLights = m_ui.EnableTiledLighting && m_TiledLightingPass;
+
         if (!m_ui.UseDeferredShading || m_ui.EnableTranslucency)
         {
-            m_ForwardPass->PrepareLights(forwardContext, m_CommandList, m_Scene->GetSceneGraph()->GetLights(), m_AmbientTop, m_AmbientBottom, lightProbes);
+            if (selectForwardLights)
+            {
+                TiledLightingPass::SelectForwardLights(*m_View, sceneLights, m_ForwardLights);
+                m_ForwardPass->PrepareLights(forwardContext, m_CommandList, m_ForwardLights, m_AmbientTop, m_AmbientBottom, lightProbes);
+            }
+            else
+            {
+                m_ForwardPass->PrepareLights(forwardContext, m_CommandList, sceneLights, m_AmbientTop, m_AmbientBottom, lightProbes);
+            }
         }
 
+        // With single-pass stereo, the scene is culled once per frame against a frustum that encloses both eyes,
+        // and the same draw items are used for both eyes in all passes below
+        const bool singlePassStereo = IsSinglePassStereo();
+        // CPU occlusion culling applies to the opaque passes of the main view, stereo culling is applied on top
+        m_SoftwareOcclusion->BeginFrame();
+        SoftwareOcclusionDrawStrategy softwareOcclusionDrawStrategy(sceneOpaqueDrawStrategy, *m_SoftwareOcclusion);
+        IDrawStrategy& viewOpaqueDrawStrategy = m_ui.EnableSoftwareOcclusion ? softwareOcclusionDrawStrategy : sceneOpaqueDrawStrategy;
+
+        SharedCullingDrawStrategy sharedOpaqueDrawStrategy(viewOpaqueDrawStrategy, m_StereoCullingView);
+        SharedCullingDrawStrategy sharedTransparentDrawStrategy(sceneTransparentDrawStrategy, m_StereoCullingView);
+        IDrawStrategy& opaqueDrawStrategy = singlePassStereo ? sharedOpaqueDrawStrategy : viewOpaqueDrawStrategy;
+        IDrawStrategy& transparentDrawStrategy = singlePassStereo ? sharedTransparentDrawStrategy : sceneTransparentDrawStrategy;
+
+        // The static items of the opaque and OIT passes are replayed from recorded bundles. CPU occlusion
+        // culling can hide static items behind animated occluders, so it needs the live path.
+        DrawBundleCache* drawBundles = m_ui.EnableDrawBundles && !m_ui.EnableSoftwareOcclusion ? m_DrawBundles.get() : nullptr;
+
+        auto renderOpaqueCompositeView = [this, drawBundles](const ICompositeView* compositeView, const ICompositeView* compositeViewPrev,
+            FramebufferFactory& framebufferFactory, IDrawStrategy& drawStrategy, IGeometryPass& pass, GeometryPassContext& passContext, const char* passEvent)
+        {
+            if (drawBundles)
+            {
+                drawBundles->RenderCompositeView(m_CommandList, compositeView, compositeViewPrev, framebufferFactory,
+                    m_Scene->GetSceneGraph()->GetRootNode(), drawStrategy, pass, passContext, passEvent, m_ui.EnableMaterialEvents);
+            }
+            else
+            {
+                RenderCompositeView(m_CommandList, compositeView, compositeViewPrev, framebufferFactory,
+                    m_Scene->GetSceneGraph()->GetRootNode(), drawStrategy, pass, passContext, passEvent, m_ui.EnableMaterialEvents);
+            }
+        };
+
+        // Occlusion culling needs a single planar view, the culling state is kept per view
+        const bool occlusionCulling = m_ui.EnableOcclusionCulling && m_OcclusionCullingPass && m_View->GetNumChildViews(ViewType::PLANAR) == 1;
+
         if (m_ui.UseDeferredShading)
         {
             GBufferFillPass::Context gbufferContext;
 
-            RenderCompositeView(m_CommandList,
-                m_View.get(), m_ViewPrevious.get(), 
-                *m_RenderTargets->GBufferFramebuffer, 
-                m_Scene->GetSceneGraph()->GetRootNode(),
-                *m_OpaqueDrawStrategy,
-                *m_GBufferPass,
-                gbufferContext,
-                "GBufferFill",
-                m_ui.EnableMaterialEvents);
+            // The stereo GBuffer pass only writes the standard layout
+            const bool compactGBuffer = m_CompactGBufferPasses && !singlePassStereo;
+
+            if (singlePassStereo)
+            {
+                // Both eyes are drawn at once, using the combined view for culling and the viewport
+                m_StereoGBufferPass->SetStereoView(
+                    static_cast<const StereoPlanarView*>(m_View.get()),
+                    static_cast<const StereoPlanarView*>(m_ViewPrevious.get()));
+
+                renderOpaqueCompositeView(
+                    &m_StereoCullingView, &m_StereoCullingView,
+                    *m_RenderTargets->GBufferFramebuffer,
+                    opaqueDrawStrategy,
+                    *m_StereoGBufferPass,
+                    gbufferContext,
+                    "GBufferFill - Stereo");
+            }
+            else if (m_ui.UseVisibilityBuffer && m_VisibilityBufferPass)
+            {
+                m_VisibilityBufferTimer->BeginFrame(m_CommandList);
+                m_VisibilityBufferPass->Render(m_CommandList, *m_View, *m_ViewPrevious, *m_Scene, opaqueDrawStrategy,
+                    m_DescriptorTableManager->GetDescriptorTable(), m_RenderTargets->VisibilityIDs);
+                m_VisibilityBufferTimer->EndFrame(m_CommandList);
+            }
+            else
+            {
+                FramebufferFactory& gbufferFramebuffer = compactGBuffer ? *m_RenderTargets->CompactGBufferFramebuffer : *m_RenderTargets->GBufferFramebuffer;
+                GBufferFillPass& gbufferPass = compactGBuffer ? *m_CompactGBufferPass : *m_GBufferPass;
+
+                m_GBufferTimer->BeginFrame(m_CommandList);
+                if (occlusionCulling)
+                {
+                    m_OcclusionCullingPass->Render(m_CommandList,
+                        *m_View, m_ViewPrevious.get(),
+                        gbufferFramebuffer.GetFramebuffer(*m_View),
+                        m_RenderTargets->Depth, 0,
+                        m_Scene->GetSceneGraph()->GetRootNode(),
+                        opaqueDrawStrategy,
+                        gbufferPass,
+                        gbufferContext,
+                        compactGBuffer ? "CompactGBufferFill - Occlusion Culling" : "GBufferFill - Occlusion Culling");
+                }
+                else
+                {
+                    renderOpaqueCompositeView(
+                        m_View.get(), m_ViewPrevious.get(),
+                        gbufferFramebuffer,
+                        opaqueDrawStrategy,
+                        gbufferPass,
+                        gbufferContext,
+                        compactGBuffer ? "CompactGBufferFill" : "GBufferFill");
+                }
+                m_GBufferTimer->EndFrame(m_CommandList);
+            }
 
             nvrhi::ITexture* ambientOcclusionTarget = nullptr;
             if (m_ui.EnableSsao && m_SsaoPass)
             {
-                m_SsaoPass->Render(m_CommandList, m_ui.SsaoParams, *m_View);
+                // In split screen mode, the full resolution pass fills the whole target and the reduced
+                // resolution pass overwrites the left half. Donut's full resolution pass can't read the
+                // octahedral normals of the compact GBuffer, so that one always uses the reduced resolution pass.
+                const bool reducedResolution = m_ReducedSsaoPass && (m_ui.EnableReducedSsao || compactGBuffer);
+                const bool fullResolution = !compactGBuffer && (!reducedResolution || m_ui.SsaoSplitScreen);
+                if (fullResolution)
+                {
+                    m_SsaoTimer->BeginFrame(m_CommandList);
+                    m_SsaoPass->Render(m_CommandList, m_ui.SsaoParams, *m_View);
+                    m_SsaoTimer->EndFrame(m_CommandList);
+                }
+
+                if (reducedResolution)
+                {
+                    ReducedResolutionSsaoPass::Inputs ssaoInputs;
+                    ssaoInputs.depth = m_RenderTargets->Depth;
+                    ssaoInputs.gbufferNormals = compactGBuffer ? m_RenderTargets->CompactNormals : m_RenderTargets->GBufferNormals;
+                    ssaoInputs.octahedralNormals = compactGBuffer;
+                    ssaoInputs.motionVectors = m_RenderTargets->MotionVectors;
+                    ssaoInputs.output = m_RenderTargets->AmbientOcclusion;
+
+                    ReducedResolutionSsaoPass::Parameters reducedParams = m_ui.ReducedSsaoParams;
+                    reducedParams.splitPosition = (m_ui.SsaoSplitScreen && fullResolution) ? int(m_RenderSize.x / 2) : INT_MAX;
+
+                    // The stereo GBuffer pass doesn't write motion vectors
+                    if (singlePassStereo)
+                        m_ReducedSsaoPass->ResetHistory();
+
+                    m_ReducedSsaoTimer->BeginFrame(m_CommandList);
+                    m_ReducedSsaoPass->Render(m_CommandList, m_ui.SsaoParams, reducedParams, *m_View, ssaoInputs);
+                    m_ReducedSsaoTimer->EndFrame(m_CommandList);
+                }
+                else if (m_ReducedSsaoPass)
+                {
+                    m_ReducedSsaoPass->ResetHistory();
+                }
+
                 ambientOcclusionTarget = m_RenderTargets->AmbientOcclusion;
             }
 
-            DeferredLightingPass::Inputs deferredInputs;
-            deferredInputs.SetGBuffer(*m_RenderTargets);
-            deferredInputs.ambientOcclusion = m_ui.EnableSsao ? m_RenderTargets->AmbientOcclusion : nullptr;
-            deferredInputs.ambientColorTop = m_AmbientTop;
-            deferredInputs.ambientColorBottom = m_AmbientBottom;
-            deferredInputs.lights = &m_Scene->GetSceneGraph()->GetLights();
-            deferredInputs.lightProbes = m_ui.EnableLightProbe ? &m_LightProbes : nullptr;
-            deferredInputs.output = m_RenderTargets->HdrColor;
+            if (tiledLighting)
+                m_TiledLightingPass->SetLights(sceneLights, m_DeferredLights);
+
+            if (compactGBuffer)
+            {
+                CompactDeferredLightingPass::Inputs compactInputs;
+                compactInputs.depth = m_RenderTargets->Depth;
+                compactInputs.gbufferBaseColor = m_RenderTargets->CompactBaseColor;
+                compactInputs.gbufferNormals = m_RenderTargets->CompactNormals;
+                compactInputs.gbufferMaterial = m_RenderTargets->CompactMaterial;
+                compactInputs.gbufferEmissive = m_RenderTargets->CompactEmissive;
+                compactInputs.ambientOcclusion = m_ui.EnableSsao ? m_RenderTargets->AmbientOcclusion : nullptr;
+                compactInputs.ambientColorTop = m_AmbientTop;
+                compactInputs.ambientColorBottom = m_AmbientBottom;
+                compactInputs.lights = tiledLighting ? &m_DeferredLights : &sceneLights;
+                compactInputs.output = m_RenderTargets->HdrColor;
+
+                m_CompactLightingPass->Render(m_CommandList, *m_View, compactInputs);
+            }
+            else
+            {
+                DeferredLightingPass::Inputs deferredInputs;
+                deferredInputs.SetGBuffer(*m_RenderTargets);
+                deferredInputs.ambientOcclusion = m_ui.EnableSsao ? m_RenderTargets->AmbientOcclusion : nullptr;
+                deferredInputs.ambientColorTop = m_AmbientTop;
+                deferredInputs.ambientColorBottom = m_AmbientBottom;
+                deferredInputs.lights = tiledLighting ? &m_DeferredLights : &sceneLights;
+                deferredInputs.lightProbes = m_ui.EnableLightProbe ? &m_LightProbes : nullptr;
+                deferredInputs.output = m_RenderTargets->HdrColor;
+
+                m_DeferredLightingPass->Render(m_CommandList, *m_View, deferredInputs);
+            }
+
+            if (tiledLighting)
+            {
+                TiledLightingPass::Inputs tiledInputs;
+                tiledInputs.SetGBuffer(*m_RenderTargets);
+                tiledInputs.output = m_RenderTargets->HdrColor;
+
+                if (compactGBuffer)
+                {
+                    tiledInputs.gbufferDiffuse = m_RenderTargets->CompactBaseColor;
+                    tiledInputs.gbufferSpecular = m_RenderTargets->CompactNormals;
+                    tiledInputs.gbufferNormals = m_RenderTargets->CompactMaterial;
+                    tiledInputs.gbufferEmissive = m_RenderTargets->CompactEmissive;
+                    tiledInputs.compactGBuffer = true;
+                }
 
-            m_DeferredLightingPass->Render(m_CommandList, *m_View, deferredInputs);
+                m_TiledLightingPass->Render(m_CommandList, *m_View, tiledInputs);
+            }
+        }
+        else if (occlusionCulling)
+        {
+            m_OcclusionCullingPass->Render(m_CommandList,
+                *m_View, m_ViewPrevious.get(),
+                m_RenderTargets->ForwardFramebuffer->GetFramebuffer(*m_View),
+                m_RenderTargets->Depth, 0,
+                m_Scene->GetSceneGraph()->GetRootNode(),
+                opaqueDrawStrategy,
+                *m_ForwardPass,
+                forwardContext,
+                "ForwardOpaque - Occlusion Culling");
         }
         else
         {
-            RenderCompositeView(m_CommandList,
+            renderOpaqueCompositeView(
                 m_View.get(), m_ViewPrevious.get(),
                 *m_RenderTargets->ForwardFramebuffer,
-                m_Scene->GetSceneGraph()->GetRootNode(),
-                *m_OpaqueDrawStrategy,
+                opaqueDrawStrategy,
                 *m_ForwardPass,
                 forwardContext,
-                "ForwardOpaque",
-                m_ui.EnableMaterialEvents);
+                "ForwardOpaque");
         }
 
-        if(m_Pick)
+        // Wait for a free readback slot if too many picks are in flight
+        const bool pick = m_Pick && !m_PickReadbackBusy[m_PickReadbackSlot];
+
+        if(pick)
         {
             m_CommandList->clearTextureUInt(m_RenderTargets->MaterialIDs, nvrhi::AllSubresources, 0xffff);
 
@@ -1007,7 +1727,7 @@ public:
                 m_View.get(), m_ViewPrevious.get(),
                 *m_RenderTargets->MaterialIDFramebuffer,
                 m_Scene->GetSceneGraph()->GetRootNode(),
-                *m_OpaqueDrawStrategy,
+                opaqueDrawStrategy,
                 *m_MaterialIDPass,
                 materialIdContext,
                 "MaterialID");
@@ -1018,25 +1738,47 @@ public:
                     m_View.get(), m_ViewPrevious.get(),
                     *m_RenderTargets->MaterialIDFramebuffer,
                     m_Scene->GetSceneGraph()->GetRootNode(),
-                    *m_TransparentDrawStrategy,
+                    transparentDrawStrategy,
                     *m_MaterialIDPass,
                     materialIdContext,
                     "MaterialID - Translucent");
             }
 
-            m_PixelReadbackPass->Capture(m_CommandList, m_PickPosition);
+            // The material IDs are rendered at the current render resolution
+            const float renderScale = float(m_RenderSize.x) / float(m_RenderTargets->GetSize().x);
+            const uint2 pickPosition = uint2(float2(m_PickPosition) * renderScale);
+            m_PickReadbackPasses[m_PickReadbackSlot]->Capture(m_CommandList, pickPosition);
         }
 
         if (m_ui.EnableProceduralSky)
-            m_SkyPass->Render(m_CommandList, *m_View, *m_SunLight, m_ui.SkyParams);
+        {
+            if (m_SkyPass)
+                m_SkyPass->Render(m_CommandList, *m_View, *m_SkyTables);
+            else
+                m_FallbackSkyPass->Render(m_CommandList, *m_View, *m_SunLight, m_ui.SkyParams);
+        }
 
-        if (m_ui.EnableTranslucency)
+        if (oit)
+        {
+            m_OitPass->Render(m_CommandList,
+                *m_View, m_ViewPrevious.get(),
+                m_RenderTargets->HdrColor,
+                m_RenderTargets->Depth,
+                m_Scene->GetSceneGraph()->GetRootNode(),
+                transparentDrawStrategy,
+                selectForwardLights ? m_ForwardLights : sceneLights,
+                m_AmbientTop, m_AmbientBottom,
+                m_ui.OitTechnique,
+                drawBundles,
+                m_ui.EnableMaterialEvents);
+        }
+        else if (m_ui.EnableTranslucency)
         {
             RenderCompositeView(m_CommandList,
                 m_View.get(), m_ViewPrevious.get(),
                 *m_RenderTargets->ForwardFramebuffer,
                 m_Scene->GetSceneGraph()->GetRootNode(),
-                *m_TransparentDrawStrategy,
+                transparentDrawStrategy,
                 *m_ForwardPass,
                 forwardContext,
                 "ForwardTransparent",
@@ -1052,13 +1794,13 @@ public:
                 m_TemporalAntiAliasingPass->RenderMotionVectors(m_CommandList, *m_View, *m_ViewPrevious);
             }
 
-            m_TemporalAntiAliasingPass->TemporalResolve(m_CommandList, m_ui.TemporalAntiAliasingParams, m_PreviousViewsValid, *m_View, *m_View);
+            m_TemporalAntiAliasingPass->TemporalResolve(m_CommandList, m_ui.TemporalAntiAliasingParams, m_PreviousViewsValid, *m_View, *m_OutputView);
 
             finalHdrColor = m_RenderTargets->ResolvedColor;
             
             if (m_ui.EnableBloom)
             {
-                m_BloomPass->Render(m_CommandList, m_RenderTargets->ResolvedFramebuffer, *m_View, m_RenderTargets->ResolvedColor, m_ui.BloomSigma, m_ui.BloomAlpha);
+                RenderBloom(m_RenderTargets->ResolvedFramebuffer, *m_OutputView, m_RenderTargets->ResolvedColor);
             }
             m_PreviousViewsValid = true;
         }
@@ -1076,7 +1818,7 @@ public:
 
             if (m_ui.EnableBloom)
             {
-                m_BloomPass->Render(m_CommandList, finalHdrFramebuffer, *m_View, finalHdrColor, m_ui.BloomSigma, m_ui.BloomAlpha);
+                RenderBloom(finalHdrFramebuffer, *m_View, finalHdrColor);
             }
 
             m_PreviousViewsValid = false;
@@ -1088,11 +1830,33 @@ public:
             toneMappingParams.eyeAdaptationSpeedUp = 0.f;
             toneMappingParams.eyeAdaptationSpeedDown = 0.f;
         }
-        m_ToneMappingPass->SimpleRender(m_CommandList, toneMappingParams, *m_View, finalHdrColor);
+        m_ToneMappingPass->SimpleRender(m_CommandList, toneMappingParams, *m_OutputView, finalHdrColor);
         
         m_CommonPasses->BlitTexture(m_CommandList, framebuffer, m_RenderTargets->LdrColor, &m_BindingCache);
 
-        if (m_ui.TestMipMapGen)
+        if (m_ui.TestMipMapGen && m_MipGenPass)
+        {
+            m_MipGenPass->GenerateMips(m_CommandList, m_RenderTargets->ResolvedColor);
+
+            // Show the mips in a row along the bottom of the window, each at half of its size
+            const nvrhi::TextureDesc& resolvedDesc = m_RenderTargets->ResolvedColor->getDesc();
+            float x = 10.f;
+            for (uint32_t mip = 1; mip < resolvedDesc.mipLevels; mip++)
+            {
+                const float width = std::max(float(resolvedDesc.width >> (mip + 1)), 1.f);
+                const float height = std::max(float(resolvedDesc.height >> (mip + 1)), 1.f);
+
+                engine::BlitParameters blitParams;
+                blitParams.targetFramebuffer = framebuffer;
+                blitParams.targetViewport = nvrhi::Viewport(x, x + width, windowViewport.maxY - 10.f - height, windowViewport.maxY - 10.f, 0.f, 1.f);
+                blitParams.sourceTexture = m_RenderTargets->ResolvedColor;
+                blitParams.sourceMip = mip;
+                m_CommonPasses->BlitTexture(m_CommandList, blitParams, &m_BindingCache);
+
+                x += width + 10.f;
+            }
+        }
+        else if (m_ui.TestMipMapGen && m_MipMapGenPass)
         {
             m_MipMapGenPass->Dispatch(m_CommandList);
             m_MipMapGenPass->Display(m_CommonPasses, m_CommandList, framebuffer);
@@ -1118,55 +1882,130 @@ public:
             }
         }
 
+        if (m_LightProbeBaker->IsBusy())
+        {
+            LightProbeBaker::SceneInputs bakerInputs;
+            bakerInputs.rootNode = m_Scene->GetSceneGraph()->GetRootNode();
+            bakerInputs.lights = &m_Scene->GetSceneGraph()->GetLights();
+            bakerInputs.sunLight = m_SunLight.get();
+            bakerInputs.opaqueDrawStrategy = m_OpaqueDrawStrategy.get();
+            bakerInputs.transparentDrawStrategy = m_TransparentDrawStrategy.get();
+            bakerInputs.skyParams = m_ui.SkyParams;
+            bakerInputs.skyTables = m_SkyTables.get();
+            bakerInputs.ambientTop = m_AmbientTop;
+            bakerInputs.ambientBottom = m_AmbientBottom;
+            bakerInputs.csmExponent = m_ui.CsmExponent;
+
+            m_LightProbeBaker->Update(m_CommandList, bakerInputs, m_ui.LightProbeBakeBudgetMs);
+        }
+
+        bool saveScreenshotNow = false;
+        if (!m_ui.ScreenshotFileName.empty())
+        {
+            saveScreenshotNow = !SaveScreenshotAsync(framebufferTexture, m_ui.ScreenshotFileName);
+            if (!saveScreenshotNow)
+                m_ui.ScreenshotFileName = "";
+        }
+
+        m_GpuFrameTimer->EndFrame(m_CommandList);
         m_CommandList->close();
         GetDevice()->executeCommandList(m_CommandList);
 
-        if (!m_ui.ScreenshotFileName.empty())
+        if (saveScreenshotNow)
         {
             SaveTextureToFile(GetDevice(), m_CommonPasses.get(), framebufferTexture, nvrhi::ResourceStates::RenderTarget, m_ui.ScreenshotFileName.c_str());
             m_ui.ScreenshotFileName = "";
         }
 
-        if (m_Pick)
+        if (pick)
         {
+            // The result is read by ReadbackQueue::Poll in a later frame, once the GPU has finished this one
+            const uint32_t slot = m_PickReadbackSlot;
+            std::shared_ptr<PixelReadbackPass> pickReadbackPass = m_PickReadbackPasses[slot];
+            m_ReadbackQueue->OnCompletion([this, slot, pickReadbackPass]()
+            {
+                m_PickReadbackBusy[slot] = false;
+                ApplyPickResult(pickReadbackPass->ReadUInts());
+            });
+
             m_Pick = false;
-            uint4 pixelValue = m_PixelReadbackPass->ReadUInts();
-            m_ui.SelectedMaterial = nullptr;
-            m_ui.SelectedNode = nullptr;
+            m_PickReadbackBusy[slot] = true;
+            m_PickReadbackSlot = (slot + 1) % c_NumPickReadbackSlots;
+        }
 
-            for (const auto& material : m_Scene->GetSceneGraph()->GetMaterials())
-            {
-                if (material->materialID == int(pixelValue.x))
-                {
-                    m_ui.SelectedMaterial = material;
-                    break;
-                }
-            }
+        m_ReadbackQueue->Submit();
 
-            for (const auto& instance : m_Scene->GetSceneGraph()->GetMeshInstances())
-            {
-                if (instance->GetInstanceIndex() == int(pixelValue.y))
-                {
-                    m_ui.SelectedNode = instance->GetNodeSharedPtr();
-                    break;
-                }
-            }
+        m_TemporalAntiAliasingPass->AdvanceFrame();
+        std::swap(m_View, m_ViewPrevious);
+
+        GetDeviceManager()->SetVsyncEnabled(m_ui.EnableVsync);
+    }
+
+    void ApplyPickResult(const uint4& pixelValue)
+    {
+        m_ui.SelectedMaterial = nullptr;
+        m_ui.SelectedNode = nullptr;
 
-            if (m_ui.SelectedNode)
+        for (const auto& material : m_Scene->GetSceneGraph()->GetMaterials())
+        {
+            if (material->materialID == int(pixelValue.x))
             {
-                log::info("Picked node: %s", m_ui.SelectedNode->GetPath().generic_string().c_str());
-                PointThirdPersonCameraAt(m_ui.SelectedNode);
+                m_ui.SelectedMaterial = material;
+                break;
             }
-            else
+        }
+
+        for (const auto& instance : m_Scene->GetSceneGraph()->GetMeshInstances())
+        {
+            if (instance->GetInstanceIndex() == int(pixelValue.y))
             {
-                PointThirdPersonCameraAt(m_Scene->GetSceneGraph()->GetRootNode());
+                m_ui.SelectedNode = instance->GetNodeSharedPtr();
+                break;
             }
         }
 
-        m_TemporalAntiAliasingPass->AdvanceFrame();
-        std::swap(m_View, m_ViewPrevious);
+        if (m_ui.SelectedNode)
+        {
+            log::info("Picked node: %s", m_ui.SelectedNode->GetPath().generic_string().c_str());
+            PointThirdPersonCameraAt(m_ui.SelectedNode);
+        }
+        else
+        {
+            PointThirdPersonCameraAt(m_Scene->GetSceneGraph()->GetRootNode());
+        }
+    }
 
-        GetDeviceManager()->SetVsyncEnabled(m_ui.EnableVsync);
+    // Records a copy of the framebuffer and writes the file when it arrives on the CPU.
+    // Returns false if the file or framebuffer format is not supported by the async path.
+    bool SaveScreenshotAsync(nvrhi::ITexture* framebufferTexture, const std::string& fileName)
+    {
+        std::string extension = std::filesystem::path(fileName).extension().generic_string();
+        std::transform(extension.begin(), extension.end(), extension.begin(), [](char c) { return char(::tolower(c)); });
+        if (extension != ".bmp")
+            return false;
+
+        switch (framebufferTexture->getDesc().format)
+        {
+        case nvrhi::Format::RGBA8_UNORM:
+        case nvrhi::Format::SRGBA8_UNORM:
+        case nvrhi::Format::BGRA8_UNORM:
+        case nvrhi::Format::SBGRA8_UNORM:
+            break;
+        default:
+            return false;
+        }
+
+        m_ReadbackQueue->ReadTexture(m_CommandList, framebufferTexture, nvrhi::TextureSlice(),
+            [fileName](const void* data, size_t rowPitch, uint32_t width, uint32_t height, nvrhi::Format format)
+            {
+                const bool bgra = format == nvrhi::Format::BGRA8_UNORM || format == nvrhi::Format::SBGRA8_UNORM;
+                if (WriteBmpFile(fileName.c_str(), data, rowPitch, width, height, bgra))
+                    log::info("Saved screenshot: %s", fileName.c_str());
+                else
+                    log::warning("Failed to write screenshot: %s", fileName.c_str());
+            });
+
+        return true;
     }
 
     std::shared_ptr<ShaderFactory> GetShaderFactory()
@@ -1231,138 +2070,141 @@ public:
         }
     }
 
-    void RenderLightProbe(LightProbe& probe)
+    void BakeLightProbe(const std::shared_ptr<LightProbe>& probe)
     {
-        nvrhi::DeviceHandle device = GetDeviceManager()->GetDevice();
+        float3 probePosition = GetActiveCamera().GetPosition();
+        if (m_ui.ActiveSceneCamera)
+            probePosition = m_ui.ActiveSceneCamera->GetWorldToViewMatrix().m_translation;
 
-        uint32_t environmentMapSize = 1024;
-        uint32_t environmentMapMipLevels = 8;
+        // Everything that changes the probe contents besides its position
+        std::string cacheKey = m_CurrentSceneName;
+        const double3 sunDirection = m_SunLight->GetDirection();
+        cacheKey.append(reinterpret_cast<const char*>(&sunDirection), sizeof(sunDirection));
+        cacheKey.append(reinterpret_cast<const char*>(&m_SunLight->irradiance), sizeof(m_SunLight->irradiance));
+        cacheKey.append(reinterpret_cast<const char*>(&m_ui.SkyParams), sizeof(m_ui.SkyParams));
+        cacheKey.append(reinterpret_cast<const char*>(&m_ui.AmbientIntensity), sizeof(m_ui.AmbientIntensity));
 
-        nvrhi::TextureDesc cubemapDesc;
-        cubemapDesc.arraySize = 6;
-        cubemapDesc.width = environmentMapSize;
-        cubemapDesc.height = environmentMapSize;
-        cubemapDesc.mipLevels = environmentMapMipLevels;
-        cubemapDesc.dimension = nvrhi::TextureDimension::TextureCube;
-        cubemapDesc.isRenderTarget = true;
-        cubemapDesc.format = nvrhi::Format::RGBA16_FLOAT;
-        cubemapDesc.initialState = nvrhi::ResourceStates::RenderTarget;
-        cubemapDesc.keepInitialState = true;
-        cubemapDesc.clearValue = nvrhi::Color(0.f);
-        cubemapDesc.useClearValue = true;
+        m_LightProbeBaker->Enqueue(probe, probePosition, cacheKey);
+    }
 
-        nvrhi::TextureHandle colorTexture = device->createTexture(cubemapDesc);
+    const DynamicResolutionController& GetDynamicResolution() const
+    {
+        return m_DynamicResolution;
+    }
 
-        const nvrhi::Format depthFormats[] = {
-            nvrhi::Format::D24S8,
-            nvrhi::Format::D32,
-            nvrhi::Format::D16,
-            nvrhi::Format::D32S8 };
+    uint2 GetRenderSize() const
+    {
+        return m_RenderSize;
+    }
 
-        const nvrhi::FormatSupport depthFeatures =
-            nvrhi::FormatSupport::Texture |
-            nvrhi::FormatSupport::DepthStencil |
-            nvrhi::FormatSupport::ShaderLoad;
+    float GetSsaoTimeMs() const
+    {
+        return m_SsaoTimeMs;
+    }
 
-        cubemapDesc.mipLevels = 1;
-        cubemapDesc.format = nvrhi::utils::ChooseFormat(GetDevice(), depthFeatures, depthFormats, std::size(depthFormats));
-        cubemapDesc.isTypeless = true;
-        cubemapDesc.initialState = nvrhi::ResourceStates::DepthWrite;
+    float GetReducedSsaoTimeMs() const
+    {
+        return m_ReducedSsaoTimeMs;
+    }
 
-        nvrhi::TextureHandle depthTexture = device->createTexture(cubemapDesc);
+    float GetBloomTimeMs() const
+    {
+        return m_BloomTimeMs;
+    }
 
-        std::shared_ptr<FramebufferFactory> framebuffer = std::make_shared<FramebufferFactory>(device);
-        framebuffer->RenderTargets = { colorTexture };
-        framebuffer->DepthTarget = depthTexture;
+    OrderIndependentTransparencyPass* GetOitPass() const
+    {
+        return m_OitPass.get();
+    }
 
-        CubemapView view;
-        view.SetArrayViewports(environmentMapSize, 0);
-        const float nearPlane = 0.1f;
-        const float cullDistance = 100.f;
-        float3 probePosition = GetActiveCamera().GetPosition();
-        if (m_ui.ActiveSceneCamera)
-            probePosition = m_ui.ActiveSceneCamera->GetWorldToViewMatrix().m_translation;
+    float GetPyramidBloomTimeMs() const
+    {
+        return m_PyramidBloomTimeMs;
+    }
 
-        view.SetTransform(dm::translation(-probePosition), nearPlane, cullDistance);
-        view.UpdateCache();
-        
-        std::shared_ptr<SkyPass> skyPass = std::make_shared<SkyPass>(device, m_ShaderFactory, m_CommonPasses, framebuffer, view);
+    float GetGBufferTimeMs() const
+    {
+        return m_GBufferTimeMs;
+    }
 
-        ForwardShadingPass::CreateParameters ForwardParams;
-        ForwardParams.singlePassCubemap = GetDevice()->queryFeatureSupport(nvrhi::Feature::FastGeometryShader);
-        std::shared_ptr<ForwardShadingPass> forwardPass = std::make_shared<ForwardShadingPass>(device, m_CommonPasses);
-        forwardPass->Init(*m_ShaderFactory, ForwardParams);
-        
-        nvrhi::CommandListHandle commandList = device->createCommandList();
-        commandList->open();
-        commandList->clearTextureFloat(colorTexture, nvrhi::AllSubresources, nvrhi::Color(0.f));
+    float GetVisibilityBufferTimeMs() const
+    {
+        return m_VisibilityBufferTimeMs;
+    }
 
-        const nvrhi::FormatInfo& depthFormatInfo = nvrhi::getFormatInfo(depthTexture->getDesc().format);
-        commandList->clearDepthStencilTexture(depthTexture, nvrhi::AllSubresources, true, 0.f, depthFormatInfo.hasStencil, 0);
+    const RenderTargets* GetRenderTargets() const
+    {
+        return m_RenderTargets.get();
+    }
 
-        box3 sceneBounds = m_Scene->GetSceneGraph()->GetRootNode()->GetGlobalBoundingBox();
-        float zRange = length(sceneBounds.diagonal()) * 0.5f;
-        m_ShadowMap->SetupForCubemapView(*m_SunLight, view.GetViewOrigin(), cullDistance, zRange, zRange, m_ui.CsmExponent);
-        m_ShadowMap->Clear(commandList);
+    const VisibilityBufferPass* GetVisibilityBufferPass() const
+    {
+        return m_VisibilityBufferPass.get();
+    }
 
-        DepthPass::Context shadowContext;
+    const OcclusionCullingPass* GetOcclusionCullingPass() const
+    {
+        return m_OcclusionCullingPass.get();
+    }
 
-        RenderCompositeView(commandList,
-            &m_ShadowMap->GetView(), nullptr,
-            *m_ShadowFramebuffer,
-            m_Scene->GetSceneGraph()->GetRootNode(),
-            *m_OpaqueDrawStrategy,
-            *m_ShadowDepthPass,
-            shadowContext,
-            "ShadowMap");
+    const CompactGBufferFillPass* GetCompactGBufferPass() const
+    {
+        return m_CompactGBufferPass.get();
+    }
 
-        ForwardShadingPass::Context forwardContext;
+    const StereoGBufferFillPass* GetStereoGBufferPass() const
+    {
+        return m_StereoGBufferPass.get();
+    }
 
-        std::vector<std::shared_ptr<LightProbe>> lightProbes;
-        forwardPass->PrepareLights(forwardContext, commandList, m_Scene->GetSceneGraph()->GetLights(), m_AmbientTop, m_AmbientBottom, lightProbes);
-
-        RenderCompositeView(commandList,
-            &view, nullptr,
-            *framebuffer,
-            m_Scene->GetSceneGraph()->GetRootNode(),
-            *m_OpaqueDrawStrategy,
-            *forwardPass,
-            forwardContext,
-            "ForwardOpaque");
-        
-        skyPass->Render(commandList, view, *m_SunLight, m_ui.SkyParams);
+    // Sum over the shadow cascades
+    OcclusionCullingPass::Stats GetShadowOcclusionCullingStats() const
+    {
+        OcclusionCullingPass::Stats total;
+        for (const auto& cullingPass : m_ShadowOcclusionCullingPasses)
+        {
+            const OcclusionCullingPass::Stats& stats = cullingPass->GetStats();
+            total.numItems += stats.numItems;
+            total.numDrawnPhase1 += stats.numDrawnPhase1;
+            total.numDrawnPhase2 += stats.numDrawnPhase2;
+            total.numCulled += stats.numCulled;
+        }
+        return total;
+    }
 
-        RenderCompositeView(commandList,
-            &view, nullptr,
-            *framebuffer,
-            m_Scene->GetSceneGraph()->GetRootNode(),
-            *m_TransparentDrawStrategy,
-            *forwardPass,
-            forwardContext,
-            "ForwardTransparent");
+    const SoftwareOcclusionCuller& GetSoftwareOcclusion() const
+    {
+        return *m_SoftwareOcclusion;
+    }
 
-        m_LightProbePass->GenerateCubemapMips(commandList, colorTexture, 0, 0, environmentMapMipLevels - 1);
+    DrawListCache& GetDrawListCache()
+    {
+        return *m_DrawListCache;
+    }
 
-        m_LightProbePass->RenderDiffuseMap(commandList, colorTexture, nvrhi::AllSubresources, probe.diffuseMap, probe.diffuseArrayIndex * 6, 0);
-        
-        uint32_t specularMapMipLevels = probe.specularMap->getDesc().mipLevels;
-        for (uint32_t mipLevel = 0; mipLevel < specularMapMipLevels; mipLevel++)
-        {
-            float roughness = powf(float(mipLevel) / float(specularMapMipLevels - 1), 2.0f);
-            m_LightProbePass->RenderSpecularMap(commandList, roughness, colorTexture, nvrhi::AllSubresources, probe.specularMap, probe.specularArrayIndex * 6, mipLevel);
-        }
-        
-        m_LightProbePass->RenderEnvironmentBrdfTexture(commandList);
+    DrawBundleCache& GetDrawBundles()
+    {
+        return *m_DrawBundles;
+    }
+
+    const TiledLightingPass* GetTiledLightingPass() const
+    {
+        return m_TiledLightingPass.get();
+    }
 
-        commandList->close();
-        device->executeCommandList(commandList);
-        device->waitForIdle();
-        device->runGarbageCollection();
+    ShadowCache& GetShadowCache()
+    {
+        return *m_ShadowCache;
+    }
+
+    const LightProbeBaker& GetLightProbeBaker() const
+    {
+        return *m_LightProbeBaker;
+    }
 
-        probe.environmentBrdf = m_LightProbePass->GetEnvironmentBrdfTexture();
-        box3 bounds = box3(probePosition, probePosition).grow(10.f);
-        probe.bounds = frustum::fromBox(bounds);
-        probe.enabled = true;
+    const SkyLookupTables* GetSkyTables() const
+    {
+        return m_SkyTables.get();
     }
 };
 
@@ -1460,7 +2302,87 @@ protected:
         ImGui::Checkbox("Deferred Shading", &m_ui.UseDeferredShading);
         if (m_ui.AntiAliasingMode >= AntiAliasingMode::MSAA_2X)
             m_ui.UseDeferredShading = false; // Deferred shading doesn't work with MSAA
+        if (m_ui.UseDeferredShading && m_app->GetVisibilityBufferPass())
+        {
+            ImGui::Checkbox("Visibility Buffer", &m_ui.UseVisibilityBuffer);
+            if (m_ui.UseVisibilityBuffer && m_app->GetVisibilityBufferPass()->GetNumSkippedDraws() > 0)
+                ImGui::Text("%u draws skipped: index out of range", m_app->GetVisibilityBufferPass()->GetNumSkippedDraws());
+            ImGui::Text("GBuffer fill %.2f ms, visibility buffer %.2f ms", m_app->GetGBufferTimeMs(), m_app->GetVisibilityBufferTimeMs());
+        }
+        if (m_ui.UseDeferredShading && m_app->GetRenderTargets() && m_app->GetCompactGBufferPass())
+        {
+            ImGui::Checkbox("Compact GBuffer", &m_ui.UseCompactGBuffer);
+
+            // Bytes written by the GBuffer fill and read back by lighting, per frame at the render target size
+            const RenderTargets& targets = *m_app->GetRenderTargets();
+            const float pixelsInMB = float(targets.GetSize().x * targets.GetSize().y) / (1024.f * 1024.f);
+            const uint32_t standardBytes = targets.GetGBufferBytesPerPixel();
+            const uint32_t compactBytes = targets.GetCompactGBufferBytesPerPixel();
+            ImGui::Text("GBuffer layout: %u B/pixel (%.1f MB)", standardBytes, float(standardBytes) * pixelsInMB);
+            ImGui::Text("Compact layout: %u B/pixel (%.1f MB)", compactBytes, float(compactBytes) * pixelsInMB);
+            if (m_ui.UseCompactGBuffer && m_ui.EnableLightProbe)
+                ImGui::TextUnformatted("Light probes are not applied with the compact GBuffer");
+        }
+        if (m_app->GetOcclusionCullingPass())
+        {
+            ImGui::Checkbox("Occlusion Culling", &m_ui.EnableOcclusionCulling);
+            if (m_ui.EnableOcclusionCulling)
+            {
+                // Counters from a few frames ago, as returned by the GPU
+                const OcclusionCullingPass::Stats& viewStats = m_app->GetOcclusionCullingPass()->GetStats();
+                const OcclusionCullingPass::Stats shadowStats = m_app->GetShadowOcclusionCullingStats();
+                ImGui::Text("View: %u of %u culled, %u + %u drawn", viewStats.numCulled, viewStats.numItems,
+                    viewStats.numDrawnPhase1, viewStats.numDrawnPhase2);
+                ImGui::Text("Shadows: %u of %u culled, %u + %u drawn", shadowStats.numCulled, shadowStats.numItems,
+                    shadowStats.numDrawnPhase1, shadowStats.numDrawnPhase2);
+                if (m_ui.EnableShadowCache)
+                    ImGui::TextUnformatted("Cached shadows are not culled");
+                if (m_ui.UseVisibilityBuffer)
+                    ImGui::TextUnformatted("The visibility buffer is not culled");
+            }
+        }
+        ImGui::Checkbox("CPU Occlusion Culling", &m_ui.EnableSoftwareOcclusion);
+        if (m_ui.EnableSoftwareOcclusion)
+        {
+            const SoftwareOcclusionCuller& culler = m_app->GetSoftwareOcclusion();
+            ImGui::Text("%u occluders, %u triangles", culler.GetNumOccluders(), culler.GetNumOccluderTriangles());
+            for (size_t view = 0; view < culler.GetViewStats().size(); view++)
+            {
+                const SoftwareOcclusionCuller::ViewStats& stats = culler.GetViewStats()[view];
+                const float ratio = stats.numTested ? float(stats.numRejected) / float(stats.numTested) : 0.f;
+                ImGui::Text("View %d: %u of %u rejected (%.0f%%)", int(view), stats.numRejected, stats.numTested, ratio * 100.f);
+            }
+        }
+        ImGui::Checkbox("Persistent Draw Lists", &m_ui.EnableDrawListCache);
+        if (m_ui.EnableDrawListCache)
+        {
+            const DrawListCache::Stats& stats = m_app->GetDrawListCache().GetStats();
+            ImGui::Text("%u entries, %u views, %u moved", stats.numEntries, stats.numViews, stats.numDirtyEntries);
+            ImGui::Text("Lists: %u reused, %u updated, %u rebuilt", stats.numReused, stats.numUpdated, stats.numRebuilt);
+            ImGui::Text("Entries tested: %u", stats.numEntriesTested);
+            ImGui::Text("Sort: opaque %.3f ms, transparent %.3f ms", stats.opaqueSortTimeMs, stats.transparentSortTimeMs);
+            ImGui::Text("Sorts: %u incremental, %u radix", stats.numCoherentSorts, stats.numRadixSorts);
+        }
+        ImGui::Checkbox("Draw Bundles", &m_ui.EnableDrawBundles);
+        if (m_ui.EnableDrawBundles)
+        {
+            if (m_ui.EnableSoftwareOcclusion)
+                ImGui::TextUnformatted("Not used with CPU occlusion culling");
+            const DrawBundleCache::Stats& stats = m_app->GetDrawBundles().GetStats();
+            ImGui::Text("%u bundles: %u replayed, %u recorded", stats.numBundles, stats.numReplayed, stats.numRecorded);
+            ImGui::Text("Draws: %u replayed, %u recorded", stats.numReplayedDraws, stats.numRecordedDraws);
+        }
+        ImGui::Checkbox("Tiled Local Lights", &m_ui.EnableTiledLighting);
+        if (m_ui.EnableTiledLighting && m_ui.UseDeferredShading && m_app->GetTiledLightingPass())
+        {
+            const TiledLightingPass::Stats& tiledStats = m_app->GetTiledLightingPass()->GetStats();
+            ImGui::Text("%d local lights in %d tiles", tiledStats.numLocalLights, tiledStats.numTiles);
+            if (tiledStats.numOverflowTiles)
+                ImGui::Text("%u tiles dropped lights, up to %u touched one", tiledStats.numOverflowTiles, tiledStats.maxTileLights);
+        }
         ImGui::Checkbox("Stereo", &m_ui.Stereo);
+        if (m_ui.Stereo && m_app->GetStereoGBufferPass())
+            ImGui::Checkbox("Single-Pass Stereo", &m_ui.SinglePassStereo);
         ImGui::Checkbox("Animations", &m_ui.EnableAnimations);
 
         if (ImGui::BeginCombo("Camera (T)", m_ui.ActiveSceneCamera ? m_ui.ActiveSceneCamera->GetName().c_str()
@@ -1490,6 +2412,32 @@ protected:
         
         ImGui::Combo("AA Mode", (int*)&m_ui.AntiAliasingMode, "None\0TemporalAA\0MSAA 2x\0MSAA 4x\0MSAA 8x\0");
         ImGui::Combo("TAA Camera Jitter", (int*)&m_ui.TemporalAntiAliasingJitter, "MSAA\0Halton\0R2\0White Noise\0");
+
+        ImGui::Checkbox("Dynamic Resolution", &m_ui.EnableDynamicResolution);
+        if (m_ui.EnableDynamicResolution)
+        {
+            if (m_ui.AntiAliasingMode != AntiAliasingMode::TEMPORAL)
+            {
+                ImGui::TextDisabled("Dynamic resolution requires TemporalAA");
+            }
+            else
+            {
+                auto& params = m_ui.DynamicResolutionParams;
+                ImGui::SliderFloat("Target GPU Time (ms)", &params.targetFrameTimeMs, 4.f, 50.f);
+                ImGui::SliderFloat("Min Scale", &params.minScale, 0.25f, params.maxScale);
+                ImGui::SliderFloat("Max Scale", &params.maxScale, params.minScale, 1.f);
+
+                const DynamicResolutionController& controller = m_app->GetDynamicResolution();
+                const uint2 renderSize = m_app->GetRenderSize();
+                ImGui::Text("Render size: %dx%d (%.0f%%), GPU time: %.2f ms, %d changes",
+                    renderSize.x, renderSize.y, controller.GetScale() * 100.f,
+                    controller.GetFilteredFrameTimeMs(), controller.GetNumScaleChanges());
+
+                const auto& history = controller.GetScaleHistory();
+                ImGui::PlotLines("Scale", history.data(), int(history.size()), int(controller.GetHistoryOffset()),
+                    nullptr, params.minScale, params.maxScale, ImVec2(0.f, 40.f));
+            }
+        }
         
         ImGui::SliderFloat("Ambient Intensity", &m_ui.AmbientIntensity, 0.f, 1.f);
 
@@ -1508,13 +2456,71 @@ protected:
             ImGui::SliderFloat("Glow Sharpness", &m_ui.SkyParams.glowSharpness, 1.f, 10.f);
             ImGui::SliderFloat("Glow Intensity", &m_ui.SkyParams.glowIntensity, 0.f, 1.f);
             ImGui::SliderFloat("Horizon Size", &m_ui.SkyParams.horizonSize, 0.f, 90.f);
+            if (const SkyLookupTables* skyTables = m_app->GetSkyTables())
+                ImGui::Text("Sky tables baked %u times", skyTables->GetNumBakes());
         }
         ImGui::Checkbox("Enable SSAO", &m_ui.EnableSsao);
+        if (m_ui.EnableSsao && m_ui.UseDeferredShading)
+        {
+            const char* ssaoResolutions[] = { "Full", "Half", "Quarter" };
+            int ssaoResolution = m_ui.EnableReducedSsao ? (m_ui.ReducedSsaoParams.downsampleFactor == 4 ? 2 : 1) : 0;
+            if (ImGui::Combo("SSAO Resolution", &ssaoResolution, ssaoResolutions, IM_ARRAYSIZE(ssaoResolutions)))
+            {
+                m_ui.EnableReducedSsao = ssaoResolution > 0;
+                m_ui.ReducedSsaoParams.downsampleFactor = ssaoResolution == 2 ? 4 : 2;
+            }
+
+            if (m_ui.EnableReducedSsao)
+            {
+                int numSamples = int(m_ui.ReducedSsaoParams.numSamples);
+                if (ImGui::SliderInt("SSAO Samples", &numSamples, 1, 32))
+                    m_ui.ReducedSsaoParams.numSamples = uint32_t(numSamples);
+                ImGui::Checkbox("SSAO Temporal Accumulation", &m_ui.ReducedSsaoParams.enableTemporalAccumulation);
+                if (m_ui.ReducedSsaoParams.enableTemporalAccumulation)
+                    ImGui::SliderFloat("SSAO History Length", &m_ui.ReducedSsaoParams.maxHistoryLength, 1.f, 64.f);
+                ImGui::SliderFloat("SSAO Upsample Sharpness", &m_ui.ReducedSsaoParams.upsampleSharpness, 1.f, 128.f);
+                ImGui::Checkbox("SSAO Split Screen (reduced | full)", &m_ui.SsaoSplitScreen);
+                ImGui::Text("SSAO: full res %.2f ms, reduced %.2f ms", m_app->GetSsaoTimeMs(), m_app->GetReducedSsaoTimeMs());
+            }
+            else
+            {
+                ImGui::Text("SSAO: %.2f ms", m_app->GetSsaoTimeMs());
+            }
+        }
         ImGui::Checkbox("Enable Bloom", &m_ui.EnableBloom);
         ImGui::DragFloat("Bloom Sigma", &m_ui.BloomSigma, 0.01f, 0.1f, 100.f);
         ImGui::DragFloat("Bloom Alpha", &m_ui.BloomAlpha, 0.01f, 0.01f, 1.0f);
+        if (m_ui.EnableBloom)
+        {
+            ImGui::Checkbox("Pyramid Bloom", &m_ui.UsePyramidBloom);
+            // Each timing is updated while its pass is active, toggle the mode to compare
+            ImGui::Text("Bloom: gaussian %.2f ms, pyramid %.2f ms", m_app->GetBloomTimeMs(), m_app->GetPyramidBloomTimeMs());
+        }
         ImGui::Checkbox("Enable Shadows", &m_ui.EnableShadows);
+        if (m_ui.EnableShadows)
+        {
+            ImGui::Checkbox("Cache Static Shadows", &m_ui.EnableShadowCache);
+            if (m_ui.EnableShadowCache)
+            {
+                const ShadowCache::Stats& shadowStats = m_app->GetShadowCache().GetStats();
+                ImGui::Text("Cascades rendered: %d static, %d dynamic (%d dynamic instances)",
+                    shadowStats.staticCascadesRendered, shadowStats.dynamicCascadesRendered,
+                    int(m_app->GetShadowCache().GetNumDynamicInstances()));
+            }
+        }
         ImGui::Checkbox("Enable Translucency", &m_ui.EnableTranslucency);
+        if (m_ui.EnableTranslucency && m_app->GetOitPass())
+        {
+            ImGui::Checkbox("Order-Independent Transparency", &m_ui.EnableOit);
+            if (m_ui.EnableOit)
+            {
+                if (m_app->GetOitPass()->IsMultiLayerSupported())
+                    ImGui::Combo("OIT Mode", (int*)&m_ui.OitTechnique, "Weighted Blended\0Multi-Layer Alpha Blending\0");
+                else
+                    ImGui::Text("Weighted blended, no rasterizer ordered views");
+                ImGui::TextDisabled("Light probes are not applied to OIT surfaces");
+            }
+        }
 
         ImGui::Separator();
         ImGui::Checkbox("Temporal AA Clamping", &m_ui.TemporalAntiAliasingParams.enableHistoryClamping);
@@ -1546,17 +2552,25 @@ protected:
             }
         }
 
-        ImGui::TextUnformatted("Render Light Probe: ");
-        uint32_t probeIndex = 1;
+        ImGui::TextUnformatted("Bake Light Probe: ");
         for (auto probe : m_app->GetLightProbes())
         {
             ImGui::SameLine();
             if (ImGui::Button(probe->name.c_str()))
             {
-                m_app->RenderLightProbe(*probe);
+                m_app->BakeLightProbe(probe);
             }
         }
 
+        ImGui::SliderFloat("Bake Budget (ms)", &m_ui.LightProbeBakeBudgetMs, 0.5f, 16.f);
+
+        const LightProbeBaker& lightProbeBaker = m_app->GetLightProbeBaker();
+        if (lightProbeBaker.IsBusy())
+        {
+            ImGui::Text("Baking probe %s: %d%%, %d in queue", lightProbeBaker.GetCurrentProbeName().c_str(),
+                int(lightProbeBaker.GetProgress() * 100.f), int(lightProbeBaker.GetQueueLength()) - 1);
+        }
+
         if (ImGui::Button("Screenshot"))
         {
             std::string fileName;
@@ -1567,7 +2581,7 @@ protected:
         }
 
         ImGui::Separator();
-        ImGui::Checkbox("Test MipMapGen Pass", &m_ui.TestMipMapGen);
+        ImGui::Checkbox("Test Mip Generation", &m_ui.TestMipMapGen);
         ImGui::Checkbox("Display Shadow Map", &m_ui.DisplayShadowMap);
 
         ImGui::End();
@@ -1582,6 +2596,14 @@ protected:
             MaterialDomain previousDomain = material->domain;
             material->dirty = donut::app::MaterialEditor(material.get(), true);
 
+            // Alpha testing and culling affect the cached shadows and the sort keys of the draw lists
+            if (material->dirty)
+            {
+                m_app->GetShadowCache().InvalidateStaticGeometry();
+                m_app->GetDrawListCache().Invalidate();
+                m_app->GetDrawBundles().Invalidate();
+            }
+
             if (previousDomain != material->domain)
                 m_app->GetScene()->GetSceneGraph()->GetRootNode()->InvalidateContent();
             
@@ -0,0 +1,625 @@
+/*
+* Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#include "LightProbeBaker.h"
+
+#include <donut/core/log.h>
+#include <donut/engine/FramebufferFactory.h>
+#include <donut/engine/SceneGraph.h>
+#include <donut/render/CascadedShadowMap.h>
+#include <donut/render/DepthPass.h>
+#include <donut/render/DrawStrategy.h>
+#include <donut/render/ForwardShadingPass.h>
+#include <donut/render/LightProbeProcessingPass.h>
+#include <nvrhi/utils.h>
+#include <ReadbackQueue.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#include "CachedSky.h"
+
+using namespace donut;
+using namespace donut::math;
+using namespace donut::engine;
+using namespace donut::render;
+
+static constexpr uint32_t c_CacheFileMagic = 0x4250434c; // "LCPB"
+static constexpr uint32_t c_CacheFileVersion = 1;
+
+static constexpr float c_ProbeNearPlane = 0.1f;
+static constexpr float c_ProbeCullDistance = 100.f;
+
+struct LightProbeCacheHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t format;
+    uint32_t diffuseSize;
+    uint32_t diffuseMipLevels;
+    uint32_t specularSize;
+    uint32_t specularMipLevels;
+    uint32_t reserved;
+};
+
+// Images in the cache file: all mips of the 6 diffuse faces, then all mips of the 6 specular faces
+struct LightProbeCacheImage
+{
+    nvrhi::ITexture* texture;
+    uint32_t arraySlice;
+    uint32_t mipLevel;
+    uint32_t width;
+    uint32_t height;
+};
+
+static std::vector<LightProbeCacheImage> GetCacheImages(const LightProbe& probe)
+{
+    std::vector<LightProbeCacheImage> images;
+
+    auto addImages = [&images](nvrhi::ITexture* texture, uint32_t firstArraySlice)
+    {
+        const nvrhi::TextureDesc& desc = texture->getDesc();
+        for (uint32_t face = 0; face < 6; face++)
+        {
+            for (uint32_t mipLevel = 0; mipLevel < desc.mipLevels; mipLevel++)
+            {
+                images.push_back({ texture, firstArraySlice + face, mipLevel,
+                    std::max(desc.width >> mipLevel, 1u), std::max(desc.height >> mipLevel, 1u) });
+            }
+        }
+    };
+
+    addImages(probe.diffuseMap, probe.diffuseArrayIndex * 6);
+    addImages(probe.specularMap, probe.specularArrayIndex * 6);
+
+    return images;
+}
+
+static uint64_t HashString(uint64_t hash, const void* data, size_t size)
+{
+    // FNV-1a, stable between runs
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+LightProbeBaker::LightProbeBaker(
+    nvrhi::IDevice* device,
+    std::shared_ptr<ShaderFactory> shaderFactory,
+    std::shared_ptr<CommonRenderPasses> commonPasses,
+    ReadbackQueue* readbackQueue,
+    nvrhi::Format shadowMapFormat,
+    const std::filesystem::path& cacheDirectory)
+    : m_Device(device)
+    , m_ShaderFactory(std::move(shaderFactory))
+    , m_CommonPasses(std::move(commonPasses))
+    , m_ReadbackQueue(readbackQueue)
+    , m_CacheDirectory(cacheDirectory)
+{
+    // Initial cost estimates, replaced with measurements as soon as the timer queries resolve
+    m_StepCostMs[size_t(StepType::LoadFromCache)] = 1.f;
+    m_StepCostMs[size_t(StepType::Shadows)] = 1.f;
+    m_StepCostMs[size_t(StepType::Face)] = 2.f;
+    m_StepCostMs[size_t(StepType::Mips)] = 0.5f;
+    m_StepCostMs[size_t(StepType::Diffuse)] = 1.f;
+    m_StepCostMs[size_t(StepType::Specular)] = 1.f;
+    m_StepCostMs[size_t(StepType::Finalize)] = 0.1f;
+
+    nvrhi::TextureDesc cubemapDesc;
+    cubemapDesc.arraySize = 6;
+    cubemapDesc.width = c_EnvironmentMapSize;
+    cubemapDesc.height = c_EnvironmentMapSize;
+    cubemapDesc.mipLevels = c_EnvironmentMapMipLevels;
+    cubemapDesc.dimension = nvrhi::TextureDimension::TextureCube;
+    cubemapDesc.isRenderTarget = true;
+    cubemapDesc.format = nvrhi::Format::RGBA16_FLOAT;
+    cubemapDesc.initialState = nvrhi::ResourceStates::RenderTarget;
+    cubemapDesc.keepInitialState = true;
+    cubemapDesc.clearValue = nvrhi::Color(0.f);
+    cubemapDesc.useClearValue = true;
+    cubemapDesc.debugName = "LightProbeBaker/Color";
+
+    m_ColorTexture = m_Device->createTexture(cubemapDesc);
+
+    const nvrhi::Format depthFormats[] = {
+        nvrhi::Format::D24S8,
+        nvrhi::Format::D32,
+        nvrhi::Format::D16,
+        nvrhi::Format::D32S8 };
+
+    const nvrhi::FormatSupport depthFeatures =
+        nvrhi::FormatSupport::Texture |
+        nvrhi::FormatSupport::DepthStencil |
+        nvrhi::FormatSupport::ShaderLoad;
+
+    cubemapDesc.mipLevels = 1;
+    cubemapDesc.format = nvrhi::utils::ChooseFormat(m_Device, depthFeatures, depthFormats, std::size(depthFormats));
+    cubemapDesc.isTypeless = true;
+    cubemapDesc.initialState = nvrhi::ResourceStates::DepthWrite;
+    cubemapDesc.debugName = "LightProbeBaker/Depth";
+
+    m_DepthTexture = m_Device->createTexture(cubemapDesc);
+
+    m_Framebuffer = std::make_shared<FramebufferFactory>(m_Device);
+    m_Framebuffer->RenderTargets = { m_ColorTexture };
+    m_Framebuffer->DepthTarget = m_DepthTexture;
+
+    m_View.SetArrayViewports(c_EnvironmentMapSize, 0);
+    m_View.SetTransform(dm::affine3::identity(), c_ProbeNearPlane, c_ProbeCullDistance);
+    m_View.UpdateCache();
+
+    // The faces draw the sky from the low resolution cubemap, the probe filtering blurs it anyway.
+    // The cached sky has no D3D11 shaders, donut's pass computes the sky per pixel there.
+    if (m_Device->getGraphicsAPI() != nvrhi::GraphicsAPI::D3D11)
+        m_SkyPass = std::make_shared<CachedSkyPass>(m_Device, m_ShaderFactory, m_CommonPasses, m_Framebuffer, m_View, CachedSkyPass::Source::Cubemap);
+    else
+        m_FallbackSkyPass = std::make_shared<SkyPass>(m_Device, m_ShaderFactory, m_CommonPasses, m_Framebuffer, m_View);
+
+    // Faces are rendered one at a time, so the single-pass cubemap path is not needed
+    ForwardShadingPass::CreateParameters forwardParams;
+    m_ForwardPass = std::make_shared<ForwardShadingPass>(m_Device, m_CommonPasses);
+    m_ForwardPass->Init(*m_ShaderFactory, forwardParams);
+
+    m_LightProbePass = std::make_shared<LightProbeProcessingPass>(m_Device, m_ShaderFactory, m_CommonPasses);
+
+    // The probes have their own shadow map, which lives across the frames of one bake
+    m_ShadowMap = std::make_shared<CascadedShadowMap>(m_Device, 1024, 4, 0, shadowMapFormat);
+    m_ShadowMap->SetupProxyViews();
+
+    m_ShadowFramebuffer = std::make_shared<FramebufferFactory>(m_Device);
+    m_ShadowFramebuffer->DepthTarget = m_ShadowMap->GetTexture();
+
+    DepthPass::CreateParameters shadowDepthParams;
+    shadowDepthParams.slopeScaledDepthBias = 4.f;
+    shadowDepthParams.depthBias = 100;
+    m_ShadowDepthPass = std::make_shared<DepthPass>(m_Device, m_CommonPasses);
+    m_ShadowDepthPass->Init(*m_ShaderFactory, shadowDepthParams);
+}
+
+void LightProbeBaker::Enqueue(std::shared_ptr<LightProbe> probe, const float3& position, const std::string& cacheKey)
+{
+    // Replace a pending bake of the same probe
+    auto it = std::find_if(m_Jobs.begin(), m_Jobs.end(), [&probe](const Job& job) { return job.probe == probe; });
+    if (it != m_Jobs.end() && it != m_Jobs.begin())
+        m_Jobs.erase(it);
+
+    Job job;
+    job.probe = std::move(probe);
+    job.position = position;
+
+    uint64_t hash = 0xcbf29ce484222325ull;
+    hash = HashString(hash, cacheKey.data(), cacheKey.size());
+    hash = HashString(hash, &position, sizeof(position));
+    hash = HashString(hash, &job.probe->diffuseMap->getDesc().width, sizeof(uint32_t));
+    hash = HashString(hash, &job.probe->specularMap->getDesc().width, sizeof(uint32_t));
+
+    char fileName[32];
+    snprintf(fileName, sizeof(fileName), "%016llx.probe", (unsigned long long)hash);
+    job.cacheFile = m_CacheDirectory / fileName;
+
+    m_Jobs.push_back(std::move(job));
+}
+
+void LightProbeBaker::Reset()
+{
+    m_Jobs.clear();
+    m_ForwardPass->ResetBindingCache();
+    m_ShadowDepthPass->ResetBindingCache();
+    m_LightProbePass->ResetCaches();
+}
+
+float LightProbeBaker::GetProgress() const
+{
+    if (m_Jobs.empty() || m_Jobs.front().numSteps == 0)
+        return 0.f;
+
+    return float(m_Jobs.front().nextStep) / float(m_Jobs.front().numSteps);
+}
+
+std::string LightProbeBaker::GetCurrentProbeName() const
+{
+    return m_Jobs.empty() ? std::string() : m_Jobs.front().probe->name;
+}
+
+void LightProbeBaker::StartJob(Job& job)
+{
+    job.nextStep = 0;
+    job.loadFromCache = !m_CacheDirectory.empty() && std::filesystem::exists(job.cacheFile);
+
+    if (job.loadFromCache)
+    {
+        job.numSteps = 2;
+    }
+    else
+    {
+        // Shadows, 6 faces, mips, diffuse, specular mips, finalize
+        job.numSteps = 1 + 6 + 1 + 1 + job.probe->specularMap->getDesc().mipLevels + 1;
+
+        m_View.SetTransform(dm::translation(-job.position), c_ProbeNearPlane, c_ProbeCullDistance);
+        m_View.UpdateCache();
+    }
+}
+
+void LightProbeBaker::GetStep(const Job& job, uint32_t stepIndex, StepType& type, uint32_t& index) const
+{
+    index = 0;
+
+    if (job.loadFromCache)
+    {
+        type = (stepIndex == 0) ? StepType::LoadFromCache : StepType::Finalize;
+        return;
+    }
+
+    const uint32_t specularMipLevels = job.probe->specularMap->getDesc().mipLevels;
+
+    if (stepIndex == 0)
+    {
+        type = StepType::Shadows;
+    }
+    else if (stepIndex < 7)
+    {
+        type = StepType::Face;
+        index = stepIndex - 1;
+    }
+    else if (stepIndex == 7)
+    {
+        type = StepType::Mips;
+    }
+    else if (stepIndex == 8)
+    {
+        type = StepType::Diffuse;
+    }
+    else if (stepIndex < 9 + specularMipLevels)
+    {
+        type = StepType::Specular;
+        index = stepIndex - 9;
+    }
+    else
+    {
+        type = StepType::Finalize;
+    }
+}
+
+void LightProbeBaker::PollTimers()
+{
+    auto it = m_PendingTimers.begin();
+    while (it != m_PendingTimers.end())
+    {
+        if (!m_Device->pollTimerQuery(it->query))
+        {
+            ++it;
+            continue;
+        }
+
+        // Smooth the measurements so that one slow frame doesn't throw off the schedule
+        const float timeMs = m_Device->getTimerQueryTime(it->query) * 1000.f;
+        float& estimate = m_StepCostMs[size_t(it->type)];
+        estimate = estimate * 0.75f + timeMs * 0.25f;
+
+        m_Device->resetTimerQuery(it->query);
+        m_FreeTimers.push_back(it->query);
+        it = m_PendingTimers.erase(it);
+    }
+}
+
+void LightProbeBaker::Update(nvrhi::ICommandList* commandList, const SceneInputs& inputs, float timeBudgetMs)
+{
+    PollTimers();
+
+    if (m_Jobs.empty())
+        return;
+
+    commandList->beginMarker("LightProbeBaker");
+
+    float spentMs = 0.f;
+    while (!m_Jobs.empty())
+    {
+        Job& job = m_Jobs.front();
+        if (job.numSteps == 0)
+            StartJob(job);
+
+        StepType type;
+        uint32_t index;
+        GetStep(job, job.nextStep, type, index);
+
+        const float costMs = m_StepCostMs[size_t(type)];
+        if (spentMs > 0.f && spentMs + costMs > timeBudgetMs)
+            break;
+
+        // Advance before executing, the step may restart the job
+        ++job.nextStep;
+
+        nvrhi::TimerQueryHandle timer;
+        if (m_FreeTimers.empty())
+        {
+            timer = m_Device->createTimerQuery();
+        }
+        else
+        {
+            timer = m_FreeTimers.back();
+            m_FreeTimers.pop_back();
+        }
+
+        commandList->beginTimerQuery(timer);
+        ExecuteStep(commandList, inputs, job, type, index);
+        commandList->endTimerQuery(timer);
+        m_PendingTimers.push_back({ timer, type });
+
+        spentMs += costMs;
+
+        if (job.nextStep == job.numSteps)
+            m_Jobs.pop_front();
+    }
+
+    commandList->endMarker();
+}
+
+void LightProbeBaker::ExecuteStep(nvrhi::ICommandList* commandList, const SceneInputs& inputs, Job& job, StepType type, uint32_t index)
+{
+    LightProbe& probe = *job.probe;
+
+    switch (type)
+    {
+    case StepType::LoadFromCache:
+        if (!LoadFromCache(commandList, job))
+        {
+            // The file is unusable, bake the probe instead
+            log::warning("Cannot load light probe cache file '%s', baking the probe", job.cacheFile.generic_string().c_str());
+            std::error_code error;
+            std::filesystem::remove(job.cacheFile, error);
+            StartJob(job);
+        }
+        break;
+
+    case StepType::Shadows: {
+        commandList->clearTextureFloat(m_ColorTexture, nvrhi::AllSubresources, nvrhi::Color(0.f));
+
+        box3 sceneBounds = inputs.rootNode->GetGlobalBoundingBox();
+        float zRange = length(sceneBounds.diagonal()) * 0.5f;
+        m_ShadowMap->SetupForCubemapView(*inputs.sunLight, m_View.GetViewOrigin(), c_ProbeCullDistance, zRange, zRange, inputs.csmExponent);
+        m_ShadowMap->Clear(commandList);
+
+        DepthPass::Context shadowContext;
+
+        RenderCompositeView(commandList,
+            &m_ShadowMap->GetView(), nullptr,
+            *m_ShadowFramebuffer,
+            inputs.rootNode,
+            *inputs.opaqueDrawStrategy,
+            *m_ShadowDepthPass,
+            shadowContext,
+            "ShadowMap");
+        break;
+    }
+
+    case StepType::Face: {
+        const IView* faceView = m_View.GetChildView(ViewType::PLANAR, index);
+
+        const nvrhi::FormatInfo& depthFormatInfo = nvrhi::getFormatInfo(m_DepthTexture->getDesc().format);
+        commandList->clearDepthStencilTexture(m_DepthTexture, faceView->GetSubresources(), true, 0.f, depthFormatInfo.hasStencil, 0);
+        commandList->clearTextureFloat(m_ColorTexture, faceView->GetSubresources(), nvrhi::Color(0.f));
+
+        // Use the probe shadow map for the sun while preparing the light constants
+        std::shared_ptr<IShadowMap> sunShadowMap = inputs.sunLight->shadowMap;
+        inputs.sunLight->shadowMap = m_ShadowMap;
+
+        ForwardShadingPass::Context forwardContext;
+        std::vector<std::shared_ptr<LightProbe>> lightProbes;
+        m_ForwardPass->PrepareLights(forwardContext, commandList, *inputs.lights, inputs.ambientTop, inputs.ambientBottom, lightProbes);
+
+        inputs.sunLight->shadowMap = sunShadowMap;
+
+        RenderCompositeView(commandList,
+            faceView, nullptr,
+            *m_Framebuffer,
+            inputs.rootNode,
+            *inputs.opaqueDrawStrategy,
+            *m_ForwardPass,
+            forwardContext,
+            "ForwardOpaque");
+
+        if (m_SkyPass)
+        {
+            inputs.skyTables->Update(commandList, *inputs.sunLight, inputs.skyParams);
+            m_SkyPass->Render(commandList, *faceView, *inputs.skyTables);
+        }
+        else
+        {
+            m_FallbackSkyPass->Render(commandList, *faceView, *inputs.sunLight, inputs.skyParams);
+        }
+
+        RenderCompositeView(commandList,
+            faceView, nullptr,
+            *m_Framebuffer,
+            inputs.rootNode,
+            *inputs.transparentDrawStrategy,
+            *m_ForwardPass,
+            forwardContext,
+            "ForwardTransparent");
+        break;
+    }
+
+    case StepType::Mips:
+        m_LightProbePass->GenerateCubemapMips(commandList, m_ColorTexture, 0, 0, c_EnvironmentMapMipLevels - 1);
+        break;
+
+    case StepType::Diffuse:
+        // The probe maps are overwritten over the next few frames, don't sample them in between
+        probe.enabled = false;
+        m_LightProbePass->RenderDiffuseMap(commandList, m_ColorTexture, nvrhi::AllSubresources, probe.diffuseMap, probe.diffuseArrayIndex * 6, 0);
+        break;
+
+    case StepType::Specular: {
+        const uint32_t specularMapMipLevels = probe.specularMap->getDesc().mipLevels;
+        const float roughness = powf(float(index) / float(std::max(specularMapMipLevels - 1, 1u)), 2.0f);
+        m_LightProbePass->RenderSpecularMap(commandList, roughness, m_ColorTexture, nvrhi::AllSubresources, probe.specularMap, probe.specularArrayIndex * 6, index);
+        break;
+    }
+
+    case StepType::Finalize: {
+        if (!m_EnvironmentBrdfReady)
+        {
+            m_LightProbePass->RenderEnvironmentBrdfTexture(commandList);
+            m_EnvironmentBrdfReady = true;
+        }
+
+        probe.environmentBrdf = m_LightProbePass->GetEnvironmentBrdfTexture();
+        box3 bounds = box3(job.position, job.position).grow(10.f);
+        probe.bounds = frustum::fromBox(bounds);
+        probe.enabled = true;
+
+        if (!job.loadFromCache)
+            SaveToCache(commandList, job);
+        break;
+    }
+
+    default:
+        break;
+    }
+}
+
+bool LightProbeBaker::LoadFromCache(nvrhi::ICommandList* commandList, const Job& job)
+{
+    std::ifstream file(job.cacheFile, std::ios::binary);
+    if (!file.is_open())
+        return false;
+
+    const LightProbe& probe = *job.probe;
+    const nvrhi::TextureDesc& diffuseDesc = probe.diffuseMap->getDesc();
+    const nvrhi::TextureDesc& specularDesc = probe.specularMap->getDesc();
+
+    LightProbeCacheHeader header{};
+    file.read(reinterpret_cast<char*>(&header), sizeof(header));
+
+    if (!file.good()
+        || header.magic != c_CacheFileMagic
+        || header.version != c_CacheFileVersion
+        || header.format != uint32_t(specularDesc.format)
+        || diffuseDesc.format != specularDesc.format
+        || header.diffuseSize != diffuseDesc.width
+        || header.diffuseMipLevels != diffuseDesc.mipLevels
+        || header.specularSize != specularDesc.width
+        || header.specularMipLevels != specularDesc.mipLevels)
+        return false;
+
+    const uint32_t bytesPerPixel = nvrhi::getFormatInfo(specularDesc.format).bytesPerBlock;
+
+    // Read the whole file before uploading, so that a truncated file doesn't leave the probe half-updated
+    std::vector<LightProbeCacheImage> images = GetCacheImages(probe);
+    std::vector<std::vector<uint8_t>> imageData(images.size());
+    for (size_t i = 0; i < images.size(); i++)
+    {
+        imageData[i].resize(size_t(images[i].width) * images[i].height * bytesPerPixel);
+        file.read(reinterpret_cast<char*>(imageData[i].data()), std::streamsize(imageData[i].size()));
+        if (!file.good())
+            return false;
+    }
+
+    job.probe->enabled = false;
+
+    for (size_t i = 0; i < images.size(); i++)
+    {
+        const LightProbeCacheImage& image = images[i];
+        commandList->writeTexture(image.texture, image.arraySlice, image.mipLevel, imageData[i].data(), size_t(image.width) * bytesPerPixel);
+    }
+
+    return true;
+}
+
+void LightProbeBaker::SaveToCache(nvrhi::ICommandList* commandList, const Job& job)
+{
+    if (m_CacheDirectory.empty() || !m_ReadbackQueue)
+        return;
+
+    const LightProbe& probe = *job.probe;
+    const nvrhi::TextureDesc& diffuseDesc = probe.diffuseMap->getDesc();
+    const nvrhi::TextureDesc& specularDesc = probe.specularMap->getDesc();
+
+    if (diffuseDesc.format != specularDesc.format)
+        return;
+
+    // The images arrive in later frames; the file is written when the last one is in
+    struct PendingCacheFile
+    {
+        std::filesystem::path fileName;
+        LightProbeCacheHeader header{};
+        std::vector<std::vector<uint8_t>> imageData;
+        size_t remainingImages = 0;
+    };
+
+    std::vector<LightProbeCacheImage> images = GetCacheImages(probe);
+    const uint32_t bytesPerPixel = nvrhi::getFormatInfo(specularDesc.format).bytesPerBlock;
+
+    auto pending = std::make_shared<PendingCacheFile>();
+    pending->fileName = job.cacheFile;
+    pending->header.magic = c_CacheFileMagic;
+    pending->header.version = c_CacheFileVersion;
+    pending->header.format = uint32_t(specularDesc.format);
+    pending->header.diffuseSize = diffuseDesc.width;
+    pending->header.diffuseMipLevels = diffuseDesc.mipLevels;
+    pending->header.specularSize = specularDesc.width;
+    pending->header.specularMipLevels = specularDesc.mipLevels;
+    pending->imageData.resize(images.size());
+    pending->remainingImages = images.size();
+
+    for (size_t imageIndex = 0; imageIndex < images.size(); imageIndex++)
+    {
+        const LightProbeCacheImage& image = images[imageIndex];
+
+        nvrhi::TextureSlice slice;
+        slice.arraySlice = image.arraySlice;
+        slice.mipLevel = image.mipLevel;
+
+        m_ReadbackQueue->ReadTexture(commandList, image.texture, slice,
+            [pending, imageIndex, bytesPerPixel](const void* data, size_t rowPitch, uint32_t width, uint32_t height, nvrhi::Format)
+            {
+                // Store the rows tightly packed
+                const size_t packedRowPitch = size_t(width) * bytesPerPixel;
+                std::vector<uint8_t>& imageData = pending->imageData[imageIndex];
+                imageData.resize(packedRowPitch * height);
+                for (uint32_t row = 0; row < height; row++)
+                    memcpy(imageData.data() + packedRowPitch * row, static_cast<const uint8_t*>(data) + rowPitch * row, packedRowPitch);
+
+                if (--pending->remainingImages != 0)
+                    return;
+
+                std::error_code error;
+                std::filesystem::create_directories(pending->fileName.parent_path(), error);
+
+                std::ofstream file(pending->fileName, std::ios::binary);
+                file.write(reinterpret_cast<const char*>(&pending->header), sizeof(pending->header));
+                for (const auto& image : pending->imageData)
+                    file.write(reinterpret_cast<const char*>(image.data()), std::streamsize(image.size()));
+
+                if (file.good())
+                    log::info("Saved light probe cache file '%s'", pending->fileName.generic_string().c_str());
+                else
+                    log::warning("Cannot write light probe cache file '%s'", pending->fileName.generic_string().c_str());
+            });
+    }
+}
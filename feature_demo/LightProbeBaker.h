@@ -0,0 +1,178 @@
+/*
+* Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <donut/core/math/math.h>
+#include <donut/engine/View.h>
+#include <donut/render/SkyPass.h>
+#include <nvrhi/nvrhi.h>
+#include <deque>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace donut::engine
+{
+    class CommonRenderPasses;
+    class DirectionalLight;
+    class FramebufferFactory;
+    class Light;
+    class SceneGraphNode;
+    class ShaderFactory;
+    struct LightProbe;
+}
+
+namespace donut::render
+{
+    class CascadedShadowMap;
+    class DepthPass;
+    class ForwardShadingPass;
+    class IDrawStrategy;
+    class LightProbeProcessingPass;
+}
+
+class CachedSkyPass;
+class ReadbackQueue;
+class SkyLookupTables;
+
+// Bakes light probes incrementally, a few steps per frame.
+//
+// Every probe bake is split into steps: the shadow map, each environment cube face, the mip chain,
+// the diffuse map and each specular mip. Update records as many steps as fit into a GPU time budget,
+// using per-step cost estimates that are refined with timer queries. The render targets, shadow map
+// and passes are created once and reused for all probes.
+//
+// Baked probes are written into a cache directory and loaded from there on the next bake request
+// with the same cache key and position, skipping the rendering entirely.
+class LightProbeBaker
+{
+public:
+    // Scene state that the probes capture; must stay valid during the Update call
+    struct SceneInputs
+    {
+        std::shared_ptr<donut::engine::SceneGraphNode> rootNode;
+        const std::vector<std::shared_ptr<donut::engine::Light>>* lights = nullptr;
+        donut::engine::DirectionalLight* sunLight = nullptr;
+        donut::render::IDrawStrategy* opaqueDrawStrategy = nullptr;
+        donut::render::IDrawStrategy* transparentDrawStrategy = nullptr;
+        donut::render::SkyParameters skyParams;
+        // Brought up to date with skyParams before the sky is drawn into the faces.
+        // Null on D3D11, where donut's SkyPass draws the sky from skyParams instead.
+        SkyLookupTables* skyTables = nullptr;
+        donut::math::float3 ambientTop = 0.f;
+        donut::math::float3 ambientBottom = 0.f;
+        float csmExponent = 4.f;
+    };
+
+    LightProbeBaker(
+        nvrhi::IDevice* device,
+        std::shared_ptr<donut::engine::ShaderFactory> shaderFactory,
+        std::shared_ptr<donut::engine::CommonRenderPasses> commonPasses,
+        ReadbackQueue* readbackQueue,
+        nvrhi::Format shadowMapFormat,
+        const std::filesystem::path& cacheDirectory);
+
+    // Adds a probe to the queue. The cache key should describe everything that affects the probe
+    // contents besides the position, such as the scene and the lighting setup.
+    void Enqueue(std::shared_ptr<donut::engine::LightProbe> probe, const donut::math::float3& position, const std::string& cacheKey);
+
+    // Drops all queued bakes and releases the cached bindings, e.g. when the scene is unloaded.
+    void Reset();
+
+    // Records the next bake steps into the command list, spending about timeBudgetMs of GPU time.
+    // At least one step is recorded when there is work.
+    void Update(nvrhi::ICommandList* commandList, const SceneInputs& inputs, float timeBudgetMs);
+
+    [[nodiscard]] bool IsBusy() const { return !m_Jobs.empty(); }
+    [[nodiscard]] size_t GetQueueLength() const { return m_Jobs.size(); }
+
+    // Progress of the current bake, 0 to 1
+    [[nodiscard]] float GetProgress() const;
+    [[nodiscard]] std::string GetCurrentProbeName() const;
+
+private:
+    enum class StepType
+    {
+        LoadFromCache,
+        Shadows,
+        Face,
+        Mips,
+        Diffuse,
+        Specular,
+        Finalize,
+        Count
+    };
+
+    struct Job
+    {
+        std::shared_ptr<donut::engine::LightProbe> probe;
+        donut::math::float3 position = 0.f;
+        std::filesystem::path cacheFile;
+        uint32_t nextStep = 0;
+        uint32_t numSteps = 0;
+        bool loadFromCache = false;
+    };
+
+    struct PendingTimer
+    {
+        nvrhi::TimerQueryHandle query;
+        StepType type;
+    };
+
+    nvrhi::DeviceHandle m_Device;
+    std::shared_ptr<donut::engine::ShaderFactory> m_ShaderFactory;
+    std::shared_ptr<donut::engine::CommonRenderPasses> m_CommonPasses;
+    ReadbackQueue* m_ReadbackQueue;
+    std::filesystem::path m_CacheDirectory;
+
+    static constexpr uint32_t c_EnvironmentMapSize = 1024;
+    static constexpr uint32_t c_EnvironmentMapMipLevels = 8;
+
+    nvrhi::TextureHandle m_ColorTexture;
+    nvrhi::TextureHandle m_DepthTexture;
+    std::shared_ptr<donut::engine::FramebufferFactory> m_Framebuffer;
+    donut::engine::CubemapView m_View;
+    std::shared_ptr<CachedSkyPass> m_SkyPass;
+    std::shared_ptr<donut::render::SkyPass> m_FallbackSkyPass;
+    std::shared_ptr<donut::render::ForwardShadingPass> m_ForwardPass;
+    std::shared_ptr<donut::render::LightProbeProcessingPass> m_LightProbePass;
+    std::shared_ptr<donut::render::CascadedShadowMap> m_ShadowMap;
+    std::shared_ptr<donut::engine::FramebufferFactory> m_ShadowFramebuffer;
+    std::shared_ptr<donut::render::DepthPass> m_ShadowDepthPass;
+    bool m_EnvironmentBrdfReady = false;
+
+    std::deque<Job> m_Jobs;
+
+    float m_StepCostMs[size_t(StepType::Count)];
+    std::vector<PendingTimer> m_PendingTimers;
+    std::vector<nvrhi::TimerQueryHandle> m_FreeTimers;
+
+    void StartJob(Job& job);
+    void GetStep(const Job& job, uint32_t stepIndex, StepType& type, uint32_t& index) const;
+    void ExecuteStep(nvrhi::ICommandList* commandList, const SceneInputs& inputs, Job& job, StepType type, uint32_t index);
+    void PollTimers();
+
+    bool LoadFromCache(nvrhi::ICommandList* commandList, const Job& job);
+    void SaveToCache(nvrhi::ICommandList* commandList, const Job& job);
+};
@@ -0,0 +1,461 @@
+/*
+* Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#include "OcclusionCulling.h"
+
+#include <donut/engine/SceneGraph.h>
+#include <donut/engine/ShaderFactory.h>
+#include <donut/engine/View.h>
+#include <donut/render/DrawStrategy.h>
+#include <donut/render/GeometryPasses.h>
+#include <nvrhi/utils.h>
+#include <ReadbackQueue.h>
+#include <SinglePassMipGen.h>
+
+#include <algorithm>
+
+using namespace donut;
+using namespace donut::math;
+using namespace donut::engine;
+using namespace donut::render;
+
+#include "occlusion_culling_cb.h"
+
+static_assert(sizeof(nvrhi::DrawIndexedIndirectArguments) == OCCLUSION_ARGS_STRIDE, "The shader writes the instance count at a fixed offset");
+
+static uint32_t PreviousPowerOf2(uint32_t value)
+{
+    uint32_t result = 1;
+    while (result * 2 <= value)
+        result *= 2;
+    return result;
+}
+
+OcclusionCullingPass::OcclusionCullingPass(nvrhi::IDevice* device,
+    const std::shared_ptr<ShaderFactory>& shaderFactory,
+    SinglePassMipGen* mipGen,
+    ReadbackQueue* readbackQueue)
+    : m_Device(device)
+    , m_MipGen(mipGen)
+    , m_ReadbackQueue(readbackQueue)
+    , m_BindingCache(device)
+    , m_Feedback(std::make_shared<Feedback>())
+{
+    nvrhi::BindingLayoutDesc layoutDesc;
+    layoutDesc.visibility = nvrhi::ShaderType::Compute;
+    layoutDesc.bindings = {
+        nvrhi::BindingLayoutItem::VolatileConstantBuffer(0),
+        nvrhi::BindingLayoutItem::Texture_SRV(0),
+        nvrhi::BindingLayoutItem::Texture_UAV(0)
+    };
+    m_HiZBindingLayout = m_Device->createBindingLayout(layoutDesc);
+
+    layoutDesc.bindings = {
+        nvrhi::BindingLayoutItem::VolatileConstantBuffer(0),
+        nvrhi::BindingLayoutItem::StructuredBuffer_SRV(1),
+        nvrhi::BindingLayoutItem::Texture_SRV(2),
+        nvrhi::BindingLayoutItem::RawBuffer_UAV(1),
+        nvrhi::BindingLayoutItem::StructuredBuffer_UAV(2),
+        nvrhi::BindingLayoutItem::StructuredBuffer_UAV(3)
+    };
+    m_CullBindingLayout = m_Device->createBindingLayout(layoutDesc);
+
+    nvrhi::ComputePipelineDesc pipelineDesc;
+    pipelineDesc.bindingLayouts = { m_HiZBindingLayout };
+    for (int depthArray = 0; depthArray < 2; depthArray++)
+    {
+        std::vector<ShaderMacro> macros = { ShaderMacro("DEPTH_ARRAY", depthArray ? "1" : "0") };
+        pipelineDesc.CS = shaderFactory->CreateShader("app/occlusion_culling.hlsl", "hiz_init_cs", &macros, nvrhi::ShaderType::Compute);
+        m_HiZPipelines[depthArray] = m_Device->createComputePipeline(pipelineDesc);
+    }
+
+    pipelineDesc.bindingLayouts = { m_CullBindingLayout };
+    pipelineDesc.CS = shaderFactory->CreateShader("app/occlusion_culling.hlsl", "cull_cs", nullptr, nvrhi::ShaderType::Compute);
+    m_CullPipeline = m_Device->createComputePipeline(pipelineDesc);
+
+    m_ConstantBuffer = m_Device->createBuffer(nvrhi::utils::CreateVolatileConstantBufferDesc(
+        sizeof(OcclusionCullingConstants), "OcclusionCullingConstants", engine::c_MaxRenderPassConstantBufferVersions));
+
+    nvrhi::BufferDesc counterDesc;
+    counterDesc.byteSize = sizeof(uint32_t) * OCCLUSION_NUM_COUNTERS;
+    counterDesc.structStride = sizeof(uint32_t);
+    counterDesc.canHaveUAVs = true;
+    counterDesc.initialState = nvrhi::ResourceStates::UnorderedAccess;
+    counterDesc.keepInitialState = true;
+    counterDesc.debugName = "OcclusionCullingCounters";
+    m_Counters = m_Device->createBuffer(counterDesc);
+}
+
+OcclusionCullingPass::~OcclusionCullingPass() = default;
+
+void OcclusionCullingPass::CreateHiZ(uint32_t width, uint32_t height)
+{
+    const uint32_t hizWidth = PreviousPowerOf2(width);
+    const uint32_t hizHeight = PreviousPowerOf2(height);
+
+    if (m_HiZ && m_HiZ->getDesc().width == hizWidth && m_HiZ->getDesc().height == hizHeight)
+        return;
+
+    uint32_t mipLevels = 1;
+    while ((std::max(hizWidth, hizHeight) >> mipLevels) != 0)
+        ++mipLevels;
+
+    nvrhi::TextureDesc desc;
+    desc.width = hizWidth;
+    desc.height = hizHeight;
+    desc.mipLevels = mipLevels;
+    desc.format = nvrhi::Format::R32_FLOAT;
+    desc.isUAV = true;
+    desc.initialState = nvrhi::ResourceStates::ShaderResource;
+    desc.keepInitialState = true;
+    desc.debugName = "OcclusionHiZ";
+    m_HiZ = m_Device->createTexture(desc);
+
+    m_BindingCache.Clear();
+}
+
+void OcclusionCullingPass::CreateItemBuffers(uint32_t numItems)
+{
+    if (m_ItemBuffer && m_ItemBuffer->getDesc().byteSize >= numItems * sizeof(OcclusionCullingItem))
+        return;
+
+    // Leave room for the scene to grow without reallocating every frame
+    const uint32_t capacity = std::max(numItems + numItems / 2, 256u);
+
+    nvrhi::BufferDesc bufferDesc;
+    bufferDesc.byteSize = capacity * sizeof(OcclusionCullingItem);
+    bufferDesc.structStride = sizeof(OcclusionCullingItem);
+    bufferDesc.initialState = nvrhi::ResourceStates::ShaderResource;
+    bufferDesc.keepInitialState = true;
+    bufferDesc.debugName = "OcclusionCullingItems";
+    m_ItemBuffer = m_Device->createBuffer(bufferDesc);
+
+    nvrhi::BufferDesc argsDesc;
+    argsDesc.byteSize = capacity * sizeof(nvrhi::DrawIndexedIndirectArguments);
+    argsDesc.isDrawIndirectArgs = true;
+    argsDesc.canHaveUAVs = true;
+    argsDesc.canHaveRawViews = true;
+    argsDesc.initialState = nvrhi::ResourceStates::IndirectArgument;
+    argsDesc.keepInitialState = true;
+    argsDesc.debugName = "OcclusionCullingDrawArgs";
+    m_DrawArgs = m_Device->createBuffer(argsDesc);
+
+    m_BindingCache.Clear();
+}
+
+void OcclusionCullingPass::CreateVisibilityMask(uint32_t numSlots)
+{
+    const uint32_t numWords = (numSlots + 31) / 32;
+    if (m_VisibilityMask && m_VisibilityMask->getDesc().byteSize >= numWords * sizeof(uint32_t))
+        return;
+
+    nvrhi::BufferDesc bufferDesc;
+    bufferDesc.byteSize = std::max(numWords + numWords / 2, 64u) * sizeof(uint32_t);
+    bufferDesc.structStride = sizeof(uint32_t);
+    bufferDesc.canHaveUAVs = true;
+    bufferDesc.initialState = nvrhi::ResourceStates::UnorderedAccess;
+    bufferDesc.keepInitialState = true;
+    bufferDesc.debugName = "OcclusionVisibilityMask";
+    m_VisibilityMask = m_Device->createBuffer(bufferDesc);
+
+    m_BindingCache.Clear();
+}
+
+void OcclusionCullingPass::Reset()
+{
+    m_Slots.clear();
+
+    // Results that are still in flight belong to the old item identities
+    ++m_Feedback->generation;
+    m_Feedback->visibilityMask.clear();
+    m_Feedback->stats = Stats();
+}
+
+void OcclusionCullingPass::DrawItems(nvrhi::ICommandList* commandList,
+    const IView& view,
+    const IView* viewPrev,
+    nvrhi::IFramebuffer* framebuffer,
+    IGeometryPass& pass,
+    GeometryPassContext& passContext,
+    bool phase2)
+{
+    pass.SetupView(passContext, commandList, &view, viewPrev);
+
+    const Material* lastMaterial = nullptr;
+    const BufferGroup* lastBuffers = nullptr;
+    nvrhi::RasterCullMode lastCullMode = nvrhi::RasterCullMode::Back;
+    bool drawMaterial = true;
+    bool stateValid = false;
+
+    nvrhi::GraphicsState graphicsState;
+    graphicsState.framebuffer = framebuffer;
+    graphicsState.viewport = view.GetViewportState();
+    graphicsState.shadingRateState = view.GetVariableRateShadingState();
+    if (phase2)
+        graphicsState.indirectParams = m_DrawArgs;
+
+    for (size_t index = 0; index < m_Items.size(); index++)
+    {
+        const DrawItem& item = m_Items[index];
+        OcclusionCullingItem& itemData = m_ItemData[index];
+
+        // Phase 2 skips what phase 1 has drawn or the pass has rejected, the GPU decides about the rest
+        if (phase2 && (itemData.flags & (OCCLUSION_ITEM_DRAWABLE | OCCLUSION_ITEM_PHASE1)) != OCCLUSION_ITEM_DRAWABLE)
+            continue;
+
+        if (item.buffers != lastBuffers)
+        {
+            pass.SetupInputBuffers(passContext, item.buffers, graphicsState);
+            lastBuffers = item.buffers;
+            stateValid = false;
+        }
+
+        if (item.material != lastMaterial || item.cullMode != lastCullMode)
+        {
+            drawMaterial = pass.SetupMaterial(passContext, item.material, item.cullMode, graphicsState);
+            lastMaterial = item.material;
+            lastCullMode = item.cullMode;
+            stateValid = false;
+        }
+
+        if (!drawMaterial)
+            continue;
+
+        if (!stateValid)
+        {
+            commandList->setGraphicsState(graphicsState);
+            stateValid = true;
+        }
+
+        nvrhi::DrawArguments args;
+        args.vertexCount = item.geometry->numIndices;
+        args.instanceCount = 1;
+        args.startVertexLocation = item.mesh->vertexOffset + item.geometry->vertexOffsetInMesh;
+        args.startIndexLocation = item.mesh->indexOffset + item.geometry->indexOffsetInMesh;
+        args.startInstanceLocation = item.instance->GetInstanceIndex();
+
+        // The pass may move the offsets into its push constants, so the indirect arguments are
+        // only known after this call, which is why phase 1 visits the items it doesn't draw as well
+        pass.SetPushConstants(passContext, commandList, graphicsState, args);
+
+        if (phase2)
+        {
+            commandList->drawIndexedIndirect(uint32_t(index * sizeof(nvrhi::DrawIndexedIndirectArguments)));
+            continue;
+        }
+
+        itemData.flags |= OCCLUSION_ITEM_DRAWABLE;
+
+        nvrhi::DrawIndexedIndirectArguments& indirectArgs = m_ItemArgs[index];
+        indirectArgs.indexCount = args.vertexCount;
+        indirectArgs.instanceCount = 0; // Written by cull_cs
+        indirectArgs.startIndexLocation = args.startIndexLocation;
+        indirectArgs.baseVertexLocation = int32_t(args.startVertexLocation);
+        indirectArgs.startInstanceLocation = args.startInstanceLocation;
+
+        if (itemData.flags & OCCLUSION_ITEM_PHASE1)
+            commandList->drawIndexed(args);
+    }
+}
+
+void OcclusionCullingPass::Render(nvrhi::ICommandList* commandList,
+    const IView& view,
+    const IView* viewPrev,
+    nvrhi::IFramebuffer* framebuffer,
+    nvrhi::ITexture* depthTexture,
+    uint32_t depthArraySlice,
+    const std::shared_ptr<SceneGraphNode>& rootNode,
+    IDrawStrategy& drawStrategy,
+    IGeometryPass& pass,
+    GeometryPassContext& passContext,
+    const char* passEvent)
+{
+    commandList->beginMarker(passEvent);
+
+    m_Items.clear();
+    drawStrategy.PrepareForView(rootNode, view);
+    while (const DrawItem* item = drawStrategy.GetNextItem())
+    {
+        if (item->material)
+            m_Items.push_back(*item);
+    }
+
+    const uint32_t numItems = uint32_t(m_Items.size());
+    m_ItemData.resize(numItems);
+    m_ItemArgs.assign(numItems, nvrhi::DrawIndexedIndirectArguments());
+
+    // Phase 1 takes the items that were visible in the latest results from the GPU
+    const std::vector<uint32_t>& visibilityMask = m_Feedback->visibilityMask;
+
+    for (uint32_t index = 0; index < numItems; index++)
+    {
+        const DrawItem& item = m_Items[index];
+        const uint32_t slot = m_Slots.try_emplace(ItemKey{ item.instance, item.geometry }, uint32_t(m_Slots.size())).first->second;
+        const box3 bounds = item.geometry->objectSpaceBounds * item.instance->GetNode()->GetLocalToWorldTransformFloat();
+
+        OcclusionCullingItem& itemData = m_ItemData[index];
+        itemData.boundsMin = bounds.m_mins;
+        itemData.boundsMax = bounds.m_maxs;
+        itemData.slot = slot;
+        itemData.flags = bounds.isempty() ? OCCLUSION_ITEM_NO_TEST : 0;
+
+        if (slot / 32 < visibilityMask.size() && (visibilityMask[slot / 32] & (1u << (slot % 32))) != 0)
+            itemData.flags |= OCCLUSION_ITEM_PHASE1;
+    }
+
+    CreateItemBuffers(numItems);
+    CreateVisibilityMask(uint32_t(m_Slots.size()));
+
+    commandList->beginMarker("Phase 1");
+    DrawItems(commandList, view, viewPrev, framebuffer, pass, passContext, false);
+    commandList->endMarker();
+
+    uint32_t numDrawnPhase1 = 0;
+    for (const OcclusionCullingItem& itemData : m_ItemData)
+    {
+        if ((itemData.flags & (OCCLUSION_ITEM_DRAWABLE | OCCLUSION_ITEM_PHASE1)) == (OCCLUSION_ITEM_DRAWABLE | OCCLUSION_ITEM_PHASE1))
+            ++numDrawnPhase1;
+    }
+
+    // Hi-Z pyramid of the phase 1 depth
+
+    const nvrhi::TextureDesc& depthDesc = depthTexture->getDesc();
+    CreateHiZ(depthDesc.width, depthDesc.height);
+    const nvrhi::TextureDesc& hizDesc = m_HiZ->getDesc();
+    const nvrhi::Viewport& viewport = view.GetViewportState().viewports[0];
+    const bool depthArray = depthDesc.dimension == nvrhi::TextureDimension::Texture2DArray;
+
+    OcclusionCullingConstants constants = {};
+    constants.matWorldToClip = view.GetViewProjectionMatrix();
+    constants.viewportOrigin = float2(viewport.minX, viewport.minY);
+    constants.viewportSize = float2(viewport.width(), viewport.height());
+    constants.depthSize = uint2(depthDesc.width, depthDesc.height);
+    constants.hizSize = uint2(hizDesc.width, hizDesc.height);
+    constants.depthToHiZ = float2(constants.hizSize) / float2(constants.depthSize);
+    constants.hizMipLevels = hizDesc.mipLevels;
+    constants.numItems = numItems;
+    constants.depthArraySlice = depthArraySlice;
+    constants.reverseDepth = view.IsReverseDepth() ? 1 : 0;
+
+    commandList->writeBuffer(m_ConstantBuffer, &constants, sizeof(constants));
+
+    commandList->beginMarker("Hi-Z");
+
+    nvrhi::BindingSetDesc hizBindings;
+    hizBindings.bindings = {
+        nvrhi::BindingSetItem::ConstantBuffer(0, m_ConstantBuffer),
+        nvrhi::BindingSetItem::Texture_SRV(0, depthTexture, nvrhi::Format::UNKNOWN, nvrhi::TextureSubresourceSet(0, 1, 0, depthDesc.arraySize)),
+        nvrhi::BindingSetItem::Texture_UAV(0, m_HiZ, nvrhi::Format::UNKNOWN, nvrhi::TextureSubresourceSet(0, 1, 0, 1))
+    };
+
+    nvrhi::ComputeState hizState;
+    hizState.pipeline = m_HiZPipelines[depthArray ? 1 : 0];
+    hizState.bindings = { m_BindingCache.GetOrCreateBindingSet(hizBindings, m_HiZBindingLayout) };
+    commandList->setComputeState(hizState);
+    commandList->dispatch(
+        (hizDesc.width + OCCLUSION_HIZ_GROUP_SIZE - 1) / OCCLUSION_HIZ_GROUP_SIZE,
+        (hizDesc.height + OCCLUSION_HIZ_GROUP_SIZE - 1) / OCCLUSION_HIZ_GROUP_SIZE, 1);
+
+    // The farthest depth is the smallest one with reverse depth
+    const SinglePassMipGen::Reduction reduction = view.IsReverseDepth() ? SinglePassMipGen::Reduction::Min : SinglePassMipGen::Reduction::Max;
+    for (uint32_t mip = 1; mip < hizDesc.mipLevels; )
+    {
+        const uint32_t numLevels = std::min(hizDesc.mipLevels - mip,
+            SinglePassMipGen::GetMaxLevels(std::max(hizDesc.width >> mip, 1u), std::max(hizDesc.height >> mip, 1u)));
+        m_MipGen->Dispatch(commandList, m_HiZ, mip - 1, m_HiZ, mip, numLevels, reduction);
+        mip += numLevels;
+    }
+
+    commandList->endMarker();
+
+    // Test all items, enable the phase 2 draws and record the visible set
+
+    commandList->beginMarker("Cull");
+
+    if (numItems > 0)
+    {
+        commandList->writeBuffer(m_ItemBuffer, m_ItemData.data(), numItems * sizeof(OcclusionCullingItem));
+        commandList->writeBuffer(m_DrawArgs, m_ItemArgs.data(), numItems * sizeof(nvrhi::DrawIndexedIndirectArguments));
+    }
+    commandList->clearBufferUInt(m_VisibilityMask, 0);
+    commandList->clearBufferUInt(m_Counters, 0);
+
+    if (numItems > 0)
+    {
+        nvrhi::BindingSetDesc cullBindings;
+        cullBindings.bindings = {
+            nvrhi::BindingSetItem::ConstantBuffer(0, m_ConstantBuffer),
+            nvrhi::BindingSetItem::StructuredBuffer_SRV(1, m_ItemBuffer),
+            nvrhi::BindingSetItem::Texture_SRV(2, m_HiZ, nvrhi::Format::UNKNOWN, nvrhi::TextureSubresourceSet(0, hizDesc.mipLevels, 0, 1)),
+            nvrhi::BindingSetItem::RawBuffer_UAV(1, m_DrawArgs),
+            nvrhi::BindingSetItem::StructuredBuffer_UAV(2, m_VisibilityMask),
+            nvrhi::BindingSetItem::StructuredBuffer_UAV(3, m_Counters)
+        };
+
+        nvrhi::ComputeState cullState;
+        cullState.pipeline = m_CullPipeline;
+        cullState.bindings = { m_BindingCache.GetOrCreateBindingSet(cullBindings, m_CullBindingLayout) };
+        commandList->setComputeState(cullState);
+        commandList->dispatch((numItems + OCCLUSION_CULLING_GROUP_SIZE - 1) / OCCLUSION_CULLING_GROUP_SIZE, 1, 1);
+    }
+
+    // Results from an older scene or after a reset are dropped
+    const std::weak_ptr<Feedback> feedback = m_Feedback;
+    const uint32_t generation = m_Feedback->generation;
+
+    const uint64_t maskSize = ((m_Slots.size() + 31) / 32) * sizeof(uint32_t);
+    if (maskSize > 0)
+    {
+        m_ReadbackQueue->ReadBuffer(commandList, m_VisibilityMask, 0, maskSize,
+            [feedback, generation](const void* data, size_t size)
+            {
+                std::shared_ptr<Feedback> target = feedback.lock();
+                if (!target || target->generation != generation)
+                    return;
+
+                const uint32_t* words = static_cast<const uint32_t*>(data);
+                target->visibilityMask.assign(words, words + size / sizeof(uint32_t));
+            });
+    }
+
+    m_ReadbackQueue->ReadBuffer(commandList, m_Counters, 0, sizeof(uint32_t) * OCCLUSION_NUM_COUNTERS,
+        [feedback, generation, numDrawnPhase1](const void* data, size_t)
+        {
+            std::shared_ptr<Feedback> target = feedback.lock();
+            if (!target || target->generation != generation)
+                return;
+
+            const uint32_t* counters = static_cast<const uint32_t*>(data);
+            target->stats.numItems = counters[OCCLUSION_COUNTER_TESTED];
+            target->stats.numCulled = counters[OCCLUSION_COUNTER_CULLED];
+            target->stats.numDrawnPhase2 = counters[OCCLUSION_COUNTER_PHASE2];
+            target->stats.numDrawnPhase1 = numDrawnPhase1;
+        });
+
+    commandList->endMarker();
+
+    commandList->beginMarker("Phase 2");
+    DrawItems(commandList, view, viewPrev, framebuffer, pass, passContext, true);
+    commandList->endMarker();
+
+    commandList->endMarker();
+}
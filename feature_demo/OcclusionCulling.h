@@ -0,0 +1,163 @@
+/*
+* Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <donut/engine/BindingCache.h>
+#include <donut/engine/SceneTypes.h>
+#include <nvrhi/nvrhi.h>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace donut::engine
+{
+    class IView;
+    class MeshInstance;
+    class SceneGraphNode;
+    class ShaderFactory;
+}
+
+namespace donut::render
+{
+    class GeometryPassContext;
+    class IDrawStrategy;
+    class IGeometryPass;
+}
+
+class ReadbackQueue;
+class SinglePassMipGen;
+struct OcclusionCullingItem;
+
+// Two-phase occlusion culling for the opaque geometry passes, with a hierarchical depth (Hi-Z) pyramid.
+//
+// Phase 1 draws the items that were visible in the latest results the GPU has returned, and a
+// farthest-depth pyramid is built from the resulting depth buffer. A compute pass then tests the
+// bounds of all items against the pyramid, records the visible ones for the following frames, and
+// enables the indirect draws of phase 2 for the visible items that phase 1 skipped. Nothing visible
+// is missed when the earlier results are stale, it is only drawn later and occludes less.
+//
+// The results reach the CPU through the readback queue, so phase 1 is selected on the CPU a few
+// frames behind the GPU, and only phase 2 uses indirect draws. Every item gets its own draw: the
+// geometry passes address the instances through the draw arguments, which rules out compacting
+// instanced batches on the GPU.
+//
+// One object keeps the visibility of one planar view, the main view and every shadow cascade need
+// their own. Uses the single-pass mip generator, which limits it to DX12 and Vulkan.
+class OcclusionCullingPass
+{
+public:
+    struct Stats
+    {
+        uint32_t numItems = 0;
+        uint32_t numDrawnPhase1 = 0;
+        uint32_t numDrawnPhase2 = 0;
+        uint32_t numCulled = 0;
+    };
+
+    OcclusionCullingPass(nvrhi::IDevice* device,
+        const std::shared_ptr<donut::engine::ShaderFactory>& shaderFactory,
+        SinglePassMipGen* mipGen,
+        ReadbackQueue* readbackQueue);
+    ~OcclusionCullingPass();
+
+    // Draws the items of the draw strategy in both phases. The view must be a single planar view that
+    // renders into depthTexture, or into depthArraySlice of it for an array, and the depth must be cleared.
+    void Render(nvrhi::ICommandList* commandList,
+        const donut::engine::IView& view,
+        const donut::engine::IView* viewPrev,
+        nvrhi::IFramebuffer* framebuffer,
+        nvrhi::ITexture* depthTexture,
+        uint32_t depthArraySlice,
+        const std::shared_ptr<donut::engine::SceneGraphNode>& rootNode,
+        donut::render::IDrawStrategy& drawStrategy,
+        donut::render::IGeometryPass& pass,
+        donut::render::GeometryPassContext& passContext,
+        const char* passEvent);
+
+    // Forgets the visible set and the item identities, call when the scene changes
+    void Reset();
+
+    // Counters of the latest frame the GPU has returned
+    [[nodiscard]] const Stats& GetStats() const { return m_Feedback->stats; }
+
+    void ResetBindingCache() { m_BindingCache.Clear(); }
+
+private:
+    struct ItemKey
+    {
+        const donut::engine::MeshInstance* instance;
+        const donut::engine::MeshGeometry* geometry;
+
+        bool operator==(const ItemKey& other) const { return instance == other.instance && geometry == other.geometry; }
+    };
+
+    struct ItemKeyHash
+    {
+        size_t operator()(const ItemKey& key) const
+        {
+            return std::hash<const void*>()(key.instance) ^ (std::hash<const void*>()(key.geometry) * 31);
+        }
+    };
+
+    // Shared with the readback callbacks, which can outlive the pass
+    struct Feedback
+    {
+        uint32_t generation = 0;
+        std::vector<uint32_t> visibilityMask;
+        Stats stats;
+    };
+
+    void DrawItems(nvrhi::ICommandList* commandList,
+        const donut::engine::IView& view,
+        const donut::engine::IView* viewPrev,
+        nvrhi::IFramebuffer* framebuffer,
+        donut::render::IGeometryPass& pass,
+        donut::render::GeometryPassContext& passContext,
+        bool phase2);
+    void CreateHiZ(uint32_t width, uint32_t height);
+    void CreateItemBuffers(uint32_t numItems);
+    void CreateVisibilityMask(uint32_t numSlots);
+
+    nvrhi::DeviceHandle m_Device;
+    SinglePassMipGen* m_MipGen;
+    ReadbackQueue* m_ReadbackQueue;
+
+    nvrhi::BindingLayoutHandle m_HiZBindingLayout;
+    nvrhi::BindingLayoutHandle m_CullBindingLayout;
+    nvrhi::ComputePipelineHandle m_HiZPipelines[2];
+    nvrhi::ComputePipelineHandle m_CullPipeline;
+
+    nvrhi::BufferHandle m_ConstantBuffer;
+    nvrhi::BufferHandle m_ItemBuffer;
+    nvrhi::BufferHandle m_DrawArgs;
+    nvrhi::BufferHandle m_VisibilityMask;
+    nvrhi::BufferHandle m_Counters;
+    nvrhi::TextureHandle m_HiZ;
+    donut::engine::BindingCache m_BindingCache;
+
+    std::vector<donut::engine::DrawItem> m_Items;
+    std::vector<OcclusionCullingItem> m_ItemData;
+    std::vector<nvrhi::DrawIndexedIndirectArguments> m_ItemArgs;
+    std::unordered_map<ItemKey, uint32_t, ItemKeyHash> m_Slots;
+    std::shared_ptr<Feedback> m_Feedback;
+};
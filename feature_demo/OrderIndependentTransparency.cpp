@@ -0,0 +1,419 @@
+/*
+* Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#include "OrderIndependentTransparency.h"
+#include "DrawBundleCache.h"
+
+#include <donut/engine/FramebufferFactory.h>
+#include <donut/engine/SceneGraph.h>
+#include <donut/engine/ShaderFactory.h>
+#include <donut/engine/View.h>
+#include <nvrhi/utils.h>
+
+#if DONUT_WITH_DX12
+#include <d3d12.h>
+#endif
+
+#include <algorithm>
+#include <limits>
+
+using namespace donut;
+using namespace donut::math;
+using namespace donut::engine;
+using namespace donut::render;
+
+#include "oit_cb.h"
+
+void UnsortedTransparentDrawStrategy::PrepareForView(const std::shared_ptr<SceneGraphNode>& rootNode, const IView& view)
+{
+    m_Items.clear();
+    m_ReadIndex = 0;
+
+    const frustum viewFrustum = view.GetViewFrustum();
+
+    SceneGraphWalker walker(rootNode.get());
+    while (walker)
+    {
+        const bool visible = viewFrustum.intersectsWith(walker->GetGlobalBoundingBox());
+
+        const auto* instance = visible ? dynamic_cast<MeshInstance*>(walker->GetLeaf().get()) : nullptr;
+        if (instance)
+        {
+            const MeshInfo* mesh = instance->GetMesh().get();
+            const affine3 transform = walker->GetLocalToWorldTransformFloat();
+
+            for (const auto& geometry : mesh->geometries)
+            {
+                const Material* material = geometry->material.get();
+                if (!material || material->domain == MaterialDomain::Opaque || material->domain == MaterialDomain::AlphaTested)
+                    continue;
+
+                if (!viewFrustum.intersectsWith(geometry->objectSpaceBounds * transform))
+                    continue;
+
+                DrawItem& item = m_Items.emplace_back();
+                item.instance = instance;
+                item.mesh = mesh;
+                item.geometry = geometry.get();
+                item.material = material;
+                item.buffers = mesh->buffers.get();
+                item.cullMode = material->doubleSided ? nvrhi::RasterCullMode::None : nvrhi::RasterCullMode::Back;
+            }
+        }
+
+        walker.Next(visible);
+    }
+}
+
+const DrawItem* UnsortedTransparentDrawStrategy::GetNextItem()
+{
+    return m_ReadIndex < m_Items.size() ? &m_Items[m_ReadIndex++] : nullptr;
+}
+
+OitForwardShadingPass::OitForwardShadingPass(nvrhi::IDevice* device, const std::shared_ptr<CommonRenderPasses>& commonPasses, OitMode mode)
+    : ForwardShadingPass(device, commonPasses)
+    , m_Mode(mode)
+{
+    if (m_Mode == OitMode::MultiLayer)
+    {
+        nvrhi::BindingLayoutDesc layoutDesc;
+        layoutDesc.visibility = nvrhi::ShaderType::Pixel;
+        layoutDesc.registerSpace = OIT_SPACE_LAYERS;
+        layoutDesc.bindings = {
+            nvrhi::BindingLayoutItem::Texture_UAV(OIT_BINDING_LAYER_COLORS),
+            nvrhi::BindingLayoutItem::Texture_UAV(OIT_BINDING_LAYER_DEPTHS)
+        };
+        m_LayerBindingLayout = device->createBindingLayout(layoutDesc);
+    }
+}
+
+nvrhi::ShaderHandle OitForwardShadingPass::CreatePixelShader(ShaderFactory& shaderFactory, const CreateParameters& params, bool transmissiveMaterial)
+{
+    // The base pass gets no pixel shaders, which leaves its pipelines with everything but the
+    // shading to derive the OIT pipelines from, see CreateGraphicsPipeline.
+    if (!transmissiveMaterial)
+    {
+        std::vector<ShaderMacro> macros;
+        macros.push_back(ShaderMacro("OIT_MULTI_LAYER", m_Mode == OitMode::MultiLayer ? "1" : "0"));
+        m_OitPixelShader = shaderFactory.CreateShader("app/oit_forward_ps.hlsl", "main", &macros, nvrhi::ShaderType::Pixel);
+    }
+
+    return nullptr;
+}
+
+nvrhi::GraphicsPipelineHandle OitForwardShadingPass::CreateGraphicsPipeline(PipelineKey key, nvrhi::IFramebuffer* framebuffer)
+{
+    // Every domain starts from the alpha blended pipeline: the transmissive one would blend with
+    // a second source color, which the OIT targets do not have.
+    PipelineKey baseKey = key;
+    baseKey.bits.domain = MaterialDomain::AlphaBlended;
+
+    nvrhi::GraphicsPipelineHandle basePipeline = ForwardShadingPass::CreateGraphicsPipeline(baseKey, framebuffer);
+    if (!basePipeline || !m_OitPixelShader)
+        return nullptr;
+
+    nvrhi::GraphicsPipelineDesc pipelineDesc = basePipeline->getDesc();
+    pipelineDesc.PS = m_OitPixelShader;
+    pipelineDesc.renderState.depthStencilState.disableDepthWrite();
+    pipelineDesc.renderState.blendState = nvrhi::BlendState();
+
+    if (m_Mode == OitMode::WeightedBlended)
+    {
+        // Sum of the weighted premultiplied colors and weights
+        pipelineDesc.renderState.blendState.targets[0]
+            .enableBlend()
+            .setSrcBlend(nvrhi::BlendFactor::One)
+            .setDestBlend(nvrhi::BlendFactor::One)
+            .setSrcBlendAlpha(nvrhi::BlendFactor::One)
+            .setDestBlendAlpha(nvrhi::BlendFactor::One);
+
+        // Product of the transmittances
+        pipelineDesc.renderState.blendState.targets[1]
+            .enableBlend()
+            .setSrcBlend(nvrhi::BlendFactor::Zero)
+            .setDestBlend(nvrhi::BlendFactor::InvSrcColor)
+            .setSrcBlendAlpha(nvrhi::BlendFactor::Zero)
+            .setDestBlendAlpha(nvrhi::BlendFactor::InvSrcAlpha);
+    }
+    else
+    {
+        // The layers are blended in the shader
+        pipelineDesc.bindingLayouts.push_back(m_LayerBindingLayout);
+    }
+
+    return m_Device->createGraphicsPipeline(pipelineDesc, framebuffer);
+}
+
+void OitForwardShadingPass::AppendLayerBindings(nvrhi::GraphicsState& state) const
+{
+    if (m_Mode != OitMode::MultiLayer)
+        return;
+
+    // The base pass rewrites its own binding sets, keep the layers after them
+    if (state.bindings.empty() || state.bindings.back() != m_LayerBindingSet)
+    {
+        auto found = std::find(state.bindings.begin(), state.bindings.end(), m_LayerBindingSet.Get());
+        if (found != state.bindings.end())
+            state.bindings.erase(found);
+        state.bindings.push_back(m_LayerBindingSet);
+    }
+}
+
+void OitForwardShadingPass::SetupInputBuffers(GeometryPassContext& context, const BufferGroup* buffers, nvrhi::GraphicsState& state)
+{
+    ForwardShadingPass::SetupInputBuffers(context, buffers, state);
+    AppendLayerBindings(state);
+}
+
+bool OitForwardShadingPass::SetupMaterial(GeometryPassContext& context, const Material* material, nvrhi::RasterCullMode cullMode, nvrhi::GraphicsState& state)
+{
+    if (!ForwardShadingPass::SetupMaterial(context, material, cullMode, state))
+        return false;
+
+    AppendLayerBindings(state);
+    return true;
+}
+
+OrderIndependentTransparencyPass::OrderIndependentTransparencyPass(nvrhi::IDevice* device, const std::shared_ptr<ShaderFactory>& shaderFactory, const std::shared_ptr<CommonRenderPasses>& commonPasses)
+    : m_Device(device)
+    , m_BindingCache(device)
+{
+    ForwardShadingPass::CreateParameters forwardParams;
+    forwardParams.trackLiveness = false;
+
+    m_WeightedPass = std::make_unique<OitForwardShadingPass>(device, commonPasses, OitMode::WeightedBlended);
+    m_WeightedPass->Init(*shaderFactory, forwardParams);
+
+    if (IsRasterizerOrderedViewSupported(device))
+    {
+        m_MultiLayerPass = std::make_unique<OitForwardShadingPass>(device, commonPasses, OitMode::MultiLayer);
+        m_MultiLayerPass->Init(*shaderFactory, forwardParams);
+    }
+
+    // Both composite shaders fit one layout, the multi-layer one leaves t1 unused
+    nvrhi::BindingLayoutDesc layoutDesc;
+    layoutDesc.visibility = nvrhi::ShaderType::Compute;
+    layoutDesc.bindings = {
+        nvrhi::BindingLayoutItem::VolatileConstantBuffer(0),
+        nvrhi::BindingLayoutItem::Texture_SRV(0),
+        nvrhi::BindingLayoutItem::Texture_SRV(1),
+        nvrhi::BindingLayoutItem::Texture_UAV(0)
+    };
+    m_CompositeBindingLayout = m_Device->createBindingLayout(layoutDesc);
+
+    auto createPipeline = [this, &shaderFactory](bool multiLayer)
+    {
+        std::vector<ShaderMacro> macros;
+        macros.push_back(ShaderMacro("OIT_MULTI_LAYER", multiLayer ? "1" : "0"));
+
+        nvrhi::ComputePipelineDesc pipelineDesc;
+        pipelineDesc.CS = shaderFactory->CreateShader("app/oit_composite.hlsl", "composite_cs", &macros, nvrhi::ShaderType::Compute);
+        pipelineDesc.bindingLayouts = { m_CompositeBindingLayout };
+        return m_Device->createComputePipeline(pipelineDesc);
+    };
+
+    m_WeightedCompositePipeline = createPipeline(false);
+    if (m_MultiLayerPass)
+        m_MultiLayerCompositePipeline = createPipeline(true);
+
+    m_ConstantBuffer = m_Device->createBuffer(nvrhi::utils::CreateVolatileConstantBufferDesc(
+        sizeof(OitCompositeConstants), "OitCompositeConstants", engine::c_MaxRenderPassConstantBufferVersions));
+}
+
+bool OrderIndependentTransparencyPass::IsRasterizerOrderedViewSupported(nvrhi::IDevice* device)
+{
+    // NVRHI has no feature query for ROVs, ask D3D12 directly
+#if DONUT_WITH_DX12
+    if (device->getGraphicsAPI() == nvrhi::GraphicsAPI::D3D12)
+    {
+        D3D12_FEATURE_DATA_D3D12_OPTIONS options = {};
+        ID3D12Device* deviceD3D12 = device->getNativeObject(nvrhi::ObjectTypes::D3D12_Device);
+        if (SUCCEEDED(deviceD3D12->CheckFeatureSupport(D3D12_FEATURE_D3D12_OPTIONS, &options, sizeof(options))))
+            return options.ROVsSupported != FALSE;
+    }
+#endif
+
+    return false;
+}
+
+void OrderIndependentTransparencyPass::CreateBuffers(nvrhi::ITexture* depth)
+{
+    m_Depth = depth;
+
+    const nvrhi::TextureDesc& depthDesc = depth->getDesc();
+
+    nvrhi::TextureDesc desc;
+    desc.width = depthDesc.width;
+    desc.height = depthDesc.height;
+    desc.isRenderTarget = true;
+    desc.useClearValue = true;
+    desc.initialState = nvrhi::ResourceStates::RenderTarget;
+    desc.keepInitialState = true;
+
+    desc.format = nvrhi::Format::RGBA16_FLOAT;
+    desc.clearValue = nvrhi::Color(0.f);
+    desc.debugName = "OitAccumulation";
+    m_Accumulation = m_Device->createTexture(desc);
+
+    desc.format = nvrhi::Format::R16_FLOAT;
+    desc.clearValue = nvrhi::Color(1.f);
+    desc.debugName = "OitRevealage";
+    m_Revealage = m_Device->createTexture(desc);
+
+    m_WeightedFramebuffer = std::make_shared<FramebufferFactory>(m_Device);
+    m_WeightedFramebuffer->RenderTargets = { m_Accumulation, m_Revealage };
+    m_WeightedFramebuffer->DepthTarget = depth;
+
+    m_LayerColors = nullptr;
+    m_LayerDepths = nullptr;
+    m_MultiLayerFramebuffer = nullptr;
+
+    if (m_MultiLayerPass)
+    {
+        desc = nvrhi::TextureDesc();
+        desc.width = depthDesc.width;
+        desc.height = depthDesc.height;
+        desc.arraySize = OIT_MLAB_LAYERS;
+        desc.dimension = nvrhi::TextureDimension::Texture2DArray;
+        desc.isUAV = true;
+        desc.initialState = nvrhi::ResourceStates::UnorderedAccess;
+        desc.keepInitialState = true;
+
+        desc.format = nvrhi::Format::RGBA16_FLOAT;
+        desc.debugName = "OitLayerColors";
+        m_LayerColors = m_Device->createTexture(desc);
+
+        desc.format = nvrhi::Format::R32_FLOAT;
+        desc.debugName = "OitLayerDepths";
+        m_LayerDepths = m_Device->createTexture(desc);
+
+        // Only the depth test is rasterized, the layers are written through the UAVs
+        m_MultiLayerFramebuffer = std::make_shared<FramebufferFactory>(m_Device);
+        m_MultiLayerFramebuffer->DepthTarget = depth;
+
+        nvrhi::BindingSetDesc bindingSetDesc;
+        bindingSetDesc.bindings = {
+            nvrhi::BindingSetItem::Texture_UAV(OIT_BINDING_LAYER_COLORS, m_LayerColors),
+            nvrhi::BindingSetItem::Texture_UAV(OIT_BINDING_LAYER_DEPTHS, m_LayerDepths)
+        };
+        m_MultiLayerPass->SetLayerBindings(m_Device->createBindingSet(bindingSetDesc, m_MultiLayerPass->GetLayerBindingLayout()));
+    }
+
+    m_BindingCache.Clear();
+}
+
+void OrderIndependentTransparencyPass::Render(
+    nvrhi::ICommandList* commandList,
+    const ICompositeView& compositeView,
+    const ICompositeView* compositeViewPrev,
+    nvrhi::ITexture* color,
+    nvrhi::ITexture* depth,
+    const std::shared_ptr<SceneGraphNode>& rootNode,
+    IDrawStrategy& drawStrategy,
+    const std::vector<std::shared_ptr<Light>>& lights,
+    float3 ambientColorTop,
+    float3 ambientColorBottom,
+    OitMode mode,
+    DrawBundleCache* drawBundles,
+    bool materialEvents)
+{
+    const bool multiLayer = mode == OitMode::MultiLayer && m_MultiLayerPass;
+    OitForwardShadingPass& pass = multiLayer ? *m_MultiLayerPass : *m_WeightedPass;
+
+    if (depth != m_Depth)
+        CreateBuffers(depth);
+
+    commandList->beginMarker(multiLayer ? "OIT - Multi-Layer" : "OIT - Weighted Blended");
+
+    ForwardShadingPass::Context context;
+    pass.PrepareLights(context, commandList, lights, ambientColorTop, ambientColorBottom, {});
+
+    auto renderFragments = [&](FramebufferFactory& framebufferFactory)
+    {
+        if (drawBundles)
+        {
+            drawBundles->RenderCompositeView(commandList, &compositeView, compositeViewPrev, framebufferFactory,
+                rootNode, drawStrategy, pass, context, "OIT Fragments", materialEvents);
+        }
+        else
+        {
+            RenderCompositeView(commandList, &compositeView, compositeViewPrev, framebufferFactory,
+                rootNode, drawStrategy, pass, context, "OIT Fragments", materialEvents);
+        }
+    };
+
+    if (multiLayer)
+    {
+        commandList->clearTextureFloat(m_LayerColors, nvrhi::AllSubresources, nvrhi::Color(0.f, 0.f, 0.f, 1.f));
+        commandList->clearTextureFloat(m_LayerDepths, nvrhi::AllSubresources, nvrhi::Color(std::numeric_limits<float>::infinity()));
+
+        // Rasterizer ordered views keep overlapping fragments in order across draws,
+        // the UAV barriers that would otherwise separate the draws are not needed
+        commandList->setEnableUavBarriersForTexture(m_LayerColors, false);
+        commandList->setEnableUavBarriersForTexture(m_LayerDepths, false);
+
+        renderFragments(*m_MultiLayerFramebuffer);
+
+        commandList->setEnableUavBarriersForTexture(m_LayerColors, true);
+        commandList->setEnableUavBarriersForTexture(m_LayerDepths, true);
+    }
+    else
+    {
+        commandList->clearTextureFloat(m_Accumulation, nvrhi::AllSubresources, nvrhi::Color(0.f));
+        commandList->clearTextureFloat(m_Revealage, nvrhi::AllSubresources, nvrhi::Color(1.f));
+
+        renderFragments(*m_WeightedFramebuffer);
+    }
+
+    // Blend the collected surfaces over the color
+    const nvrhi::TextureDesc& colorDesc = color->getDesc();
+
+    OitCompositeConstants constants = {};
+    constants.size = uint2(colorDesc.width, colorDesc.height);
+    commandList->writeBuffer(m_ConstantBuffer, &constants, sizeof(constants));
+
+    nvrhi::BindingSetDesc bindingSetDesc;
+    bindingSetDesc.bindings = {
+        nvrhi::BindingSetItem::ConstantBuffer(0, m_ConstantBuffer),
+        nvrhi::BindingSetItem::Texture_SRV(0, multiLayer ? m_LayerColors : m_Accumulation),
+        nvrhi::BindingSetItem::Texture_SRV(1, multiLayer ? m_LayerDepths : m_Revealage),
+        nvrhi::BindingSetItem::Texture_UAV(0, color)
+    };
+
+    nvrhi::ComputeState state;
+    state.pipeline = multiLayer ? m_MultiLayerCompositePipeline : m_WeightedCompositePipeline;
+    state.bindings = { m_BindingCache.GetOrCreateBindingSet(bindingSetDesc, m_CompositeBindingLayout) };
+    commandList->setComputeState(state);
+    commandList->dispatch(
+        (constants.size.x + OIT_COMPOSITE_GROUP_SIZE - 1) / OIT_COMPOSITE_GROUP_SIZE,
+        (constants.size.y + OIT_COMPOSITE_GROUP_SIZE - 1) / OIT_COMPOSITE_GROUP_SIZE, 1);
+
+    commandList->endMarker();
+}
+
+void OrderIndependentTransparencyPass::ResetBindingCache()
+{
+    m_WeightedPass->ResetBindingCache();
+    if (m_MultiLayerPass)
+        m_MultiLayerPass->ResetBindingCache();
+    m_BindingCache.Clear();
+}
@@ -0,0 +1,161 @@
+/*
+* Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <donut/core/math/math.h>
+#include <donut/engine/BindingCache.h>
+#include <donut/render/DrawStrategy.h>
+#include <donut/render/ForwardShadingPass.h>
+#include <nvrhi/nvrhi.h>
+#include <memory>
+#include <vector>
+
+namespace donut::engine
+{
+    class CommonRenderPasses;
+    class FramebufferFactory;
+    class ICompositeView;
+    class Light;
+    class SceneGraphNode;
+    class ShaderFactory;
+}
+
+enum class OitMode
+{
+    // Weighted blended OIT: additive render targets, works on every device
+    WeightedBlended,
+    // Multi-layer alpha blending: per-pixel fragment arrays behind rasterizer ordered views
+    MultiLayer
+};
+
+// ForwardShadingPass that writes the translucent surfaces into the buffers of an OIT mode
+// instead of blending them over the color, with oit_forward_ps.hlsl for all material domains.
+// The pipelines are derived from the alpha blended pipelines of the base pass.
+class OitForwardShadingPass : public donut::render::ForwardShadingPass
+{
+public:
+    OitForwardShadingPass(nvrhi::IDevice* device, const std::shared_ptr<donut::engine::CommonRenderPasses>& commonPasses, OitMode mode);
+
+    [[nodiscard]] OitMode GetMode() const { return m_Mode; }
+
+    // The fragment layers of the multi-layer mode, bound after the bindings of the base pass
+    [[nodiscard]] nvrhi::IBindingLayout* GetLayerBindingLayout() const { return m_LayerBindingLayout; }
+    void SetLayerBindings(nvrhi::IBindingSet* bindingSet) { m_LayerBindingSet = bindingSet; }
+
+    void SetupInputBuffers(donut::render::GeometryPassContext& context, const donut::engine::BufferGroup* buffers, nvrhi::GraphicsState& state) override;
+    bool SetupMaterial(donut::render::GeometryPassContext& context, const donut::engine::Material* material, nvrhi::RasterCullMode cullMode, nvrhi::GraphicsState& state) override;
+
+protected:
+    nvrhi::ShaderHandle CreatePixelShader(donut::engine::ShaderFactory& shaderFactory, const CreateParameters& params, bool transmissiveMaterial) override;
+    nvrhi::GraphicsPipelineHandle CreateGraphicsPipeline(PipelineKey key, nvrhi::IFramebuffer* framebuffer) override;
+
+private:
+    void AppendLayerBindings(nvrhi::GraphicsState& state) const;
+
+    OitMode m_Mode;
+    nvrhi::ShaderHandle m_OitPixelShader;
+    nvrhi::BindingLayoutHandle m_LayerBindingLayout;
+    nvrhi::BindingSetHandle m_LayerBindingSet;
+};
+
+// Draw strategy that returns the visible translucent items in scene graph order, without sorting.
+// DrawListCache provides the same from its cached lists; this one is for when the cache is off.
+class UnsortedTransparentDrawStrategy : public donut::render::IDrawStrategy
+{
+public:
+    void PrepareForView(const std::shared_ptr<donut::engine::SceneGraphNode>& rootNode, const donut::engine::IView& view) override;
+    const donut::engine::DrawItem* GetNextItem() override;
+
+private:
+    std::vector<donut::engine::DrawItem> m_Items;
+    size_t m_ReadIndex = 0;
+};
+
+// Order-independent transparency for the forward translucency pass. The translucent items are
+// drawn in any order into the buffers of the selected mode, which are then composited over the
+// color in one compute pass, so the draw strategy does not need to sort them back to front.
+//
+// - Weighted blended OIT (McGuire and Bavoil 2013) adds depth-weighted premultiplied colors into
+//   an RGBA16F target and multiplies the transmittances in an R16F target. It only needs blending,
+//   but the result is an approximation wherever opaque-looking surfaces overlap.
+// - Multi-layer alpha blending (Salvi and Vaidyanathan 2014) keeps the nearest OIT_MLAB_LAYERS
+//   fragments of each pixel sorted in texture arrays and merges the rest into the last one. The
+//   arrays are rasterizer ordered views, which serialize overlapping fragments in primitive order,
+//   so it is only available where the device reports support for them.
+//
+// The color texture must be single-sampled and allow UAVs. Light probes are not applied.
+class DrawBundleCache;
+
+class OrderIndependentTransparencyPass
+{
+public:
+    OrderIndependentTransparencyPass(nvrhi::IDevice* device,
+        const std::shared_ptr<donut::engine::ShaderFactory>& shaderFactory,
+        const std::shared_ptr<donut::engine::CommonRenderPasses>& commonPasses);
+
+    [[nodiscard]] bool IsMultiLayerSupported() const { return m_MultiLayerPass != nullptr; }
+
+    // Draws the items of the strategy over the color, depth tested against the depth texture.
+    // Falls back to weighted blended OIT if the multi-layer mode is not supported. The static items
+    // are replayed from the draw bundles if those are given, the draw order doesn't matter here.
+    void Render(nvrhi::ICommandList* commandList,
+        const donut::engine::ICompositeView& compositeView,
+        const donut::engine::ICompositeView* compositeViewPrev,
+        nvrhi::ITexture* color,
+        nvrhi::ITexture* depth,
+        const std::shared_ptr<donut::engine::SceneGraphNode>& rootNode,
+        donut::render::IDrawStrategy& drawStrategy,
+        const std::vector<std::shared_ptr<donut::engine::Light>>& lights,
+        donut::math::float3 ambientColorTop,
+        donut::math::float3 ambientColorBottom,
+        OitMode mode,
+        DrawBundleCache* drawBundles,
+        bool materialEvents);
+
+    void ResetBindingCache();
+
+private:
+    static bool IsRasterizerOrderedViewSupported(nvrhi::IDevice* device);
+
+    void CreateBuffers(nvrhi::ITexture* depth);
+
+    nvrhi::DeviceHandle m_Device;
+
+    std::unique_ptr<OitForwardShadingPass> m_WeightedPass;
+    std::unique_ptr<OitForwardShadingPass> m_MultiLayerPass;
+
+    nvrhi::BindingLayoutHandle m_CompositeBindingLayout;
+    nvrhi::ComputePipelineHandle m_WeightedCompositePipeline;
+    nvrhi::ComputePipelineHandle m_MultiLayerCompositePipeline;
+    nvrhi::BufferHandle m_ConstantBuffer;
+    donut::engine::BindingCache m_BindingCache;
+
+    // The buffers follow the depth texture, which is kept to detect when the render targets change
+    nvrhi::TextureHandle m_Depth;
+    nvrhi::TextureHandle m_Accumulation;
+    nvrhi::TextureHandle m_Revealage;
+    nvrhi::TextureHandle m_LayerColors;
+    nvrhi::TextureHandle m_LayerDepths;
+    std::shared_ptr<donut::engine::FramebufferFactory> m_WeightedFramebuffer;
+    std::shared_ptr<donut::engine::FramebufferFactory> m_MultiLayerFramebuffer;
+};
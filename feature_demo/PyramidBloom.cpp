@@ -0,0 +1,237 @@
+/*
+* Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#include "PyramidBloom.h"
+
+#include <donut/engine/CommonRenderPasses.h>
+#include <donut/engine/ShaderFactory.h>
+#include <donut/engine/View.h>
+
+#include <algorithm>
+#include <cmath>
+
+using namespace donut;
+using namespace donut::math;
+using namespace donut::engine;
+
+#include "bloom_pyramid_cb.h"
+
+PyramidBloomPass::PyramidBloomPass(nvrhi::IDevice* device, const std::shared_ptr<ShaderFactory>& shaderFactory, const std::shared_ptr<CommonRenderPasses>& commonPasses)
+    : m_Device(device)
+    , m_CommonPasses(commonPasses)
+    , m_BindingCache(device)
+{
+    nvrhi::BindingLayoutDesc layoutDesc;
+    layoutDesc.visibility = nvrhi::ShaderType::Compute;
+    layoutDesc.bindings = {
+        nvrhi::BindingLayoutItem::PushConstants(0, sizeof(BloomPyramidConstants)),
+        nvrhi::BindingLayoutItem::Texture_SRV(0),
+        nvrhi::BindingLayoutItem::Sampler(0),
+        nvrhi::BindingLayoutItem::Texture_UAV(0)
+    };
+    m_BindingLayout = m_Device->createBindingLayout(layoutDesc);
+
+    auto createPipeline = [this, &shaderFactory](const char* entryName)
+    {
+        nvrhi::ComputePipelineDesc pipelineDesc;
+        pipelineDesc.CS = shaderFactory->CreateShader("app/bloom_pyramid.hlsl", entryName, nullptr, nvrhi::ShaderType::Compute);
+        pipelineDesc.bindingLayouts = { m_BindingLayout };
+        return m_Device->createComputePipeline(pipelineDesc);
+    };
+
+    m_DownsamplePipeline = createPipeline("downsample_cs");
+    m_UpsamplePipeline = createPipeline("upsample_cs");
+    m_CompositePipeline = createPipeline("composite_cs");
+}
+
+void PyramidBloomPass::ComputeLevelWeights(float sigma, uint32_t numLevels, std::vector<float>& weights)
+{
+    // Spread of the weights around the matching level, in octaves
+    constexpr float spread = 1.f;
+
+    weights.resize(numLevels);
+    float totalWeight = 0.f;
+    for (uint32_t level = 0; level < numLevels; level++)
+    {
+        const float levelSigma = float(2u << level);
+        const float octaves = std::log2(levelSigma / std::max(sigma, 0.1f)) / spread;
+        weights[level] = std::exp(-0.5f * octaves * octaves);
+        totalWeight += weights[level];
+    }
+
+    for (float& weight : weights)
+        weight /= totalWeight;
+}
+
+void PyramidBloomPass::CreatePyramid(uint2 extentSize)
+{
+    m_ExtentSize = extentSize;
+
+    uint2 levelSize = (extentSize + 1u) / 2u;
+    m_NumLevels = 1;
+    while (m_NumLevels < c_MaxLevels && levelSize.x >= 4 && levelSize.y >= 4)
+    {
+        levelSize = (levelSize + 1u) / 2u;
+        m_NumLevels++;
+    }
+
+    nvrhi::TextureDesc desc;
+    desc.width = (extentSize.x + 1) / 2;
+    desc.height = (extentSize.y + 1) / 2;
+    desc.mipLevels = m_NumLevels;
+    desc.format = nvrhi::Format::RGBA16_FLOAT;
+    desc.isUAV = true;
+    desc.initialState = nvrhi::ResourceStates::ShaderResource;
+    desc.keepInitialState = true;
+    desc.debugName = "BloomPyramid";
+    m_Pyramid = m_Device->createTexture(desc);
+
+    m_BindingCache.Clear();
+}
+
+void PyramidBloomPass::Render(nvrhi::ICommandList* commandList, const IView& view, nvrhi::ITexture* color, float sigma, float alpha)
+{
+    const nvrhi::Rect extent = view.GetViewExtent();
+    const uint2 extentSize = uint2(extent.width(), extent.height());
+    if (extentSize.x < 2 || extentSize.y < 2)
+        return;
+
+    if (any(extentSize != m_ExtentSize))
+        CreatePyramid(extentSize);
+
+    ComputeLevelWeights(sigma, m_NumLevels, m_Weights);
+
+    const nvrhi::TextureDesc& colorDesc = color->getDesc();
+    const float2 colorSize = float2(float(colorDesc.width), float(colorDesc.height));
+    const nvrhi::TextureSubresourceSet colorMip0 = nvrhi::TextureSubresourceSet(0, 1, 0, 1);
+
+    auto getLevelSize = [this](uint32_t level)
+    {
+        const nvrhi::TextureDesc& desc = m_Pyramid->getDesc();
+        return uint2(std::max(desc.width >> level, 1u), std::max(desc.height >> level, 1u));
+    };
+
+    auto dispatch = [this, commandList](nvrhi::IComputePipeline* pipeline,
+        nvrhi::ITexture* source, const nvrhi::TextureSubresourceSet& sourceSubresources,
+        nvrhi::ITexture* dest, const nvrhi::TextureSubresourceSet& destSubresources,
+        const BloomPyramidConstants& constants)
+    {
+        nvrhi::BindingSetDesc bindingSetDesc;
+        bindingSetDesc.bindings = {
+            // Every dispatch has its own constants, push constants don't run out of versions
+            nvrhi::BindingSetItem::PushConstants(0, sizeof(BloomPyramidConstants)),
+            nvrhi::BindingSetItem::Texture_SRV(0, source, nvrhi::Format::UNKNOWN, sourceSubresources),
+            nvrhi::BindingSetItem::Sampler(0, m_CommonPasses->m_LinearClampSampler),
+            nvrhi::BindingSetItem::Texture_UAV(0, dest, nvrhi::Format::UNKNOWN, destSubresources)
+        };
+
+        nvrhi::ComputeState state;
+        state.pipeline = pipeline;
+        state.bindings = { m_BindingCache.GetOrCreateBindingSet(bindingSetDesc, m_BindingLayout) };
+
+        commandList->setComputeState(state);
+        commandList->setPushConstants(&constants, sizeof(constants));
+        commandList->dispatch(
+            (constants.destSize.x + BLOOM_PYRAMID_GROUP_SIZE - 1) / BLOOM_PYRAMID_GROUP_SIZE,
+            (constants.destSize.y + BLOOM_PYRAMID_GROUP_SIZE - 1) / BLOOM_PYRAMID_GROUP_SIZE, 1);
+    };
+
+    // Sets up sampling of a whole pyramid level, with dest pixels mapped to the same normalized position
+    auto setPyramidSource = [&getLevelSize](BloomPyramidConstants& constants, uint32_t sourceLevel, uint2 destSize)
+    {
+        const float2 sourceSize = float2(getLevelSize(sourceLevel));
+        constants.sourceTexelSize = 1.f / sourceSize;
+        constants.sourceUVMin = 0.5f / sourceSize;
+        constants.sourceUVMax = 1.f - 0.5f / sourceSize;
+        constants.destToSourceScale = 1.f / float2(destSize);
+        constants.destToSourceBias = 0.f;
+    };
+
+    commandList->beginMarker("PyramidBloom");
+
+    // Downsample the color into the pyramid; the first level also suppresses fireflies
+    for (uint32_t level = 0; level < m_NumLevels; level++)
+    {
+        const uint2 levelSize = getLevelSize(level);
+        const bool coarsest = level + 1 == m_NumLevels;
+
+        BloomPyramidConstants constants = {};
+        constants.destOrigin = int2(0);
+        constants.destSize = int2(levelSize);
+        constants.weight = coarsest ? m_Weights[level] : 1.f;
+
+        if (level == 0)
+        {
+            const float2 extentMin = float2(float(extent.minX), float(extent.minY));
+            const float2 extentMax = float2(float(extent.maxX), float(extent.maxY));
+            constants.sourceTexelSize = 1.f / colorSize;
+            constants.sourceUVMin = (extentMin + 0.5f) / colorSize;
+            constants.sourceUVMax = (extentMax - 0.5f) / colorSize;
+            constants.destToSourceScale = float2(extentSize) / (float2(levelSize) * colorSize);
+            constants.destToSourceBias = extentMin / colorSize;
+            constants.karisAverage = 1;
+
+            dispatch(m_DownsamplePipeline, color, colorMip0, m_Pyramid, nvrhi::TextureSubresourceSet(0, 1, 0, 1), constants);
+        }
+        else
+        {
+            setPyramidSource(constants, level - 1, levelSize);
+
+            dispatch(m_DownsamplePipeline, m_Pyramid, nvrhi::TextureSubresourceSet(level - 1, 1, 0, 1),
+                m_Pyramid, nvrhi::TextureSubresourceSet(level, 1, 0, 1), constants);
+        }
+    }
+
+    // Accumulate the weighted levels from the coarsest one up
+    for (int level = int(m_NumLevels) - 2; level >= 0; level--)
+    {
+        const uint2 levelSize = getLevelSize(uint32_t(level));
+
+        BloomPyramidConstants constants = {};
+        constants.destOrigin = int2(0);
+        constants.destSize = int2(levelSize);
+        constants.weight = m_Weights[level];
+        setPyramidSource(constants, uint32_t(level) + 1, levelSize);
+
+        dispatch(m_UpsamplePipeline, m_Pyramid, nvrhi::TextureSubresourceSet(uint32_t(level) + 1, 1, 0, 1),
+            m_Pyramid, nvrhi::TextureSubresourceSet(uint32_t(level), 1, 0, 1), constants);
+    }
+
+    // Blend the result over the color
+    {
+        BloomPyramidConstants constants = {};
+        constants.destOrigin = int2(extent.minX, extent.minY);
+        constants.destSize = int2(extentSize);
+        constants.weight = alpha;
+        setPyramidSource(constants, 0, extentSize);
+        constants.destToSourceBias = -float2(constants.destOrigin) / float2(extentSize);
+
+        dispatch(m_CompositePipeline, m_Pyramid, nvrhi::TextureSubresourceSet(0, 1, 0, 1), color, colorMip0, constants);
+    }
+
+    commandList->endMarker();
+}
+
+void PyramidBloomPass::ResetBindingCache()
+{
+    m_BindingCache.Clear();
+}
@@ -0,0 +1,80 @@
+/*
+* Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <donut/core/math/math.h>
+#include <donut/engine/BindingCache.h>
+#include <nvrhi/nvrhi.h>
+#include <memory>
+#include <vector>
+
+namespace donut::engine
+{
+    class CommonRenderPasses;
+    class IView;
+    class ShaderFactory;
+}
+
+// Bloom built from a mip pyramid in compute, as an alternative to donut's BloomPass.
+//
+// The color is downsampled with a 13-tap filter into a chain of half resolution levels, and the
+// levels are then added back together from the smallest one with a 3x3 tent filter. The cost only
+// depends on the resolution. The width of the bloom comes from the weights of the levels: level i
+// blurs over roughly 2^(i+1) pixels, and the weights are distributed around the level that matches
+// the Gaussian sigma, so that the same sigma gives a similar look with either pass.
+class PyramidBloomPass
+{
+public:
+    PyramidBloomPass(nvrhi::IDevice* device,
+        const std::shared_ptr<donut::engine::ShaderFactory>& shaderFactory,
+        const std::shared_ptr<donut::engine::CommonRenderPasses>& commonPasses);
+
+    // Blends the bloom over the view's extent of the color texture, in place. The texture must allow UAVs.
+    void Render(nvrhi::ICommandList* commandList, const donut::engine::IView& view, nvrhi::ITexture* color, float sigma, float alpha);
+
+    // Fills the normalized weights of the pyramid levels for a Gaussian sigma in full resolution pixels.
+    static void ComputeLevelWeights(float sigma, uint32_t numLevels, std::vector<float>& weights);
+
+    [[nodiscard]] uint32_t GetNumLevels() const { return m_NumLevels; }
+
+    void ResetBindingCache();
+
+private:
+    static constexpr uint32_t c_MaxLevels = 8;
+
+    void CreatePyramid(donut::math::uint2 extentSize);
+
+    nvrhi::DeviceHandle m_Device;
+    std::shared_ptr<donut::engine::CommonRenderPasses> m_CommonPasses;
+
+    nvrhi::BindingLayoutHandle m_BindingLayout;
+    nvrhi::ComputePipelineHandle m_DownsamplePipeline;
+    nvrhi::ComputePipelineHandle m_UpsamplePipeline;
+    nvrhi::ComputePipelineHandle m_CompositePipeline;
+    donut::engine::BindingCache m_BindingCache;
+
+    nvrhi::TextureHandle m_Pyramid;
+    donut::math::uint2 m_ExtentSize = 0;
+    uint32_t m_NumLevels = 0;
+    std::vector<float> m_Weights;
+};
@@ -0,0 +1,288 @@
+/*
+* Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#include "ReducedResolutionSsao.h"
+
+#include <donut/engine/CommonRenderPasses.h>
+#include <donut/engine/ShaderFactory.h>
+#include <donut/engine/View.h>
+#include <donut/render/SsaoPass.h>
+#include <nvrhi/utils.h>
+
+#include <algorithm>
+
+using namespace donut;
+using namespace donut::math;
+using namespace donut::engine;
+using namespace donut::render;
+
+#include "reduced_ssao_cb.h"
+
+ReducedResolutionSsaoPass::ReducedResolutionSsaoPass(nvrhi::IDevice* device, const std::shared_ptr<ShaderFactory>& shaderFactory)
+    : m_Device(device)
+    , m_BindingCache(device)
+{
+    auto createLayout = [this](const nvrhi::BindingLayoutItemArray& bindings)
+    {
+        nvrhi::BindingLayoutDesc layoutDesc;
+        layoutDesc.visibility = nvrhi::ShaderType::Compute;
+        layoutDesc.bindings = bindings;
+        return m_Device->createBindingLayout(layoutDesc);
+    };
+
+    // The passes that read the full resolution normals have a variant for octahedral normals
+    auto createPipeline = [this, &shaderFactory](const char* entryName, nvrhi::IBindingLayout* bindingLayout, bool octahedralNormals)
+    {
+        std::vector<ShaderMacro> macros = { ShaderMacro("OCTAHEDRAL_NORMALS", octahedralNormals ? "1" : "0") };
+        nvrhi::ShaderHandle shader = shaderFactory->CreateShader("app/reduced_ssao.hlsl", entryName, &macros, nvrhi::ShaderType::Compute);
+
+        nvrhi::ComputePipelineDesc pipelineDesc;
+        pipelineDesc.CS = shader;
+        pipelineDesc.bindingLayouts = { bindingLayout };
+        return m_Device->createComputePipeline(pipelineDesc);
+    };
+
+    m_DownsampleBindingLayout = createLayout({
+        nvrhi::BindingLayoutItem::VolatileConstantBuffer(0),
+        nvrhi::BindingLayoutItem::Texture_SRV(0),
+        nvrhi::BindingLayoutItem::Texture_SRV(1),
+        nvrhi::BindingLayoutItem::Texture_UAV(0),
+        nvrhi::BindingLayoutItem::Texture_UAV(1)
+    });
+    for (int octahedral = 0; octahedral < 2; octahedral++)
+        m_DownsamplePipelines[octahedral] = createPipeline("downsample_cs", m_DownsampleBindingLayout, octahedral != 0);
+
+    m_AOBindingLayout = createLayout({
+        nvrhi::BindingLayoutItem::VolatileConstantBuffer(0),
+        nvrhi::BindingLayoutItem::Texture_SRV(3),
+        nvrhi::BindingLayoutItem::Texture_SRV(4),
+        nvrhi::BindingLayoutItem::Texture_UAV(2)
+    });
+    m_AOPipeline = createPipeline("ao_cs", m_AOBindingLayout, false);
+
+    m_TemporalBindingLayout = createLayout({
+        nvrhi::BindingLayoutItem::VolatileConstantBuffer(0),
+        nvrhi::BindingLayoutItem::Texture_SRV(2),
+        nvrhi::BindingLayoutItem::Texture_SRV(3),
+        nvrhi::BindingLayoutItem::Texture_SRV(4),
+        nvrhi::BindingLayoutItem::Texture_SRV(5),
+        nvrhi::BindingLayoutItem::Texture_SRV(6),
+        nvrhi::BindingLayoutItem::Texture_SRV(7),
+        nvrhi::BindingLayoutItem::Texture_UAV(3)
+    });
+    m_TemporalPipeline = createPipeline("temporal_cs", m_TemporalBindingLayout, false);
+
+    m_UpsampleBindingLayout = createLayout({
+        nvrhi::BindingLayoutItem::VolatileConstantBuffer(0),
+        nvrhi::BindingLayoutItem::Texture_SRV(0),
+        nvrhi::BindingLayoutItem::Texture_SRV(1),
+        nvrhi::BindingLayoutItem::Texture_SRV(3),
+        nvrhi::BindingLayoutItem::Texture_SRV(4),
+        nvrhi::BindingLayoutItem::Texture_SRV(7),
+        nvrhi::BindingLayoutItem::Texture_UAV(4)
+    });
+    for (int octahedral = 0; octahedral < 2; octahedral++)
+        m_UpsamplePipelines[octahedral] = createPipeline("upsample_cs", m_UpsampleBindingLayout, octahedral != 0);
+
+    m_ConstantBuffer = m_Device->createBuffer(nvrhi::utils::CreateVolatileConstantBufferDesc(
+        sizeof(ReducedSsaoConstants), "ReducedSsaoConstants", engine::c_MaxRenderPassConstantBufferVersions));
+}
+
+void ReducedResolutionSsaoPass::CreateTextures(uint2 size, uint32_t downsampleFactor)
+{
+    m_FullSize = size;
+    m_DownsampleFactor = downsampleFactor;
+    m_ReducedSize = (size + downsampleFactor - 1) / downsampleFactor;
+
+    nvrhi::TextureDesc desc;
+    desc.width = m_ReducedSize.x;
+    desc.height = m_ReducedSize.y;
+    desc.isUAV = true;
+    desc.initialState = nvrhi::ResourceStates::ShaderResource;
+    desc.keepInitialState = true;
+
+    desc.format = nvrhi::Format::R32_FLOAT;
+    desc.debugName = "ReducedSsao/Depth0";
+    m_LowDepth[0] = m_Device->createTexture(desc);
+    desc.debugName = "ReducedSsao/Depth1";
+    m_LowDepth[1] = m_Device->createTexture(desc);
+
+    desc.format = nvrhi::Format::RG16_FLOAT;
+    desc.debugName = "ReducedSsao/Accumulated0";
+    m_AccumulatedAO[0] = m_Device->createTexture(desc);
+    desc.debugName = "ReducedSsao/Accumulated1";
+    m_AccumulatedAO[1] = m_Device->createTexture(desc);
+
+    desc.format = nvrhi::Format::RGBA16_FLOAT;
+    desc.debugName = "ReducedSsao/Normals";
+    m_LowNormals = m_Device->createTexture(desc);
+
+    desc.format = nvrhi::Format::R16_FLOAT;
+    desc.debugName = "ReducedSsao/RawAO";
+    m_RawAO = m_Device->createTexture(desc);
+
+    m_BindingCache.Clear();
+    m_HistoryValid = false;
+}
+
+void ReducedResolutionSsaoPass::Render(
+    nvrhi::ICommandList* commandList,
+    const SsaoParameters& ssaoParams,
+    const Parameters& params,
+    const IView& view,
+    const Inputs& inputs)
+{
+    const nvrhi::TextureDesc& outputDesc = inputs.output->getDesc();
+    const uint32_t downsampleFactor = clamp(params.downsampleFactor, 1u, uint32_t(REDUCED_SSAO_MAX_DOWNSAMPLE_FACTOR));
+    const uint2 outputSize = uint2(outputDesc.width, outputDesc.height);
+
+    if (any(outputSize != m_FullSize) || downsampleFactor != m_DownsampleFactor)
+        CreateTextures(outputSize, downsampleFactor);
+
+    // Dynamic resolution or a different view layout changes the mapping between pixels and history texels
+    const uint32_t numViews = view.GetNumChildViews(ViewType::PLANAR);
+    std::vector<nvrhi::Viewport> viewports(numViews);
+    for (uint32_t viewIndex = 0; viewIndex < numViews; viewIndex++)
+        viewports[viewIndex] = view.GetChildView(ViewType::PLANAR, viewIndex)->GetViewportState().viewports[0];
+
+    if (viewports != m_PreviousViewports)
+    {
+        m_PreviousViewports = viewports;
+        m_HistoryValid = false;
+    }
+
+    const uint32_t current = m_FrameIndex & 1;
+    const uint32_t previous = current ^ 1;
+
+    commandList->beginMarker("ReducedResolutionSsao");
+
+    nvrhi::BindingSetDesc downsampleBindings;
+    downsampleBindings.bindings = {
+        nvrhi::BindingSetItem::ConstantBuffer(0, m_ConstantBuffer),
+        nvrhi::BindingSetItem::Texture_SRV(0, inputs.depth),
+        nvrhi::BindingSetItem::Texture_SRV(1, inputs.gbufferNormals),
+        nvrhi::BindingSetItem::Texture_UAV(0, m_LowDepth[current]),
+        nvrhi::BindingSetItem::Texture_UAV(1, m_LowNormals)
+    };
+
+    nvrhi::BindingSetDesc aoBindings;
+    aoBindings.bindings = {
+        nvrhi::BindingSetItem::ConstantBuffer(0, m_ConstantBuffer),
+        nvrhi::BindingSetItem::Texture_SRV(3, m_LowDepth[current]),
+        nvrhi::BindingSetItem::Texture_SRV(4, m_LowNormals),
+        nvrhi::BindingSetItem::Texture_UAV(2, m_RawAO)
+    };
+
+    nvrhi::BindingSetDesc temporalBindings;
+    temporalBindings.bindings = {
+        nvrhi::BindingSetItem::ConstantBuffer(0, m_ConstantBuffer),
+        nvrhi::BindingSetItem::Texture_SRV(2, inputs.motionVectors),
+        nvrhi::BindingSetItem::Texture_SRV(3, m_LowDepth[current]),
+        nvrhi::BindingSetItem::Texture_SRV(4, m_LowNormals),
+        nvrhi::BindingSetItem::Texture_SRV(5, m_LowDepth[previous]),
+        nvrhi::BindingSetItem::Texture_SRV(6, m_RawAO),
+        nvrhi::BindingSetItem::Texture_SRV(7, m_AccumulatedAO[previous]),
+        nvrhi::BindingSetItem::Texture_UAV(3, m_AccumulatedAO[current])
+    };
+
+    nvrhi::BindingSetDesc upsampleBindings;
+    upsampleBindings.bindings = {
+        nvrhi::BindingSetItem::ConstantBuffer(0, m_ConstantBuffer),
+        nvrhi::BindingSetItem::Texture_SRV(0, inputs.depth),
+        nvrhi::BindingSetItem::Texture_SRV(1, inputs.gbufferNormals),
+        nvrhi::BindingSetItem::Texture_SRV(3, m_LowDepth[current]),
+        nvrhi::BindingSetItem::Texture_SRV(4, m_LowNormals),
+        nvrhi::BindingSetItem::Texture_SRV(7, m_AccumulatedAO[current]),
+        nvrhi::BindingSetItem::Texture_UAV(4, inputs.output)
+    };
+
+    nvrhi::ComputeState downsampleState;
+    downsampleState.pipeline = m_DownsamplePipelines[inputs.octahedralNormals ? 1 : 0];
+    downsampleState.bindings = { m_BindingCache.GetOrCreateBindingSet(downsampleBindings, m_DownsampleBindingLayout) };
+
+    nvrhi::ComputeState aoState;
+    aoState.pipeline = m_AOPipeline;
+    aoState.bindings = { m_BindingCache.GetOrCreateBindingSet(aoBindings, m_AOBindingLayout) };
+
+    nvrhi::ComputeState temporalState;
+    temporalState.pipeline = m_TemporalPipeline;
+    temporalState.bindings = { m_BindingCache.GetOrCreateBindingSet(temporalBindings, m_TemporalBindingLayout) };
+
+    nvrhi::ComputeState upsampleState;
+    upsampleState.pipeline = m_UpsamplePipelines[inputs.octahedralNormals ? 1 : 0];
+    upsampleState.bindings = { m_BindingCache.GetOrCreateBindingSet(upsampleBindings, m_UpsampleBindingLayout) };
+
+    for (uint32_t viewIndex = 0; viewIndex < numViews; viewIndex++)
+    {
+        const IView* planarView = view.GetChildView(ViewType::PLANAR, viewIndex);
+        const nvrhi::Viewport& viewport = viewports[viewIndex];
+        const float4x4 projection = planarView->GetProjectionMatrix(false);
+
+        ReducedSsaoConstants constants = {};
+        planarView->FillPlanarViewConstants(constants.view);
+        constants.fullResOrigin = int2(int(viewport.minX), int(viewport.minY));
+        constants.fullResSize = int2(int(viewport.width()), int(viewport.height()));
+        constants.lowResOrigin = constants.fullResOrigin / int(downsampleFactor);
+        constants.lowResSize = (constants.fullResSize + int(downsampleFactor) - 1) / int(downsampleFactor);
+        constants.downsampleFactor = downsampleFactor;
+        constants.frameIndex = m_FrameIndex;
+        constants.numSamples = params.numSamples;
+        constants.historyValid = (m_HistoryValid && params.enableTemporalAccumulation) ? 1 : 0;
+        constants.radiusWorld = ssaoParams.radiusWorld;
+        constants.surfaceBias = ssaoParams.surfaceBias;
+        constants.powerExponent = ssaoParams.powerExponent;
+        constants.amount = ssaoParams.amount;
+        constants.projectionScale = 0.5f * float2(constants.fullResSize) * float2(projection.row0.x, projection.row1.y) / float(downsampleFactor);
+        constants.backgroundViewDepth = ssaoParams.backgroundViewDepth;
+        constants.maxHistoryLength = std::max(params.maxHistoryLength, 1.f);
+        constants.depthRejection = params.depthRejection;
+        constants.upsampleSharpness = params.upsampleSharpness;
+        constants.splitPosition = params.splitPosition;
+        constants.reverseDepth = planarView->IsReverseDepth() ? 1 : 0;
+        commandList->writeBuffer(m_ConstantBuffer, &constants, sizeof(constants));
+
+        const uint2 lowResGroups = (uint2(constants.lowResSize) + REDUCED_SSAO_GROUP_SIZE - 1) / REDUCED_SSAO_GROUP_SIZE;
+        const uint2 fullResGroups = (uint2(constants.fullResSize) + REDUCED_SSAO_GROUP_SIZE - 1) / REDUCED_SSAO_GROUP_SIZE;
+
+        commandList->setComputeState(downsampleState);
+        commandList->dispatch(lowResGroups.x, lowResGroups.y, 1);
+
+        commandList->setComputeState(aoState);
+        commandList->dispatch(lowResGroups.x, lowResGroups.y, 1);
+
+        commandList->setComputeState(temporalState);
+        commandList->dispatch(lowResGroups.x, lowResGroups.y, 1);
+
+        commandList->setComputeState(upsampleState);
+        commandList->dispatch(fullResGroups.x, fullResGroups.y, 1);
+    }
+
+    commandList->endMarker();
+
+    m_HistoryValid = true;
+    ++m_FrameIndex;
+}
+
+void ReducedResolutionSsaoPass::ResetBindingCache()
+{
+    m_BindingCache.Clear();
+}
@@ -0,0 +1,123 @@
+/*
+* Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <donut/core/math/math.h>
+#include <donut/engine/BindingCache.h>
+#include <nvrhi/nvrhi.h>
+#include <array>
+#include <climits>
+#include <memory>
+#include <vector>
+
+namespace donut::engine
+{
+    class IView;
+    class ShaderFactory;
+}
+
+namespace donut::render
+{
+    struct SsaoParameters;
+}
+
+// Computes screen space ambient occlusion at half or quarter resolution.
+//
+// Depth and normals are first reduced by picking one full resolution sample per block, alternating
+// between the nearest and the farthest one in a checkerboard. AO is then estimated with a few samples
+// per pixel in a pattern that rotates every frame, accumulated over frames by reprojecting the previous
+// result with the motion vectors, and finally upsampled to full resolution with depth and normal aware
+// weights. The SSAO parameters have the same meaning as for donut's full resolution SsaoPass.
+class ReducedResolutionSsaoPass
+{
+public:
+    struct Parameters
+    {
+        // 2 for half resolution, 4 for quarter resolution
+        uint32_t downsampleFactor = 2;
+        uint32_t numSamples = 8;
+        bool enableTemporalAccumulation = true;
+        // Longer histories average more samples but react slower to changes in dynamic scenes
+        float maxHistoryLength = 16.f;
+        // Relative view depth difference above which the history of a pixel is discarded
+        float depthRejection = 0.1f;
+        float upsampleSharpness = 32.f;
+        // Full resolution pixels at or to the right of this column are not written, for split screen comparisons
+        int splitPosition = INT_MAX;
+    };
+
+    struct Inputs
+    {
+        nvrhi::ITexture* depth = nullptr;
+        nvrhi::ITexture* gbufferNormals = nullptr;
+        nvrhi::ITexture* motionVectors = nullptr;
+        nvrhi::ITexture* output = nullptr;
+        // The normals are octahedral encoded in xy, as in the compact GBuffer
+        bool octahedralNormals = false;
+    };
+
+    ReducedResolutionSsaoPass(nvrhi::IDevice* device, const std::shared_ptr<donut::engine::ShaderFactory>& shaderFactory);
+
+    // Renders the AO for every planar child view of the view into the output.
+    void Render(nvrhi::ICommandList* commandList,
+        const donut::render::SsaoParameters& ssaoParams,
+        const Parameters& params,
+        const donut::engine::IView& view,
+        const Inputs& inputs);
+
+    // Makes the next frame start accumulating from scratch, e.g. when the motion vectors are not valid
+    void ResetHistory() { m_HistoryValid = false; }
+
+    void ResetBindingCache();
+
+    [[nodiscard]] donut::math::uint2 GetReducedSize() const { return m_ReducedSize; }
+
+private:
+    void CreateTextures(donut::math::uint2 size, uint32_t downsampleFactor);
+
+    nvrhi::DeviceHandle m_Device;
+
+    nvrhi::BindingLayoutHandle m_DownsampleBindingLayout;
+    nvrhi::BindingLayoutHandle m_AOBindingLayout;
+    nvrhi::BindingLayoutHandle m_TemporalBindingLayout;
+    nvrhi::BindingLayoutHandle m_UpsampleBindingLayout;
+    std::array<nvrhi::ComputePipelineHandle, 2> m_DownsamplePipelines;
+    nvrhi::ComputePipelineHandle m_AOPipeline;
+    nvrhi::ComputePipelineHandle m_TemporalPipeline;
+    std::array<nvrhi::ComputePipelineHandle, 2> m_UpsamplePipelines;
+    nvrhi::BufferHandle m_ConstantBuffer;
+    donut::engine::BindingCache m_BindingCache;
+
+    // Depth and accumulated AO are kept for two frames, the previous frame's copies are the history
+    std::array<nvrhi::TextureHandle, 2> m_LowDepth;
+    std::array<nvrhi::TextureHandle, 2> m_AccumulatedAO;
+    nvrhi::TextureHandle m_LowNormals;
+    nvrhi::TextureHandle m_RawAO;
+
+    donut::math::uint2 m_FullSize = 0;
+    donut::math::uint2 m_ReducedSize = 0;
+    uint32_t m_DownsampleFactor = 0;
+    uint32_t m_FrameIndex = 0;
+    bool m_HistoryValid = false;
+    std::vector<nvrhi::Viewport> m_PreviousViewports;
+};
@@ -0,0 +1,172 @@
+/*
+* Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#include "ShadowCache.h"
+
+#include <donut/engine/FramebufferFactory.h>
+#include <donut/engine/SceneGraph.h>
+#include <donut/render/CascadedShadowMap.h>
+#include <donut/render/DepthPass.h>
+#include <donut/render/GeometryPasses.h>
+
+#include <cstring>
+
+using namespace donut;
+using namespace donut::math;
+using namespace donut::engine;
+using namespace donut::render;
+
+void ShadowCasterDrawStrategy::PrepareForView(const std::shared_ptr<SceneGraphNode>& rootNode, const IView& view)
+{
+    m_Inner.PrepareForView(rootNode, view);
+}
+
+const DrawItem* ShadowCasterDrawStrategy::GetNextItem()
+{
+    while (const DrawItem* item = m_Inner.GetNextItem())
+    {
+        const bool dynamic = m_DynamicInstances.find(item->instance) != m_DynamicInstances.end();
+        if (dynamic == m_Dynamic)
+            return item;
+    }
+
+    return nullptr;
+}
+
+ShadowCache::ShadowCache(nvrhi::IDevice* device, const CascadedShadowMap& shadowMap, uint32_t numNearCascades)
+    : m_NumNearCascades(numNearCascades)
+{
+    nvrhi::TextureDesc desc = shadowMap.GetTexture()->getDesc();
+    desc.debugName = "ShadowCache/StaticDepth";
+    desc.initialState = nvrhi::ResourceStates::ShaderResource;
+    desc.keepInitialState = true;
+    m_StaticDepth = device->createTexture(desc);
+
+    m_StaticFramebuffer = std::make_shared<FramebufferFactory>(device);
+    m_StaticFramebuffer->DepthTarget = m_StaticDepth;
+
+    m_Cascades.resize(shadowMap.GetNumberOfCascades());
+}
+
+void ShadowCache::SetDynamicNodes(const SceneGraph& sceneGraph, const std::vector<std::shared_ptr<SceneGraphNode>>& animatedNodes)
+{
+    m_DynamicInstances.clear();
+
+    for (const auto& node : animatedNodes)
+    {
+        // Walk only the subtree of the animated node
+        for (SceneGraphWalker walker(node.get()); walker; walker.Next(true))
+        {
+            if (auto meshInstance = dynamic_cast<MeshInstance*>(walker->GetLeaf().get()))
+                m_DynamicInstances.insert(meshInstance);
+        }
+    }
+
+    for (const auto& skinnedInstance : sceneGraph.GetSkinnedMeshInstances())
+        m_DynamicInstances.insert(skinnedInstance.get());
+
+    InvalidateStaticGeometry();
+}
+
+void ShadowCache::InvalidateStaticGeometry()
+{
+    for (CascadeState& cascade : m_Cascades)
+        cascade.valid = false;
+}
+
+void ShadowCache::Render(
+    nvrhi::ICommandList* commandList,
+    CascadedShadowMap& shadowMap,
+    FramebufferFactory& shadowFramebuffer,
+    const std::shared_ptr<SceneGraphNode>& rootNode,
+    IDrawStrategy& drawStrategy,
+    DepthPass& depthPass,
+    bool materialEvents)
+{
+    m_Stats = Stats();
+
+    ShadowCasterDrawStrategy staticStrategy(drawStrategy, m_DynamicInstances, false);
+    ShadowCasterDrawStrategy dynamicStrategy(drawStrategy, m_DynamicInstances, true);
+
+    const uint32_t numCascades = uint32_t(m_Cascades.size());
+    const uint32_t numFarCascades = numCascades > m_NumNearCascades ? numCascades - m_NumNearCascades : 0;
+    const uint32_t roundRobinCascade = numFarCascades ? m_NumNearCascades + (m_NextFarCascade++ % numFarCascades) : ~0u;
+
+    for (uint32_t cascadeIndex = 0; cascadeIndex < numCascades; cascadeIndex++)
+    {
+        std::shared_ptr<IShadowMap> cascadeShadowMap = shadowMap.GetCascade(cascadeIndex);
+        const ICompositeView& cascadeView = cascadeShadowMap->GetView();
+        const IView* cascadePlanarView = cascadeView.GetChildView(ViewType::PLANAR, 0);
+        CascadeState& cascade = m_Cascades[cascadeIndex];
+
+        // Stable cascades only change their projection when the light moves or the cascade snaps
+        const float4x4 worldToUvzw = cascadeShadowMap->GetWorldToUvzwMatrix();
+        const bool moved = memcmp(&worldToUvzw, &cascade.worldToUvzw, sizeof(float4x4)) != 0;
+        const bool staticDirty = !cascade.valid || moved;
+
+        const float clearDepth = cascadePlanarView->IsReverseDepth() ? 0.f : 1.f;
+
+        if (staticDirty)
+        {
+            commandList->clearDepthStencilTexture(m_StaticDepth, cascadePlanarView->GetSubresources(), true, clearDepth, false, 0);
+
+            DepthPass::Context context;
+            RenderCompositeView(commandList,
+                &cascadeView, nullptr,
+                *m_StaticFramebuffer,
+                rootNode,
+                staticStrategy,
+                depthPass,
+                context,
+                "ShadowMap - Static",
+                materialEvents);
+
+            cascade.worldToUvzw = worldToUvzw;
+            cascade.valid = true;
+            ++m_Stats.staticCascadesRendered;
+        }
+
+        const bool updateDynamic = staticDirty || cascadeIndex < m_NumNearCascades || cascadeIndex == roundRobinCascade;
+        if (!updateDynamic)
+            continue;
+
+        nvrhi::TextureSlice slice;
+        slice.arraySlice = cascadePlanarView->GetSubresources().baseArraySlice;
+        commandList->copyTexture(shadowMap.GetTexture(), slice, m_StaticDepth, slice);
+
+        if (!m_DynamicInstances.empty())
+        {
+            DepthPass::Context context;
+            RenderCompositeView(commandList,
+                &cascadeView, nullptr,
+                shadowFramebuffer,
+                rootNode,
+                dynamicStrategy,
+                depthPass,
+                context,
+                "ShadowMap - Dynamic",
+                materialEvents);
+        }
+
+        ++m_Stats.dynamicCascadesRendered;
+    }
+}
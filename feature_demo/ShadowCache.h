@@ -0,0 +1,118 @@
+/*
+* Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <donut/core/math/math.h>
+#include <donut/render/DrawStrategy.h>
+#include <nvrhi/nvrhi.h>
+#include <memory>
+#include <unordered_set>
+#include <vector>
+
+namespace donut::engine
+{
+    class CommonRenderPasses;
+    class FramebufferFactory;
+    class MeshInstance;
+    class SceneGraph;
+    class SceneGraphNode;
+}
+
+namespace donut::render
+{
+    class CascadedShadowMap;
+    class DepthPass;
+}
+
+// Draw strategy that passes through either the static or the dynamic items of another strategy.
+class ShadowCasterDrawStrategy : public donut::render::IDrawStrategy
+{
+public:
+    ShadowCasterDrawStrategy(donut::render::IDrawStrategy& inner, const std::unordered_set<const donut::engine::MeshInstance*>& dynamicInstances, bool dynamic)
+        : m_Inner(inner)
+        , m_DynamicInstances(dynamicInstances)
+        , m_Dynamic(dynamic)
+    { }
+
+    void PrepareForView(const std::shared_ptr<donut::engine::SceneGraphNode>& rootNode, const donut::engine::IView& view) override;
+    const donut::engine::DrawItem* GetNextItem() override;
+
+private:
+    donut::render::IDrawStrategy& m_Inner;
+    const std::unordered_set<const donut::engine::MeshInstance*>& m_DynamicInstances;
+    bool m_Dynamic;
+};
+
+// Renders a cascaded shadow map with the static casters cached between frames.
+//
+// Static geometry is rendered into a separate depth array with one slice per cascade. A slice is
+// re-rendered only when its cascade projection changes, which happens when the light moves or the
+// stable cascade snaps to a new texel position, or when the static geometry is invalidated.
+// Every updated cascade is then restored from the cache with a copy, and the dynamic casters are
+// drawn on top. The near cascades get the dynamic casters every frame; the far cascades that didn't
+// move take turns, one per frame, and keep their previous contents in between.
+class ShadowCache
+{
+public:
+    struct Stats
+    {
+        uint32_t staticCascadesRendered = 0;
+        uint32_t dynamicCascadesRendered = 0;
+    };
+
+    ShadowCache(nvrhi::IDevice* device, const donut::render::CascadedShadowMap& shadowMap, uint32_t numNearCascades = 2);
+
+    // Finds the mesh instances that can move: skinned instances and everything under animated nodes.
+    void SetDynamicNodes(const donut::engine::SceneGraph& sceneGraph, const std::vector<std::shared_ptr<donut::engine::SceneGraphNode>>& animatedNodes);
+
+    // Forces all cached cascades to be re-rendered, e.g. after static objects or materials have changed.
+    void InvalidateStaticGeometry();
+
+    // Renders the cascades of the shadow map, which must have been set up for this frame.
+    void Render(
+        nvrhi::ICommandList* commandList,
+        donut::render::CascadedShadowMap& shadowMap,
+        donut::engine::FramebufferFactory& shadowFramebuffer,
+        const std::shared_ptr<donut::engine::SceneGraphNode>& rootNode,
+        donut::render::IDrawStrategy& drawStrategy,
+        donut::render::DepthPass& depthPass,
+        bool materialEvents);
+
+    [[nodiscard]] const Stats& GetStats() const { return m_Stats; }
+    [[nodiscard]] size_t GetNumDynamicInstances() const { return m_DynamicInstances.size(); }
+
+private:
+    struct CascadeState
+    {
+        donut::math::float4x4 worldToUvzw = donut::math::float4x4::identity();
+        bool valid = false;
+    };
+
+    nvrhi::TextureHandle m_StaticDepth;
+    std::shared_ptr<donut::engine::FramebufferFactory> m_StaticFramebuffer;
+    std::vector<CascadeState> m_Cascades;
+    std::unordered_set<const donut::engine::MeshInstance*> m_DynamicInstances;
+    uint32_t m_NumNearCascades;
+    uint32_t m_NextFarCascade = 0;
+    Stats m_Stats;
+};
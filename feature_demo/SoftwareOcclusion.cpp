@@ -0,0 +1,203 @@
+/*
+* Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#include "SoftwareOcclusion.h"
+
+#include <donut/engine/SceneGraph.h>
+#include <donut/engine/View.h>
+
+#include <algorithm>
+#include <unordered_map>
+
+using namespace donut;
+using namespace donut::math;
+using namespace donut::engine;
+using namespace donut::render;
+
+#ifdef DONUT_WITH_TASKFLOW
+SoftwareOcclusionCuller::SoftwareOcclusionCuller(const Parameters& params, tf::Executor* executor)
+    : m_Params(params)
+    , m_Executor(executor)
+#else
+SoftwareOcclusionCuller::SoftwareOcclusionCuller(const Parameters& params)
+    : m_Params(params)
+#endif
+{
+}
+
+void SoftwareOcclusionCuller::Clear()
+{
+    m_Occluders.clear();
+    m_Meshes.clear();
+    m_NumOccluderTriangles = 0;
+    m_ViewStats.clear();
+}
+
+void SoftwareOcclusionCuller::SelectOccluders(const SceneGraph& sceneGraph)
+{
+    Clear();
+
+    struct Candidate
+    {
+        const MeshInstance* instance;
+        float size;
+        uint32_t numTriangles;
+    };
+
+    const float sceneSize = length(sceneGraph.GetRootNode()->GetGlobalBoundingBox().diagonal());
+    std::vector<Candidate> candidates;
+
+    for (const auto& instance : sceneGraph.GetMeshInstances())
+    {
+        const MeshInfo* mesh = instance->GetMesh().get();
+
+        // Skinned vertices only exist on the GPU
+        if (mesh->skinPrototype || mesh->buffers->positionData.empty() || mesh->buffers->indexData.empty())
+            continue;
+
+        uint32_t numTriangles = 0;
+        for (const auto& geometry : mesh->geometries)
+        {
+            if (geometry->material && geometry->material->domain == MaterialDomain::Opaque)
+                numTriangles += geometry->numIndices / 3;
+        }
+
+        if (numTriangles == 0 || numTriangles > m_Params.maxTrianglesPerOccluder)
+            continue;
+
+        const box3 bounds = mesh->objectSpaceBounds * instance->GetNode()->GetLocalToWorldTransformFloat();
+        const float size = length(bounds.diagonal());
+        if (size < m_Params.minOccluderSize * sceneSize)
+            continue;
+
+        candidates.push_back({ instance.get(), size, numTriangles });
+    }
+
+    // Stable, so that equally sized instances keep the scene graph order
+    std::stable_sort(candidates.begin(), candidates.end(),
+        [](const Candidate& a, const Candidate& b) { return a.size > b.size; });
+
+    // Instances of the same mesh share the triangle data
+    std::unordered_map<const MeshInfo*, std::shared_ptr<OccluderMesh>> meshes;
+
+    for (const Candidate& candidate : candidates)
+    {
+        if (m_NumOccluderTriangles + candidate.numTriangles > m_Params.maxTotalTriangles)
+            continue;
+
+        const MeshInfo* mesh = candidate.instance->GetMesh().get();
+        std::shared_ptr<OccluderMesh>& occluderMesh = meshes[mesh];
+
+        if (!occluderMesh)
+        {
+            occluderMesh = std::make_shared<OccluderMesh>();
+
+            for (const auto& geometry : mesh->geometries)
+            {
+                if (!geometry->material || geometry->material->domain != MaterialDomain::Opaque)
+                    continue;
+
+                // Indices are relative to the first vertex of the geometry
+                const uint32_t firstVertex = mesh->vertexOffset + geometry->vertexOffsetInMesh;
+                const uint32_t firstIndex = mesh->indexOffset + geometry->indexOffsetInMesh;
+                const uint32_t baseVertex = uint32_t(occluderMesh->positions.size());
+
+                occluderMesh->positions.insert(occluderMesh->positions.end(),
+                    mesh->buffers->positionData.begin() + firstVertex,
+                    mesh->buffers->positionData.begin() + firstVertex + geometry->numVertices);
+
+                for (uint32_t index = 0; index < geometry->numIndices / 3 * 3; index++)
+                    occluderMesh->indices.push_back(baseVertex + mesh->buffers->indexData[firstIndex + index]);
+            }
+        }
+
+        Occluder occluder;
+        occluder.instance = candidate.instance;
+        occluder.mesh = occluderMesh;
+        m_Occluders.push_back(occluder);
+        m_NumOccluderTriangles += candidate.numTriangles;
+    }
+
+    m_Meshes.resize(m_Occluders.size());
+}
+
+void SoftwareOcclusionCuller::RenderOccluders(const IView& view)
+{
+    const nvrhi::Viewport& viewport = view.GetViewportState().viewports[0];
+    const float aspect = viewport.width() > 0.f ? viewport.height() / viewport.width() : 1.f;
+    m_Rasterizer.SetResolution(m_Params.resolution, uint32_t(float(m_Params.resolution) * aspect));
+    m_Rasterizer.Clear(view.IsReverseDepth());
+
+    m_WorldToClip = view.GetViewProjectionMatrix();
+
+    // The transforms are read every frame, so moving occluders work
+    for (size_t index = 0; index < m_Occluders.size(); index++)
+    {
+        const Occluder& occluder = m_Occluders[index];
+        MaskedOcclusionRasterizer::Mesh& mesh = m_Meshes[index];
+        mesh.positions = occluder.mesh->positions.data();
+        mesh.indices = occluder.mesh->indices.data();
+        mesh.numTriangles = uint32_t(occluder.mesh->indices.size() / 3);
+        mesh.objectToClip = affineToHomogeneous(occluder.instance->GetNode()->GetLocalToWorldTransformFloat()) * m_WorldToClip;
+    }
+
+#ifdef DONUT_WITH_TASKFLOW
+    m_Rasterizer.RenderOccluders(m_Meshes, m_Executor);
+#else
+    m_Rasterizer.RenderOccluders(m_Meshes);
+#endif
+
+    m_ViewStats.push_back(ViewStats());
+}
+
+bool SoftwareOcclusionCuller::IsVisible(const DrawItem& item)
+{
+    const box3 bounds = item.geometry->objectSpaceBounds * item.instance->GetNode()->GetLocalToWorldTransformFloat();
+    const bool visible = m_Rasterizer.TestBox(bounds, m_WorldToClip);
+
+    if (!m_ViewStats.empty())
+    {
+        ViewStats& stats = m_ViewStats.back();
+        ++stats.numTested;
+        if (!visible)
+            ++stats.numRejected;
+    }
+
+    return visible;
+}
+
+void SoftwareOcclusionDrawStrategy::PrepareForView(const std::shared_ptr<SceneGraphNode>& rootNode, const IView& view)
+{
+    m_Inner.PrepareForView(rootNode, view);
+    m_Culler.RenderOccluders(view);
+}
+
+const DrawItem* SoftwareOcclusionDrawStrategy::GetNextItem()
+{
+    while (const DrawItem* item = m_Inner.GetNextItem())
+    {
+        if (m_Culler.IsVisible(*item))
+            return item;
+    }
+
+    return nullptr;
+}
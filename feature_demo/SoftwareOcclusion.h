@@ -0,0 +1,129 @@
+/*
+* Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <donut/core/math/math.h>
+#include <donut/render/DrawStrategy.h>
+#include <MaskedOcclusionRasterizer.h>
+#include <memory>
+#include <vector>
+
+namespace donut::engine
+{
+    class IView;
+    class MeshInstance;
+    class SceneGraph;
+    class SceneGraphNode;
+}
+
+// CPU occlusion culling of draw items, for configurations without the GPU culling pass (D3D11).
+//
+// A few large, low-poly mesh instances are picked from the scene as occluders: everything whose
+// bounds are large compared to the scene, biggest first, until the triangle budget is used up.
+// For every view, their opaque geometry is rasterized with MaskedOcclusionRasterizer at a low
+// resolution, and the world-space bounds of the draw items are tested against the result. The
+// rejected share of the tested items is kept per view.
+class SoftwareOcclusionCuller
+{
+public:
+    struct Parameters
+    {
+        // Minimum diagonal of an occluder's bounds, relative to the diagonal of the scene bounds
+        float minOccluderSize = 0.05f;
+        uint32_t maxTrianglesPerOccluder = 2048;
+        uint32_t maxTotalTriangles = 32768;
+        // Width of the depth buffer; the height follows the aspect of the view
+        uint32_t resolution = 256;
+    };
+
+    struct ViewStats
+    {
+        uint32_t numTested = 0;
+        uint32_t numRejected = 0;
+    };
+
+#ifdef DONUT_WITH_TASKFLOW
+    explicit SoftwareOcclusionCuller(const Parameters& params = Parameters(), tf::Executor* executor = nullptr);
+#else
+    explicit SoftwareOcclusionCuller(const Parameters& params = Parameters());
+#endif
+
+    // Picks the occluders, call after loading the scene
+    void SelectOccluders(const donut::engine::SceneGraph& sceneGraph);
+    void Clear();
+
+    // Starts a new list of view statistics
+    void BeginFrame() { m_ViewStats.clear(); }
+
+    // Rasterizes the occluders for a planar view and starts its statistics
+    void RenderOccluders(const donut::engine::IView& view);
+
+    // Tests the bounds of the item against the occluders of the last view
+    [[nodiscard]] bool IsVisible(const donut::engine::DrawItem& item);
+
+    [[nodiscard]] const std::vector<ViewStats>& GetViewStats() const { return m_ViewStats; }
+    [[nodiscard]] uint32_t GetNumOccluders() const { return uint32_t(m_Occluders.size()); }
+    [[nodiscard]] uint32_t GetNumOccluderTriangles() const { return m_NumOccluderTriangles; }
+
+private:
+    // Object space triangles of the opaque geometries of a mesh
+    struct OccluderMesh
+    {
+        std::vector<donut::math::float3> positions;
+        std::vector<uint32_t> indices;
+    };
+
+    struct Occluder
+    {
+        const donut::engine::MeshInstance* instance = nullptr;
+        std::shared_ptr<OccluderMesh> mesh;
+    };
+
+    Parameters m_Params;
+#ifdef DONUT_WITH_TASKFLOW
+    tf::Executor* m_Executor;
+#endif
+    MaskedOcclusionRasterizer m_Rasterizer;
+    std::vector<Occluder> m_Occluders;
+    std::vector<MaskedOcclusionRasterizer::Mesh> m_Meshes;
+    uint32_t m_NumOccluderTriangles = 0;
+    donut::math::float4x4 m_WorldToClip = donut::math::float4x4::identity();
+    std::vector<ViewStats> m_ViewStats;
+};
+
+// Draw strategy that drops the items of another strategy which the culler finds occluded.
+class SoftwareOcclusionDrawStrategy : public donut::render::IDrawStrategy
+{
+public:
+    SoftwareOcclusionDrawStrategy(donut::render::IDrawStrategy& inner, SoftwareOcclusionCuller& culler)
+        : m_Inner(inner)
+        , m_Culler(culler)
+    { }
+
+    void PrepareForView(const std::shared_ptr<donut::engine::SceneGraphNode>& rootNode, const donut::engine::IView& view) override;
+    const donut::engine::DrawItem* GetNextItem() override;
+
+private:
+    donut::render::IDrawStrategy& m_Inner;
+    SoftwareOcclusionCuller& m_Culler;
+};
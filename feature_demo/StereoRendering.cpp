@@ -0,0 +1,141 @@
+/*
+* Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#include "StereoRendering.h"
+
+#include <donut/engine/SceneGraph.h>
+#include <donut/engine/ShaderFactory.h>
+#include <nvrhi/utils.h>
+
+#include <cassert>
+#include <cmath>
+
+using namespace donut;
+using namespace donut::math;
+using namespace donut::engine;
+using namespace donut::render;
+
+#include "stereo_gbuffer_cb.h"
+
+void SharedCullingDrawStrategy::PrepareForView(const std::shared_ptr<SceneGraphNode>& rootNode, const IView& view)
+{
+    if (!m_Prepared)
+    {
+        m_Inner.PrepareForView(rootNode, m_CullingView);
+
+        while (const DrawItem* item = m_Inner.GetNextItem())
+            m_Items.push_back(*item);
+
+        m_Prepared = true;
+    }
+
+    m_NextItem = 0;
+}
+
+const DrawItem* SharedCullingDrawStrategy::GetNextItem()
+{
+    if (m_NextItem < m_Items.size())
+        return &m_Items[m_NextItem++];
+
+    return nullptr;
+}
+
+void SetupStereoCullingView(
+    PlanarView& cullingView,
+    const affine3& leftViewMatrix,
+    float eyeSeparation,
+    float verticalFov,
+    float eyeAspectRatio,
+    float zNear,
+    const nvrhi::Viewport& viewport)
+{
+    // Distance behind the eyes where the outer side planes of the two frustums intersect
+    const float tanHalfFovX = tanf(verticalFov * 0.5f) * eyeAspectRatio;
+    const float pullBack = eyeSeparation * 0.5f / tanHalfFovX;
+
+    // Move the origin to the midpoint between the eyes, then back along the view direction
+    affine3 viewMatrix = leftViewMatrix;
+    viewMatrix.m_translation -= float3(eyeSeparation * 0.5f, 0.f, 0.f);
+    viewMatrix.m_translation += float3(0.f, 0.f, pullBack);
+
+    float4x4 projection = perspProjD3DStyleReverse(verticalFov, eyeAspectRatio, zNear + pullBack);
+
+    cullingView.SetViewport(viewport);
+    cullingView.SetMatrices(viewMatrix, projection);
+    cullingView.UpdateCache();
+}
+
+void StereoGBufferFillPass::Init(ShaderFactory& shaderFactory, const CreateParameters& params)
+{
+    // The vertex shader reads the instance data from buffers to index it by half the instance ID
+    CreateParameters stereoParams = params;
+    stereoParams.useInputAssembler = false;
+    // Without motion vectors, leave the stencil clear so that TAA computes camera motion for all pixels
+    stereoParams.enableMotionVectors = false;
+    stereoParams.stencilWriteMask = 0;
+    stereoParams.enableSinglePassCubemap = false;
+
+    GBufferFillPass::Init(shaderFactory, stereoParams);
+}
+
+void StereoGBufferFillPass::SetStereoView(const StereoPlanarView* view, const StereoPlanarView* viewPrev)
+{
+    m_StereoView = view;
+    m_StereoViewPrev = viewPrev;
+}
+
+void StereoGBufferFillPass::SetupView(GeometryPassContext& context, nvrhi::ICommandList* commandList, const IView* view, const IView* viewPrev)
+{
+    assert(m_StereoView && m_StereoViewPrev);
+
+    // Let the base class set up the pipeline key from the left eye, then replace the view constants
+    GBufferFillPass::SetupView(context, commandList, &m_StereoView->LeftView, &m_StereoViewPrev->LeftView);
+
+    StereoGBufferFillConstants constants = {};
+    m_StereoView->LeftView.FillPlanarViewConstants(constants.eyes[0].view);
+    m_StereoViewPrev->LeftView.FillPlanarViewConstants(constants.eyes[0].viewPrev);
+    m_StereoView->RightView.FillPlanarViewConstants(constants.eyes[1].view);
+    m_StereoViewPrev->RightView.FillPlanarViewConstants(constants.eyes[1].viewPrev);
+    commandList->writeBuffer(m_GBufferCB, &constants, sizeof(constants));
+}
+
+void StereoGBufferFillPass::SetPushConstants(GeometryPassContext& context, nvrhi::ICommandList* commandList, nvrhi::GraphicsState& state, nvrhi::DrawArguments& args)
+{
+    GBufferFillPass::SetPushConstants(context, commandList, state, args);
+
+    // One instance per eye
+    args.instanceCount *= 2;
+}
+
+nvrhi::ShaderHandle StereoGBufferFillPass::CreateVertexShader(ShaderFactory& shaderFactory, const CreateParameters& params)
+{
+    return shaderFactory.CreateShader("app/stereo_gbuffer_vs.hlsl", "buffer_loads", nullptr, nvrhi::ShaderType::Vertex);
+}
+
+void StereoGBufferFillPass::CreateViewBindings(nvrhi::BindingLayoutHandle& layout, nvrhi::BindingSetHandle& set, const CreateParameters& params)
+{
+    // The view constant buffer holds both eyes
+    m_GBufferCB = m_Device->createBuffer(nvrhi::utils::CreateVolatileConstantBufferDesc(sizeof(StereoGBufferFillConstants),
+        "StereoGBufferFillConstants", params.numConstantBufferVersions));
+
+    GBufferFillPass::CreateViewBindings(layout, set, params);
+}
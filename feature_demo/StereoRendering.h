@@ -0,0 +1,95 @@
+/*
+* Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <donut/engine/View.h>
+#include <donut/render/DrawStrategy.h>
+#include <donut/render/GBufferFillPass.h>
+#include <memory>
+#include <vector>
+
+// Draw strategy that culls the scene once against a view enclosing both eyes of a stereo view,
+// and then returns the same items for every child view that the composite view is rendered with.
+// Create one instance per RenderCompositeView call.
+class SharedCullingDrawStrategy : public donut::render::IDrawStrategy
+{
+public:
+    SharedCullingDrawStrategy(donut::render::IDrawStrategy& inner, const donut::engine::IView& cullingView)
+        : m_Inner(inner)
+        , m_CullingView(cullingView)
+    { }
+
+    void PrepareForView(const std::shared_ptr<donut::engine::SceneGraphNode>& rootNode, const donut::engine::IView& view) override;
+    const donut::engine::DrawItem* GetNextItem() override;
+
+private:
+    donut::render::IDrawStrategy& m_Inner;
+    const donut::engine::IView& m_CullingView;
+    std::vector<donut::engine::DrawItem> m_Items;
+    size_t m_NextItem = 0;
+    bool m_Prepared = false;
+};
+
+// Sets up a single frustum that contains the frustums of both eyes, for eyes that share the orientation
+// and projection of the left view and are separated by eyeSeparation along the view X axis.
+// The combined view is pulled back behind the eyes so that its side planes pass through the outer ones,
+// and its viewport covers both eyes.
+void SetupStereoCullingView(
+    donut::engine::PlanarView& cullingView,
+    const donut::math::affine3& leftViewMatrix,
+    float eyeSeparation,
+    float verticalFov,
+    float eyeAspectRatio,
+    float zNear,
+    const nvrhi::Viewport& viewport);
+
+// GBuffer fill pass that renders both eyes of a StereoPlanarView in one pass using instanced stereo.
+//
+// The pass is rendered with the combined culling view, so the scene is traversed and the draws are
+// recorded once. Every draw gets twice the instances, and the vertex shader picks the eye from the
+// instance ID. Motion vectors are not supported because the pixel shader only knows the first eye.
+class StereoGBufferFillPass : public donut::render::GBufferFillPass
+{
+public:
+    StereoGBufferFillPass(nvrhi::IDevice* device, std::shared_ptr<donut::engine::CommonRenderPasses> commonPasses)
+        : GBufferFillPass(device, std::move(commonPasses))
+    { }
+
+    void Init(donut::engine::ShaderFactory& shaderFactory, const CreateParameters& params) override;
+
+    // Sets the stereo view whose eyes are rendered by the next SetupView call.
+    void SetStereoView(const donut::engine::StereoPlanarView* view, const donut::engine::StereoPlanarView* viewPrev);
+
+    void SetupView(donut::render::GeometryPassContext& context, nvrhi::ICommandList* commandList,
+        const donut::engine::IView* view, const donut::engine::IView* viewPrev) override;
+    void SetPushConstants(donut::render::GeometryPassContext& context, nvrhi::ICommandList* commandList,
+        nvrhi::GraphicsState& state, nvrhi::DrawArguments& args) override;
+
+protected:
+    nvrhi::ShaderHandle CreateVertexShader(donut::engine::ShaderFactory& shaderFactory, const CreateParameters& params) override;
+    void CreateViewBindings(nvrhi::BindingLayoutHandle& layout, nvrhi::BindingSetHandle& set, const CreateParameters& params) override;
+
+private:
+    const donut::engine::StereoPlanarView* m_StereoView = nullptr;
+    const donut::engine::StereoPlanarView* m_StereoViewPrev = nullptr;
+};
@@ -0,0 +1,339 @@
+/*
+* Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#include "TiledLightingPass.h"
+
+#include <donut/engine/CommonRenderPasses.h>
+#include <donut/engine/SceneGraph.h>
+#include <donut/engine/ShaderFactory.h>
+#include <donut/engine/View.h>
+#include <donut/render/GBuffer.h>
+#include <donut/shaders/light_types.h>
+#include <nvrhi/utils.h>
+#include <ReadbackQueue.h>
+
+#include <algorithm>
+
+using namespace donut;
+using namespace donut::math;
+using namespace donut::engine;
+using namespace donut::render;
+
+#include <donut/shaders/light_cb.h>
+#include "tiled_lighting_cb.h"
+
+void TiledLightingPass::Inputs::SetGBuffer(const GBufferRenderTargets& targets)
+{
+    depth = targets.Depth;
+    gbufferDiffuse = targets.GBufferDiffuse;
+    gbufferSpecular = targets.GBufferSpecular;
+    gbufferNormals = targets.GBufferNormals;
+    gbufferEmissive = targets.GBufferEmissive;
+}
+
+TiledLightingPass::TiledLightingPass(nvrhi::IDevice* device, const std::shared_ptr<ShaderFactory>& shaderFactory,
+    ReadbackQueue* readbackQueue)
+    : m_Device(device)
+    , m_ReadbackQueue(readbackQueue)
+    , m_BindingCache(device)
+    , m_Feedback(std::make_shared<Feedback>())
+{
+    std::vector<ShaderMacro> cullDefines = { { "CULL_LIGHTS", "1" } };
+    m_CullShader = shaderFactory->CreateShader("app/tiled_lighting.hlsl", "cull_cs", &cullDefines, nvrhi::ShaderType::Compute);
+
+    std::vector<ShaderMacro> shadeDefines = { { "CULL_LIGHTS", "0" }, { "COMPACT_GBUFFER", "0" } };
+    m_ShadeShader = shaderFactory->CreateShader("app/tiled_lighting.hlsl", "shade_cs", &shadeDefines, nvrhi::ShaderType::Compute);
+
+    shadeDefines = { { "CULL_LIGHTS", "0" }, { "COMPACT_GBUFFER", "1" } };
+    m_CompactShadeShader = shaderFactory->CreateShader("app/tiled_lighting.hlsl", "shade_cs", &shadeDefines, nvrhi::ShaderType::Compute);
+
+    nvrhi::BindingLayoutDesc layoutDesc;
+    layoutDesc.visibility = nvrhi::ShaderType::Compute;
+    layoutDesc.bindings = {
+        nvrhi::BindingLayoutItem::VolatileConstantBuffer(0),
+        nvrhi::BindingLayoutItem::Texture_SRV(0),
+        nvrhi::BindingLayoutItem::StructuredBuffer_SRV(1),
+        nvrhi::BindingLayoutItem::StructuredBuffer_UAV(0),
+        nvrhi::BindingLayoutItem::StructuredBuffer_UAV(1)
+    };
+    m_CullBindingLayout = m_Device->createBindingLayout(layoutDesc);
+
+    layoutDesc.bindings = {
+        nvrhi::BindingLayoutItem::VolatileConstantBuffer(0),
+        nvrhi::BindingLayoutItem::Texture_SRV(0),
+        nvrhi::BindingLayoutItem::Texture_SRV(1),
+        nvrhi::BindingLayoutItem::Texture_SRV(2),
+        nvrhi::BindingLayoutItem::Texture_SRV(3),
+        nvrhi::BindingLayoutItem::Texture_SRV(4),
+        nvrhi::BindingLayoutItem::StructuredBuffer_SRV(5),
+        nvrhi::BindingLayoutItem::StructuredBuffer_SRV(6),
+        nvrhi::BindingLayoutItem::Texture_UAV(0)
+    };
+    m_ShadeBindingLayout = m_Device->createBindingLayout(layoutDesc);
+
+    nvrhi::ComputePipelineDesc pipelineDesc;
+    pipelineDesc.CS = m_CullShader;
+    pipelineDesc.bindingLayouts = { m_CullBindingLayout };
+    m_CullPipeline = m_Device->createComputePipeline(pipelineDesc);
+
+    pipelineDesc.CS = m_ShadeShader;
+    pipelineDesc.bindingLayouts = { m_ShadeBindingLayout };
+    m_ShadePipeline = m_Device->createComputePipeline(pipelineDesc);
+
+    pipelineDesc.CS = m_CompactShadeShader;
+    m_CompactShadePipeline = m_Device->createComputePipeline(pipelineDesc);
+
+    m_ConstantBuffer = m_Device->createBuffer(nvrhi::utils::CreateVolatileConstantBufferDesc(
+        sizeof(TiledLightingConstants), "TiledLightingConstants", engine::c_MaxRenderPassConstantBufferVersions));
+
+    nvrhi::BufferDesc counterDesc;
+    counterDesc.byteSize = sizeof(uint32_t) * TILED_LIGHTING_NUM_COUNTERS;
+    counterDesc.structStride = sizeof(uint32_t);
+    counterDesc.canHaveUAVs = true;
+    counterDesc.initialState = nvrhi::ResourceStates::UnorderedAccess;
+    counterDesc.keepInitialState = true;
+    counterDesc.debugName = "TiledLighting/Counters";
+    m_Counters = m_Device->createBuffer(counterDesc);
+}
+
+bool TiledLightingPass::IsLocalLight(const Light& light)
+{
+    const int lightType = light.GetLightType();
+    return lightType == LightType_Point || lightType == LightType_Spot;
+}
+
+// Returns the range of a local light, or 0 if the light has no range limit.
+static float GetLightRange(const Light& light)
+{
+    if (auto pointLight = dynamic_cast<const PointLight*>(&light))
+        return pointLight->range;
+    if (auto spotLight = dynamic_cast<const SpotLight*>(&light))
+        return spotLight->range;
+    return 0.f;
+}
+
+void TiledLightingPass::SetLights(const std::vector<std::shared_ptr<Light>>& lights, std::vector<std::shared_ptr<Light>>& otherLights)
+{
+    m_LocalLights.clear();
+    otherLights.clear();
+
+    for (const auto& light : lights)
+    {
+        if (IsLocalLight(*light))
+            m_LocalLights.push_back(light);
+        else
+            otherLights.push_back(light);
+    }
+
+    m_Stats.numLocalLights = uint32_t(m_LocalLights.size());
+}
+
+void TiledLightingPass::Render(nvrhi::ICommandList* commandList, const IView& view, const Inputs& inputs)
+{
+    m_Stats.numTiles = 0;
+    m_Stats.numOverflowTiles = m_Feedback->numOverflowTiles;
+    m_Stats.maxTileLights = m_Feedback->maxTileLights;
+
+    if (m_LocalLights.empty())
+    {
+        m_Feedback->numOverflowTiles = 0;
+        m_Feedback->maxTileLights = 0;
+        return;
+    }
+
+    commandList->beginMarker("TiledLighting");
+
+    // Upload the light constants and the bounding spheres used for culling
+    std::vector<LightConstants> lightConstants(m_LocalLights.size());
+    std::vector<float4> lightSpheres(m_LocalLights.size());
+    for (size_t i = 0; i < m_LocalLights.size(); i++)
+    {
+        const Light& light = *m_LocalLights[i];
+        light.FillLightConstants(lightConstants[i]);
+
+        const float range = GetLightRange(light);
+        lightSpheres[i] = float4(float3(light.GetPosition()), range > 0.f ? range : -1.f);
+    }
+
+    const uint32_t numLights = uint32_t(m_LocalLights.size());
+    if (!m_LightBuffer || m_LightBuffer->getDesc().byteSize < numLights * sizeof(LightConstants))
+    {
+        uint32_t capacity = 64;
+        while (capacity < numLights)
+            capacity *= 2;
+
+        nvrhi::BufferDesc bufferDesc;
+        bufferDesc.byteSize = capacity * sizeof(LightConstants);
+        bufferDesc.structStride = sizeof(LightConstants);
+        bufferDesc.initialState = nvrhi::ResourceStates::ShaderResource;
+        bufferDesc.keepInitialState = true;
+        bufferDesc.debugName = "TiledLighting/Lights";
+        m_LightBuffer = m_Device->createBuffer(bufferDesc);
+
+        bufferDesc.byteSize = capacity * sizeof(float4);
+        bufferDesc.structStride = sizeof(float4);
+        bufferDesc.debugName = "TiledLighting/LightSpheres";
+        m_LightSphereBuffer = m_Device->createBuffer(bufferDesc);
+
+        m_BindingCache.Clear();
+    }
+
+    commandList->writeBuffer(m_LightBuffer, lightConstants.data(), lightConstants.size() * sizeof(LightConstants));
+    commandList->writeBuffer(m_LightSphereBuffer, lightSpheres.data(), lightSpheres.size() * sizeof(float4));
+
+    // Lay out the tile lists of all child views one after another
+    const uint32_t numViews = view.GetNumChildViews(ViewType::PLANAR);
+    std::vector<TiledLightingConstants> viewConstants(numViews);
+    uint32_t numTiles = 0;
+    for (uint32_t viewIndex = 0; viewIndex < numViews; viewIndex++)
+    {
+        const IView* planarView = view.GetChildView(ViewType::PLANAR, viewIndex);
+
+        TiledLightingConstants& constants = viewConstants[viewIndex];
+        planarView->FillPlanarViewConstants(constants.view);
+        constants.tileCount = (uint2(constants.view.viewportSize) + TILED_LIGHTING_TILE_SIZE - 1) / TILED_LIGHTING_TILE_SIZE;
+        constants.numLights = numLights;
+        constants.tileListOffset = numTiles;
+        constants.reverseDepth = planarView->IsReverseDepth() ? 1 : 0;
+
+        numTiles += constants.tileCount.x * constants.tileCount.y;
+    }
+
+    m_Stats.numTiles = numTiles;
+
+    if (!m_TileLightBuffer || m_TileLightBuffer->getDesc().byteSize < numTiles * TILED_LIGHTING_TILE_STRIDE * sizeof(uint32_t))
+    {
+        nvrhi::BufferDesc bufferDesc;
+        bufferDesc.byteSize = numTiles * TILED_LIGHTING_TILE_STRIDE * sizeof(uint32_t);
+        bufferDesc.structStride = sizeof(uint32_t);
+        bufferDesc.canHaveUAVs = true;
+        bufferDesc.initialState = nvrhi::ResourceStates::ShaderResource;
+        bufferDesc.keepInitialState = true;
+        bufferDesc.debugName = "TiledLighting/TileLights";
+        m_TileLightBuffer = m_Device->createBuffer(bufferDesc);
+
+        m_BindingCache.Clear();
+    }
+
+    nvrhi::BindingSetDesc cullBindings;
+    cullBindings.bindings = {
+        nvrhi::BindingSetItem::ConstantBuffer(0, m_ConstantBuffer),
+        nvrhi::BindingSetItem::Texture_SRV(0, inputs.depth),
+        nvrhi::BindingSetItem::StructuredBuffer_SRV(1, m_LightSphereBuffer),
+        nvrhi::BindingSetItem::StructuredBuffer_UAV(0, m_TileLightBuffer),
+        nvrhi::BindingSetItem::StructuredBuffer_UAV(1, m_Counters)
+    };
+
+    nvrhi::BindingSetDesc shadeBindings;
+    shadeBindings.bindings = {
+        nvrhi::BindingSetItem::ConstantBuffer(0, m_ConstantBuffer),
+        nvrhi::BindingSetItem::Texture_SRV(0, inputs.depth),
+        nvrhi::BindingSetItem::Texture_SRV(1, inputs.gbufferDiffuse),
+        nvrhi::BindingSetItem::Texture_SRV(2, inputs.gbufferSpecular),
+        nvrhi::BindingSetItem::Texture_SRV(3, inputs.gbufferNormals),
+        nvrhi::BindingSetItem::Texture_SRV(4, inputs.gbufferEmissive),
+        nvrhi::BindingSetItem::StructuredBuffer_SRV(5, m_LightBuffer),
+        nvrhi::BindingSetItem::StructuredBuffer_SRV(6, m_TileLightBuffer),
+        nvrhi::BindingSetItem::Texture_UAV(0, inputs.output)
+    };
+
+    nvrhi::ComputeState cullState;
+    cullState.pipeline = m_CullPipeline;
+    cullState.bindings = { m_BindingCache.GetOrCreateBindingSet(cullBindings, m_CullBindingLayout) };
+
+    nvrhi::ComputeState shadeState;
+    shadeState.pipeline = inputs.compactGBuffer ? m_CompactShadePipeline : m_ShadePipeline;
+    shadeState.bindings = { m_BindingCache.GetOrCreateBindingSet(shadeBindings, m_ShadeBindingLayout) };
+
+    commandList->clearBufferUInt(m_Counters, 0);
+
+    // The views write disjoint ranges of the tile lists and only add to the counters,
+    // so the culling dispatches don't need barriers between them
+    commandList->setEnableUavBarriersForBuffer(m_TileLightBuffer, false);
+    commandList->setEnableUavBarriersForBuffer(m_Counters, false);
+    for (const TiledLightingConstants& constants : viewConstants)
+    {
+        commandList->writeBuffer(m_ConstantBuffer, &constants, sizeof(constants));
+        commandList->setComputeState(cullState);
+        commandList->dispatch(constants.tileCount.x, constants.tileCount.y, 1);
+    }
+    commandList->setEnableUavBarriersForBuffer(m_TileLightBuffer, true);
+    commandList->setEnableUavBarriersForBuffer(m_Counters, true);
+
+    const std::weak_ptr<Feedback> feedback = m_Feedback;
+    m_ReadbackQueue->ReadBuffer(commandList, m_Counters, 0, sizeof(uint32_t) * TILED_LIGHTING_NUM_COUNTERS,
+        [feedback](const void* data, size_t)
+        {
+            std::shared_ptr<Feedback> target = feedback.lock();
+            if (!target)
+                return;
+
+            const uint32_t* counters = static_cast<const uint32_t*>(data);
+            target->numOverflowTiles = counters[TILED_LIGHTING_COUNTER_OVERFLOW_TILES];
+            target->maxTileLights = counters[TILED_LIGHTING_COUNTER_MAX_TILE_LIGHTS];
+        });
+
+    for (const TiledLightingConstants& constants : viewConstants)
+    {
+        commandList->writeBuffer(m_ConstantBuffer, &constants, sizeof(constants));
+        commandList->setComputeState(shadeState);
+        commandList->dispatch(constants.tileCount.x, constants.tileCount.y, 1);
+    }
+
+    commandList->endMarker();
+}
+
+void TiledLightingPass::ResetBindingCache()
+{
+    m_BindingCache.Clear();
+}
+
+void TiledLightingPass::SelectForwardLights(const IView& view, const std::vector<std::shared_ptr<Light>>& lights, std::vector<std::shared_ptr<Light>>& result)
+{
+    result.clear();
+
+    const frustum viewFrustum = view.GetViewFrustum();
+    const double3 viewOrigin = double3(view.GetViewOrigin());
+
+    std::vector<std::pair<double, std::shared_ptr<Light>>> localLights;
+    for (const auto& light : lights)
+    {
+        if (!IsLocalLight(*light))
+        {
+            result.push_back(light);
+            continue;
+        }
+
+        const float3 position = float3(light->GetPosition());
+        const float range = GetLightRange(*light);
+        if (range > 0.f && !viewFrustum.intersectsWith(box3(position - range, position + range)))
+            continue;
+
+        localLights.emplace_back(lengthSquared(light->GetPosition() - viewOrigin), light);
+    }
+
+    std::sort(localLights.begin(), localLights.end(),
+        [](const auto& a, const auto& b) { return a.first < b.first; });
+
+    for (const auto& [distanceSquared, light] : localLights)
+        result.push_back(light);
+}
@@ -0,0 +1,131 @@
+/*
+* Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <donut/core/math/math.h>
+#include <donut/engine/BindingCache.h>
+#include <nvrhi/nvrhi.h>
+#include <memory>
+#include <vector>
+
+namespace donut::engine
+{
+    class IView;
+    class Light;
+    class ShaderFactory;
+}
+
+namespace donut::render
+{
+    class GBufferRenderTargets;
+}
+
+class ReadbackQueue;
+
+// Shades the point and spot lights of the scene from the GBuffer using per-tile light lists.
+//
+// The culling shader finds the depth bounds of every 16x16 pixel tile and tests the light spheres
+// against the tile frustum clipped to those bounds, writing the indices of the lights that touch the
+// tile into a list. The shading shader then evaluates only the lights in the list of its tile and
+// adds them to the output. Directional lights and light probes are left to DeferredLightingPass.
+// A tile keeps at most TILED_LIGHTING_MAX_LIGHTS_PER_TILE lights, the tiles that had more are counted
+// and reported in the stats.
+class TiledLightingPass
+{
+public:
+    struct Inputs
+    {
+        nvrhi::ITexture* depth = nullptr;
+        nvrhi::ITexture* gbufferDiffuse = nullptr;
+        nvrhi::ITexture* gbufferSpecular = nullptr;
+        nvrhi::ITexture* gbufferNormals = nullptr;
+        nvrhi::ITexture* gbufferEmissive = nullptr;
+        nvrhi::ITexture* output = nullptr;
+        // The four GBuffer channels are in the compact layout, see compact_gbuffer.hlsli
+        bool compactGBuffer = false;
+
+        void SetGBuffer(const donut::render::GBufferRenderTargets& targets);
+    };
+
+    struct Stats
+    {
+        uint32_t numLocalLights = 0;
+        uint32_t numTiles = 0;
+        // From the latest frame the GPU has returned: tiles that dropped lights, and the most lights
+        // that touched one of them
+        uint32_t numOverflowTiles = 0;
+        uint32_t maxTileLights = 0;
+    };
+
+    TiledLightingPass(nvrhi::IDevice* device, const std::shared_ptr<donut::engine::ShaderFactory>& shaderFactory,
+        ReadbackQueue* readbackQueue);
+
+    // Point and spot lights are handled by this pass, everything else is not.
+    static bool IsLocalLight(const donut::engine::Light& light);
+
+    // Splits the scene lights into the ones handled by this pass and the rest.
+    void SetLights(const std::vector<std::shared_ptr<donut::engine::Light>>& lights, std::vector<std::shared_ptr<donut::engine::Light>>& otherLights);
+
+    // Builds the tile light lists for every planar child view and adds the local lights to the output.
+    void Render(nvrhi::ICommandList* commandList, const donut::engine::IView& view, const Inputs& inputs);
+
+    void ResetBindingCache();
+
+    [[nodiscard]] const Stats& GetStats() const { return m_Stats; }
+
+    // Selects the lights for a forward pass that has no access to the tile lists: the non-local lights
+    // come first, followed by the local lights that intersect the view frustum, nearest to the camera first.
+    static void SelectForwardLights(const donut::engine::IView& view,
+        const std::vector<std::shared_ptr<donut::engine::Light>>& lights,
+        std::vector<std::shared_ptr<donut::engine::Light>>& result);
+
+private:
+    // Shared with the readback callbacks, which can outlive the pass
+    struct Feedback
+    {
+        uint32_t numOverflowTiles = 0;
+        uint32_t maxTileLights = 0;
+    };
+
+    nvrhi::DeviceHandle m_Device;
+    ReadbackQueue* m_ReadbackQueue;
+
+    nvrhi::ShaderHandle m_CullShader;
+    nvrhi::ShaderHandle m_ShadeShader;
+    nvrhi::ShaderHandle m_CompactShadeShader;
+    nvrhi::BindingLayoutHandle m_CullBindingLayout;
+    nvrhi::BindingLayoutHandle m_ShadeBindingLayout;
+    nvrhi::ComputePipelineHandle m_CullPipeline;
+    nvrhi::ComputePipelineHandle m_ShadePipeline;
+    nvrhi::ComputePipelineHandle m_CompactShadePipeline;
+    nvrhi::BufferHandle m_ConstantBuffer;
+    nvrhi::BufferHandle m_LightBuffer;
+    nvrhi::BufferHandle m_LightSphereBuffer;
+    nvrhi::BufferHandle m_TileLightBuffer;
+    nvrhi::BufferHandle m_Counters;
+    donut::engine::BindingCache m_BindingCache;
+
+    std::vector<std::shared_ptr<donut::engine::Light>> m_LocalLights;
+    Stats m_Stats;
+    std::shared_ptr<Feedback> m_Feedback;
+};
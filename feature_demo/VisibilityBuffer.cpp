@@ -0,0 +1,362 @@
+/*
+* Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#include "VisibilityBuffer.h"
+
+#include <donut/engine/CommonRenderPasses.h>
+#include <donut/engine/FramebufferFactory.h>
+#include <donut/engine/Scene.h>
+#include <donut/engine/SceneGraph.h>
+#include <donut/engine/ShaderFactory.h>
+#include <donut/engine/View.h>
+#include <donut/render/DrawStrategy.h>
+#include <nvrhi/utils.h>
+
+#include <algorithm>
+
+using namespace donut;
+using namespace donut::math;
+using namespace donut::engine;
+using namespace donut::render;
+
+#include "visibility_buffer_cb.h"
+
+// Average number of distinct materials per tile that the tile list is sized for
+static constexpr uint32_t c_TileListEntriesPerTile = 4;
+
+VisibilityBufferPass::VisibilityBufferPass(nvrhi::IDevice* device,
+    const std::shared_ptr<ShaderFactory>& shaderFactory,
+    const std::shared_ptr<CommonRenderPasses>& commonPasses,
+    nvrhi::IBindingLayout* bindlessLayout,
+    const std::shared_ptr<FramebufferFactory>& visibilityFramebuffer,
+    const std::shared_ptr<FramebufferFactory>& gbufferFramebuffer,
+    const IView& sampleView,
+    uint32_t motionVectorStencilMask,
+    bool compactGBuffer)
+    : m_Device(device)
+    , m_CommonPasses(commonPasses)
+    , m_VisibilityFramebuffer(visibilityFramebuffer)
+    , m_GBufferFramebuffer(gbufferFramebuffer)
+    , m_BindlessLayout(bindlessLayout)
+    , m_ReverseDepth(sampleView.IsReverseDepth())
+    , m_BindingCache(device)
+{
+    nvrhi::BindingLayoutDesc layoutDesc;
+    layoutDesc.visibility = nvrhi::ShaderType::All;
+    layoutDesc.bindings = {
+        nvrhi::BindingLayoutItem::VolatileConstantBuffer(0),
+        nvrhi::BindingLayoutItem::PushConstants(1, sizeof(VisibilityDrawConstants)),
+        nvrhi::BindingLayoutItem::StructuredBuffer_SRV(0),
+        nvrhi::BindingLayoutItem::StructuredBuffer_SRV(1),
+        nvrhi::BindingLayoutItem::StructuredBuffer_SRV(2),
+        nvrhi::BindingLayoutItem::Sampler(0)
+    };
+    m_RasterBindingLayout = m_Device->createBindingLayout(layoutDesc);
+
+    layoutDesc.visibility = nvrhi::ShaderType::Compute;
+    layoutDesc.bindings = {
+        nvrhi::BindingLayoutItem::VolatileConstantBuffer(0),
+        nvrhi::BindingLayoutItem::StructuredBuffer_SRV(0),
+        nvrhi::BindingLayoutItem::StructuredBuffer_SRV(1),
+        nvrhi::BindingLayoutItem::Texture_SRV(3),
+        nvrhi::BindingLayoutItem::StructuredBuffer_UAV(0),
+        nvrhi::BindingLayoutItem::StructuredBuffer_UAV(1),
+        nvrhi::BindingLayoutItem::StructuredBuffer_UAV(2),
+        nvrhi::BindingLayoutItem::RawBuffer_UAV(3)
+    };
+    m_ComputeBindingLayout = m_Device->createBindingLayout(layoutDesc);
+
+    layoutDesc.visibility = nvrhi::ShaderType::All;
+    layoutDesc.bindings = {
+        nvrhi::BindingLayoutItem::VolatileConstantBuffer(0),
+        nvrhi::BindingLayoutItem::StructuredBuffer_SRV(0),
+        nvrhi::BindingLayoutItem::StructuredBuffer_SRV(1),
+        nvrhi::BindingLayoutItem::StructuredBuffer_SRV(2),
+        nvrhi::BindingLayoutItem::Texture_SRV(3),
+        nvrhi::BindingLayoutItem::StructuredBuffer_SRV(4),
+        nvrhi::BindingLayoutItem::Sampler(0)
+    };
+    m_ResolveBindingLayout = m_Device->createBindingLayout(layoutDesc);
+
+    m_RasterVS = shaderFactory->CreateShader("app/visibility_buffer.hlsl", "raster_vs", nullptr, nvrhi::ShaderType::Vertex);
+    for (int alphaTested = 0; alphaTested < 2; alphaTested++)
+    {
+        std::vector<ShaderMacro> macros = { ShaderMacro("ALPHA_TESTED", alphaTested ? "1" : "0") };
+        m_RasterPS[alphaTested] = shaderFactory->CreateShader("app/visibility_buffer.hlsl", "raster_ps", &macros, nvrhi::ShaderType::Pixel);
+    }
+
+    nvrhi::ComputePipelineDesc computeDesc;
+    computeDesc.bindingLayouts = { m_ComputeBindingLayout };
+
+    std::vector<ShaderMacro> macros = { ShaderMacro("CLASSIFY_SCATTER", "0") };
+    computeDesc.CS = shaderFactory->CreateShader("app/visibility_buffer.hlsl", "classify_cs", &macros, nvrhi::ShaderType::Compute);
+    m_CountPipeline = m_Device->createComputePipeline(computeDesc);
+
+    macros = { ShaderMacro("CLASSIFY_SCATTER", "1") };
+    computeDesc.CS = shaderFactory->CreateShader("app/visibility_buffer.hlsl", "classify_cs", &macros, nvrhi::ShaderType::Compute);
+    m_ScatterPipeline = m_Device->createComputePipeline(computeDesc);
+
+    computeDesc.CS = shaderFactory->CreateShader("app/visibility_buffer.hlsl", "prefix_cs", nullptr, nvrhi::ShaderType::Compute);
+    m_PrefixPipeline = m_Device->createComputePipeline(computeDesc);
+
+    // The resolve quads cover whole tiles and don't overlap within a bin, the pixel shader discards
+    // everything that belongs to other materials. Every written pixel gets valid motion vectors.
+    nvrhi::GraphicsPipelineDesc resolveDesc;
+    resolveDesc.primType = nvrhi::PrimitiveType::TriangleStrip;
+    resolveDesc.VS = shaderFactory->CreateShader("app/visibility_buffer.hlsl", "resolve_vs", nullptr, nvrhi::ShaderType::Vertex);
+    macros = { ShaderMacro("COMPACT_GBUFFER", compactGBuffer ? "1" : "0") };
+    resolveDesc.PS = shaderFactory->CreateShader("app/visibility_buffer.hlsl", "resolve_ps", &macros, nvrhi::ShaderType::Pixel);
+    resolveDesc.bindingLayouts = { m_ResolveBindingLayout, m_BindlessLayout };
+    resolveDesc.renderState.rasterState.setCullNone();
+    resolveDesc.renderState.depthStencilState
+        .setDepthTestEnable(false)
+        .setDepthWriteEnable(false)
+        .setStencilEnable(motionVectorStencilMask != 0)
+        .setStencilReadMask(0)
+        .setStencilWriteMask(uint8_t(motionVectorStencilMask))
+        .setStencilRefValue(uint8_t(motionVectorStencilMask));
+    resolveDesc.renderState.depthStencilState.frontFaceStencil.passOp = nvrhi::StencilOp::Replace;
+    resolveDesc.renderState.depthStencilState.backFaceStencil.passOp = nvrhi::StencilOp::Replace;
+    m_ResolvePipeline = m_Device->createGraphicsPipeline(resolveDesc, m_GBufferFramebuffer->GetFramebuffer(sampleView));
+
+    m_ConstantBuffer = m_Device->createBuffer(nvrhi::utils::CreateVolatileConstantBufferDesc(
+        sizeof(VisibilityBufferConstants), "VisibilityBufferConstants", engine::c_MaxRenderPassConstantBufferVersions));
+
+    nvrhi::BufferDesc argsDesc;
+    argsDesc.byteSize = sizeof(nvrhi::DrawArguments);
+    argsDesc.isDrawIndirectArgs = true;
+    argsDesc.canHaveUAVs = true;
+    argsDesc.canHaveRawViews = true;
+    argsDesc.initialState = nvrhi::ResourceStates::IndirectArgument;
+    argsDesc.keepInitialState = true;
+    argsDesc.debugName = "VisibilityResolveArgs";
+    m_IndirectArgs = m_Device->createBuffer(argsDesc);
+}
+
+nvrhi::GraphicsPipelineHandle VisibilityBufferPass::GetRasterPipeline(bool alphaTested, nvrhi::RasterCullMode cullMode)
+{
+    nvrhi::GraphicsPipelineHandle& pipeline = m_RasterPipelines[alphaTested ? 1 : 0][int(cullMode)];
+    if (pipeline)
+        return pipeline;
+
+    nvrhi::GraphicsPipelineDesc pipelineDesc;
+    pipelineDesc.VS = m_RasterVS;
+    pipelineDesc.PS = m_RasterPS[alphaTested ? 1 : 0];
+    pipelineDesc.bindingLayouts = { m_RasterBindingLayout, m_BindlessLayout };
+    pipelineDesc.renderState.rasterState.frontCounterClockwise = true;
+    pipelineDesc.renderState.rasterState.cullMode = cullMode;
+    pipelineDesc.renderState.depthStencilState
+        .setDepthTestEnable(true)
+        .setDepthWriteEnable(true)
+        .setDepthFunc(m_ReverseDepth ? nvrhi::ComparisonFunc::GreaterOrEqual : nvrhi::ComparisonFunc::LessOrEqual)
+        .setStencilEnable(false);
+
+    // All framebuffers from the factory share the formats, any of them works for pipeline creation
+    nvrhi::IFramebuffer* framebuffer = m_VisibilityFramebuffer->GetFramebuffer(nvrhi::AllSubresources);
+    pipeline = m_Device->createGraphicsPipeline(pipelineDesc, framebuffer);
+    return pipeline;
+}
+
+void VisibilityBufferPass::CreateBinBuffers(uint32_t numMaterials, uint32_t tileListCapacity)
+{
+    if (!m_BinCounts || m_BinCounts->getDesc().byteSize < numMaterials * sizeof(uint32_t))
+    {
+        nvrhi::BufferDesc bufferDesc;
+        bufferDesc.byteSize = numMaterials * sizeof(uint32_t);
+        bufferDesc.structStride = sizeof(uint32_t);
+        bufferDesc.canHaveUAVs = true;
+        bufferDesc.initialState = nvrhi::ResourceStates::UnorderedAccess;
+        bufferDesc.keepInitialState = true;
+        bufferDesc.debugName = "VisibilityBinCounts";
+        m_BinCounts = m_Device->createBuffer(bufferDesc);
+
+        bufferDesc.debugName = "VisibilityBinOffsets";
+        m_BinOffsets = m_Device->createBuffer(bufferDesc);
+    }
+
+    if (!m_TileList || m_TileList->getDesc().byteSize < tileListCapacity * sizeof(VisibilityTileEntry))
+    {
+        nvrhi::BufferDesc bufferDesc;
+        bufferDesc.byteSize = tileListCapacity * sizeof(VisibilityTileEntry);
+        bufferDesc.structStride = sizeof(VisibilityTileEntry);
+        bufferDesc.canHaveUAVs = true;
+        bufferDesc.initialState = nvrhi::ResourceStates::ShaderResource;
+        bufferDesc.keepInitialState = true;
+        bufferDesc.debugName = "VisibilityTileList";
+        m_TileList = m_Device->createBuffer(bufferDesc);
+    }
+}
+
+void VisibilityBufferPass::Render(nvrhi::ICommandList* commandList,
+    const IView& view,
+    const IView& viewPrev,
+    const Scene& scene,
+    IDrawStrategy& drawStrategy,
+    nvrhi::IDescriptorTable* descriptorTable,
+    nvrhi::ITexture* visibilityIDs)
+{
+    nvrhi::IBuffer* materialBuffer = scene.GetMaterialBuffer();
+    const uint32_t numMaterials = std::max(1u, uint32_t(materialBuffer->getDesc().byteSize / materialBuffer->getDesc().structStride));
+
+    const nvrhi::TextureDesc& idsDesc = visibilityIDs->getDesc();
+    const uint2 tileCount = uint2(
+        (idsDesc.width + VISIBILITY_TILE_SIZE - 1) / VISIBILITY_TILE_SIZE,
+        (idsDesc.height + VISIBILITY_TILE_SIZE - 1) / VISIBILITY_TILE_SIZE);
+    const uint32_t tileListCapacity = tileCount.x * tileCount.y * c_TileListEntriesPerTile;
+
+    CreateBinBuffers(numMaterials, tileListCapacity);
+
+    VisibilityBufferConstants constants = {};
+    view.FillPlanarViewConstants(constants.view);
+    viewPrev.FillPlanarViewConstants(constants.viewPrev);
+    constants.tileCount = tileCount;
+    constants.numMaterials = numMaterials;
+    constants.tileListCapacity = tileListCapacity;
+
+    nvrhi::BindingSetDesc rasterBindings;
+    rasterBindings.bindings = {
+        nvrhi::BindingSetItem::ConstantBuffer(0, m_ConstantBuffer),
+        nvrhi::BindingSetItem::PushConstants(1, sizeof(VisibilityDrawConstants)),
+        nvrhi::BindingSetItem::StructuredBuffer_SRV(0, scene.GetInstanceBuffer()),
+        nvrhi::BindingSetItem::StructuredBuffer_SRV(1, scene.GetGeometryBuffer()),
+        nvrhi::BindingSetItem::StructuredBuffer_SRV(2, materialBuffer),
+        nvrhi::BindingSetItem::Sampler(0, m_CommonPasses->m_AnisotropicWrapSampler)
+    };
+    nvrhi::BindingSetHandle rasterSet = m_BindingCache.GetOrCreateBindingSet(rasterBindings, m_RasterBindingLayout);
+
+    nvrhi::BindingSetDesc computeBindings;
+    computeBindings.bindings = {
+        nvrhi::BindingSetItem::ConstantBuffer(0, m_ConstantBuffer),
+        nvrhi::BindingSetItem::StructuredBuffer_SRV(0, scene.GetInstanceBuffer()),
+        nvrhi::BindingSetItem::StructuredBuffer_SRV(1, scene.GetGeometryBuffer()),
+        nvrhi::BindingSetItem::Texture_SRV(3, visibilityIDs),
+        nvrhi::BindingSetItem::StructuredBuffer_UAV(0, m_BinCounts),
+        nvrhi::BindingSetItem::StructuredBuffer_UAV(1, m_BinOffsets),
+        nvrhi::BindingSetItem::StructuredBuffer_UAV(2, m_TileList),
+        nvrhi::BindingSetItem::RawBuffer_UAV(3, m_IndirectArgs)
+    };
+    nvrhi::BindingSetHandle computeSet = m_BindingCache.GetOrCreateBindingSet(computeBindings, m_ComputeBindingLayout);
+
+    nvrhi::BindingSetDesc resolveBindings;
+    resolveBindings.bindings = {
+        nvrhi::BindingSetItem::ConstantBuffer(0, m_ConstantBuffer),
+        nvrhi::BindingSetItem::StructuredBuffer_SRV(0, scene.GetInstanceBuffer()),
+        nvrhi::BindingSetItem::StructuredBuffer_SRV(1, scene.GetGeometryBuffer()),
+        nvrhi::BindingSetItem::StructuredBuffer_SRV(2, materialBuffer),
+        nvrhi::BindingSetItem::Texture_SRV(3, visibilityIDs),
+        nvrhi::BindingSetItem::StructuredBuffer_SRV(4, m_TileList),
+        nvrhi::BindingSetItem::Sampler(0, m_CommonPasses->m_AnisotropicWrapSampler)
+    };
+    nvrhi::BindingSetHandle resolveSet = m_BindingCache.GetOrCreateBindingSet(resolveBindings, m_ResolveBindingLayout);
+
+    commandList->beginMarker("VisibilityBuffer");
+    commandList->writeBuffer(m_ConstantBuffer, &constants, sizeof(constants));
+    commandList->clearTextureUInt(visibilityIDs, nvrhi::AllSubresources, VISIBILITY_EMPTY);
+
+    // Raster stage: one draw per geometry, the pipeline only changes with the alpha mode and culling
+
+    commandList->beginMarker("Raster");
+
+    m_NumDraws = 0;
+    m_NumSkippedDraws = 0;
+
+    nvrhi::GraphicsState rasterState;
+    rasterState.framebuffer = m_VisibilityFramebuffer->GetFramebuffer(view);
+    rasterState.viewport = view.GetViewportState();
+    rasterState.bindings = { rasterSet, descriptorTable };
+
+    drawStrategy.PrepareForView(scene.GetSceneGraph()->GetRootNode(), view);
+
+    while (const DrawItem* item = drawStrategy.GetNextItem())
+    {
+        const int instanceIndex = item->instance->GetInstanceIndex();
+        const size_t geometryInMesh = item->geometry->globalGeometryIndex - item->mesh->geometries[0]->globalGeometryIndex;
+
+        if (instanceIndex < 0 || uint32_t(instanceIndex) > VISIBILITY_INSTANCE_MASK || geometryInMesh >= VISIBILITY_MAX_GEOMETRIES_PER_MESH)
+        {
+            ++m_NumSkippedDraws;
+            continue;
+        }
+
+        const bool alphaTested = item->material->domain == MaterialDomain::AlphaTested
+            || item->material->domain == MaterialDomain::TransmissiveAlphaTested;
+        nvrhi::GraphicsPipelineHandle pipeline = GetRasterPipeline(alphaTested, item->cullMode);
+
+        if (pipeline != rasterState.pipeline)
+        {
+            rasterState.pipeline = pipeline;
+            commandList->setGraphicsState(rasterState);
+        }
+
+        VisibilityDrawConstants drawConstants;
+        drawConstants.instanceIndex = uint32_t(instanceIndex);
+        drawConstants.geometryInMesh = uint32_t(geometryInMesh);
+        commandList->setPushConstants(&drawConstants, sizeof(drawConstants));
+
+        nvrhi::DrawArguments args;
+        args.vertexCount = item->geometry->numIndices;
+        args.instanceCount = 1;
+        commandList->draw(args);
+
+        ++m_NumDraws;
+    }
+
+    commandList->endMarker();
+
+    // Material binning: count the tiles per material, turn the counts into offsets, scatter the tiles
+
+    commandList->beginMarker("Classify");
+
+    commandList->clearBufferUInt(m_BinCounts, 0);
+
+    nvrhi::ComputeState computeState;
+    computeState.pipeline = m_CountPipeline;
+    computeState.bindings = { computeSet };
+    commandList->setComputeState(computeState);
+    commandList->dispatch(tileCount.x, tileCount.y, 1);
+
+    computeState.pipeline = m_PrefixPipeline;
+    commandList->setComputeState(computeState);
+    commandList->dispatch(1, 1, 1);
+
+    computeState.pipeline = m_ScatterPipeline;
+    commandList->setComputeState(computeState);
+    commandList->dispatch(tileCount.x, tileCount.y, 1);
+
+    commandList->endMarker();
+
+    // Material pass: one indirect draw over all bins
+
+    commandList->beginMarker("Resolve");
+
+    nvrhi::GraphicsState resolveState;
+    resolveState.pipeline = m_ResolvePipeline;
+    resolveState.framebuffer = m_GBufferFramebuffer->GetFramebuffer(view);
+    resolveState.viewport = view.GetViewportState();
+    resolveState.bindings = { resolveSet, descriptorTable };
+    resolveState.indirectParams = m_IndirectArgs;
+    commandList->setGraphicsState(resolveState);
+    commandList->drawIndirect(0);
+
+    commandList->endMarker();
+    commandList->endMarker();
+}
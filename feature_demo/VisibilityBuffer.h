@@ -0,0 +1,120 @@
+/*
+* Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <donut/core/math/math.h>
+#include <donut/engine/BindingCache.h>
+#include <nvrhi/nvrhi.h>
+#include <memory>
+
+namespace donut::engine
+{
+    class CommonRenderPasses;
+    class FramebufferFactory;
+    class ICompositeView;
+    class IView;
+    class Scene;
+    class SceneGraphNode;
+    class ShaderFactory;
+}
+
+namespace donut::render
+{
+    class IDrawStrategy;
+}
+
+// Visibility buffer alternative to GBufferFillPass.
+//
+// The geometry is rasterized into depth and a 64-bit ID target that holds the instance, geometry and
+// primitive of every pixel, with all vertex data fetched through the bindless scene buffers so that
+// the draws only differ in their push constants. The material pass then bins 8x8 pixel tiles by
+// material on the GPU and draws one quad per tile and material, in material order. Each pixel
+// reconstructs its attributes from the triangle with analytic barycentrics and writes the regular
+// GBuffer, so lighting, SSAO and TAA work unchanged. The wide GBuffer is written once per pixel
+// instead of once per covering fragment.
+//
+// Requires a scene with a descriptor table, single-sampled targets and a planar view. The GBuffer
+// framebuffer can have the standard or the compact layout, see CompactGBuffer.h.
+class VisibilityBufferPass
+{
+public:
+    VisibilityBufferPass(nvrhi::IDevice* device,
+        const std::shared_ptr<donut::engine::ShaderFactory>& shaderFactory,
+        const std::shared_ptr<donut::engine::CommonRenderPasses>& commonPasses,
+        nvrhi::IBindingLayout* bindlessLayout,
+        const std::shared_ptr<donut::engine::FramebufferFactory>& visibilityFramebuffer,
+        const std::shared_ptr<donut::engine::FramebufferFactory>& gbufferFramebuffer,
+        const donut::engine::IView& sampleView,
+        uint32_t motionVectorStencilMask,
+        bool compactGBuffer);
+
+    // Fills the GBuffer with the items from the draw strategy. The GBuffer and depth must be cleared.
+    void Render(nvrhi::ICommandList* commandList,
+        const donut::engine::IView& view,
+        const donut::engine::IView& viewPrev,
+        const donut::engine::Scene& scene,
+        donut::render::IDrawStrategy& drawStrategy,
+        nvrhi::IDescriptorTable* descriptorTable,
+        nvrhi::ITexture* visibilityIDs);
+
+    // Draws issued into the visibility buffer in the last Render call
+    [[nodiscard]] uint32_t GetNumDraws() const { return m_NumDraws; }
+    // Draws that could not be encoded, because the instance or geometry index is out of range
+    [[nodiscard]] uint32_t GetNumSkippedDraws() const { return m_NumSkippedDraws; }
+
+    void ResetBindingCache() { m_BindingCache.Clear(); }
+
+private:
+    nvrhi::GraphicsPipelineHandle GetRasterPipeline(bool alphaTested, nvrhi::RasterCullMode cullMode);
+    void CreateBinBuffers(uint32_t numMaterials, uint32_t tileListCapacity);
+
+    nvrhi::DeviceHandle m_Device;
+    std::shared_ptr<donut::engine::CommonRenderPasses> m_CommonPasses;
+    std::shared_ptr<donut::engine::FramebufferFactory> m_VisibilityFramebuffer;
+    std::shared_ptr<donut::engine::FramebufferFactory> m_GBufferFramebuffer;
+    nvrhi::BindingLayoutHandle m_BindlessLayout;
+    bool m_ReverseDepth = true;
+
+    nvrhi::ShaderHandle m_RasterVS;
+    nvrhi::ShaderHandle m_RasterPS[2];
+    // Indexed by alpha testing and by the cull mode
+    nvrhi::GraphicsPipelineHandle m_RasterPipelines[2][3];
+
+    nvrhi::BindingLayoutHandle m_RasterBindingLayout;
+    nvrhi::BindingLayoutHandle m_ComputeBindingLayout;
+    nvrhi::BindingLayoutHandle m_ResolveBindingLayout;
+    nvrhi::ComputePipelineHandle m_CountPipeline;
+    nvrhi::ComputePipelineHandle m_PrefixPipeline;
+    nvrhi::ComputePipelineHandle m_ScatterPipeline;
+    nvrhi::GraphicsPipelineHandle m_ResolvePipeline;
+
+    nvrhi::BufferHandle m_ConstantBuffer;
+    nvrhi::BufferHandle m_BinCounts;
+    nvrhi::BufferHandle m_BinOffsets;
+    nvrhi::BufferHandle m_TileList;
+    nvrhi::BufferHandle m_IndirectArgs;
+    donut::engine::BindingCache m_BindingCache;
+
+    uint32_t m_NumDraws = 0;
+    uint32_t m_NumSkippedDraws = 0;
+};
@@ -0,0 +1,138 @@
+/*
+* Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#include <donut/shaders/vulkan.hlsli>
+#include "bloom_pyramid_cb.h"
+
+VK_PUSH_CONSTANT ConstantBuffer<BloomPyramidConstants> g_Bloom : register(b0);
+
+Texture2D<float4> t_Source : register(t0);
+SamplerState s_LinearClamp : register(s0);
+RWTexture2D<float4> u_Dest : register(u0);
+
+float4 SampleSource(float2 uv)
+{
+    return t_Source.SampleLevel(s_LinearClamp, clamp(uv, g_Bloom.sourceUVMin, g_Bloom.sourceUVMax), 0);
+}
+
+bool GetDestPixel(uint2 globalId, out int2 pixel, out float2 sourceUV)
+{
+    pixel = g_Bloom.destOrigin + int2(globalId);
+    sourceUV = (float2(pixel) + 0.5) * g_Bloom.destToSourceScale + g_Bloom.destToSourceBias;
+    return all(int2(globalId) < g_Bloom.destSize);
+}
+
+float KarisWeight(float4 color)
+{
+    return 1.0 / (1.0 + dot(color.rgb, float3(0.2126, 0.7152, 0.0722)));
+}
+
+// 13-tap downsampling filter from "Next Generation Post Processing in Call of Duty: Advanced Warfare".
+// Five overlapping 2x2 box groups, each taken with a single bilinear fetch per corner.
+[numthreads(BLOOM_PYRAMID_GROUP_SIZE, BLOOM_PYRAMID_GROUP_SIZE, 1)]
+void downsample_cs(uint3 globalId : SV_DispatchThreadID)
+{
+    int2 pixel;
+    float2 uv;
+    if (!GetDestPixel(globalId.xy, pixel, uv))
+        return;
+
+    const float2 texel = g_Bloom.sourceTexelSize;
+
+    float4 a = SampleSource(uv + texel * float2(-2, -2));
+    float4 b = SampleSource(uv + texel * float2( 0, -2));
+    float4 c = SampleSource(uv + texel * float2( 2, -2));
+    float4 d = SampleSource(uv + texel * float2(-2,  0));
+    float4 e = SampleSource(uv);
+    float4 f = SampleSource(uv + texel * float2( 2,  0));
+    float4 g = SampleSource(uv + texel * float2(-2,  2));
+    float4 h = SampleSource(uv + texel * float2( 0,  2));
+    float4 i = SampleSource(uv + texel * float2( 2,  2));
+    float4 j = SampleSource(uv + texel * float2(-1, -1));
+    float4 k = SampleSource(uv + texel * float2( 1, -1));
+    float4 l = SampleSource(uv + texel * float2(-1,  1));
+    float4 m = SampleSource(uv + texel * float2( 1,  1));
+
+    float4 groups[5] = {
+        (j + k + l + m) * 0.25,
+        (a + b + d + e) * 0.25,
+        (b + c + e + f) * 0.25,
+        (d + e + g + h) * 0.25,
+        (e + f + h + i) * 0.25
+    };
+    const float groupWeights[5] = { 0.5, 0.125, 0.125, 0.125, 0.125 };
+
+    float4 result = 0;
+    float totalWeight = 0;
+
+    [unroll]
+    for (int group = 0; group < 5; group++)
+    {
+        float weight = groupWeights[group];
+        if (g_Bloom.karisAverage)
+            weight *= KarisWeight(groups[group]);
+
+        result += groups[group] * weight;
+        totalWeight += weight;
+    }
+
+    u_Dest[pixel] = result * (g_Bloom.weight / totalWeight);
+}
+
+float4 SampleTent(float2 uv)
+{
+    const float2 texel = g_Bloom.sourceTexelSize;
+
+    float4 result = SampleSource(uv) * 4;
+    result += (SampleSource(uv + texel * float2(-1,  0)) + SampleSource(uv + texel * float2(1, 0))
+             + SampleSource(uv + texel * float2( 0, -1)) + SampleSource(uv + texel * float2(0, 1))) * 2;
+    result += SampleSource(uv + texel * float2(-1, -1)) + SampleSource(uv + texel * float2(1, -1))
+            + SampleSource(uv + texel * float2(-1,  1)) + SampleSource(uv + texel * float2(1, 1));
+
+    return result * (1.0 / 16.0);
+}
+
+// Adds the tent-filtered coarser level to the weighted current level, in place.
+[numthreads(BLOOM_PYRAMID_GROUP_SIZE, BLOOM_PYRAMID_GROUP_SIZE, 1)]
+void upsample_cs(uint3 globalId : SV_DispatchThreadID)
+{
+    int2 pixel;
+    float2 uv;
+    if (!GetDestPixel(globalId.xy, pixel, uv))
+        return;
+
+    u_Dest[pixel] = u_Dest[pixel] * g_Bloom.weight + SampleTent(uv);
+}
+
+// Blends the upsampled bloom over the scene color, in place.
+[numthreads(BLOOM_PYRAMID_GROUP_SIZE, BLOOM_PYRAMID_GROUP_SIZE, 1)]
+void composite_cs(uint3 globalId : SV_DispatchThreadID)
+{
+    int2 pixel;
+    float2 uv;
+    if (!GetDestPixel(globalId.xy, pixel, uv))
+        return;
+
+    float4 color = u_Dest[pixel];
+    float3 bloom = SampleTent(uv).rgb;
+    u_Dest[pixel] = float4(lerp(color.rgb, bloom, g_Bloom.weight), color.a);
+}
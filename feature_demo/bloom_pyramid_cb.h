@@ -0,0 +1,50 @@
+/*
+* Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef BLOOM_PYRAMID_CB_H
+#define BLOOM_PYRAMID_CB_H
+
+#define BLOOM_PYRAMID_GROUP_SIZE 8
+
+struct BloomPyramidConstants
+{
+    // Region of the destination written by the dispatch
+    int2 destOrigin;
+    int2 destSize;
+
+    // Sampling area of the source in UV space; samples outside of it are clamped
+    float2 sourceUVMin;
+    float2 sourceUVMax;
+
+    float2 sourceTexelSize;
+    // Maps destination pixels to source UV: uv = (pixel + 0.5) * destToSourceScale + destToSourceBias
+    float2 destToSourceScale;
+
+    float2 destToSourceBias;
+    // Downsampling: non-zero to apply the Karis average that suppresses fireflies
+    uint karisAverage;
+    // Downsampling: scale of the result, which applies the weight of the coarsest level.
+    // Upsampling: weight of the current level. Compositing: bloom blend factor.
+    float weight;
+};
+
+#endif // BLOOM_PYRAMID_CB_H
@@ -0,0 +1,184 @@
+/*
+* Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+// Sky from precomputed tables.
+//
+// The procedural sky is split into the parts that vary smoothly with the direction - the
+// gradient between ground, horizon and sky and the glow around the sun - and the sun disc.
+// The smooth part is baked into a sky view LUT parameterized by azimuth and elevation around
+// the up direction, with more texels near the horizon where the gradient changes fastest,
+// and from there into a small cubemap. The disc is too sharp for either table, so the
+// lookup pass adds it analytically on top.
+
+#include "cached_sky_cb.h"
+
+#ifndef USE_CUBEMAP
+#define USE_CUBEMAP 0
+#endif
+
+static const float c_Pi = 3.14159265;
+
+ConstantBuffer<CachedSkyConstants> g_Sky : register(b0);
+
+Texture2D<float4> t_SkyViewLut : register(t0);
+TextureCube<float4> t_SkyCubemap : register(t1);
+SamplerState s_LinearWrap : register(s0);
+
+RWTexture2D<float4> u_SkyViewLut : register(u0);
+RWTexture2DArray<float4> u_SkyCubemap : register(u1);
+
+void GetSkyFrame(out float3 tangent, out float3 bitangent)
+{
+    const float3 up = g_Sky.params.directionUp;
+    const float3 reference = abs(up.y) < 0.99 ? float3(0, 1, 0) : float3(1, 0, 0);
+    tangent = normalize(cross(reference, up));
+    bitangent = cross(up, tangent);
+}
+
+float2 DirectionToLutUV(float3 direction)
+{
+    float3 tangent, bitangent;
+    GetSkyFrame(tangent, bitangent);
+
+    const float azimuth = atan2(dot(direction, bitangent), dot(direction, tangent));
+    const float elevation = asin(clamp(dot(direction, g_Sky.params.directionUp), -1.0, 1.0));
+
+    // Square root mapping of the elevation, dense around the horizon
+    const float v = 0.5 + 0.5 * sign(elevation) * sqrt(abs(elevation) / (0.5 * c_Pi));
+
+    return float2(azimuth / (2 * c_Pi) + 0.5, v);
+}
+
+float3 LutUVToDirection(float2 uv)
+{
+    float3 tangent, bitangent;
+    GetSkyFrame(tangent, bitangent);
+
+    const float azimuth = (uv.x - 0.5) * 2 * c_Pi;
+    const float t = 2 * uv.y - 1;
+    const float elevation = sign(t) * t * t * 0.5 * c_Pi;
+
+    const float cosElevation = cos(elevation);
+    return tangent * (cos(azimuth) * cosElevation) + bitangent * (sin(azimuth) * cosElevation)
+        + g_Sky.params.directionUp * sin(elevation);
+}
+
+float3 CubemapTexelToDirection(uint3 texel)
+{
+    const float2 uv = (float2(texel.xy) + 0.5) * g_Sky.cubemapInvSize * 2 - 1;
+
+    float3 direction;
+    switch (texel.z)
+    {
+    case 0: direction = float3(1, -uv.y, -uv.x); break;
+    case 1: direction = float3(-1, -uv.y, uv.x); break;
+    case 2: direction = float3(uv.x, 1, uv.y); break;
+    case 3: direction = float3(uv.x, -1, -uv.y); break;
+    case 4: direction = float3(uv.x, -uv.y, 1); break;
+    default: direction = float3(-uv.x, -uv.y, -1); break;
+    }
+    return normalize(direction);
+}
+
+float GetAngleToLight(float3 direction)
+{
+    return acos(saturate(dot(direction, g_Sky.params.directionToLight)));
+}
+
+// Sky gradient and sun glow, the same terms as in donut's ProceduralSky
+float3 EvaluateSmoothSky(float3 direction)
+{
+    const ProceduralSkyShaderParameters params = g_Sky.params;
+
+    const float elevation = asin(clamp(dot(direction, params.directionUp), -1.0, 1.0));
+    const float top = smoothstep(0, params.horizonSize, elevation);
+    const float bottom = smoothstep(0, params.horizonSize, -elevation);
+    const float3 environment = lerp(lerp(params.horizonColor, params.groundColor, bottom), params.skyColor, top);
+
+    const float halfAngularSize = params.angularSizeOfLight * 0.5;
+    const float glowInput = saturate(2.0 * (1.0 - smoothstep(halfAngularSize - params.glowSize, halfAngularSize + params.glowSize, GetAngleToLight(direction))));
+    const float glow = params.glowIntensity * pow(glowInput, params.glowSharpness);
+
+    return environment + glow * params.lightColor;
+}
+
+// The part of the sun disc that exceeds the glow. Inside the disc the glow is at its peak,
+// so subtracting the peak is exact there and only approximate over the antialiased edge.
+float3 EvaluateSunDisc(float3 direction, float angularSizeOfPixel)
+{
+    const ProceduralSkyShaderParameters params = g_Sky.params;
+
+    const float halfAngularSize = params.angularSizeOfLight * 0.5;
+    float disc = saturate(1.0 - smoothstep(halfAngularSize - angularSizeOfPixel * 2, halfAngularSize + angularSizeOfPixel * 2, GetAngleToLight(direction)));
+    disc = pow(disc, 4.0);
+
+    return max(disc - params.glowIntensity, 0) * params.lightColor;
+}
+
+[numthreads(CACHED_SKY_GROUP_SIZE, CACHED_SKY_GROUP_SIZE, 1)]
+void bake_lut_cs(uint3 globalId : SV_DispatchThreadID)
+{
+    if (any(float2(globalId.xy) >= g_Sky.lutSize))
+        return;
+
+    const float2 uv = (float2(globalId.xy) + 0.5) * g_Sky.lutInvSize;
+    u_SkyViewLut[globalId.xy] = float4(EvaluateSmoothSky(LutUVToDirection(uv)), 1);
+}
+
+float3 SampleSkyViewLut(float3 direction)
+{
+    float2 uv = DirectionToLutUV(direction);
+
+    // Azimuth wraps around through the sampler, elevation must not
+    uv.y = clamp(uv.y, 0.5 * g_Sky.lutInvSize.y, 1 - 0.5 * g_Sky.lutInvSize.y);
+
+    return t_SkyViewLut.SampleLevel(s_LinearWrap, uv, 0).rgb;
+}
+
+[numthreads(CACHED_SKY_GROUP_SIZE, CACHED_SKY_GROUP_SIZE, 1)]
+void bake_cubemap_cs(uint3 globalId : SV_DispatchThreadID)
+{
+    if (any(globalId.xy >= g_Sky.cubemapSize))
+        return;
+
+    u_SkyCubemap[globalId] = float4(SampleSkyViewLut(CubemapTexelToDirection(globalId)), 1);
+}
+
+void main_ps(
+    in float4 i_position : SV_Position,
+    in float2 i_uv : UV,
+    out float4 o_color : SV_Target0)
+{
+    const float4 clipPos = float4(i_uv.x * 2 - 1, 1 - i_uv.y * 2, 0.5, 1);
+    const float4 translatedWorldPos = mul(clipPos, g_Sky.matClipToTranslatedWorld);
+    const float3 direction = normalize(translatedWorldPos.xyz / translatedWorldPos.w);
+
+    const float angularSizeOfPixel = length(fwidth(direction));
+
+#if USE_CUBEMAP
+    const float3 sky = t_SkyCubemap.SampleLevel(s_LinearWrap, direction, 0).rgb;
+#else
+    const float3 sky = SampleSkyViewLut(direction);
+#endif
+
+    o_color = float4(sky + EvaluateSunDisc(direction, angularSizeOfPixel), 1);
+}
@@ -0,0 +1,46 @@
+/*
+* Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef CACHED_SKY_CB_H
+#define CACHED_SKY_CB_H
+
+#include <donut/shaders/sky_cb.h>
+
+#define CACHED_SKY_GROUP_SIZE 8
+
+struct CachedSkyConstants
+{
+    // Used by the lookup pass to reconstruct the view direction of every pixel
+    float4x4 matClipToTranslatedWorld;
+
+    ProceduralSkyShaderParameters params;
+
+    // Sky view LUT: azimuth around directionUp in x, elevation in y
+    float2 lutSize;
+    float2 lutInvSize;
+
+    uint cubemapSize;
+    float cubemapInvSize;
+    uint2 padding;
+};
+
+#endif // CACHED_SKY_CB_H
@@ -0,0 +1,178 @@
+/*
+* Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+// Hi-Z occlusion culling.
+//
+// hiz_init_cs reduces the depth buffer into the first level of the Hi-Z pyramid, which has the
+// largest power-of-two size that fits into the depth buffer, so that every further level is an
+// exact half of the previous one and can be built with the single-pass mip generator. Every texel
+// keeps the farthest depth of its footprint.
+//
+// cull_cs projects the world space bounds of every draw item, picks the level at which the screen
+// rectangle covers at most 2x2 texels, and compares the nearest depth of the box with the farthest
+// depth stored there. Visible items set their bit in the visibility mask for the next frames,
+// and the ones that phase 1 didn't draw get an instance count of 1 in their phase 2 draw arguments.
+
+#pragma pack_matrix(row_major)
+
+#include "occlusion_culling_cb.h"
+
+#ifndef DEPTH_ARRAY
+#define DEPTH_ARRAY 0
+#endif
+
+ConstantBuffer<OcclusionCullingConstants> g_Culling : register(b0);
+
+#if DEPTH_ARRAY
+Texture2DArray<float> t_Depth : register(t0);
+#else
+Texture2D<float> t_Depth : register(t0);
+#endif
+StructuredBuffer<OcclusionCullingItem> t_Items : register(t1);
+Texture2D<float> t_HiZ : register(t2);
+
+RWTexture2D<float> u_HiZ : register(u0);
+RWByteAddressBuffer u_DrawArgs : register(u1);
+RWStructuredBuffer<uint> u_VisibilityMask : register(u2);
+RWStructuredBuffer<uint> u_Counters : register(u3);
+
+float FarthestDepth(float a, float b)
+{
+    return g_Culling.reverseDepth ? min(a, b) : max(a, b);
+}
+
+float NearestDepth(float a, float b)
+{
+    return g_Culling.reverseDepth ? max(a, b) : min(a, b);
+}
+
+float LoadDepth(uint2 pixel)
+{
+#if DEPTH_ARRAY
+    return t_Depth[uint3(pixel, g_Culling.depthArraySlice)];
+#else
+    return t_Depth[pixel];
+#endif
+}
+
+[numthreads(OCCLUSION_HIZ_GROUP_SIZE, OCCLUSION_HIZ_GROUP_SIZE, 1)]
+void hiz_init_cs(uint2 texel : SV_DispatchThreadID)
+{
+    if (any(texel >= g_Culling.hizSize))
+        return;
+
+    // The footprint is between 1 and 2 depth pixels wide, so it touches at most 3 of them per axis
+    const uint2 first = texel * g_Culling.depthSize / g_Culling.hizSize;
+    const uint2 last = min(((texel + 1) * g_Culling.depthSize + g_Culling.hizSize - 1) / g_Culling.hizSize, g_Culling.depthSize) - 1;
+
+    float farthest = LoadDepth(first);
+    for (uint y = first.y; y <= last.y; y++)
+    {
+        for (uint x = first.x; x <= last.x; x++)
+            farthest = FarthestDepth(farthest, LoadDepth(uint2(x, y)));
+    }
+
+    u_HiZ[texel] = farthest;
+}
+
+bool IsOccluded(float3 boundsMin, float3 boundsMax)
+{
+    const float3 extent = boundsMax - boundsMin;
+
+    float2 ndcMin = 1.0;
+    float2 ndcMax = -1.0;
+    float nearest = g_Culling.reverseDepth ? 0.0 : 1.0;
+
+    [unroll]
+    for (uint corner = 0; corner < 8; corner++)
+    {
+        const float3 position = boundsMin + extent * float3(corner & 1, (corner >> 1) & 1, (corner >> 2) & 1);
+        const float4 clipPos = mul(float4(position, 1.0), g_Culling.matWorldToClip);
+
+        // Boxes that reach behind the camera can't be tested
+        if (clipPos.w <= 0.0)
+            return false;
+
+        const float3 ndc = clipPos.xyz / clipPos.w;
+        ndcMin = min(ndcMin, ndc.xy);
+        ndcMax = max(ndcMax, ndc.xy);
+        nearest = NearestDepth(nearest, ndc.z);
+    }
+
+    // Rectangle in depth buffer pixels, then in texels of the first Hi-Z level
+    const float2 uvMin = saturate(float2(ndcMin.x, -ndcMax.y) * 0.5 + 0.5);
+    const float2 uvMax = saturate(float2(ndcMax.x, -ndcMin.y) * 0.5 + 0.5);
+    const float2 rectMin = (g_Culling.viewportOrigin + uvMin * g_Culling.viewportSize) * g_Culling.depthToHiZ;
+    const float2 rectMax = (g_Culling.viewportOrigin + uvMax * g_Culling.viewportSize) * g_Culling.depthToHiZ;
+
+    // At this level, the rectangle is at most one texel wide and covers at most 2x2 texels
+    const float2 rectSize = rectMax - rectMin;
+    const uint mip = min(uint(ceil(log2(max(max(rectSize.x, rectSize.y), 1.0)))), g_Culling.hizMipLevels - 1);
+
+    const int2 mipSize = int2(max(g_Culling.hizSize >> mip, 1));
+    const int2 texelMin = clamp(int2(rectMin) >> mip, 0, mipSize - 1);
+    const int2 texelMax = clamp(int2(rectMax) >> mip, 0, mipSize - 1);
+
+    float farthest = t_HiZ.Load(int3(texelMin, mip));
+    farthest = FarthestDepth(farthest, t_HiZ.Load(int3(texelMax.x, texelMin.y, mip)));
+    farthest = FarthestDepth(farthest, t_HiZ.Load(int3(texelMin.x, texelMax.y, mip)));
+    farthest = FarthestDepth(farthest, t_HiZ.Load(int3(texelMax, mip)));
+
+    return g_Culling.reverseDepth ? (nearest < farthest) : (nearest > farthest);
+}
+
+[numthreads(OCCLUSION_CULLING_GROUP_SIZE, 1, 1)]
+void cull_cs(uint itemIndex : SV_DispatchThreadID)
+{
+    bool tested = false;
+    bool culled = false;
+    bool drawLate = false;
+
+    if (itemIndex < g_Culling.numItems)
+    {
+        const OcclusionCullingItem item = t_Items[itemIndex];
+
+        if (item.flags & OCCLUSION_ITEM_DRAWABLE)
+        {
+            tested = true;
+            culled = !(item.flags & OCCLUSION_ITEM_NO_TEST) && IsOccluded(item.boundsMin, item.boundsMax);
+            drawLate = !culled && !(item.flags & OCCLUSION_ITEM_PHASE1);
+
+            if (!culled)
+                InterlockedOr(u_VisibilityMask[item.slot >> 5], 1u << (item.slot & 31));
+        }
+
+        u_DrawArgs.Store(itemIndex * OCCLUSION_ARGS_STRIDE + OCCLUSION_ARGS_INSTANCE_COUNT_OFFSET, drawLate ? 1 : 0);
+    }
+
+    // One atomic per wave and counter
+    const uint numTested = WaveActiveCountBits(tested);
+    const uint numCulled = WaveActiveCountBits(culled);
+    const uint numLate = WaveActiveCountBits(drawLate);
+
+    if (WaveIsFirstLane())
+    {
+        InterlockedAdd(u_Counters[OCCLUSION_COUNTER_TESTED], numTested);
+        InterlockedAdd(u_Counters[OCCLUSION_COUNTER_CULLED], numCulled);
+        InterlockedAdd(u_Counters[OCCLUSION_COUNTER_PHASE2], numLate);
+    }
+}
@@ -0,0 +1,72 @@
+/*
+* Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef OCCLUSION_CULLING_CB_H
+#define OCCLUSION_CULLING_CB_H
+
+#define OCCLUSION_CULLING_GROUP_SIZE 64
+#define OCCLUSION_HIZ_GROUP_SIZE 8
+
+// Item flags
+#define OCCLUSION_ITEM_DRAWABLE 1u   // The geometry pass accepted the material
+#define OCCLUSION_ITEM_PHASE1   2u   // Drawn in phase 1, because it was visible in an earlier frame
+#define OCCLUSION_ITEM_NO_TEST  4u   // Empty bounds, always treated as visible
+
+// Counters written by cull_cs
+#define OCCLUSION_COUNTER_TESTED 0
+#define OCCLUSION_COUNTER_CULLED 1
+#define OCCLUSION_COUNTER_PHASE2 2
+#define OCCLUSION_NUM_COUNTERS   3
+
+// Size of nvrhi::DrawIndexedIndirectArguments and the offset of instanceCount in it
+#define OCCLUSION_ARGS_STRIDE 20
+#define OCCLUSION_ARGS_INSTANCE_COUNT_OFFSET 4
+
+struct OcclusionCullingConstants
+{
+    float4x4 matWorldToClip;
+
+    float2 viewportOrigin;
+    float2 viewportSize;
+
+    uint2 depthSize;
+    uint2 hizSize;
+
+    // Scales depth buffer pixels into texels of the first Hi-Z level
+    float2 depthToHiZ;
+    uint hizMipLevels;
+    uint numItems;
+
+    uint depthArraySlice;
+    uint reverseDepth;
+    uint2 padding;
+};
+
+struct OcclusionCullingItem
+{
+    float3 boundsMin;
+    uint slot;      // Index of the visibility bit, stable across frames
+    float3 boundsMax;
+    uint flags;
+};
+
+#endif // OCCLUSION_CULLING_CB_H
@@ -0,0 +1,43 @@
+/*
+* Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef OIT_CB_H
+#define OIT_CB_H
+
+#define OIT_COMPOSITE_GROUP_SIZE 8
+
+// Fragments kept per pixel by multi-layer alpha blending, one texture array slice each
+#define OIT_MLAB_LAYERS 4
+
+// The MLAB layers are bound to the forward pixel shader in addition to the bindings of donut's
+// ForwardShadingPass, in a register space after the ones used in forward_cb.h
+#define OIT_SPACE_LAYERS 4
+#define OIT_BINDING_LAYER_COLORS 0
+#define OIT_BINDING_LAYER_DEPTHS 1
+
+struct OitCompositeConstants
+{
+    uint2 size;
+    uint2 padding;
+};
+
+#endif // OIT_CB_H
@@ -0,0 +1,86 @@
+/*
+* Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma pack_matrix(row_major)
+
+#include "oit_cb.h"
+
+#if OIT_MULTI_LAYER
+#define MLAB_FRAGMENTS OIT_MLAB_LAYERS
+#include <mlab.hlsli>
+#endif
+
+ConstantBuffer<OitCompositeConstants> g_Composite : register(b0);
+
+#if OIT_MULTI_LAYER
+Texture2DArray<float4> t_LayerColors : register(t0);
+#else
+Texture2D<float4> t_Accumulation : register(t0);
+Texture2D<float> t_Revealage : register(t1);
+#endif
+
+RWTexture2D<float4> u_Color : register(u0);
+
+// Blends the translucent surfaces that the OIT buffers have collected over the color
+[numthreads(OIT_COMPOSITE_GROUP_SIZE, OIT_COMPOSITE_GROUP_SIZE, 1)]
+void composite_cs(uint2 pixelPosition : SV_DispatchThreadID)
+{
+    if (any(pixelPosition >= g_Composite.size))
+        return;
+
+    float3 color;
+    float transmittance;
+
+#if OIT_MULTI_LAYER
+    // The layers are in front to back order, their depths are not needed any more
+    BlendFragment buffer[MLAB_FRAGMENTS];
+    [unroll]
+    for (uint layer = 0; layer < MLAB_FRAGMENTS; layer++)
+    {
+        float4 layerColor = t_LayerColors[uint3(pixelPosition, layer)];
+        buffer[layer].color = layerColor.rgb;
+        buffer[layer].attenuation = layerColor.a;
+        buffer[layer].depth = 0;
+    }
+
+    BlendFragment result = blendIntegrate(buffer);
+    color = result.color;
+    transmittance = result.attenuation;
+#else
+    transmittance = t_Revealage[pixelPosition];
+
+    float4 accumulation = t_Accumulation[pixelPosition];
+
+    // The weights can overflow half floats with many close layers, keep the hue at least
+    if (any(isinf(accumulation.rgb)))
+        accumulation.rgb = accumulation.a;
+
+    float3 averageColor = accumulation.rgb / clamp(accumulation.a, 1e-4, 5e4);
+    color = averageColor * (1 - transmittance);
+#endif
+
+    if (transmittance == 1)
+        return;
+
+    float4 background = u_Color[pixelPosition];
+    u_Color[pixelPosition] = float4(color + background.rgb * transmittance, background.a);
+}
@@ -0,0 +1,200 @@
+/*
+* Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma pack_matrix(row_major)
+
+// Pixel shader for OitForwardShadingPass. Same inputs and bindings as donut's forward pixel shader:
+// the surface is lit by the lights of the pass with their cascaded shadows and by the ambient light,
+// light probes are not applied. Instead of blending over the color, the result goes into the buffers
+// of the OIT mode, see OrderIndependentTransparency.h.
+//
+// Transmissive materials are drawn with their coverage as the alpha: both OIT modes blend with a
+// scalar transmittance, so there is no colored transmission.
+
+#include <donut/shaders/forward_cb.h>
+
+#define MATERIAL_REGISTER_SPACE     FORWARD_SPACE_MATERIAL
+#define MATERIAL_CB_SLOT            FORWARD_BINDING_MATERIAL_CONSTANTS
+#define MATERIAL_DIFFUSE_SLOT       FORWARD_BINDING_MATERIAL_DIFFUSE_TEXTURE
+#define MATERIAL_SPECULAR_SLOT      FORWARD_BINDING_MATERIAL_SPECULAR_TEXTURE
+#define MATERIAL_NORMALS_SLOT       FORWARD_BINDING_MATERIAL_NORMAL_TEXTURE
+#define MATERIAL_EMISSIVE_SLOT      FORWARD_BINDING_MATERIAL_EMISSIVE_TEXTURE
+#define MATERIAL_OCCLUSION_SLOT     FORWARD_BINDING_MATERIAL_OCCLUSION_TEXTURE
+#define MATERIAL_TRANSMISSION_SLOT  FORWARD_BINDING_MATERIAL_TRANSMISSION_TEXTURE
+#define MATERIAL_OPACITY_SLOT       FORWARD_BINDING_MATERIAL_OPACITY_TEXTURE
+
+#define MATERIAL_SAMPLER_REGISTER_SPACE FORWARD_SPACE_VIEW
+#define MATERIAL_SAMPLER_SLOT       FORWARD_BINDING_MATERIAL_SAMPLER
+
+#include <donut/shaders/scene_material.hlsli>
+#include <donut/shaders/material_bindings.hlsli>
+#include <donut/shaders/forward_vertex.hlsli>
+#include <donut/shaders/lighting.hlsli>
+#include <donut/shaders/shadows.hlsli>
+#include <donut/shaders/binding_helpers.hlsli>
+#include "oit_cb.h"
+
+#if OIT_MULTI_LAYER
+#define MLAB_FRAGMENTS OIT_MLAB_LAYERS
+#include <mlab.hlsli>
+#endif
+
+DECLARE_CBUFFER(ForwardShadingViewConstants, g_ForwardView, FORWARD_BINDING_VIEW_CONSTANTS, FORWARD_SPACE_VIEW);
+DECLARE_CBUFFER(ForwardShadingLightConstants, g_ForwardLight, FORWARD_BINDING_LIGHT_CONSTANTS, FORWARD_SPACE_SHADING);
+
+Texture2DArray t_ShadowMapArray : REGISTER_SRV(FORWARD_BINDING_SHADOW_MAP_TEXTURE, FORWARD_SPACE_SHADING);
+SamplerComparisonState s_ShadowSampler : REGISTER_SAMPLER(FORWARD_BINDING_SHADOW_MAP_SAMPLER, FORWARD_SPACE_SHADING);
+
+#if OIT_MULTI_LAYER
+// Premultiplied color and transmittance, and view depth of the fragments, front to back
+RasterizerOrderedTexture2DArray<float4> u_LayerColors : REGISTER_UAV(OIT_BINDING_LAYER_COLORS, OIT_SPACE_LAYERS);
+RasterizerOrderedTexture2DArray<float> u_LayerDepths : REGISTER_UAV(OIT_BINDING_LAYER_DEPTHS, OIT_SPACE_LAYERS);
+#endif
+
+float GetLightShadow(LightConstants light, float3 surfaceWorldPos)
+{
+    if (light.shadowCascades[0] < 0)
+        return 1;
+
+    // x is the shadow, y is the weight of the cascades that covered the position so far
+    float2 shadow = 0;
+    for (int cascade = 0; cascade < 4; cascade++)
+    {
+        if (light.shadowCascades[cascade] < 0)
+            break;
+
+        float2 cascadeShadow = EvaluateShadowGather16(t_ShadowMapArray, s_ShadowSampler,
+            g_ForwardLight.shadows[light.shadowCascades[cascade]], surfaceWorldPos, g_ForwardLight.shadowMapTextureSize);
+
+        shadow = saturate(shadow + cascadeShadow * (1.0001 - shadow.y));
+
+        if (shadow.y == 1)
+            break;
+    }
+
+    return shadow.x + (1 - shadow.y) * light.outOfBoundsShadow;
+}
+
+bool IsTransmissive(int domain)
+{
+    return domain == MaterialDomain_Transmissive
+        || domain == MaterialDomain_TransmissiveAlphaTested
+        || domain == MaterialDomain_TransmissiveAlphaBlended;
+}
+
+#if OIT_MULTI_LAYER
+// Fragments that fail the depth test must not reach the layers
+[earlydepthstencil]
+#endif
+void main(
+    in float4 i_position : SV_Position,
+    in SceneVertex i_vtx,
+    in bool i_isFrontFace : SV_IsFrontFace
+#if !OIT_MULTI_LAYER
+    , out float4 o_accumulation : SV_Target0
+    , out float o_revealage : SV_Target1
+#endif
+)
+{
+    MaterialTextureSample textures = SampleMaterialTexturesAuto(i_vtx.texCoord, g_Material.normalTextureTransformScale);
+
+    MaterialSample surface = EvaluateSceneMaterial(i_vtx.normal, i_vtx.tangent, g_Material, textures);
+
+    float alpha = 1;
+    if (g_Material.domain == MaterialDomain_AlphaBlended || g_Material.domain == MaterialDomain_TransmissiveAlphaBlended)
+        alpha = surface.opacity;
+    else if (g_Material.domain == MaterialDomain_TransmissiveAlphaTested)
+        clip(surface.opacity - g_Material.alphaCutoff);
+
+    if (IsTransmissive(g_Material.domain))
+        alpha *= 1 - surface.transmission;
+
+    if (alpha <= 0)
+        discard;
+
+    if (!i_isFrontFace)
+        surface.shadingNormal = -surface.shadingNormal;
+
+    float3 surfaceWorldPos = i_vtx.pos;
+    float3 viewIncident = GetIncidentVector(g_ForwardView.view.cameraDirectionOrPosition, surfaceWorldPos);
+
+    float3 diffuseTerm = 0;
+    float3 specularTerm = 0;
+
+    for (uint lightIndex = 0; lightIndex < g_ForwardLight.numLights; lightIndex++)
+    {
+        LightConstants light = g_ForwardLight.lights[lightIndex];
+
+        float shadow = GetLightShadow(light, surfaceWorldPos);
+        if (shadow == 0)
+            continue;
+
+        float3 diffuseRadiance, specularRadiance;
+        ShadeSurface(light, surface, surfaceWorldPos, viewIncident, diffuseRadiance, specularRadiance);
+
+        diffuseTerm += (shadow * diffuseRadiance) * light.color;
+        specularTerm += (shadow * specularRadiance) * light.color;
+    }
+
+    float3 ambientColor = lerp(g_ForwardLight.ambientColorBottom.rgb, g_ForwardLight.ambientColorTop.rgb, surface.shadingNormal.y * 0.5 + 0.5);
+    diffuseTerm += ambientColor * surface.diffuseAlbedo * surface.occlusion;
+    specularTerm += ambientColor * surface.specularF0 * surface.occlusion;
+
+    float3 premultipliedColor = (diffuseTerm + specularTerm + surface.emissiveColor) * alpha;
+
+    // Clip space w is the view depth with perspective projections
+    float viewDepth = i_position.w;
+
+#if OIT_MULTI_LAYER
+    const uint2 pixelPosition = uint2(i_position.xy);
+
+    BlendFragment buffer[MLAB_FRAGMENTS];
+    [unroll]
+    for (uint layer = 0; layer < MLAB_FRAGMENTS; layer++)
+    {
+        float4 layerColor = u_LayerColors[uint3(pixelPosition, layer)];
+        buffer[layer].color = layerColor.rgb;
+        buffer[layer].attenuation = layerColor.a;
+        buffer[layer].depth = u_LayerDepths[uint3(pixelPosition, layer)];
+    }
+
+    BlendFragment fragment;
+    fragment.color = premultipliedColor;
+    fragment.attenuation = 1 - alpha;
+    fragment.depth = viewDepth;
+    blendInsert(fragment, buffer);
+
+    [unroll]
+    for (uint outputLayer = 0; outputLayer < MLAB_FRAGMENTS; outputLayer++)
+    {
+        u_LayerColors[uint3(pixelPosition, outputLayer)] = float4(buffer[outputLayer].color, buffer[outputLayer].attenuation);
+        u_LayerDepths[uint3(pixelPosition, outputLayer)] = buffer[outputLayer].depth;
+    }
+#else
+    // Depth weight, equation 7 in McGuire and Bavoil, "Weighted Blended Order-Independent Transparency"
+    float weight = alpha * clamp(10 / (1e-5 + pow(viewDepth / 5, 2) + pow(viewDepth / 200, 6)), 1e-2, 3e3);
+
+    // Added up in the accumulation target, the revealage target is multiplied by 1 - alpha
+    o_accumulation = float4(premultipliedColor, alpha) * weight;
+    o_revealage = alpha;
+#endif
+}
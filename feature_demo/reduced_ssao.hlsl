@@ -0,0 +1,338 @@
+/*
+* Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma pack_matrix(row_major)
+
+#include <compact_gbuffer.hlsli>
+#include "reduced_ssao_cb.h"
+
+#ifndef OCTAHEDRAL_NORMALS
+#define OCTAHEDRAL_NORMALS 0
+#endif
+
+// ---[ Resources ]---
+
+ConstantBuffer<ReducedSsaoConstants> g_Ssao : register(b0);
+
+// Full resolution inputs
+Texture2D t_Depth : register(t0);
+Texture2D<float4> t_Normals : register(t1);
+Texture2D<float2> t_MotionVectors : register(t2);
+
+// Reduced resolution view depth, and view space normals with the index of the selected sample in w
+Texture2D<float> t_LowDepth : register(t3);
+Texture2D<float4> t_LowNormals : register(t4);
+Texture2D<float> t_PrevLowDepth : register(t5);
+Texture2D<float> t_RawAO : register(t6);
+// AO and history length: the previous frame's result in the temporal pass, the current one in upsampling
+Texture2D<float2> t_AccumulatedAO : register(t7);
+
+RWTexture2D<float> u_LowDepth : register(u0);
+RWTexture2D<float4> u_LowNormals : register(u1);
+RWTexture2D<float> u_RawAO : register(u2);
+RWTexture2D<float2> u_AccumulatedAO : register(u3);
+RWTexture2D<float> u_Output : register(u4);
+
+// View depth stored for pixels without geometry
+static const float c_BackgroundDepth = 1e8;
+static const float c_GoldenAngle = 2.39996323;
+
+// ---[ Helpers ]---
+
+bool IsBackground(float depth)
+{
+    return g_Ssao.reverseDepth ? (depth == 0) : (depth == 1);
+}
+
+float3 ClipToView(float2 clipXY, float depth)
+{
+    float4 viewPos = mul(float4(clipXY, depth, 1), g_Ssao.view.matClipToView);
+    return viewPos.xyz / viewPos.w;
+}
+
+float2 WindowToClip(float2 windowPos)
+{
+    return windowPos * g_Ssao.view.windowToClipScale + g_Ssao.view.windowToClipBias;
+}
+
+// Reconstructs the view space position of a full resolution pixel from its view depth
+float3 GetViewPosition(int2 fullPixel, float viewDepth)
+{
+    // The near plane is finite with both regular and infinite reverse projections
+    float3 ray = ClipToView(WindowToClip(float2(fullPixel) + 0.5), g_Ssao.reverseDepth ? 1 : 0);
+    return ray * (viewDepth / ray.z);
+}
+
+float3 GetViewNormal(int2 fullPixel)
+{
+#if OCTAHEDRAL_NORMALS
+    float3 worldNormal = DecodeOctahedralNormal(t_Normals[fullPixel].xy);
+#else
+    float3 worldNormal = t_Normals[fullPixel].xyz;
+#endif
+    return normalize(mul(float4(worldNormal, 0), g_Ssao.view.matWorldToView).xyz);
+}
+
+// Full resolution pixel that a reduced resolution pixel was taken from
+int2 GetSamplePixel(int2 lowPixel, uint sampleIndex)
+{
+    int2 blockOrigin = g_Ssao.fullResOrigin + (lowPixel - g_Ssao.lowResOrigin) * int(g_Ssao.downsampleFactor);
+    return blockOrigin + int2(sampleIndex % g_Ssao.downsampleFactor, sampleIndex / g_Ssao.downsampleFactor);
+}
+
+// Maps a full resolution window position to continuous reduced resolution texel coordinates
+float2 FullToLowResPosition(float2 fullPos)
+{
+    return (fullPos - float2(g_Ssao.fullResOrigin)) / float(g_Ssao.downsampleFactor) + float2(g_Ssao.lowResOrigin) - 0.5;
+}
+
+bool IsInsideLowResViewport(int2 lowPixel)
+{
+    return all(lowPixel >= g_Ssao.lowResOrigin) && all(lowPixel < g_Ssao.lowResOrigin + g_Ssao.lowResSize);
+}
+
+float InterleavedGradientNoise(float2 pixel)
+{
+    return frac(52.9829189 * frac(dot(pixel, float2(0.06711056, 0.00583715))));
+}
+
+// ---[ Depth and Normal Downsampling ]---
+
+// Picks one full resolution sample per block, alternating between the nearest and the farthest
+// sample in a checkerboard pattern so that both sides of depth edges are represented.
+// Depth and normal always come from the same sample.
+[numthreads(REDUCED_SSAO_GROUP_SIZE, REDUCED_SSAO_GROUP_SIZE, 1)]
+void downsample_cs(uint3 globalId : SV_DispatchThreadID)
+{
+    if (any(int2(globalId.xy) >= g_Ssao.lowResSize))
+        return;
+
+    const int2 lowPixel = g_Ssao.lowResOrigin + int2(globalId.xy);
+    const bool selectFarthest = ((lowPixel.x ^ lowPixel.y) & 1) != 0;
+    const int2 fullResEnd = g_Ssao.fullResOrigin + g_Ssao.fullResSize;
+
+    float bestDepth = selectFarthest ? -1 : c_BackgroundDepth * 2;
+    uint bestIndex = 0;
+
+    for (uint sampleIndex = 0; sampleIndex < g_Ssao.downsampleFactor * g_Ssao.downsampleFactor; sampleIndex++)
+    {
+        int2 fullPixel = GetSamplePixel(lowPixel, sampleIndex);
+        if (any(fullPixel >= fullResEnd))
+            continue;
+
+        float depth = t_Depth[fullPixel].x;
+        float viewDepth = IsBackground(depth) ? c_BackgroundDepth : ClipToView(WindowToClip(float2(fullPixel) + 0.5), depth).z;
+
+        if (selectFarthest ? (viewDepth > bestDepth) : (viewDepth < bestDepth))
+        {
+            bestDepth = viewDepth;
+            bestIndex = sampleIndex;
+        }
+    }
+
+    const int2 fullPixel = GetSamplePixel(lowPixel, bestIndex);
+    u_LowDepth[lowPixel] = bestDepth;
+    u_LowNormals[lowPixel] = float4(bestDepth < c_BackgroundDepth ? GetViewNormal(fullPixel) : 0, bestIndex);
+}
+
+// ---[ Ambient Occlusion ]---
+
+// Estimates the occlusion from a few samples in a disk around the pixel, scaled to the world space
+// radius. The sample pattern rotates every frame so that the temporal pass can accumulate a larger
+// effective number of samples.
+[numthreads(REDUCED_SSAO_GROUP_SIZE, REDUCED_SSAO_GROUP_SIZE, 1)]
+void ao_cs(uint3 globalId : SV_DispatchThreadID)
+{
+    if (any(int2(globalId.xy) >= g_Ssao.lowResSize))
+        return;
+
+    const int2 lowPixel = g_Ssao.lowResOrigin + int2(globalId.xy);
+    const float viewDepth = t_LowDepth[lowPixel];
+
+    if (viewDepth > g_Ssao.backgroundViewDepth)
+    {
+        u_RawAO[lowPixel] = 1;
+        return;
+    }
+
+    const float4 normalAndIndex = t_LowNormals[lowPixel];
+    const float3 position = GetViewPosition(GetSamplePixel(lowPixel, uint(normalAndIndex.w)), viewDepth);
+    const float3 normal = normalAndIndex.xyz;
+
+    const float radiusSquared = g_Ssao.radiusWorld * g_Ssao.radiusWorld;
+    const float2 radiusPixels = g_Ssao.radiusWorld * g_Ssao.projectionScale / viewDepth;
+
+    const float noise = InterleavedGradientNoise(float2(lowPixel));
+    const float startAngle = (noise + float(g_Ssao.frameIndex) * 0.618034) * 6.2831853;
+    const float radialJitter = frac(noise * 7.0 + float(g_Ssao.frameIndex) * 0.7548777);
+
+    float occlusion = 0;
+    for (uint sampleIndex = 0; sampleIndex < g_Ssao.numSamples; sampleIndex++)
+    {
+        float angle = startAngle + float(sampleIndex) * c_GoldenAngle;
+        float radius = sqrt((float(sampleIndex) + radialJitter) / float(g_Ssao.numSamples));
+        int2 samplePixel = int2(floor(float2(lowPixel) + 0.5 + float2(cos(angle), sin(angle)) * radius * radiusPixels));
+
+        if (all(samplePixel == lowPixel) || !IsInsideLowResViewport(samplePixel))
+            continue;
+
+        float sampleDepth = t_LowDepth[samplePixel];
+        if (sampleDepth > g_Ssao.backgroundViewDepth)
+            continue;
+
+        uint sampleSubPixel = uint(t_LowNormals[samplePixel].w);
+        float3 delta = GetViewPosition(GetSamplePixel(samplePixel, sampleSubPixel), sampleDepth) - position;
+        float distanceSquared = dot(delta, delta);
+        if (distanceSquared >= radiusSquared || distanceSquared < 1e-8)
+            continue;
+
+        float cosine = dot(delta, normal) * rsqrt(distanceSquared);
+        occlusion += saturate(cosine - g_Ssao.surfaceBias) * (1 - distanceSquared / radiusSquared);
+    }
+
+    occlusion /= float(max(g_Ssao.numSamples, 1));
+    u_RawAO[lowPixel] = pow(saturate(1 - occlusion * g_Ssao.amount), g_Ssao.powerExponent);
+}
+
+// ---[ Temporal Accumulation ]---
+
+// Blends the new AO into the reprojected history. History samples whose depth differs from the
+// current pixel are rejected; pixels without valid history start accumulating again.
+[numthreads(REDUCED_SSAO_GROUP_SIZE, REDUCED_SSAO_GROUP_SIZE, 1)]
+void temporal_cs(uint3 globalId : SV_DispatchThreadID)
+{
+    if (any(int2(globalId.xy) >= g_Ssao.lowResSize))
+        return;
+
+    const int2 lowPixel = g_Ssao.lowResOrigin + int2(globalId.xy);
+    const float rawAO = t_RawAO[lowPixel];
+    const float viewDepth = t_LowDepth[lowPixel];
+
+    if (!g_Ssao.historyValid || viewDepth > g_Ssao.backgroundViewDepth)
+    {
+        u_AccumulatedAO[lowPixel] = float2(rawAO, 1);
+        return;
+    }
+
+    const int2 fullPixel = GetSamplePixel(lowPixel, uint(t_LowNormals[lowPixel].w));
+    const float2 motion = t_MotionVectors[fullPixel];
+    const float2 prevPosition = FullToLowResPosition(float2(fullPixel) + 0.5 + motion);
+    const int2 basePixel = int2(floor(prevPosition));
+    const float2 weights = frac(prevPosition);
+
+    float2 history = 0;
+    float totalWeight = 0;
+
+    [unroll]
+    for (int tap = 0; tap < 4; tap++)
+    {
+        int2 offset = int2(tap & 1, tap >> 1);
+        int2 tapPixel = basePixel + offset;
+        if (!IsInsideLowResViewport(tapPixel))
+            continue;
+
+        float2 bilinear = lerp(1 - weights, weights, float2(offset));
+        float weight = bilinear.x * bilinear.y;
+
+        float prevDepth = t_PrevLowDepth[tapPixel];
+        if (abs(prevDepth - viewDepth) > g_Ssao.depthRejection * viewDepth)
+            continue;
+
+        history += t_AccumulatedAO[tapPixel] * weight;
+        totalWeight += weight;
+    }
+
+    if (totalWeight < 1e-3)
+    {
+        u_AccumulatedAO[lowPixel] = float2(rawAO, 1);
+        return;
+    }
+
+    history /= totalWeight;
+
+    float historyLength = min(history.y + 1, g_Ssao.maxHistoryLength);
+    float ao = lerp(history.x, rawAO, 1 / historyLength);
+    u_AccumulatedAO[lowPixel] = float2(ao, historyLength);
+}
+
+// ---[ Bilateral Upsampling ]---
+
+// Interpolates the reduced resolution AO with bilinear weights modulated by depth and normal
+// similarity, falling back to the closest sample in depth when no sample is similar enough.
+[numthreads(REDUCED_SSAO_GROUP_SIZE, REDUCED_SSAO_GROUP_SIZE, 1)]
+void upsample_cs(uint3 globalId : SV_DispatchThreadID)
+{
+    if (any(int2(globalId.xy) >= g_Ssao.fullResSize))
+        return;
+
+    const int2 fullPixel = g_Ssao.fullResOrigin + int2(globalId.xy);
+    if (fullPixel.x >= g_Ssao.splitPosition)
+        return;
+
+    const float depth = t_Depth[fullPixel].x;
+    if (IsBackground(depth))
+    {
+        u_Output[fullPixel] = 1;
+        return;
+    }
+
+    const float viewDepth = ClipToView(WindowToClip(float2(fullPixel) + 0.5), depth).z;
+    const float3 normal = GetViewNormal(fullPixel);
+
+    const float2 lowPosition = FullToLowResPosition(float2(fullPixel) + 0.5);
+    const int2 basePixel = int2(floor(lowPosition));
+    const float2 weights = frac(lowPosition);
+    const int2 lowResMax = g_Ssao.lowResOrigin + g_Ssao.lowResSize - 1;
+
+    float sum = 0;
+    float totalWeight = 0;
+    float closestAO = 1;
+    float closestDepthDifference = c_BackgroundDepth;
+
+    [unroll]
+    for (int tap = 0; tap < 4; tap++)
+    {
+        int2 offset = int2(tap & 1, tap >> 1);
+        int2 tapPixel = clamp(basePixel + offset, g_Ssao.lowResOrigin, lowResMax);
+
+        float2 bilinear = lerp(1 - weights, weights, float2(offset));
+        float tapDepth = t_LowDepth[tapPixel];
+        float3 tapNormal = t_LowNormals[tapPixel].xyz;
+        float tapAO = t_AccumulatedAO[tapPixel].x;
+
+        float depthDifference = abs(tapDepth - viewDepth);
+        float depthWeight = exp2(-g_Ssao.upsampleSharpness * depthDifference / viewDepth);
+        float normalWeight = pow(saturate(dot(tapNormal, normal)), 8);
+        float weight = max(bilinear.x * bilinear.y, 1e-3) * depthWeight * normalWeight;
+
+        sum += tapAO * weight;
+        totalWeight += weight;
+
+        if (depthDifference < closestDepthDifference)
+        {
+            closestDepthDifference = depthDifference;
+            closestAO = tapAO;
+        }
+    }
+
+    u_Output[fullPixel] = (totalWeight > 1e-4) ? sum / totalWeight : closestAO;
+}
@@ -0,0 +1,62 @@
+/*
+* Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef REDUCED_SSAO_CB_H
+#define REDUCED_SSAO_CB_H
+
+#include <donut/shaders/view_cb.h>
+
+#define REDUCED_SSAO_GROUP_SIZE 8
+#define REDUCED_SSAO_MAX_DOWNSAMPLE_FACTOR 4
+
+struct ReducedSsaoConstants
+{
+    PlanarViewConstants view;
+
+    // Viewport of the view in the full resolution inputs and in the reduced resolution textures
+    int2 fullResOrigin;
+    int2 fullResSize;
+    int2 lowResOrigin;
+    int2 lowResSize;
+
+    uint downsampleFactor;
+    uint frameIndex;
+    uint numSamples;
+    uint historyValid;
+
+    float radiusWorld;
+    float surfaceBias;
+    float powerExponent;
+    float amount;
+
+    // Converts a view space length at view depth 1 into reduced resolution pixels
+    float2 projectionScale;
+    float backgroundViewDepth;
+    float maxHistoryLength;
+
+    float depthRejection;
+    float upsampleSharpness;
+    int splitPosition;
+    uint reverseDepth;
+};
+
+#endif // REDUCED_SSAO_CB_H
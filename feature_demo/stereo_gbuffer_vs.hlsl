@@ -0,0 +1,74 @@
+/*
+* Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma pack_matrix(row_major)
+
+#include <donut/shaders/bindless.h>
+#include <donut/shaders/binding_helpers.hlsli>
+#include <donut/shaders/forward_vertex.hlsli>
+#include <donut/shaders/packing.hlsli>
+#include "stereo_gbuffer_cb.h"
+
+DECLARE_CBUFFER(StereoGBufferFillConstants, c_StereoGBuffer, GBUFFER_BINDING_VIEW_CONSTANTS, GBUFFER_SPACE_VIEW);
+
+DECLARE_PUSH_CONSTANTS(GBufferPushConstants, g_Push, GBUFFER_BINDING_PUSH_CONSTANTS, GBUFFER_SPACE_VIEW);
+
+StructuredBuffer<InstanceData> t_Instances : REGISTER_SRV(GBUFFER_BINDING_INSTANCE_BUFFER, GBUFFER_SPACE_INPUT);
+ByteAddressBuffer t_Vertices : REGISTER_SRV(GBUFFER_BINDING_VERTEX_BUFFER, GBUFFER_SPACE_INPUT);
+
+// Instanced stereo: every draw is issued with twice the instance count, and the lowest bit of the
+// instance ID selects the eye. Both eyes share one viewport that covers the whole render target,
+// so each eye is squeezed into its half of the clip space and clipped at the center line.
+void buffer_loads(
+    in uint i_vertexID : SV_VertexID,
+    in uint i_instanceID : SV_InstanceID,
+    out float4 o_position : SV_Position,
+    out SceneVertex o_vtx,
+    out uint o_instance : INSTANCE,
+    out float o_clipDistance : SV_ClipDistance0)
+{
+    const uint eye = i_instanceID & 1;
+    const uint instanceIndex = i_instanceID >> 1;
+
+    InstanceData instance = t_Instances[instanceIndex + g_Push.startInstanceLocation];
+    uint vertexID = i_vertexID + g_Push.startVertexLocation;
+
+    float3 position = asfloat(t_Vertices.Load3(g_Push.positionOffset + vertexID * c_SizeOfPosition));
+    float2 texCoord = asfloat(t_Vertices.Load2(g_Push.texCoordOffset + vertexID * c_SizeOfTexcoord));
+    float3 normal = Unpack_RGB8_SNORM(t_Vertices.Load(g_Push.normalOffset + vertexID * c_SizeOfNormal));
+    float4 tangent = Unpack_RGBA8_SNORM(t_Vertices.Load(g_Push.tangentOffset + vertexID * c_SizeOfNormal));
+
+    o_vtx.pos = mul(instance.transform, float4(position, 1.0)).xyz;
+    o_vtx.prevPos = mul(instance.prevTransform, float4(position, 1.0)).xyz;
+    o_vtx.texCoord = texCoord;
+    o_vtx.normal = mul(instance.transform, float4(normal, 0)).xyz;
+    o_vtx.tangent.xyz = mul(instance.transform, float4(tangent.xyz, 0)).xyz;
+    o_vtx.tangent.w = tangent.w;
+
+    float4 clipPos = mul(float4(o_vtx.pos, 1.0), c_StereoGBuffer.eyes[eye].view.matWorldToClip);
+
+    clipPos.x = clipPos.x * 0.5 + (eye ? 0.5 : -0.5) * clipPos.w;
+    o_clipDistance = eye ? clipPos.x : -clipPos.x;
+
+    o_position = clipPos;
+    o_instance = instanceIndex + g_Push.startInstanceLocation;
+}
@@ -0,0 +1,233 @@
+/*
+* Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#pragma pack_matrix(row_major)
+
+#include <donut/shaders/gbuffer.hlsli>
+#include <donut/shaders/lighting.hlsli>
+#include <donut/shaders/light_cb.h>
+#include <compact_gbuffer.hlsli>
+#include "tiled_lighting_cb.h"
+
+#ifndef COMPACT_GBUFFER
+#define COMPACT_GBUFFER 0
+#endif
+
+// ---[ Resources ]---
+
+ConstantBuffer<TiledLightingConstants> g_Tiled : register(b0);
+
+Texture2D t_GBufferDepth : register(t0);
+
+#if CULL_LIGHTS
+
+// xyz = world space position, w = range or a negative value for lights with unlimited range
+StructuredBuffer<float4> t_LightSpheres : register(t1);
+RWStructuredBuffer<uint> u_TileLights : register(u0);
+RWStructuredBuffer<uint> u_Counters : register(u1);
+
+#else
+
+Texture2D t_GBuffer0 : register(t1);
+Texture2D t_GBuffer1 : register(t2);
+Texture2D t_GBuffer2 : register(t3);
+Texture2D t_GBuffer3 : register(t4);
+StructuredBuffer<LightConstants> t_Lights : register(t5);
+StructuredBuffer<uint> t_TileLights : register(t6);
+RWTexture2D<float4> u_Output : register(u0);
+
+#endif
+
+bool IsBackground(float depth)
+{
+    return g_Tiled.reverseDepth ? (depth == 0) : (depth == 1);
+}
+
+bool GetPixel(uint2 groupId, uint2 threadId, out uint2 pixelPosition)
+{
+    uint2 viewportOrigin = uint2(g_Tiled.view.viewportOrigin);
+    uint2 viewportSize = uint2(g_Tiled.view.viewportSize);
+    uint2 offset = groupId * TILED_LIGHTING_TILE_SIZE + threadId;
+
+    pixelPosition = viewportOrigin + offset;
+    return all(offset < viewportSize);
+}
+
+uint GetTileIndex(uint2 groupId)
+{
+    return g_Tiled.tileListOffset + groupId.y * g_Tiled.tileCount.x + groupId.x;
+}
+
+#if CULL_LIGHTS
+
+// ---[ Light Culling ]---
+
+groupshared uint s_MinDepth;
+groupshared uint s_MaxDepth;
+groupshared uint s_NumLights;
+groupshared uint s_LightIndices[TILED_LIGHTING_MAX_LIGHTS_PER_TILE];
+
+float3 ClipToView(float2 clipXY, float depth)
+{
+    float4 viewPos = mul(float4(clipXY, depth, 1), g_Tiled.view.matClipToView);
+    return viewPos.xyz / viewPos.w;
+}
+
+[numthreads(TILED_LIGHTING_TILE_SIZE, TILED_LIGHTING_TILE_SIZE, 1)]
+void cull_cs(uint3 groupId : SV_GroupID, uint3 threadId : SV_GroupThreadID, uint threadIndex : SV_GroupIndex)
+{
+    if (threadIndex == 0)
+    {
+        s_MinDepth = asuint(1.0);
+        s_MaxDepth = 0;
+        s_NumLights = 0;
+    }
+
+    GroupMemoryBarrierWithGroupSync();
+
+    // Depth values are non-negative, so their bit patterns sort the same way as the floats
+    uint2 pixelPosition;
+    if (GetPixel(groupId.xy, threadId.xy, pixelPosition))
+    {
+        float depth = t_GBufferDepth[pixelPosition].x;
+        if (!IsBackground(depth))
+        {
+            InterlockedMin(s_MinDepth, asuint(depth));
+            InterlockedMax(s_MaxDepth, asuint(depth));
+        }
+    }
+
+    GroupMemoryBarrierWithGroupSync();
+
+    float minDepth = asfloat(s_MinDepth);
+    float maxDepth = asfloat(s_MaxDepth);
+
+    // Tiles that only contain the sky don't need any lights
+    if (minDepth <= maxDepth)
+    {
+        // Bounding box of the tile frustum between the depth bounds, in view space
+        float2 windowMin = g_Tiled.view.viewportOrigin + float2(groupId.xy * TILED_LIGHTING_TILE_SIZE);
+        float2 windowMax = min(windowMin + TILED_LIGHTING_TILE_SIZE, g_Tiled.view.viewportOrigin + g_Tiled.view.viewportSize);
+        float2 clipMin = windowMin * g_Tiled.view.windowToClipScale + g_Tiled.view.windowToClipBias;
+        float2 clipMax = windowMax * g_Tiled.view.windowToClipScale + g_Tiled.view.windowToClipBias;
+
+        float3 boxMin = ClipToView(clipMin, minDepth);
+        float3 boxMax = boxMin;
+        [unroll]
+        for (uint corner = 1; corner < 8; corner++)
+        {
+            float2 clipXY = float2((corner & 1) ? clipMax.x : clipMin.x, (corner & 2) ? clipMax.y : clipMin.y);
+            float3 viewPos = ClipToView(clipXY, (corner & 4) ? maxDepth : minDepth);
+            boxMin = min(boxMin, viewPos);
+            boxMax = max(boxMax, viewPos);
+        }
+
+        for (uint lightIndex = threadIndex; lightIndex < g_Tiled.numLights; lightIndex += TILED_LIGHTING_TILE_SIZE * TILED_LIGHTING_TILE_SIZE)
+        {
+            float4 sphere = t_LightSpheres[lightIndex];
+
+            bool visible = true;
+            if (sphere.w >= 0)
+            {
+                float3 center = mul(float4(sphere.xyz, 1), g_Tiled.view.matWorldToView).xyz;
+                float3 delta = center - clamp(center, boxMin, boxMax);
+                visible = dot(delta, delta) <= sphere.w * sphere.w;
+            }
+
+            if (visible)
+            {
+                uint slot;
+                InterlockedAdd(s_NumLights, 1, slot);
+                if (slot < TILED_LIGHTING_MAX_LIGHTS_PER_TILE)
+                    s_LightIndices[slot] = lightIndex;
+            }
+        }
+    }
+
+    GroupMemoryBarrierWithGroupSync();
+
+    uint tileBase = GetTileIndex(groupId.xy) * TILED_LIGHTING_TILE_STRIDE;
+    uint numLights = min(s_NumLights, TILED_LIGHTING_MAX_LIGHTS_PER_TILE);
+
+    if (threadIndex == 0)
+    {
+        u_TileLights[tileBase] = numLights;
+
+        if (s_NumLights > TILED_LIGHTING_MAX_LIGHTS_PER_TILE)
+        {
+            InterlockedAdd(u_Counters[TILED_LIGHTING_COUNTER_OVERFLOW_TILES], 1);
+            InterlockedMax(u_Counters[TILED_LIGHTING_COUNTER_MAX_TILE_LIGHTS], s_NumLights);
+        }
+    }
+
+    for (uint slot = threadIndex; slot < numLights; slot += TILED_LIGHTING_TILE_SIZE * TILED_LIGHTING_TILE_SIZE)
+        u_TileLights[tileBase + 1 + slot] = s_LightIndices[slot];
+}
+
+#else
+
+// ---[ Shading ]---
+
+[numthreads(TILED_LIGHTING_TILE_SIZE, TILED_LIGHTING_TILE_SIZE, 1)]
+void shade_cs(uint3 groupId : SV_GroupID, uint3 threadId : SV_GroupThreadID)
+{
+    uint2 pixelPosition;
+    if (!GetPixel(groupId.xy, threadId.xy, pixelPosition))
+        return;
+
+    float depth = t_GBufferDepth[pixelPosition].x;
+    if (IsBackground(depth))
+        return;
+
+    uint tileBase = GetTileIndex(groupId.xy) * TILED_LIGHTING_TILE_STRIDE;
+    uint numLights = t_TileLights[tileBase];
+    if (numLights == 0)
+        return;
+
+#if COMPACT_GBUFFER
+    MaterialSample surfaceMaterial = DecodeCompactGBuffer(pixelPosition, t_GBuffer0, t_GBuffer1, t_GBuffer2, t_GBuffer3);
+#else
+    MaterialSample surfaceMaterial = DecodeGBuffer(pixelPosition, t_GBuffer0, t_GBuffer1, t_GBuffer2, t_GBuffer3);
+#endif
+
+    float3 surfaceWorldPos = ReconstructWorldPosition(g_Tiled.view, float2(pixelPosition) + 0.5, depth);
+
+    float3 viewIncident = GetIncidentVector(g_Tiled.view.cameraDirectionOrPosition, surfaceWorldPos);
+
+    float3 diffuseTerm = 0;
+    float3 specularTerm = 0;
+
+    for (uint slot = 0; slot < numLights; slot++)
+    {
+        LightConstants light = t_Lights[t_TileLights[tileBase + 1 + slot]];
+
+        float3 diffuseRadiance, specularRadiance;
+        ShadeSurface(light, surfaceMaterial, surfaceWorldPos, viewIncident, diffuseRadiance, specularRadiance);
+
+        diffuseTerm += diffuseRadiance * light.color;
+        specularTerm += specularRadiance * light.color;
+    }
+
+    u_Output[pixelPosition] += float4(diffuseTerm + specularTerm, 0);
+}
+
+#endif
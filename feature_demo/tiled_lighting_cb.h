@@ -0,0 +1,51 @@
+/*
+* Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef TILED_LIGHTING_CB_H
+#define TILED_LIGHTING_CB_H
+
+#include <donut/shaders/view_cb.h>
+
+#define TILED_LIGHTING_TILE_SIZE 16
+#define TILED_LIGHTING_MAX_LIGHTS_PER_TILE 255
+
+// Every tile stores its light count followed by up to TILED_LIGHTING_MAX_LIGHTS_PER_TILE light indices
+#define TILED_LIGHTING_TILE_STRIDE (TILED_LIGHTING_MAX_LIGHTS_PER_TILE + 1)
+
+// Lights past the per-tile limit are dropped, these counters report it
+#define TILED_LIGHTING_COUNTER_OVERFLOW_TILES 0
+#define TILED_LIGHTING_COUNTER_MAX_TILE_LIGHTS 1
+#define TILED_LIGHTING_NUM_COUNTERS 2
+
+struct TiledLightingConstants
+{
+    PlanarViewConstants view;
+
+    uint2 tileCount;
+    uint numLights;
+    uint tileListOffset;
+
+    uint reverseDepth;
+    uint3 padding;
+};
+
+#endif // TILED_LIGHTING_CB_H
@@ -0,0 +1,411 @@
+/*
+* Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+// Visibility buffer rendering.
+//
+// The raster stage only writes depth and the IDs of the visible triangle. The material pass then
+// bins the 8x8 pixel tiles by the materials that occur in them, and draws one quad per tile and
+// material, sorted by material, so that neighboring waves evaluate the same material. For every
+// pixel, it fetches the triangle through the bindless scene buffers, computes the barycentrics and
+// their screen derivatives from the pixel position, and writes the regular GBuffer.
+
+#pragma pack_matrix(row_major)
+
+#include <donut/shaders/bindless.h>
+#include <donut/shaders/motion_vectors.hlsli>
+#include <donut/shaders/packing.hlsli>
+#include <donut/shaders/scene_material.hlsli>
+#include <compact_gbuffer.hlsli>
+#include "visibility_buffer_cb.h"
+
+#ifdef SPIRV
+#define VK_PUSH_CONSTANT [[vk::push_constant]]
+#define VK_BINDING(reg,dset) [[vk::binding(reg,dset)]]
+#else
+#define VK_PUSH_CONSTANT
+#define VK_BINDING(reg,dset)
+#endif
+
+#ifndef ALPHA_TESTED
+#define ALPHA_TESTED 0
+#endif
+
+#ifndef CLASSIFY_SCATTER
+#define CLASSIFY_SCATTER 0
+#endif
+
+#ifndef COMPACT_GBUFFER
+#define COMPACT_GBUFFER 0
+#endif
+
+ConstantBuffer<VisibilityBufferConstants> g_Visibility : register(b0);
+VK_PUSH_CONSTANT ConstantBuffer<VisibilityDrawConstants> g_Draw : register(b1);
+
+StructuredBuffer<InstanceData> t_InstanceData : register(t0);
+StructuredBuffer<GeometryData> t_GeometryData : register(t1);
+StructuredBuffer<MaterialConstants> t_MaterialConstants : register(t2);
+Texture2D<uint2> t_VisibilityIDs : register(t3);
+StructuredBuffer<VisibilityTileEntry> t_TileList : register(t4);
+SamplerState s_MaterialSampler : register(s0);
+
+RWStructuredBuffer<uint> u_BinCounts : register(u0);
+RWStructuredBuffer<uint> u_BinOffsets : register(u1);
+RWStructuredBuffer<VisibilityTileEntry> u_TileList : register(u2);
+RWByteAddressBuffer u_IndirectArgs : register(u3);
+
+VK_BINDING(0, 1) ByteAddressBuffer t_BindlessBuffers[] : register(t0, space1);
+VK_BINDING(1, 1) Texture2D t_BindlessTextures[] : register(t0, space2);
+
+float3 LoadPosition(GeometryData geometry, uint index)
+{
+    return asfloat(t_BindlessBuffers[NonUniformResourceIndex(geometry.vertexBufferIndex)].Load3(geometry.positionOffset + index * c_SizeOfPosition));
+}
+
+float2 LoadTexCoord(GeometryData geometry, uint index)
+{
+    if (geometry.texCoord1Offset == ~0u)
+        return 0;
+
+    return asfloat(t_BindlessBuffers[NonUniformResourceIndex(geometry.vertexBufferIndex)].Load2(geometry.texCoord1Offset + index * c_SizeOfTexcoord));
+}
+
+uint LoadIndex(GeometryData geometry, uint vertexInGeometry)
+{
+    return t_BindlessBuffers[NonUniformResourceIndex(geometry.indexBufferIndex)].Load(geometry.indexOffset + vertexInGeometry * 4);
+}
+
+// Raster stage
+
+void raster_vs(
+    in uint i_vertexID : SV_VertexID,
+    out float4 o_position : SV_Position,
+    out float2 o_texCoord : TEXCOORD)
+{
+    const InstanceData instance = t_InstanceData[g_Draw.instanceIndex];
+    const GeometryData geometry = t_GeometryData[instance.firstGeometryIndex + g_Draw.geometryInMesh];
+
+    const uint index = LoadIndex(geometry, i_vertexID);
+    const float3 worldPos = mul(instance.transform, float4(LoadPosition(geometry, index), 1.0)).xyz;
+
+    o_position = mul(float4(worldPos, 1.0), g_Visibility.view.matWorldToClip);
+    o_texCoord = LoadTexCoord(geometry, index);
+}
+
+void raster_ps(
+    in float4 i_position : SV_Position,
+    in float2 i_texCoord : TEXCOORD,
+    in uint i_primitiveID : SV_PrimitiveID,
+    out uint2 o_ids : SV_Target0)
+{
+#if ALPHA_TESTED
+    const InstanceData instance = t_InstanceData[g_Draw.instanceIndex];
+    const GeometryData geometry = t_GeometryData[instance.firstGeometryIndex + g_Draw.geometryInMesh];
+    const MaterialConstants material = t_MaterialConstants[geometry.materialIndex];
+
+    float opacity = material.opacity;
+    if (material.baseOrDiffuseTextureIndex >= 0)
+        opacity *= t_BindlessTextures[NonUniformResourceIndex(material.baseOrDiffuseTextureIndex)].Sample(s_MaterialSampler, i_texCoord).a;
+
+    clip(opacity - material.alphaCutoff);
+#endif
+
+    o_ids = uint2(g_Draw.instanceIndex | (g_Draw.geometryInMesh << VISIBILITY_INSTANCE_BITS), i_primitiveID);
+}
+
+// Material binning
+
+uint GetPixelMaterial(uint2 ids)
+{
+    const InstanceData instance = t_InstanceData[ids.x & VISIBILITY_INSTANCE_MASK];
+    const GeometryData geometry = t_GeometryData[instance.firstGeometryIndex + (ids.x >> VISIBILITY_INSTANCE_BITS)];
+    return geometry.materialIndex;
+}
+
+// Open addressing set of the materials found in the tile, twice the size of the tile to keep probing short
+#define TILE_MATERIAL_SLOTS (VISIBILITY_TILE_SIZE * VISIBILITY_TILE_SIZE * 2)
+groupshared uint s_TileMaterials[TILE_MATERIAL_SLOTS];
+
+// Two passes with the same classification: the first one counts the tiles of every material,
+// the second one, after prefix_cs has turned the counts into offsets, writes the tile list.
+[numthreads(VISIBILITY_TILE_SIZE, VISIBILITY_TILE_SIZE, 1)]
+void classify_cs(uint3 groupId : SV_GroupID, uint threadIndex : SV_GroupIndex, uint2 localId : SV_GroupThreadID)
+{
+    for (uint slot = threadIndex; slot < TILE_MATERIAL_SLOTS; slot += VISIBILITY_TILE_SIZE * VISIBILITY_TILE_SIZE)
+        s_TileMaterials[slot] = VISIBILITY_EMPTY;
+
+    GroupMemoryBarrierWithGroupSync();
+
+    const uint2 pixel = uint2(g_Visibility.view.viewportOrigin) + groupId.xy * VISIBILITY_TILE_SIZE + localId;
+    const bool inside = all(float2(groupId.xy * VISIBILITY_TILE_SIZE + localId) < g_Visibility.view.viewportSize);
+    const uint2 ids = inside ? t_VisibilityIDs[pixel] : uint2(VISIBILITY_EMPTY, 0);
+
+    if (ids.x == VISIBILITY_EMPTY)
+        return;
+
+    const uint material = GetPixelMaterial(ids);
+
+    // Only the thread that inserts the material into the set reports the tile
+    uint slot = (material * 2654435761u) % TILE_MATERIAL_SLOTS;
+    for (uint probe = 0; probe < TILE_MATERIAL_SLOTS; probe++)
+    {
+        uint previous;
+        InterlockedCompareExchange(s_TileMaterials[slot], VISIBILITY_EMPTY, material, previous);
+
+        if (previous == material)
+            return;
+
+        if (previous == VISIBILITY_EMPTY)
+        {
+#if CLASSIFY_SCATTER
+            uint position;
+            InterlockedAdd(u_BinOffsets[material], 1, position);
+            if (position >= g_Visibility.tileListCapacity)
+                return;
+
+            VisibilityTileEntry entry;
+            entry.tile = groupId.x | (groupId.y << 16);
+            entry.material = material;
+            u_TileList[position] = entry;
+#else
+            InterlockedAdd(u_BinCounts[material], 1);
+#endif
+            return;
+        }
+
+        slot = (slot + 1) % TILE_MATERIAL_SLOTS;
+    }
+}
+
+groupshared uint s_ChunkSums[VISIBILITY_PREFIX_GROUP_SIZE];
+
+// Exclusive prefix sum of the bin sizes in a single group, which also fills the resolve draw arguments
+[numthreads(VISIBILITY_PREFIX_GROUP_SIZE, 1, 1)]
+void prefix_cs(uint threadIndex : SV_GroupIndex)
+{
+    const uint chunkSize = (g_Visibility.numMaterials + VISIBILITY_PREFIX_GROUP_SIZE - 1) / VISIBILITY_PREFIX_GROUP_SIZE;
+    const uint chunkStart = threadIndex * chunkSize;
+    const uint chunkEnd = min(chunkStart + chunkSize, g_Visibility.numMaterials);
+
+    uint sum = 0;
+    for (uint material = chunkStart; material < chunkEnd; material++)
+        sum += u_BinCounts[material];
+    s_ChunkSums[threadIndex] = sum;
+
+    GroupMemoryBarrierWithGroupSync();
+
+    if (threadIndex == 0)
+    {
+        uint total = 0;
+        for (uint chunk = 0; chunk < VISIBILITY_PREFIX_GROUP_SIZE; chunk++)
+        {
+            const uint chunkSum = s_ChunkSums[chunk];
+            s_ChunkSums[chunk] = total;
+            total += chunkSum;
+        }
+
+        // DrawIndirectArguments: one 4-vertex strip per tile entry
+        u_IndirectArgs.Store4(0, uint4(4, min(total, g_Visibility.tileListCapacity), 0, 0));
+    }
+
+    GroupMemoryBarrierWithGroupSync();
+
+    uint offset = s_ChunkSums[threadIndex];
+    for (uint material = chunkStart; material < chunkEnd; material++)
+    {
+        u_BinOffsets[material] = offset;
+        offset += u_BinCounts[material];
+    }
+}
+
+// Material resolve
+
+void resolve_vs(
+    in uint i_vertexID : SV_VertexID,
+    in uint i_instanceID : SV_InstanceID,
+    out float4 o_position : SV_Position,
+    out nointerpolation uint o_material : MATERIAL)
+{
+    const VisibilityTileEntry entry = t_TileList[i_instanceID];
+    const uint2 tile = uint2(entry.tile & 0xffff, entry.tile >> 16);
+    const uint2 corner = uint2(i_vertexID & 1, i_vertexID >> 1);
+
+    const float2 localPos = min(float2((tile + corner) * VISIBILITY_TILE_SIZE), g_Visibility.view.viewportSize);
+    const float2 windowPos = g_Visibility.view.viewportOrigin + localPos;
+
+    o_position = float4(windowPos * g_Visibility.view.windowToClipScale + g_Visibility.view.windowToClipBias, 0.5, 1);
+    o_material = entry.material;
+}
+
+struct Barycentrics
+{
+    float3 value;
+    float3 ddx;
+    float3 ddy;
+};
+
+// Perspective correct barycentrics of a pixel and their derivatives along the window axes,
+// from the clip space positions of the triangle vertices
+Barycentrics ComputeBarycentrics(float4 clip0, float4 clip1, float4 clip2, float2 pixelNdc, float2 viewportSize)
+{
+    const float3 invW = rcp(float3(clip0.w, clip1.w, clip2.w));
+    const float2 ndc0 = clip0.xy * invW.x;
+    const float2 ndc1 = clip1.xy * invW.y;
+    const float2 ndc2 = clip2.xy * invW.z;
+
+    const float invDet = rcp(determinant(float2x2(ndc2 - ndc1, ndc0 - ndc1)));
+    float3 ddxNdc = float3(ndc1.y - ndc2.y, ndc2.y - ndc0.y, ndc0.y - ndc1.y) * invDet * invW;
+    float3 ddyNdc = float3(ndc2.x - ndc1.x, ndc0.x - ndc2.x, ndc1.x - ndc0.x) * invDet * invW;
+    float ddxSum = dot(ddxNdc, 1);
+    float ddySum = dot(ddyNdc, 1);
+
+    const float2 delta = pixelNdc - ndc0;
+    const float interpInvW = invW.x + delta.x * ddxSum + delta.y * ddySum;
+    const float interpW = rcp(interpInvW);
+
+    Barycentrics result;
+    result.value.x = interpW * (invW.x + delta.x * ddxNdc.x + delta.y * ddyNdc.x);
+    result.value.y = interpW * (delta.x * ddxNdc.y + delta.y * ddyNdc.y);
+    result.value.z = interpW * (delta.x * ddxNdc.z + delta.y * ddyNdc.z);
+
+    // One pixel step in NDC, with Y pointing down in window space
+    const float2 pixelStep = float2(2, -2) / viewportSize;
+    ddxNdc *= pixelStep.x;
+    ddxSum *= pixelStep.x;
+    ddyNdc *= pixelStep.y;
+    ddySum *= pixelStep.y;
+
+    result.ddx = rcp(interpInvW + ddxSum) * (result.value * interpInvW + ddxNdc) - result.value;
+    result.ddy = rcp(interpInvW + ddySum) * (result.value * interpInvW + ddyNdc) - result.value;
+    return result;
+}
+
+float4 SampleMaterialTexture(int textureIndex, float2 uv, float2 ddxUV, float2 ddyUV)
+{
+    return t_BindlessTextures[NonUniformResourceIndex(textureIndex)].SampleGrad(s_MaterialSampler, uv, ddxUV, ddyUV);
+}
+
+void resolve_ps(
+    in float4 i_position : SV_Position,
+    in nointerpolation uint i_material : MATERIAL,
+    out float4 o_channel0 : SV_Target0,
+    out float4 o_channel1 : SV_Target1,
+    out float4 o_channel2 : SV_Target2,
+    out float4 o_channel3 : SV_Target3,
+    out float4 o_motion : SV_Target4)
+{
+    const uint2 ids = t_VisibilityIDs[uint2(i_position.xy)];
+    if (ids.x == VISIBILITY_EMPTY)
+        discard;
+
+    const InstanceData instance = t_InstanceData[ids.x & VISIBILITY_INSTANCE_MASK];
+    const GeometryData geometry = t_GeometryData[instance.firstGeometryIndex + (ids.x >> VISIBILITY_INSTANCE_BITS)];
+
+    // Pixels of the tile with other materials are shaded by the quads of their own bins
+    if (geometry.materialIndex != i_material)
+        discard;
+
+    const MaterialConstants material = t_MaterialConstants[i_material];
+    ByteAddressBuffer vertexBuffer = t_BindlessBuffers[NonUniformResourceIndex(geometry.vertexBufferIndex)];
+
+    uint3 indices;
+    indices.x = LoadIndex(geometry, ids.y * 3 + 0);
+    indices.y = LoadIndex(geometry, ids.y * 3 + 1);
+    indices.z = LoadIndex(geometry, ids.y * 3 + 2);
+
+    float3 objectPos[3];
+    float4 clipPos[3];
+    [unroll]
+    for (uint i = 0; i < 3; i++)
+    {
+        objectPos[i] = LoadPosition(geometry, indices[i]);
+        const float3 worldPos = mul(instance.transform, float4(objectPos[i], 1.0)).xyz;
+        clipPos[i] = mul(float4(worldPos, 1.0), g_Visibility.view.matWorldToClip);
+    }
+
+    const float2 pixelNdc = i_position.xy * g_Visibility.view.windowToClipScale + g_Visibility.view.windowToClipBias;
+    const Barycentrics bary = ComputeBarycentrics(clipPos[0], clipPos[1], clipPos[2], pixelNdc, g_Visibility.view.viewportSize);
+
+    const float3 objectPosition = objectPos[0] * bary.value.x + objectPos[1] * bary.value.y + objectPos[2] * bary.value.z;
+
+    float2 texCoord = 0;
+    float2 ddxTexCoord = 0;
+    float2 ddyTexCoord = 0;
+    if (geometry.texCoord1Offset != ~0u)
+    {
+        const float2 uv0 = LoadTexCoord(geometry, indices.x);
+        const float2 uv1 = LoadTexCoord(geometry, indices.y);
+        const float2 uv2 = LoadTexCoord(geometry, indices.z);
+        texCoord = uv0 * bary.value.x + uv1 * bary.value.y + uv2 * bary.value.z;
+        ddxTexCoord = uv0 * bary.ddx.x + uv1 * bary.ddx.y + uv2 * bary.ddx.z;
+        ddyTexCoord = uv0 * bary.ddy.x + uv1 * bary.ddy.y + uv2 * bary.ddy.z;
+    }
+
+    float3 normal = float3(0, 0, 1);
+    if (geometry.normalOffset != ~0u)
+    {
+        normal = 0;
+        [unroll]
+        for (uint i = 0; i < 3; i++)
+            normal += Unpack_RGB8_SNORM(vertexBuffer.Load(geometry.normalOffset + indices[i] * c_SizeOfNormal)) * bary.value[i];
+    }
+
+    float4 tangent = 0;
+    if (geometry.tangentOffset != ~0u)
+    {
+        [unroll]
+        for (uint i = 0; i < 3; i++)
+            tangent += Unpack_RGBA8_SNORM(vertexBuffer.Load(geometry.tangentOffset + indices[i] * c_SizeOfNormal)) * bary.value[i];
+        tangent.w = sign(tangent.w);
+    }
+
+    MaterialTextureSample textures = DefaultMaterialTextures();
+    if (material.baseOrDiffuseTextureIndex >= 0)
+        textures.baseOrDiffuse = SampleMaterialTexture(material.baseOrDiffuseTextureIndex, texCoord, ddxTexCoord, ddyTexCoord);
+    if (material.metalRoughOrSpecularTextureIndex >= 0)
+        textures.metalRoughOrSpecular = SampleMaterialTexture(material.metalRoughOrSpecularTextureIndex, texCoord, ddxTexCoord, ddyTexCoord);
+    if (material.normalTextureIndex >= 0)
+        textures.normal = SampleMaterialTexture(material.normalTextureIndex, texCoord, ddxTexCoord, ddyTexCoord);
+    if (material.emissiveTextureIndex >= 0)
+        textures.emissive = SampleMaterialTexture(material.emissiveTextureIndex, texCoord, ddxTexCoord, ddyTexCoord);
+    if (material.occlusionTextureIndex >= 0)
+        textures.occlusion = SampleMaterialTexture(material.occlusionTextureIndex, texCoord, ddxTexCoord, ddyTexCoord);
+
+    const float3 worldNormal = mul(instance.transform, float4(normal, 0)).xyz;
+    const float4 worldTangent = float4(mul(instance.transform, float4(tangent.xyz, 0)).xyz, tangent.w);
+    const MaterialSample surface = EvaluateSceneMaterial(worldNormal, worldTangent, material, textures);
+
+#if COMPACT_GBUFFER
+    EncodeCompactGBuffer(surface, uint2(i_position.xy), o_channel0, o_channel1, o_channel2, o_channel3);
+#else
+    // Same layout as the output of GBufferFillPass
+    o_channel0 = float4(surface.diffuseAlbedo, surface.opacity);
+    o_channel1 = float4(surface.specularF0, surface.occlusion);
+    o_channel2 = float4(surface.shadingNormal, surface.roughness);
+    o_channel3 = float4(surface.emissiveColor, 0);
+#endif
+
+    const float3 worldPosition = mul(instance.transform, float4(objectPosition, 1.0)).xyz;
+    const float3 prevWorldPosition = mul(instance.prevTransform, float4(objectPosition, 1.0)).xyz;
+    const float4 currentClip = mul(float4(worldPosition, 1.0), g_Visibility.view.matWorldToClip);
+    const float3 svPosition = float3(i_position.xy, currentClip.z / currentClip.w);
+    o_motion = float4(GetMotionVector(svPosition, prevWorldPosition, g_Visibility.view, g_Visibility.viewPrev), 0);
+}
@@ -0,0 +1,63 @@
+/*
+* Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef VISIBILITY_BUFFER_CB_H
+#define VISIBILITY_BUFFER_CB_H
+
+#include <donut/shaders/view_cb.h>
+
+// Material bins are made of 8x8 pixel tiles
+#define VISIBILITY_TILE_SIZE 8
+#define VISIBILITY_PREFIX_GROUP_SIZE 256
+
+// The visibility buffer stores the instance index and the geometry index within the mesh in x,
+// and the primitive index in y. Cleared to all ones where nothing was drawn.
+#define VISIBILITY_INSTANCE_BITS 20
+#define VISIBILITY_INSTANCE_MASK ((1u << VISIBILITY_INSTANCE_BITS) - 1)
+#define VISIBILITY_MAX_GEOMETRIES_PER_MESH (1u << (32 - VISIBILITY_INSTANCE_BITS))
+#define VISIBILITY_EMPTY 0xffffffffu
+
+struct VisibilityBufferConstants
+{
+    PlanarViewConstants view;
+    PlanarViewConstants viewPrev;
+
+    uint2 tileCount;
+    uint numMaterials;
+    // Entries that fit into the tile list; bins past it are dropped
+    uint tileListCapacity;
+};
+
+struct VisibilityDrawConstants
+{
+    uint instanceIndex;
+    uint geometryInMesh;
+};
+
+// One entry per tile and material that occurs in it, sorted by material
+struct VisibilityTileEntry
+{
+    uint tile; // x in the low 16 bits, y in the high 16 bits
+    uint material;
+};
+
+#endif // VISIBILITY_BUFFER_CB_H